@@ -0,0 +1,72 @@
+// Host variant of the on-target benchmark (CONFIG_USE_BENCHMARK), limited to the platform-free
+// cases. Prints the same "BENCHMARK {json}" line, for scripts/benchmark_report.py:
+//   build-host/host_benchmark > host.log && python scripts/benchmark_report.py host.log
+#include "benchmark_cases.h"
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iterator>
+#include <new>
+
+#if __has_include(<cJSON.h>)
+#include <cJSON.h>
+#endif
+
+// AUDIO_CODEC_DMA_FRAME_NUM and AUDIO_CODEC_DMA_DESC_NUM of audio_codec.h
+#define HOST_DMA_FRAME_NUM 240
+#define HOST_DMA_DESC_NUM 6
+
+// Every heap allocation of C++ code and of cJSON is counted, for the "allocs" of the reports
+static std::atomic<uint32_t> allocations{0};
+
+static void* CountedMalloc(size_t size) {
+    allocations++;
+    return malloc(size);
+}
+
+void* operator new(size_t size) {
+    if (void* pointer = CountedMalloc(size)) {
+        return pointer;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* pointer) noexcept {
+    free(pointer);
+}
+
+void operator delete(void* pointer, size_t size) noexcept {
+    free(pointer);
+}
+
+int main() {
+    BenchmarkReport::allocation_count = []() -> uint32_t { return allocations; };
+#if __has_include(<cJSON.h>)
+    cJSON_Hooks hooks = {CountedMalloc, free};
+    cJSON_InitHooks(&hooks);
+#endif
+
+    std::ifstream file(ASSETS_DIR "/common/success.ogg", std::ios::binary);
+    std::string ogg(std::istreambuf_iterator<char>(file), {});
+    if (ogg.empty()) {
+        fprintf(stderr, "Can not read %s\n", ASSETS_DIR "/common/success.ogg");
+        return 1;
+    }
+
+    BenchmarkReport report;
+    PortableBenchmarks::RunOggDemux(report, ogg);
+    PortableBenchmarks::RunControlMessages(report);
+    PortableBenchmarks::RunPlaybackClock(report, HOST_DMA_FRAME_NUM, HOST_DMA_DESC_NUM);
+    PortableBenchmarks::RunReferenceDelay(report);
+    PortableBenchmarks::RunInputSettling(report);
+#if __has_include(<cJSON.h>)
+    PortableBenchmarks::RunMcpDispatch(report);
+#endif
+
+    // cpu_mhz is unknown on the host, the baseline is only comparable on the same machine
+    printf("BENCHMARK {\"board\":\"host\",\"version\":\"host\",\"cpu_mhz\":0,\"results\":%s}\n",
+        report.ToJson().c_str());
+    return 0;
+}
@@ -0,0 +1,158 @@
+#include "host_test.h"
+#include "afsk_demod.h"
+
+#include <algorithm>
+#include <cstring>
+#include <optional>
+
+using namespace audio_wifi_config;
+
+namespace {
+
+// The microphone rate of AudioService, ReceiveWifiCredentialsFromAudio reads 30 ms chunks of it
+constexpr int kInputSampleRate = 16000;
+constexpr size_t kChunkSamples = 480;
+const std::string kCredentials = "AP\npw1234";
+
+struct Wav {
+    int sample_rate = 0;
+    std::vector<int16_t> samples;
+};
+
+// Mono 16-bit PCM WAV, as built by scripts/sonic_wifi_config.html
+Wav ReadWav(const std::string& path) {
+    Wav wav;
+    std::string data = host_test::ReadFile(path);
+    if (data.size() < 12 || data.compare(0, 4, "RIFF") != 0 || data.compare(8, 4, "WAVE") != 0) {
+        return wav;
+    }
+    size_t offset = 12;
+    while (offset + 8 <= data.size()) {
+        uint32_t size;
+        memcpy(&size, data.data() + offset + 4, 4);
+        if (data.compare(offset, 4, "fmt ") == 0) {
+            int32_t rate;
+            memcpy(&rate, data.data() + offset + 12, 4);
+            wav.sample_rate = rate;
+        } else if (data.compare(offset, 4, "data") == 0) {
+            size = std::min<size_t>(size, data.size() - offset - 8);
+            wav.samples.resize(size / 2);
+            memcpy(wav.samples.data(), data.data() + offset + 8, wav.samples.size() * 2);
+        }
+        offset += 8 + size + (size & 1);
+    }
+    return wav;
+}
+
+// Linear interpolation, the phone plays 44.1 kHz and the device captures at 16 kHz
+std::vector<int16_t> Resample(const std::vector<int16_t>& in, int from_rate, int to_rate) {
+    std::vector<int16_t> out(static_cast<size_t>(in.size()) * to_rate / from_rate);
+    for (size_t i = 0; i < out.size(); i++) {
+        double position = static_cast<double>(i) * from_rate / to_rate;
+        size_t index = static_cast<size_t>(position);
+        double fraction = position - index;
+        int16_t next = index + 1 < in.size() ? in[index + 1] : in[index];
+        out[i] = static_cast<int16_t>(in[index] * (1 - fraction) + next * fraction);
+    }
+    return out;
+}
+
+std::vector<int16_t> LoadCapture() {
+    Wav wav = ReadWav(TEST_DATA_DIR "/afsk_wifi.wav");
+    if (wav.sample_rate == 0) {
+        return {};
+    }
+    return Resample(wav.samples, wav.sample_rate, kInputSampleRate);
+}
+
+// Room noise and a quieter speaker: scales the tones and adds uniform noise of the given peak
+std::vector<int16_t> Degrade(std::vector<int16_t> samples, float gain, int noise_peak, uint32_t seed = 1) {
+    for (auto& sample : samples) {
+        seed = seed * 1103515245 + 12345;
+        int noise = static_cast<int>((seed >> 16) % (2 * noise_peak + 1)) - noise_peak;
+        sample = static_cast<int16_t>(std::clamp(static_cast<int>(sample * gain) + noise, -32768, 32767));
+    }
+    return samples;
+}
+
+// Runs the capture through the decoder as ReceiveWifiCredentialsFromAudio does
+std::optional<std::string> Decode(const std::vector<int16_t>& capture, int input_sample_rate = kInputSampleRate) {
+    AudioSignalProcessor processor(kAudioSampleRate, kMarkFrequency, kSpaceFrequency, kBitRate, kWindowSize,
+        input_sample_rate);
+    AudioDataBuffer buffer;
+    for (size_t offset = 0; offset < capture.size(); offset += kChunkSamples) {
+        size_t end = std::min(offset + kChunkSamples, capture.size());
+        std::vector<int16_t> chunk(capture.begin() + offset, capture.begin() + end);
+        if (buffer.ProcessProbabilityData(processor.ProcessAudioSamples(chunk), 0.5f)) {
+            return buffer.decoded_text;
+        }
+    }
+    return std::nullopt;
+}
+
+// The recording starts before the phone plays and goes on after it stops, with some room noise
+std::vector<int16_t> WithLeadIn(const std::vector<int16_t>& capture, size_t lead_samples) {
+    std::vector<int16_t> out = Degrade(std::vector<int16_t>(lead_samples, 0), 1, 200, 7);
+    out.insert(out.end(), capture.begin(), capture.end());
+    auto tail = Degrade(std::vector<int16_t>(kInputSampleRate / 4, 0), 1, 200, 11);
+    out.insert(out.end(), tail.begin(), tail.end());
+    return out;
+}
+
+} // namespace
+
+TEST(DecodesTheWebPageRecording) {
+    auto capture = LoadCapture();
+    CHECK(!capture.empty());
+    auto text = Decode(WithLeadIn(capture, kInputSampleRate / 4));
+    CHECK(text.has_value());
+    CHECK_EQ(kCredentials, *text);
+}
+
+TEST(DecodesAtTheWebPageRate) {
+    // Decimation also works straight from the 44.1 kHz file
+    Wav wav = ReadWav(TEST_DATA_DIR "/afsk_wifi.wav");
+    CHECK_EQ(44100, wav.sample_rate);
+    std::vector<int16_t> capture(wav.sample_rate / 4, 0);
+    capture.insert(capture.end(), wav.samples.begin(), wav.samples.end());
+    auto text = Decode(capture, wav.sample_rate);
+    CHECK(text.has_value());
+    CHECK_EQ(kCredentials, *text);
+}
+
+TEST(DecodesMisalignedStarts) {
+    auto capture = LoadCapture();
+    // Offsets across one bit (160 samples at 16 kHz) and across the 30 ms read chunks
+    for (size_t lead : {1u, 37u, 80u, 113u, 159u, 481u, 3001u}) {
+        auto text = Decode(WithLeadIn(capture, kInputSampleRate / 4 + lead));
+        CHECK(text.has_value());
+        CHECK_EQ(kCredentials, *text);
+    }
+}
+
+TEST(DecodesTheSecondLoopWhenRecordingStartsMidway) {
+    // The page loops the sound, a capture may start in the middle of the first one
+    auto capture = LoadCapture();
+    std::vector<int16_t> looped(capture.begin() + capture.size() / 3, capture.end());
+    looped.insert(looped.end(), capture.begin(), capture.end());
+    auto text = Decode(WithLeadIn(looped, 0));
+    CHECK(text.has_value());
+    CHECK_EQ(kCredentials, *text);
+}
+
+TEST(DecodesQuietAndNoisyRecordings) {
+    auto capture = LoadCapture();
+    // About 20 dB and 6 dB of signal to noise
+    for (auto [gain, noise] : {std::pair<float, int>{0.05f, 280}, std::pair<float, int>{0.25f, 7000}}) {
+        auto text = Decode(WithLeadIn(Degrade(capture, gain, noise), kInputSampleRate / 4));
+        CHECK(text.has_value());
+        CHECK_EQ(kCredentials, *text);
+    }
+}
+
+TEST(IgnoresNoiseAndTruncatedRecordings) {
+    CHECK(!Decode(Degrade(std::vector<int16_t>(kInputSampleRate * 3, 0), 1, 8000)).has_value());
+    auto capture = LoadCapture();
+    capture.resize(capture.size() * 3 / 4);
+    CHECK(!Decode(WithLeadIn(capture, kInputSampleRate / 4)).has_value());
+}
@@ -0,0 +1,89 @@
+#include "host_test.h"
+#include "audio_mixer.h"
+
+namespace {
+
+// As in AudioService, 60 ms mix frames at the codec output rate
+constexpr int kSampleRate = 24000;
+constexpr int kFrameSamples = kSampleRate * 60 / 1000;
+// MAX_PLAYBACK_TASKS_IN_QUEUE of AudioService
+constexpr int kMaxQueuedFrames = 2;
+
+std::vector<int16_t> MakePacket(int samples, int16_t value) {
+    return std::vector<int16_t>(samples, value);
+}
+
+} // namespace
+
+TEST(TwentyMsPacketsFillAMixFrame) {
+    AudioMixer mixer;
+    mixer.Configure(kFrameSamples, kSampleRate);
+    const uint32_t pending = AUDIO_STREAM_BIT(kAudioStreamTts);
+    const int packet_samples = kSampleRate * 20 / 1000;
+
+    // The decode task of AudioService: decode while the stream is not full, then wait for the mixer
+    int16_t next = 0;
+    for (int round = 0; round < 10; round++) {
+        while (!mixer.IsFull(kAudioStreamTts, kMaxQueuedFrames)) {
+            mixer.Push(kAudioStreamTts, MakePacket(packet_samples, next++), 0);
+        }
+        CHECK(mixer.HasFrame(pending));
+
+        std::vector<int16_t> out;
+        uint32_t timestamp;
+        CHECK_EQ(AUDIO_STREAM_BIT(kAudioStreamTts), mixer.Mix(pending, out, timestamp));
+        CHECK_EQ(static_cast<size_t>(kFrameSamples), out.size());
+        // Packets come out whole and in order
+        CHECK_EQ(static_cast<int16_t>(round * 3), out.front());
+        CHECK_EQ(static_cast<int16_t>(round * 3 + 2), out.back());
+    }
+}
+
+TEST(WaitsForAFullFrameWhileDecoding) {
+    AudioMixer mixer;
+    mixer.Configure(kFrameSamples, kSampleRate);
+    mixer.Push(kAudioStreamTts, MakePacket(kFrameSamples / 3, 1), 0);
+    CHECK(!mixer.HasFrame(AUDIO_STREAM_BIT(kAudioStreamTts)));
+    CHECK(!mixer.IsFull(kAudioStreamTts, kMaxQueuedFrames));
+
+    // Once the stream has nothing more to decode, the rest is played as a short frame
+    std::vector<int16_t> out;
+    uint32_t timestamp;
+    CHECK(mixer.HasFrame(0));
+    CHECK_EQ(AUDIO_STREAM_BIT(kAudioStreamTts), mixer.Mix(0, out, timestamp));
+    CHECK_EQ(static_cast<size_t>(kFrameSamples / 3), out.size());
+    CHECK(mixer.IsEmpty());
+}
+
+TEST(TimestampFollowsPlayedSamples) {
+    AudioMixer mixer;
+    mixer.Configure(kFrameSamples, kSampleRate);
+    const int packet_samples = kSampleRate * 40 / 1000;
+    mixer.Push(kAudioStreamTts, MakePacket(packet_samples, 0), 1000);
+    mixer.Push(kAudioStreamTts, MakePacket(packet_samples, 0), 1040);
+
+    std::vector<int16_t> out;
+    uint32_t timestamp;
+    mixer.Mix(0, out, timestamp);
+    CHECK_EQ(1000u, timestamp);
+    // The second frame starts 20 ms into the second packet
+    mixer.Mix(0, out, timestamp);
+    CHECK_EQ(1060u, timestamp);
+}
+
+TEST(UiSoundDucksSpeech) {
+    AudioMixer mixer;
+    mixer.Configure(kFrameSamples, kSampleRate);
+    mixer.Push(kAudioStreamTts, MakePacket(kFrameSamples * 2, 10000), 0);
+    mixer.Push(kAudioStreamUi, MakePacket(kFrameSamples * 2, 0), 0);
+
+    std::vector<int16_t> out;
+    uint32_t timestamp;
+    uint32_t both = AUDIO_STREAM_BIT(kAudioStreamTts) | AUDIO_STREAM_BIT(kAudioStreamUi);
+    CHECK_EQ(both, mixer.Mix(0, out, timestamp));
+    // The gain ramps down to -6 dB over the first frame and stays there
+    CHECK(out.front() > 9900);
+    mixer.Mix(0, out, timestamp);
+    CHECK(out.front() < 5100 && out.front() > 4900);
+    CHECK(out.back() < 5100 && out.back() > 4900);
+}
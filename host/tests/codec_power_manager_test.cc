@@ -0,0 +1,68 @@
+#include "host_test.h"
+#include "codec_power_manager.h"
+
+#include <cmath>
+#include <vector>
+
+namespace {
+
+constexpr int kSampleRate = 16000;
+constexpr int kBlockFrames = kSampleRate * AUDIO_INPUT_SETTLE_BLOCK_MS / 1000;
+
+// Mic noise floor of about 16 LSB, with the power-up pop of a codec starting after zeros_ms
+std::vector<int16_t> MakeInput(int zeros_ms, bool pop) {
+    std::vector<int16_t> pcm(kSampleRate * AUDIO_INPUT_SETTLE_MAX_MS / 1000, 0);
+    uint32_t seed = 1;
+    for (size_t i = kSampleRate * zeros_ms / 1000, n = 0; i < pcm.size(); i++, n++) {
+        seed = seed * 1103515245 + 12345;
+        float t = static_cast<float>(n) / kSampleRate;
+        float level = pop ? 2000 * expf(-t / 0.02f) + 4000 * expf(-t / 0.025f) * sinf(2 * M_PI * 760 * t) : 0;
+        pcm[i] = static_cast<int16_t>(level + static_cast<int16_t>(seed >> 16) / 1024);
+    }
+    return pcm;
+}
+
+int SettleMs(const std::vector<int16_t>& pcm) {
+    CodecPowerManager manager;
+    manager.StartInputSettling();
+    for (size_t offset = 0; offset + kBlockFrames <= pcm.size(); offset += kBlockFrames) {
+        if (manager.OnInputSettlingBlock(pcm.data() + offset, kBlockFrames, 1)) {
+            return (offset + kBlockFrames) * 1000 / kSampleRate;
+        }
+    }
+    return -1;
+}
+
+} // namespace
+
+TEST(SteadyNoiseSettlesAfterTwoBlocks) {
+    CHECK_EQ(2 * AUDIO_INPUT_SETTLE_BLOCK_MS, SettleMs(MakeInput(0, false)));
+}
+
+TEST(WaitsForThePopToDecay) {
+    int settle_ms = SettleMs(MakeInput(0, true));
+    CHECK(settle_ms > 2 * AUDIO_INPUT_SETTLE_BLOCK_MS);
+    CHECK(settle_ms < AUDIO_INPUT_SETTLE_MAX_MS);
+}
+
+TEST(LeadingZerosDoNotCountAsSettled) {
+    int settle_ms = SettleMs(MakeInput(0, true));
+    for (int zeros_ms : {20, 30, 50}) {
+        // The pop after the zeros decays as it does without them
+        CHECK_EQ(zeros_ms + settle_ms, SettleMs(MakeInput(zeros_ms, true)));
+    }
+}
+
+TEST(DigitalSilenceGivesUpAtTheMaximum) {
+    CHECK_EQ(AUDIO_INPUT_SETTLE_MAX_MS, SettleMs(MakeInput(AUDIO_INPUT_SETTLE_MAX_MS, false)));
+}
+
+TEST(StartInputSettlingForgetsTheLastBlock) {
+    auto noise = MakeInput(0, false);
+    CodecPowerManager manager;
+    manager.StartInputSettling();
+    CHECK(!manager.OnInputSettlingBlock(noise.data(), kBlockFrames, 1));
+    manager.StartInputSettling();
+    CHECK(!manager.OnInputSettlingBlock(noise.data(), kBlockFrames, 1));
+    CHECK(manager.OnInputSettlingBlock(noise.data() + kBlockFrames, kBlockFrames, 1));
+}
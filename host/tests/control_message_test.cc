@@ -0,0 +1,51 @@
+#include "host_test.h"
+#include "control_message.h"
+
+namespace {
+
+bool Parse(ControlMessage& message, const std::string& json) {
+    return message.Parse(json.data(), json.size());
+}
+
+} // namespace
+
+TEST(ParsesTtsSentence) {
+    std::string json = "{\"type\":\"tts\",\"state\":\"sentence_start\","
+        "\"text\":\"\\u4eca\\u5929 \\\"ok\\\"\",\"session_id\":\"a1b2\"}";
+    ControlMessage message;
+    CHECK(Parse(message, json));
+    CHECK_EQ(kControlMessageTts, message.type);
+    CHECK_EQ(kControlMessageStateSentenceStart, message.state);
+    CHECK_EQ(std::string_view("a1b2"), message.session_id);
+    CHECK_EQ(std::string("今天 \"ok\""), message.GetString(message.text));
+}
+
+TEST(KeepsPayloadAsRawJson) {
+    std::string json = "{ \"session_id\" : \"s\", \"type\" : \"mcp\", "
+        "\"payload\" : {\"jsonrpc\":\"2.0\",\"params\":{\"text\":\"}\"}} }";
+    ControlMessage message;
+    CHECK(Parse(message, json));
+    CHECK_EQ(kControlMessageMcp, message.type);
+    CHECK_EQ(std::string_view("{\"jsonrpc\":\"2.0\",\"params\":{\"text\":\"}\"}}"), message.payload);
+}
+
+TEST(RejectsMissingFields) {
+    ControlMessage message;
+    CHECK(!Parse(message, "{\"state\":\"start\"}"));
+    ControlMessage tts;
+    CHECK(!Parse(tts, "{\"type\":\"tts\"}"));
+    ControlMessage truncated;
+    CHECK(!Parse(truncated, "{\"type\":\"tts\",\"state\":\"st"));
+    ControlMessage not_object;
+    CHECK(!Parse(not_object, "[1, 2]"));
+}
+
+TEST(AcceptsUnknownTypesAndStates) {
+    // The fields are views into the frame
+    std::string json = "{\"type\":\"future\",\"state\":\"paused\",\"extra\":[1,{\"a\":2}],\"n\":3}";
+    ControlMessage message;
+    CHECK(Parse(message, json));
+    CHECK_EQ(kControlMessageUnknown, message.type);
+    CHECK_EQ(kControlMessageStateUnknown, message.state);
+    CHECK_EQ(std::string_view("future"), message.type_name);
+}
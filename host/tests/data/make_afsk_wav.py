@@ -0,0 +1,53 @@
+#!/usr/bin/env python3
+"""
+生成与 scripts/sonic_wifi_config.html 相同的声波配网 WAV，作为 afsk_demod_test 的测试数据。
+算法逐行对应网页中的 generate()：44.1 kHz、单声道、16 位，Mark 1800 Hz / Space 1500 Hz，100 bps，
+数据为 0x01 0x02 + "SSID\\n密码" + 校验和 + 0x03 0x04。
+
+用法：
+    python3 make_afsk_wav.py <ssid> <password> <output.wav>
+"""
+import math
+import struct
+import sys
+
+MARK = 1800
+SPACE = 1500
+SAMPLE_RATE = 44100
+BIT_RATE = 100
+START_BYTES = [0x01, 0x02]
+END_BYTES = [0x03, 0x04]
+
+
+def modulate(ssid, password):
+    text_bytes = list((ssid + "\n" + password).encode("utf-8"))
+    full_bytes = START_BYTES + text_bytes + [sum(text_bytes) & 0xFF] + END_BYTES
+    bits = [(byte >> i) & 1 for byte in full_bytes for i in range(7, -1, -1)]
+
+    samples_per_bit = SAMPLE_RATE // BIT_RATE
+    pcm = bytearray()
+    for i, bit in enumerate(bits):
+        freq = MARK if bit else SPACE
+        for j in range(samples_per_bit):
+            t = (i * samples_per_bit + j) / SAMPLE_RATE
+            s = max(-1.0, min(1.0, math.sin(2 * math.pi * freq * t)))
+            # 与网页的 floatTo16BitPCM 一样按位运算截断为整数
+            value = int(s * 0x8000 if s < 0 else s * 0x7FFF)
+            pcm += struct.pack("<h", value)
+    return bytes(pcm)
+
+
+def main():
+    if len(sys.argv) != 4:
+        print(__doc__)
+        sys.exit(1)
+    pcm = modulate(sys.argv[1], sys.argv[2])
+    header = b"RIFF" + struct.pack("<I", 36 + len(pcm)) + b"WAVE"
+    header += b"fmt " + struct.pack("<IHHIIHH", 16, 1, 1, SAMPLE_RATE, SAMPLE_RATE * 2, 2, 16)
+    header += b"data" + struct.pack("<I", len(pcm))
+    with open(sys.argv[3], "wb") as f:
+        f.write(header + pcm)
+
+
+if __name__ == "__main__":
+    main()
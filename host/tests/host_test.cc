@@ -0,0 +1,53 @@
+#include "host_test.h"
+
+#include <fstream>
+#include <iterator>
+#include <vector>
+
+namespace host_test {
+
+namespace {
+
+struct Test {
+    const char* name;
+    std::function<void()> fn;
+};
+
+std::vector<Test>& Tests() {
+    static std::vector<Test> tests;
+    return tests;
+}
+
+bool failed = false;
+
+} // namespace
+
+void Register(const char* name, std::function<void()> fn) {
+    Tests().push_back({name, std::move(fn)});
+}
+
+void Fail(const char* file, int line, const std::string& message) {
+    fprintf(stderr, "%s:%d: CHECK failed: %s\n", file, line, message.c_str());
+    failed = true;
+}
+
+std::string ReadFile(const std::string& path) {
+    std::ifstream file(path, std::ios::binary);
+    return std::string(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+}
+
+} // namespace host_test
+
+int main() {
+    int failures = 0;
+    for (auto& test : host_test::Tests()) {
+        host_test::failed = false;
+        test.fn();
+        printf("[%s] %s\n", host_test::failed ? "FAIL" : " OK ", test.name);
+        if (host_test::failed) {
+            failures++;
+        }
+    }
+    printf("%zu tests, %d failed\n", host_test::Tests().size(), failures);
+    return failures;
+}
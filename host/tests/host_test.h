@@ -0,0 +1,54 @@
+#ifndef HOST_TEST_H
+#define HOST_TEST_H
+
+// A minimal test runner for the host build, without dependencies:
+//   TEST(Name) { CHECK(condition); CHECK_EQ(expected, actual); }
+// Every test of the executable runs, the exit code is the number of failed tests.
+
+#include <cstdio>
+#include <functional>
+#include <sstream>
+#include <string>
+
+namespace host_test {
+
+void Register(const char* name, std::function<void()> fn);
+void Fail(const char* file, int line, const std::string& message);
+// Contents of a file, empty if it can not be read
+std::string ReadFile(const std::string& path);
+
+struct Registrar {
+    Registrar(const char* name, std::function<void()> fn) { Register(name, std::move(fn)); }
+};
+
+template<typename A, typename B>
+std::string Describe(const char* expected_text, const char* actual_text, const A& expected, const B& actual) {
+    std::ostringstream out;
+    out << expected_text << " == " << actual_text << " (" << expected << " vs " << actual << ")";
+    return out.str();
+}
+
+} // namespace host_test
+
+#define TEST(name) \
+    static void name(); \
+    static host_test::Registrar name##_registrar(#name, name); \
+    static void name()
+
+#define CHECK(condition) do { \
+    if (!(condition)) { \
+        host_test::Fail(__FILE__, __LINE__, #condition); \
+        return; \
+    } \
+} while (0)
+
+#define CHECK_EQ(expected, actual) do { \
+    auto&& e_ = (expected); \
+    auto&& a_ = (actual); \
+    if (!(e_ == a_)) { \
+        host_test::Fail(__FILE__, __LINE__, host_test::Describe(#expected, #actual, e_, a_)); \
+        return; \
+    } \
+} while (0)
+
+#endif // HOST_TEST_H
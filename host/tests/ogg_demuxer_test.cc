@@ -0,0 +1,88 @@
+#include "host_test.h"
+#include "ogg_demuxer.h"
+
+#include <vector>
+
+namespace {
+
+// One Ogg page holding the given packets, laced into 255 byte segments
+std::string MakePage(const std::vector<std::string>& packets) {
+    std::string segments;
+    std::string body;
+    for (auto& packet : packets) {
+        size_t left = packet.size();
+        while (left >= 255) {
+            segments += static_cast<char>(255);
+            left -= 255;
+        }
+        segments += static_cast<char>(left);
+        body += packet;
+    }
+    std::string page = "OggS";
+    page.resize(26, '\0');
+    page += static_cast<char>(segments.size());
+    return page + segments + body;
+}
+
+std::string MakeOpusHead(uint32_t sample_rate) {
+    std::string head = "OpusHead";
+    head += '\x01';  // version
+    head += '\x01';  // channels
+    head += std::string(2, '\0');  // pre-skip
+    for (int i = 0; i < 4; i++) {
+        head += static_cast<char>((sample_rate >> (i * 8)) & 0xff);
+    }
+    head += std::string(3, '\0');  // gain, mapping family
+    return head;
+}
+
+} // namespace
+
+TEST(DemuxesPromptSound) {
+    auto ogg = host_test::ReadFile(ASSETS_DIR "/common/success.ogg");
+    CHECK(!ogg.empty());
+    size_t bytes = 0;
+    bool rates_match = true;
+    size_t count = OggDemuxer::Demux(ogg, [&](int sample_rate, const uint8_t* data, size_t size) {
+        rates_match &= sample_rate == 16000;
+        bytes += size;
+    });
+    CHECK(count > 0);
+    CHECK(rates_match);
+    CHECK(bytes < ogg.size());
+}
+
+TEST(SkipsHeadersAndReadsSampleRate) {
+    auto ogg = MakePage({MakeOpusHead(24000)}) + MakePage({"OpusTags" + std::string(8, '\0')}) +
+        MakePage({"abc", "defg"});
+    std::vector<std::string> packets;
+    int rate = 0;
+    CHECK_EQ(2u, OggDemuxer::Demux(ogg, [&](int sample_rate, const uint8_t* data, size_t size) {
+        rate = sample_rate;
+        packets.emplace_back(reinterpret_cast<const char*>(data), size);
+    }));
+    CHECK_EQ(24000, rate);
+    CHECK_EQ(std::string("abc"), packets[0]);
+    CHECK_EQ(std::string("defg"), packets[1]);
+}
+
+TEST(JoinsLacedSegments) {
+    std::string big(600, 'x');
+    auto ogg = MakePage({MakeOpusHead(16000)}) + MakePage({"OpusTags"}) + MakePage({big, "y"});
+    std::vector<size_t> sizes;
+    OggDemuxer::Demux(ogg, [&](int sample_rate, const uint8_t* data, size_t size) {
+        sizes.push_back(size);
+    });
+    CHECK_EQ(2u, sizes.size());
+    CHECK_EQ(600u, sizes[0]);
+    CHECK_EQ(1u, sizes[1]);
+}
+
+TEST(StopsAtTruncatedPage) {
+    auto ogg = MakePage({MakeOpusHead(16000)}) + MakePage({"OpusTags"}) + MakePage({"first"}) +
+        MakePage({"second"});
+    ogg.resize(ogg.size() - 3);
+    CHECK_EQ(1u, OggDemuxer::Demux(ogg, [](int, const uint8_t*, size_t) {}));
+    CHECK_EQ(0u, OggDemuxer::Demux("", [](int, const uint8_t*, size_t) {}));
+    CHECK_EQ(0u, OggDemuxer::Demux("not an ogg stream", [](int, const uint8_t*, size_t) {}));
+}
@@ -0,0 +1,87 @@
+#include "host_test.h"
+#include "reference_delay_estimator.h"
+
+#include <cmath>
+
+namespace {
+
+constexpr int kSampleRate = 16000;
+constexpr int kChunkFrames = 256;
+
+// Mic on channel 0, reference on channel 1. The reference is noise with a syllable-like
+// envelope, the mic hears it echo_delay_ms later at half the level plus some noise.
+class EchoSource {
+public:
+    explicit EchoSource(int echo_delay_ms)
+        : echo_delay_(echo_delay_ms * kSampleRate / 1000), reference_(kSampleRate), chunk_(kChunkFrames * 2) {}
+
+    int16_t* Next(bool playing = true) {
+        for (int i = 0; i < kChunkFrames; i++, position_++) {
+            seed_ = seed_ * 1103515245 + 12345;
+            float t = static_cast<float>(position_) / kSampleRate;
+            float envelope = playing ? sinf(2 * M_PI * 3.7f * t) * sinf(2 * M_PI * 1.3f * t) : 0;
+            size_t index = position_ % reference_.size();
+            reference_[index] = static_cast<int16_t>(envelope * envelope * (static_cast<int16_t>(seed_ >> 16) / 4));
+            int16_t echo = position_ >= echo_delay_ ? reference_[(position_ - echo_delay_) % reference_.size()] / 2 : 0;
+            chunk_[i * 2] = echo + static_cast<int16_t>(seed_ & 0xff) - 128;
+            chunk_[i * 2 + 1] = reference_[index];
+        }
+        return chunk_.data();
+    }
+
+private:
+    size_t echo_delay_;
+    std::vector<int16_t> reference_;
+    std::vector<int16_t> chunk_;
+    uint32_t seed_ = 1;
+    size_t position_ = 0;
+};
+
+// Chunks in the given milliseconds of audio
+int Chunks(int ms) {
+    return ms * kSampleRate / 1000 / kChunkFrames;
+}
+
+} // namespace
+
+TEST(LocksOnTheEchoDelay) {
+    ReferenceDelayEstimator estimator;
+    estimator.Configure(kSampleRate, 2, 1);
+    EchoSource source(48);
+    bool changed = false;
+    for (int i = 0; i < Chunks(6000); i++) {
+        changed |= estimator.Process(source.Next(), kChunkFrames);
+    }
+    CHECK(changed);
+    CHECK(estimator.locked());
+    CHECK(std::abs(estimator.delay_ms() - 48) <= 2);
+    CHECK(estimator.reference_active());
+}
+
+TEST(NeedsTwoEstimatesToLock) {
+    ReferenceDelayEstimator estimator;
+    estimator.Configure(kSampleRate, 2, 1);
+    EchoSource source(30);
+    // The first estimate is taken once the 1024 ms window is full, it is only a candidate
+    for (int i = 0; i < Chunks(1100); i++) {
+        estimator.Process(source.Next(), kChunkFrames);
+    }
+    CHECK(!estimator.locked());
+    // The next one, 500 ms later, confirms it
+    for (int i = 0; i < Chunks(600); i++) {
+        estimator.Process(source.Next(), kChunkFrames);
+    }
+    CHECK(estimator.locked());
+    CHECK(std::abs(estimator.delay_ms() - 30) <= 2);
+}
+
+TEST(IgnoresSilentReference) {
+    ReferenceDelayEstimator estimator;
+    estimator.Configure(kSampleRate, 2, 1);
+    EchoSource source(48);
+    for (int i = 0; i < Chunks(4000); i++) {
+        CHECK(!estimator.Process(source.Next(false), kChunkFrames));
+    }
+    CHECK(!estimator.locked());
+    CHECK(!estimator.reference_active());
+}
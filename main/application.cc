@@ -10,6 +10,14 @@
 #endif
 #include "assets/lang_config.h"
 #include "mcp_server.h"
+#include "metrics.h"
+#include "tracer.h"
+#if CONFIG_USE_BENCHMARK
+#include "benchmark.h"
+#endif
+#if CONFIG_USE_POWER_GOVERNOR
+#include "power_governor.h"
+#endif
 
 #include <cstring>
 #include <esp_log.h>
@@ -208,7 +216,7 @@ void Application::ShowActivationCode(const std::string& code, const std::string&
         auto it = std::find_if(digit_sounds.begin(), digit_sounds.end(),
             [digit](const digit_sound& ds) { return ds.digit == digit; });
         if (it != digit_sounds.end()) {
-            audio_service_.PlaySound(it->sound);
+            audio_service_.PlaySound(it->sound, kAudioStreamAlert);
         }
     }
 }
@@ -220,7 +228,7 @@ void Application::Alert(const char* status, const char* message, const char* emo
     display->SetEmotion(emotion);
     display->SetChatMessage("system", message);
     if (!sound.empty()) {
-        audio_service_.PlaySound(sound);
+        audio_service_.PlaySound(sound, kAudioStreamAlert);
     }
 }
 
@@ -254,14 +262,10 @@ void Application::ToggleChatState() {
 
     if (device_state_ == kDeviceStateIdle) {
         Schedule([this]() {
-            if (!protocol_->IsAudioChannelOpened()) {
-                SetDeviceState(kDeviceStateConnecting);
-                if (!protocol_->OpenAudioChannel()) {
-                    return;
-                }
-            }
-
-            SetListeningMode(aec_mode_ == kAecOff ? kListeningModeAutoStop : kListeningModeRealtime);
+            Tracer::GetInstance().NewTurn();
+            OpenAudioChannelAsync([this]() {
+                SetListeningMode(aec_mode_ == kAecOff ? kListeningModeAutoStop : kListeningModeRealtime);
+            });
         });
     } else if (device_state_ == kDeviceStateSpeaking) {
         Schedule([this]() {
@@ -291,14 +295,10 @@ void Application::StartListening() {
     
     if (device_state_ == kDeviceStateIdle) {
         Schedule([this]() {
-            if (!protocol_->IsAudioChannelOpened()) {
-                SetDeviceState(kDeviceStateConnecting);
-                if (!protocol_->OpenAudioChannel()) {
-                    return;
-                }
-            }
-
-            SetListeningMode(kListeningModeManualStop);
+            Tracer::GetInstance().NewTurn();
+            OpenAudioChannelAsync([this]() {
+                SetListeningMode(kListeningModeManualStop);
+            });
         });
     } else if (device_state_ == kDeviceStateSpeaking) {
         Schedule([this]() {
@@ -308,6 +308,28 @@ void Application::StartListening() {
     }
 }
 
+void Application::PrepareAudioChannel() {
+#if CONFIG_WEBSOCKET_SPECULATIVE_CONNECT
+    Schedule([this]() {
+        if (!protocol_ || device_state_ != kDeviceStateIdle || opening_audio_channel_ || pre_connecting_ ||
+            protocol_->IsAudioChannelOpened()) {
+            return;
+        }
+        // Connecting can take seconds, do not hold the main loop. Like OpenAudioChannelAsync, the task
+        // goes through the application, which owns the protocol, and reports back on the main loop.
+        pre_connecting_ = true;
+        xTaskCreate([](void* arg) {
+            auto app = (Application*)arg;
+            app->protocol_->PreConnect();
+            app->Schedule([app]() {
+                app->pre_connecting_ = false;
+            });
+            vTaskDelete(NULL);
+        }, "pre_connect", 2048 * 4, this, 2, nullptr);
+    });
+#endif
+}
+
 void Application::StopListening() {
     if (device_state_ == kDeviceStateAudioTesting) {
         audio_service_.EnableAudioTesting(false);
@@ -346,7 +368,18 @@ void Application::Start() {
     /* Setup the audio service */
     auto codec = board.GetAudioCodec();
     audio_service_.Initialize(codec);
+
+#if CONFIG_USE_BENCHMARK
+    // The benchmark measures the full tools list, add the common tools here instead of
+    // before initializing the protocol. Run before the audio tasks start so the results
+    // are not disturbed by them
+    McpServer::GetInstance().AddCommonTools();
+    Benchmark::Run();
+#endif
     audio_service_.Start();
+#if CONFIG_USE_POWER_GOVERNOR
+    PowerGovernor::GetInstance().Start();
+#endif
 
     AudioServiceCallbacks callbacks;
     callbacks.on_send_queue_available = [this]() {
@@ -356,6 +389,10 @@ void Application::Start() {
         xEventGroupSetBits(event_group_, MAIN_EVENT_WAKE_WORD_DETECTED);
     };
     callbacks.on_vad_change = [this](bool speaking) {
+        // 只记录用户说完话的时刻，首包 TTS 延迟从这里开始计算
+        if (!speaking && device_state_ == kDeviceStateListening) {
+            vad_end_time_ms_ = esp_timer_get_time() / 1000;
+        }
         xEventGroupSetBits(event_group_, MAIN_EVENT_VAD_CHANGE);
     };
     audio_service_.SetCallbacks(callbacks);
@@ -384,14 +421,27 @@ void Application::Start() {
     // Initialize the protocol
     display->SetStatus(Lang::Strings::LOADING_PROTOCOL);
 
+#if !CONFIG_USE_BENCHMARK
     // Add MCP common tools before initializing the protocol
     McpServer::GetInstance().AddCommonTools();
+#endif
 
 #if CONFIG_CONNECTION_TYPE_NERTC
     protocol_ = std::make_unique<NeRtcProtocol>();
+#else
+#if CONFIG_USE_OTA_PROTOCOL_SELECTION
+    if (ota.HasMqttConfig()) {
+        protocol_ = std::make_unique<MqttProtocol>();
+    } else if (ota.HasWebsocketConfig()) {
+        protocol_ = std::make_unique<WebsocketProtocol>();
+    } else {
+        ESP_LOGW(TAG, "No protocol specified in the OTA config, using MQTT");
+        protocol_ = std::make_unique<MqttProtocol>();
+    }
 #else
     ESP_LOGW(TAG, "No protocol specified in the OTA config, using MQTT");
     protocol_ = std::make_unique<MqttProtocol>();
+#endif
 #endif
 
     protocol_->OnConnected([this]() {
@@ -403,8 +453,29 @@ void Application::Start() {
         xEventGroupSetBits(event_group_, MAIN_EVENT_ERROR);
     });
     protocol_->OnIncomingAudio([this](std::unique_ptr<AudioStreamPacket> packet) {
-        if (device_state_ == kDeviceStateSpeaking) {
-            audio_service_.PushPacketToDecodeQueue(std::move(packet));
+        uint32_t vad_end_time = vad_end_time_ms_.exchange(0);
+        if (vad_end_time != 0) {
+            Metrics::GetInstance().Observe(kMetricVadEndToFirstTtsMs, esp_timer_get_time() / 1000 - vad_end_time);
+        }
+        std::lock_guard<std::mutex> lock(downlink_mutex_);
+        if (!downlink_accepting_) {
+            // No reply in progress, or it was aborted. Over MQTT the audio comes by UDP and
+            // may overtake "tts start", keep it for a moment in case a reply is starting.
+            if (downlink_early_.size() >= MAX_DECODE_PACKETS_IN_QUEUE) {
+                downlink_early_.pop_front();
+            }
+            downlink_early_.emplace_back(esp_timer_get_time(), std::move(packet));
+            return;
+        }
+        if (downlink_playing_) {
+            if (audio_service_.PushPacketToDecodeQueue(std::move(packet))) {
+                Tracer::GetInstance().RecordFirst(kTraceFirstDownlinkQueued);
+            }
+        } else if (downlink_prebuffer_.size() < MAX_DECODE_PACKETS_IN_QUEUE) {
+            // The main loop has not switched to speaking yet
+            downlink_prebuffer_.push_back(std::move(packet));
+        } else {
+            Metrics::GetInstance().Increment(kMetricDecodeQueueDropped);
         }
     });
     protocol_->OnAudioChannelOpened([this, codec, &board]() {
@@ -417,24 +488,29 @@ void Application::Start() {
     protocol_->OnAudioChannelClosed([this, &board]() {
         board.SetPowerSaveMode(true);
         Schedule([this]() {
+            if (device_state_ == kDeviceStateListening || device_state_ == kDeviceStateSpeaking) {
+                conversation_interrupted_us_ = esp_timer_get_time();
+            }
             auto display = Board::GetInstance().GetDisplay();
             display->SetChatMessage("system", "");
             SetDeviceState(kDeviceStateIdle);
         });
     });
-    protocol_->OnIncomingJson([this, display](const cJSON* root) {
-        // Parse JSON data
-        auto type = cJSON_GetObjectItem(root, "type");
-        if (strcmp(type->valuestring, "tts") == 0) {
-            auto state = cJSON_GetObjectItem(root, "state");
-            if (strcmp(state->valuestring, "start") == 0) {
+    protocol_->OnIncomingMessage([this, display](const ControlMessage& message) {
+        switch (message.type) {
+        case kControlMessageTts:
+            if (message.state == kControlMessageStateStart) {
+                Tracer::GetInstance().Record(kTraceTtsStartReceived);
+                // Accept the reply audio right away, it may arrive before the main loop runs
+                OpenDownlink();
                 Schedule([this]() {
                     aborted_ = false;
                     if (device_state_ == kDeviceStateIdle || device_state_ == kDeviceStateListening) {
                         SetDeviceState(kDeviceStateSpeaking);
                     }
                 });
-            } else if (strcmp(state->valuestring, "stop") == 0) {
+            } else if (message.state == kControlMessageStateStop) {
+                Tracer::GetInstance().Record(kTraceTtsStopReceived);
                 Schedule([this]() {
                     if (device_state_ == kDeviceStateSpeaking) {
                         if (listening_mode_ == kListeningModeManualStop) {
@@ -452,71 +528,71 @@ void Application::Start() {
                         }
                     }
                 });
-            } else if (strcmp(state->valuestring, "sentence_start") == 0) {
-                auto text = cJSON_GetObjectItem(root, "text");
-                if (cJSON_IsString(text)) {
-                    ESP_LOGI(TAG, "<< %s", text->valuestring);
-                    Schedule([this, display, message = std::string(text->valuestring)]() {
-                        display->SetChatMessage("assistant", message.c_str());
-                    });
-                }
-            }
-        } else if (strcmp(type->valuestring, "stt") == 0) {
-            auto text = cJSON_GetObjectItem(root, "text");
-            if (cJSON_IsString(text)) {
-                ESP_LOGI(TAG, ">> %s", text->valuestring);
-                Schedule([this, display, message = std::string(text->valuestring)]() {
-                    display->SetChatMessage("user", message.c_str());
-                });
-            }
-        } else if (strcmp(type->valuestring, "llm") == 0) {
-            auto emotion = cJSON_GetObjectItem(root, "emotion");
-            if (cJSON_IsString(emotion)) {
-                Schedule([this, display, emotion_str = std::string(emotion->valuestring)]() {
-                    display->SetEmotion(emotion_str.c_str());
+            } else if (message.state == kControlMessageStateSentenceStart && !message.text.empty()) {
+                Tracer::GetInstance().Record(kTraceTtsSentenceReceived);
+                auto text = message.GetString(message.text);
+                ESP_LOGI(TAG, "<< %s", text.c_str());
+                Schedule([this, display, text = std::move(text)]() {
+                    display->SetChatMessage("assistant", text.c_str());
                 });
             }
-        } else if (strcmp(type->valuestring, "mcp") == 0) {
-            auto payload = cJSON_GetObjectItem(root, "payload");
-            if (cJSON_IsObject(payload)) {
+            break;
+        case kControlMessageStt: {
+            Tracer::GetInstance().Record(kTraceSttReceived);
+            auto text = message.GetString(message.text);
+            ESP_LOGI(TAG, ">> %s", text.c_str());
+            Schedule([this, display, text = std::move(text)]() {
+                display->SetChatMessage("user", text.c_str());
+            });
+            break;
+        }
+        case kControlMessageLlm:
+            Schedule([this, display, emotion = message.GetString(message.emotion)]() {
+                display->SetEmotion(emotion.c_str());
+            });
+            break;
+        case kControlMessageMcp: {
+            // Only the payload becomes a cJSON tree, the MCP server works on it
+            auto payload = cJSON_ParseWithLength(message.payload.data(), message.payload.size());
+            if (payload != nullptr) {
                 McpServer::GetInstance().ParseMessage(payload);
-            }
-        } else if (strcmp(type->valuestring, "system") == 0) {
-            auto command = cJSON_GetObjectItem(root, "command");
-            if (cJSON_IsString(command)) {
-                ESP_LOGI(TAG, "System command: %s", command->valuestring);
-                if (strcmp(command->valuestring, "reboot") == 0) {
-                    // Do a reboot if user requests a OTA update
-                    Schedule([this]() {
-                        Reboot();
-                    });
-                } else {
-                    ESP_LOGW(TAG, "Unknown system command: %s", command->valuestring);
-                }
-            }
-        } else if (strcmp(type->valuestring, "alert") == 0) {
-            auto status = cJSON_GetObjectItem(root, "status");
-            auto message = cJSON_GetObjectItem(root, "message");
-            auto emotion = cJSON_GetObjectItem(root, "emotion");
-            if (cJSON_IsString(status) && cJSON_IsString(message) && cJSON_IsString(emotion)) {
-                Alert(status->valuestring, message->valuestring, emotion->valuestring, Lang::Sounds::OGG_VIBRATION);
+                cJSON_Delete(payload);
             } else {
-                ESP_LOGW(TAG, "Alert command requires status, message and emotion");
+                ESP_LOGE(TAG, "Invalid MCP payload");
             }
-#if CONFIG_RECEIVE_CUSTOM_MESSAGE
-        } else if (strcmp(type->valuestring, "custom") == 0) {
-            auto payload = cJSON_GetObjectItem(root, "payload");
-            ESP_LOGI(TAG, "Received custom message: %s", cJSON_PrintUnformatted(root));
-            if (cJSON_IsObject(payload)) {
-                Schedule([this, display, payload_str = std::string(cJSON_PrintUnformatted(payload))]() {
-                    display->SetChatMessage("system", payload_str.c_str());
+            break;
+        }
+        case kControlMessageSystem: {
+            auto command = message.GetString(message.command);
+            ESP_LOGI(TAG, "System command: %s", command.c_str());
+            if (command == "reboot") {
+                // Do a reboot if user requests a OTA update
+                Schedule([this]() {
+                    Reboot();
                 });
             } else {
-                ESP_LOGW(TAG, "Invalid custom message format: missing payload");
+                ESP_LOGW(TAG, "Unknown system command: %s", command.c_str());
             }
+            break;
+        }
+        case kControlMessageAlert:
+            Alert(message.GetString(message.status).c_str(), message.GetString(message.message).c_str(),
+                message.GetString(message.emotion).c_str(), Lang::Sounds::OGG_VIBRATION);
+            break;
+#if CONFIG_RECEIVE_CUSTOM_MESSAGE
+        case kControlMessageCustom:
+            ESP_LOGI(TAG, "Received custom message: %.*s", (int)message.payload.size(), message.payload.data());
+            Schedule([this, display, payload_str = std::string(message.payload)]() {
+                display->SetChatMessage("system", payload_str.c_str());
+            });
+            break;
 #endif
-        } else {
-            ESP_LOGW(TAG, "Unknown message type: %s", type->valuestring);
+        case kControlMessageIot:
+            ESP_LOGW(TAG, "IoT commands are not supported: %.*s", (int)message.payload.size(), message.payload.data());
+            break;
+        default:
+            ESP_LOGW(TAG, "Unknown message type: %.*s", (int)message.type_name.size(), message.type_name.data());
+            break;
         }
     });
     bool protocol_started = protocol_->Start();
@@ -564,13 +640,28 @@ void Application::MainEventLoop() {
             MAIN_EVENT_ERROR, pdTRUE, pdFALSE, portMAX_DELAY);
 
         if (bits & MAIN_EVENT_ERROR) {
+            if (device_state_ == kDeviceStateListening || device_state_ == kDeviceStateSpeaking) {
+                conversation_interrupted_us_ = esp_timer_get_time();
+            }
             SetDeviceState(kDeviceStateIdle);
             Alert(Lang::Strings::ERROR, last_error_message_.c_str(), "circle_xmark", Lang::Sounds::OGG_EXCLAMATION);
         }
 
         if (bits & MAIN_EVENT_SEND_AUDIO) {
             while (auto packet = audio_service_.PopPacketFromSendQueue()) {
-                if (!protocol_->SendAudio(std::move(packet))) {
+                if (opening_audio_channel_) {
+                    // Keep the beginning of the utterance, it usually carries the command
+                    if (preconnect_packets_.size() < MAX_PRECONNECT_PACKETS) {
+                        preconnect_packets_.push_back(std::move(packet));
+                    } else {
+                        Metrics::GetInstance().Increment(kMetricPreconnectDropped);
+                        if (failover_start_us_ != 0) {
+                            failover_lost_packets_++;
+                        }
+                    }
+                    continue;
+                }
+                if (!SendAudio(std::move(packet))) {
                     break;
                 }
             }
@@ -606,6 +697,8 @@ void Application::MainEventLoop() {
                 // SystemInfo::PrintTaskCpuUsage(pdMS_TO_TICKS(1000));
                 // SystemInfo::PrintTaskList();
                 SystemInfo::PrintHeapStats();
+                Metrics::GetInstance().UpdateHeapStats();
+                Metrics::GetInstance().ReportToAudioDebugger();
             }
         }
     }
@@ -616,32 +709,21 @@ void Application::OnWakeWordDetected() {
         return;
     }
 
+    Metrics::GetInstance().Increment(kMetricWakeWordDetected);
     if (device_state_ == kDeviceStateIdle) {
+        Tracer::GetInstance().NewTurn();
+        Tracer::GetInstance().Record(kTraceWakeWordDetected);
+        wake_word_time_us_ = esp_timer_get_time();
         audio_service_.EncodeWakeWord();
 
         if (!protocol_->IsAudioChannelOpened()) {
-            SetDeviceState(kDeviceStateConnecting);
-            if (!protocol_->OpenAudioChannel()) {
-                audio_service_.EnableWakeWordDetection(true);
-                return;
-            }
-        }
-
-        auto wake_word = audio_service_.GetLastWakeWord();
-        ESP_LOGI(TAG, "Wake word detected: %s", wake_word.c_str());
-#if CONFIG_USE_AFE_WAKE_WORD || CONFIG_USE_CUSTOM_WAKE_WORD
-        // Encode and send the wake word data to the server
-        while (auto packet = audio_service_.PopWakeWordPacket()) {
-            protocol_->SendAudio(std::move(packet));
+            OpenAudioChannelAsync([this]() {
+                Metrics::GetInstance().Observe(kMetricWakeWordToChannelOpenMs, (esp_timer_get_time() - wake_word_time_us_) / 1000);
+                OnWakeWordChannelReady();
+            });
+            return;
         }
-        // Set the chat state to wake word detected
-        protocol_->SendWakeWordDetected(wake_word);
-        SetListeningMode(aec_mode_ == kAecOff ? kListeningModeAutoStop : kListeningModeRealtime);
-#else
-        SetListeningMode(aec_mode_ == kAecOff ? kListeningModeAutoStop : kListeningModeRealtime);
-        // Play the pop up sound to indicate the wake word is detected
-        audio_service_.PlaySound(Lang::Sounds::OGG_POPUP);
-#endif
+        OnWakeWordChannelReady();
     } else if (device_state_ == kDeviceStateSpeaking) {
         AbortSpeaking(kAbortReasonWakeWordDetected);
     } else if (device_state_ == kDeviceStateActivating) {
@@ -649,9 +731,227 @@ void Application::OnWakeWordDetected() {
     }
 }
 
+void Application::OnWakeWordChannelReady() {
+    auto wake_word = audio_service_.GetLastWakeWord();
+    ESP_LOGI(TAG, "Wake word detected: %s", wake_word.c_str());
+#if CONFIG_USE_AFE_WAKE_WORD || CONFIG_USE_CUSTOM_WAKE_WORD
+    // Encode and send the wake word data to the server
+    while (auto packet = audio_service_.PopWakeWordPacket()) {
+        protocol_->SendAudio(std::move(packet));
+    }
+    // Set the chat state to wake word detected
+    protocol_->SendWakeWordDetected(wake_word);
+    SetListeningMode(aec_mode_ == kAecOff ? kListeningModeAutoStop : kListeningModeRealtime);
+#else
+    SetListeningMode(aec_mode_ == kAecOff ? kListeningModeAutoStop : kListeningModeRealtime);
+    // Play the pop up sound to indicate the wake word is detected
+    audio_service_.PlaySound(Lang::Sounds::OGG_POPUP);
+#endif
+}
+
+// Runs on_ready on the main loop once the audio channel is opened. Opening may
+// take seconds (DNS, TLS, server hello), so it runs on a worker task while the
+// main loop keeps going and the mic audio is kept in the pre-connect buffer.
+void Application::OpenAudioChannelAsync(std::function<void()> on_ready) {
+    if (protocol_->IsAudioChannelOpened()) {
+        on_ready();
+        return;
+    }
+    if (opening_audio_channel_) {
+        ESP_LOGW(TAG, "Audio channel is already being opened");
+        return;
+    }
+
+    opening_audio_channel_ = true;
+    on_audio_channel_ready_ = std::move(on_ready);
+    preconnect_packets_.clear();
+    SetDeviceState(kDeviceStateConnecting);
+
+    // Start capturing right away, the AFE warms up while connecting
+    audio_service_.EnableVoiceProcessing(true);
+    audio_service_.EnableWakeWordDetection(false);
+
+    xTaskCreate([](void* arg) {
+        auto app = (Application*)arg;
+        bool success = app->OpenAudioChannel();
+        app->Schedule([app, success]() {
+            app->OnAudioChannelOpenDone(success);
+        });
+        vTaskDelete(NULL);
+    }, "open_channel", 2048 * 4, this, 3, nullptr);
+}
+
+void Application::OnAudioChannelOpenDone(bool success) {
+    opening_audio_channel_ = false;
+    auto on_ready = std::move(on_audio_channel_ready_);
+    on_audio_channel_ready_ = nullptr;
+
+    // The user may have cancelled, or a network error may have reset the state
+    if (!success || device_state_ != kDeviceStateConnecting) {
+        preconnect_packets_.clear();
+        failover_start_us_ = 0;
+        if (device_state_ == kDeviceStateConnecting) {
+            SetDeviceState(kDeviceStateIdle);
+        }
+        return;
+    }
+    on_ready();
+}
+
+bool Application::SendAudio(std::unique_ptr<AudioStreamPacket> packet) {
+    auto send_start = esp_timer_get_time();
+    if (!protocol_->SendAudio(std::move(packet))) {
+        Metrics::GetInstance().Increment(kMetricSendAudioFailed);
+        uplink_failed_packets_++;
+        return false;
+    }
+    uplink_failed_packets_ = 0;
+    auto now = esp_timer_get_time();
+    Metrics::GetInstance().Observe(kMetricSendAudioUs, now - send_start);
+    Tracer::GetInstance().RecordFirst(kTraceFirstUplinkSent);
+    if (wake_word_time_us_ != 0) {
+        Metrics::GetInstance().Observe(kMetricWakeWordToFirstUplinkMs, (now - wake_word_time_us_) / 1000);
+        wake_word_time_us_ = 0;
+    }
+    return true;
+}
+
+void Application::FlushPreconnectAudio() {
+    if (preconnect_packets_.empty()) {
+        return;
+    }
+    ESP_LOGI(TAG, "Sending %u packets captured while connecting", preconnect_packets_.size());
+    while (!preconnect_packets_.empty()) {
+        auto packet = std::move(preconnect_packets_.front());
+        preconnect_packets_.pop_front();
+        if (!SendAudio(std::move(packet))) {
+            preconnect_packets_.clear();
+            return;
+        }
+    }
+    // Continue with what was captured after the buffer was closed
+    xEventGroupSetBits(event_group_, MAIN_EVENT_SEND_AUDIO);
+}
+
+// Called from the network switch task of DualNetworkBoard, after a probe failure or a switch
+// requested with the button. The new interface is up, continue the conversation on it:
+// MQTT+UDP keeps its session, otherwise a conversation that was going on, or that was dropped
+// with the old link, gets a new session and continues listening.
+void Application::OnNetworkSwitched(int64_t link_lost_time_us) {
+    Schedule([this, link_lost_time_us]() {
+        if (!protocol_) {
+            return;
+        }
+        failover_start_us_ = link_lost_time_us;
+        // Packets that failed to send on the old link since the last one that went through
+        failover_lost_packets_ = uplink_failed_packets_;
+
+        bool active = device_state_ == kDeviceStateListening || device_state_ == kDeviceStateSpeaking;
+        auto migration = active ? protocol_->MigrateAudioChannel() : kAudioChannelLost;
+        if (migration == kAudioChannelResumed) {
+            ReportFailover("session migrated");
+            xEventGroupSetBits(event_group_, MAIN_EVENT_SEND_AUDIO);
+            return;
+        }
+        if (migration == kAudioChannelNewSession) {
+            // The channel is open in a session the server just started, continue listening in it
+            DropReplyOfLostSession();
+            bool processor_running = audio_service_.IsAudioProcessorRunning();
+            SetDeviceState(kDeviceStateListening);
+            if (processor_running) {
+                // SetDeviceState only starts listening when it starts the audio processor
+                protocol_->SendStartListening(listening_mode_);
+            }
+            ReportFailover("new session");
+            xEventGroupSetBits(event_group_, MAIN_EVENT_SEND_AUDIO);
+            return;
+        }
+
+        protocol_->ResetConnection();
+        bool interrupted = conversation_interrupted_us_ != 0 &&
+            conversation_interrupted_us_ + FAILOVER_INTERRUPT_MARGIN_MS * 1000 >= link_lost_time_us;
+        conversation_interrupted_us_ = 0;
+        if (!active && !interrupted) {
+            ReportFailover("idle");
+            return;
+        }
+
+        DropReplyOfLostSession();
+        OpenAudioChannelAsync([this]() {
+            SetDeviceState(kDeviceStateListening);
+            ReportFailover("new session");
+        });
+    });
+}
+
+void Application::DropReplyOfLostSession() {
+    if (device_state_ != kDeviceStateSpeaking) {
+        return;
+    }
+    // The rest of the reply is lost with the old session
+    {
+        std::lock_guard<std::mutex> lock(downlink_mutex_);
+        downlink_accepting_ = false;
+        downlink_prebuffer_.clear();
+    }
+    audio_service_.AbortPlayback();
+}
+
+void Application::ReportFailover(const char* how) {
+    auto& metrics = Metrics::GetInstance();
+    int elapsed_ms = (esp_timer_get_time() - failover_start_us_) / 1000;
+    metrics.Observe(kMetricNetworkFailoverMs, elapsed_ms);
+    metrics.Increment(kMetricNetworkFailover);
+    metrics.Increment(kMetricFailoverPacketsLost, failover_lost_packets_);
+    ESP_LOGW(TAG, "Network failover done in %d ms (%s), %d uplink packets lost", elapsed_ms, how, failover_lost_packets_);
+    failover_start_us_ = 0;
+    failover_lost_packets_ = 0;
+    uplink_failed_packets_ = 0;
+}
+
+bool Application::OpenAudioChannel() {
+    auto& tracer = Tracer::GetInstance();
+    tracer.Record(kTraceOpenAudioChannel, kTracePhaseBegin);
+    bool success = protocol_->OpenAudioChannel();
+    tracer.Record(kTraceOpenAudioChannel, kTracePhaseEnd);
+    if (!success) {
+        Metrics::GetInstance().Increment(kMetricAudioChannelOpenFailed);
+    }
+    return success;
+}
+
+void Application::OpenDownlink() {
+    std::lock_guard<std::mutex> lock(downlink_mutex_);
+    // Drop what is left of an earlier or aborted reply, but not the reply being played
+    if (!downlink_accepting_ || device_state_ != kDeviceStateSpeaking) {
+        downlink_prebuffer_.clear();
+        audio_service_.ResetDecoder();
+        // Audio that arrived just before "tts start" belongs to this reply, older packets
+        // are the tail of an earlier or aborted one
+        int64_t now = esp_timer_get_time();
+        for (auto& [arrival_us, packet] : downlink_early_) {
+            if (now - arrival_us <= DOWNLINK_EARLY_AUDIO_MAX_AGE_MS * 1000) {
+                downlink_prebuffer_.push_back(std::move(packet));
+            } else {
+                Metrics::GetInstance().Increment(kMetricDecodeQueueDropped);
+            }
+        }
+    }
+    downlink_early_.clear();
+    downlink_accepting_ = true;
+}
+
 void Application::AbortSpeaking(AbortReason reason) {
     ESP_LOGI(TAG, "Abort speaking");
     aborted_ = true;
+    {
+        // The rest of this reply is stale, the next "tts start" opens the downlink again
+        std::lock_guard<std::mutex> lock(downlink_mutex_);
+        downlink_accepting_ = false;
+        downlink_prebuffer_.clear();
+    }
+    // Stop locally instead of waiting for the server to stop sending
+    audio_service_.AbortPlayback();
     protocol_->SendAbortSpeaking(reason);
 }
 
@@ -673,6 +973,15 @@ void Application::SetDeviceState(DeviceState state) {
     // Send the state change event
     DeviceStateEventManager::GetInstance().PostStateChangeEvent(previous_state, state);
 
+    if (previous_state == kDeviceStateSpeaking || state == kDeviceStateIdle) {
+        std::lock_guard<std::mutex> lock(downlink_mutex_);
+        downlink_playing_ = false;
+        if (state == kDeviceStateIdle) {
+            downlink_accepting_ = false;
+            downlink_prebuffer_.clear();
+        }
+    }
+
     auto& board = Board::GetInstance();
     auto display = board.GetDisplay();
     auto led = board.GetLed();
@@ -680,6 +989,11 @@ void Application::SetDeviceState(DeviceState state) {
     switch (state) {
         case kDeviceStateUnknown:
         case kDeviceStateIdle:
+            // The turn is over, do not attribute the next reply to a stale VAD end
+            vad_end_time_ms_ = 0;
+            wake_word_time_us_ = 0;
+            preconnect_packets_.clear();
+            Tracer::GetInstance().EndTurn();
             display->SetStatus(Lang::Strings::STANDBY);
             display->SetEmotion("neutral");
             audio_service_.EnableVoiceProcessing(false);
@@ -691,6 +1005,10 @@ void Application::SetDeviceState(DeviceState state) {
             display->SetChatMessage("system", "");
             break;
         case kDeviceStateListening:
+            if (previous_state == kDeviceStateSpeaking) {
+                // Continued dialog, the next user utterance starts a new turn
+                Tracer::GetInstance().NewTurn();
+            }
             display->SetStatus(Lang::Strings::LISTENING);
             display->SetEmotion("neutral");
 
@@ -700,6 +1018,10 @@ void Application::SetDeviceState(DeviceState state) {
                 protocol_->SendStartListening(listening_mode_);
                 audio_service_.EnableVoiceProcessing(true);
                 audio_service_.EnableWakeWordDetection(false);
+            } else if (previous_state == kDeviceStateConnecting) {
+                // Capture started while connecting, send what was said so far
+                protocol_->SendStartListening(listening_mode_);
+                FlushPreconnectAudio();
             }
             break;
         case kDeviceStateSpeaking:
@@ -714,7 +1036,17 @@ void Application::SetDeviceState(DeviceState state) {
                 audio_service_.EnableWakeWordDetection(false);
 #endif
             }
-            audio_service_.ResetDecoder();
+            {
+                // The decoder was reset when the reply started, play what arrived in the meantime
+                std::lock_guard<std::mutex> lock(downlink_mutex_);
+                while (!downlink_prebuffer_.empty()) {
+                    if (audio_service_.PushPacketToDecodeQueue(std::move(downlink_prebuffer_.front()))) {
+                        Tracer::GetInstance().RecordFirst(kTraceFirstDownlinkQueued);
+                    }
+                    downlink_prebuffer_.pop_front();
+                }
+                downlink_playing_ = true;
+            }
             break;
         default:
             // Do nothing
@@ -729,12 +1061,17 @@ void Application::Reboot() {
 
 void Application::WakeWordInvoke(const std::string& wake_word) {
     if (device_state_ == kDeviceStateIdle) {
-        ToggleChatState();
+        if (!protocol_) {
+            ESP_LOGE(TAG, "Protocol not initialized");
+            return;
+        }
         Schedule([this, wake_word]() {
-            if (protocol_) {
-                protocol_->SendWakeWordDetected(wake_word); 
-            }
-        }); 
+            Tracer::GetInstance().NewTurn();
+            OpenAudioChannelAsync([this, wake_word]() {
+                SetListeningMode(aec_mode_ == kAecOff ? kListeningModeAutoStop : kListeningModeRealtime);
+                protocol_->SendWakeWordDetected(wake_word);
+            });
+        });
     } else if (device_state_ == kDeviceStateSpeaking) {
         Schedule([this]() {
             AbortSpeaking(kAbortReasonNone);
@@ -10,6 +10,7 @@
 #include <mutex>
 #include <deque>
 #include <memory>
+#include <atomic>
 
 #include "protocol.h"
 #include "ota.h"
@@ -25,6 +26,13 @@
 #define MAIN_EVENT_CHECK_NEW_VERSION_DONE (1 << 5)
 #define MAIN_EVENT_CLOCK_TICK (1 << 6)
 
+// Mic audio kept while the audio channel is being opened
+#define MAX_PRECONNECT_PACKETS (3000 / OPUS_FRAME_DURATION_MS)
+// A conversation dropped this long before the link loss was noticed is resumed after a network failover
+#define FAILOVER_INTERRUPT_MARGIN_MS 2000
+// Reply audio received at most this long before "tts start" is played with the reply
+#define DOWNLINK_EARLY_AUDIO_MAX_AGE_MS 500
+
 
 enum AecMode {
     kAecOff,
@@ -54,6 +62,8 @@ public:
     void ToggleChatState();
     void StartListening();
     void StopListening();
+    // Hint that the user is about to talk (e.g. a button pressed down), see CONFIG_WEBSOCKET_SPECULATIVE_CONNECT
+    void PrepareAudioChannel();
     void Reboot();
     void WakeWordInvoke(const std::string& wake_word);
     bool CanEnterSleepMode();
@@ -62,6 +72,8 @@ public:
     AecMode GetAecMode() const { return aec_mode_; }
     void PlaySound(const std::string_view& sound);
     AudioService& GetAudioService() { return audio_service_; }
+    // The board switched to another network interface, link_lost_time_us is when the old link was lost
+    void OnNetworkSwitched(int64_t link_lost_time_us);
 
 private:
     Application();
@@ -81,10 +93,46 @@ private:
     bool has_server_time_ = false;
     bool aborted_ = false;
     int clock_ticks_ = 0;
+    // Time of the last local VAD end, used to measure the first TTS packet latency
+    std::atomic<uint32_t> vad_end_time_ms_{0};
     TaskHandle_t check_new_version_task_handle_ = nullptr;
     TaskHandle_t main_event_loop_task_handle_ = nullptr;
 
+    // Channel opening runs on a worker task, these are only used by the main loop
+    bool opening_audio_channel_ = false;
+    // A PreConnect task is running, only touched on the main loop
+    bool pre_connecting_ = false;
+    std::function<void()> on_audio_channel_ready_;
+    std::deque<std::unique_ptr<AudioStreamPacket>> preconnect_packets_;
+    int64_t wake_word_time_us_ = 0;
+
+    // Network failover, used by the main loop only
+    int64_t conversation_interrupted_us_ = 0;
+    int uplink_failed_packets_ = 0;
+    int64_t failover_start_us_ = 0;
+    int failover_lost_packets_ = 0;
+
+    // Downlink audio of the current reply is accepted from "tts start" until the reply
+    // is aborted or the device goes idle, whatever the UI state. Packets that arrive
+    // before the state machine reaches Speaking wait in the prebuffer. Packets that
+    // arrive outside of a reply wait in downlink_early_ with their arrival time, the
+    // next "tts start" keeps the recent ones.
+    std::mutex downlink_mutex_;
+    bool downlink_accepting_ = false;
+    bool downlink_playing_ = false;
+    std::deque<std::unique_ptr<AudioStreamPacket>> downlink_prebuffer_;
+    std::deque<std::pair<int64_t, std::unique_ptr<AudioStreamPacket>>> downlink_early_;
+
     void OnWakeWordDetected();
+    void OnWakeWordChannelReady();
+    void OpenDownlink();
+    bool OpenAudioChannel();
+    void OpenAudioChannelAsync(std::function<void()> on_ready);
+    void OnAudioChannelOpenDone(bool success);
+    bool SendAudio(std::unique_ptr<AudioStreamPacket> packet);
+    void FlushPreconnectAudio();
+    void DropReplyOfLostSession();
+    void ReportFailover(const char* how);
     void CheckNewVersion(Ota& ota);
     void ShowActivationCode(const std::string& code, const std::string& message);
     void SetListeningMode(ListeningMode mode);
@@ -0,0 +1,102 @@
+#include "asset_bundle.h"
+
+#include <esp_log.h>
+#include <esp_rom_crc.h>
+
+#include <cstring>
+
+#define TAG "AssetBundle"
+
+AssetBundle::~AssetBundle() {
+    if (base_ != nullptr) {
+        esp_partition_munmap(mmap_handle_);
+    }
+}
+
+bool AssetBundle::Initialize() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (initialized_) {
+        return base_ != nullptr;
+    }
+    initialized_ = true;
+
+    partition_ = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, "assets");
+    if (partition_ == nullptr) {
+        ESP_LOGW(TAG, "No assets partition found");
+        return false;
+    }
+
+    AssetBundleHeader header;
+    if (esp_partition_read(partition_, 0, &header, sizeof(header)) != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to read bundle header");
+        return false;
+    }
+    if (header.magic != ASSET_BUNDLE_MAGIC || header.version != ASSET_BUNDLE_VERSION) {
+        ESP_LOGW(TAG, "No valid asset bundle in partition %s (magic 0x%08lx version %u)",
+            partition_->label, header.magic, header.version);
+        return false;
+    }
+    size_t index_size = sizeof(AssetEntry) * header.count;
+    if (header.total_size > partition_->size || sizeof(header) + index_size > header.total_size) {
+        ESP_LOGE(TAG, "Invalid bundle size %lu, partition size %lu", header.total_size, partition_->size);
+        return false;
+    }
+
+    const void* ptr = nullptr;
+    esp_err_t err = esp_partition_mmap(partition_, 0, header.total_size, ESP_PARTITION_MMAP_DATA, &ptr, &mmap_handle_);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to mmap assets partition: %s", esp_err_to_name(err));
+        return false;
+    }
+
+    auto base = static_cast<const uint8_t*>(ptr);
+    auto entries = reinterpret_cast<const AssetEntry*>(base + sizeof(header));
+    uint32_t crc = esp_rom_crc32_le(0, reinterpret_cast<const uint8_t*>(entries), index_size);
+    if (crc != header.index_crc) {
+        ESP_LOGE(TAG, "Bundle index CRC mismatch: 0x%08lx != 0x%08lx", crc, header.index_crc);
+        esp_partition_munmap(mmap_handle_);
+        return false;
+    }
+
+    base_ = base;
+    entries_ = entries;
+    count_ = header.count;
+    total_size_ = header.total_size;
+    ESP_LOGI(TAG, "Mapped %u assets (%lu bytes) from partition %s", count_, header.total_size, partition_->label);
+    return true;
+}
+
+const AssetEntry* AssetBundle::Find(const char* name) {
+    if (!Initialize()) {
+        return nullptr;
+    }
+
+    // The index is sorted by name
+    int low = 0, high = count_ - 1;
+    while (low <= high) {
+        int mid = (low + high) / 2;
+        int cmp = strncmp(name, entries_[mid].name, ASSET_NAME_MAX_LEN);
+        if (cmp == 0) {
+            auto entry = &entries_[mid];
+            if (entry->offset + entry->size > total_size_) {
+                ESP_LOGE(TAG, "Asset %s is out of range", name);
+                return nullptr;
+            }
+            return entry;
+        } else if (cmp < 0) {
+            high = mid - 1;
+        } else {
+            low = mid + 1;
+        }
+    }
+    return nullptr;
+}
+
+bool AssetBundle::GetData(const char* name, std::string_view& data) {
+    auto entry = Find(name);
+    if (entry == nullptr) {
+        return false;
+    }
+    data = std::string_view(reinterpret_cast<const char*>(GetData(entry)), entry->size);
+    return true;
+}
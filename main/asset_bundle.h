@@ -0,0 +1,64 @@
+#ifndef ASSET_BUNDLE_H
+#define ASSET_BUNDLE_H
+
+#include <esp_partition.h>
+
+#include <cstdint>
+#include <mutex>
+#include <string_view>
+
+// Asset bundle layout, generated by scripts/gen_assets.py
+#define ASSET_BUNDLE_MAGIC      0x4C425341  // "ASBL"
+#define ASSET_BUNDLE_VERSION    1
+#define ASSET_NAME_MAX_LEN      32
+
+struct AssetBundleHeader {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t count;
+    uint32_t total_size;
+    uint32_t index_crc;
+} __attribute__((packed));
+
+struct AssetEntry {
+    char name[ASSET_NAME_MAX_LEN];
+    uint32_t offset;
+    uint32_t size;
+    uint16_t width;
+    uint16_t height;
+    uint32_t reserved;
+} __attribute__((packed));
+
+// Memory-maps the bundle stored in the "assets" partition and resolves
+// assets by name. Returned data points straight into flash, no copy is made.
+class AssetBundle {
+public:
+    static AssetBundle& GetInstance() {
+        static AssetBundle instance;
+        return instance;
+    }
+    // 删除拷贝构造函数和赋值运算符
+    AssetBundle(const AssetBundle&) = delete;
+    AssetBundle& operator=(const AssetBundle&) = delete;
+
+    // Maps the partition on first call, returns false if no valid bundle is flashed
+    bool Initialize();
+    const AssetEntry* Find(const char* name);
+    bool GetData(const char* name, std::string_view& data);
+    const uint8_t* GetData(const AssetEntry* entry) const { return base_ + entry->offset; }
+
+private:
+    AssetBundle() = default;
+    ~AssetBundle();
+
+    std::mutex mutex_;
+    bool initialized_ = false;
+    const esp_partition_t* partition_ = nullptr;
+    esp_partition_mmap_handle_t mmap_handle_ = 0;
+    const uint8_t* base_ = nullptr;
+    const AssetEntry* entries_ = nullptr;
+    uint16_t count_ = 0;
+    uint32_t total_size_ = 0;
+};
+
+#endif // ASSET_BUNDLE_H
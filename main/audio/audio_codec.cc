@@ -5,6 +5,8 @@
 #include <esp_log.h>
 #include <cstring>
 #include <driver/i2s_common.h>
+#include <esp_timer.h>
+#include <esp_attr.h>
 
 #define TAG "AudioCodec"
 
@@ -26,6 +28,43 @@ bool AudioCodec::InputData(std::vector<int16_t>& data) {
     return false;
 }
 
+bool AudioCodec::DiscardOutput() {
+    if (tx_handle_ == nullptr || !output_enabled_) {
+        return false;
+    }
+
+    // A restarted channel sends from the first DMA buffer, so every buffer is preloaded
+    // with zeros, which is silence whatever the slot format of the codec is
+    static const uint8_t zeros[AUDIO_CODEC_DMA_FRAME_NUM * 2 * sizeof(int32_t)] = {};
+    if (i2s_channel_disable(tx_handle_) != ESP_OK) {
+        return false;
+    }
+    size_t loaded;
+    do {
+        loaded = 0;
+        if (i2s_channel_preload_data(tx_handle_, zeros, sizeof(zeros), &loaded) != ESP_OK) {
+            break;
+        }
+    } while (loaded == sizeof(zeros));
+    ESP_ERROR_CHECK(i2s_channel_enable(tx_handle_));
+    output_restart_buffers_ = output_buffers_sent_.load();
+    output_buffer_sent_time_ = static_cast<uint32_t>(esp_timer_get_time());
+    return true;
+}
+
+bool IRAM_ATTR AudioCodec::OnOutputBufferSent(i2s_chan_handle_t handle, i2s_event_data_t* event, void* user_ctx) {
+    auto codec = static_cast<AudioCodec*>(user_ctx);
+    uint32_t now = static_cast<uint32_t>(esp_timer_get_time());
+    uint32_t sent = codec->output_buffers_sent_.load();
+    // No buffer for a while means that the channel was stopped, e.g. by esp_codec_dev_close()
+    if (now - codec->output_buffer_sent_time_.load() > codec->output_buffer_us_ * 3 / 2) {
+        codec->output_restart_buffers_ = sent;
+    }
+    codec->output_buffer_sent_time_ = now;
+    codec->output_buffers_sent_ = sent + 1;
+    return false;
+}
+
 void AudioCodec::Start() {
     Settings settings("audio", false);
     output_volume_ = settings.GetInt("output_volume", output_volume_);
@@ -35,6 +74,10 @@ void AudioCodec::Start() {
     }
 
     if (tx_handle_ != nullptr) {
+        output_buffer_us_ = AUDIO_CODEC_DMA_FRAME_NUM * 1000000LL / output_sample_rate_;
+        i2s_event_callbacks_t callbacks = {};
+        callbacks.on_sent = OnOutputBufferSent;
+        ESP_ERROR_CHECK_WITHOUT_ABORT(i2s_channel_register_event_callback(tx_handle_, &callbacks, this));
         ESP_ERROR_CHECK(i2s_channel_enable(tx_handle_));
     }
 
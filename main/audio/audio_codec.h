@@ -8,6 +8,7 @@
 #include <vector>
 #include <string>
 #include <functional>
+#include <atomic>
 
 #include "board.h"
 
@@ -27,6 +28,9 @@ public:
     virtual void OutputData(std::vector<int16_t>& data);
     virtual bool InputData(std::vector<int16_t>& data);
     virtual void Start();
+    // Drops the audio queued in the DMA buffers so that the speaker goes silent right away.
+    // Called from the thread that calls OutputData. Returns false if the codec can not do it.
+    virtual bool DiscardOutput();
 
     inline bool duplex() const { return duplex_; }
     inline bool input_reference() const { return input_reference_; }
@@ -37,6 +41,11 @@ public:
     inline int output_volume() const { return output_volume_; }
     inline bool input_enabled() const { return input_enabled_; }
     inline bool output_enabled() const { return output_enabled_; }
+    // DMA buffers sent by the TX channel since Start, the count when the channel was last
+    // (re)started and the esp_timer time of the last one in microseconds, for PlaybackClock
+    inline uint32_t output_buffers_sent() const { return output_buffers_sent_; }
+    inline uint32_t output_restart_buffers() const { return output_restart_buffers_; }
+    inline uint32_t output_buffer_sent_time() const { return output_buffer_sent_time_; }
 
 protected:
     i2s_chan_handle_t tx_handle_ = nullptr;
@@ -51,9 +60,16 @@ protected:
     int input_channels_ = 1;
     int output_channels_ = 1;
     int output_volume_ = 70;
+    std::atomic<uint32_t> output_buffers_sent_{0};
+    std::atomic<uint32_t> output_restart_buffers_{0};
+    std::atomic<uint32_t> output_buffer_sent_time_{0};
+    uint32_t output_buffer_us_ = 0;
 
     virtual int Read(int16_t* dest, int samples) = 0;
     virtual int Write(const int16_t* data, int samples) = 0;
+
+private:
+    static bool OnOutputBufferSent(i2s_chan_handle_t handle, i2s_event_data_t* event, void* user_ctx);
 };
 
 #endif // _AUDIO_CODEC_H
@@ -0,0 +1,156 @@
+#include "audio_mixer.h"
+
+#include <algorithm>
+
+namespace {
+
+struct StreamConfig {
+    int priority;
+    int duck_gain;      // Applied to the streams with a lower priority while this one plays
+};
+
+// Indexed by AudioStreamId
+constexpr StreamConfig kStreamConfigs[kAudioStreamCount] = {
+    {0, AUDIO_MIXER_UNITY_GAIN},
+    {1, AUDIO_MIXER_UNITY_GAIN / 2},    // -6 dB
+    {2, AUDIO_MIXER_UNITY_GAIN / 4},    // -12 dB
+};
+
+} // namespace
+
+void AudioMixer::Configure(int frame_samples, int sample_rate) {
+    frame_samples_ = frame_samples;
+    sample_rate_ = sample_rate;
+    accumulator_.reserve(frame_samples);
+}
+
+void AudioMixer::Push(AudioStreamId stream, std::vector<int16_t>&& pcm, uint32_t timestamp) {
+    auto& s = streams_[stream];
+    s.samples += pcm.size();
+    s.frames.push_back(Frame{std::move(pcm), timestamp});
+}
+
+bool AudioMixer::IsEmpty() const {
+    for (auto& s : streams_) {
+        if (!s.frames.empty()) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void AudioMixer::Clear(AudioStreamId stream) {
+    auto& s = streams_[stream];
+    s.frames.clear();
+    s.offset = 0;
+    s.samples = 0;
+}
+
+void AudioMixer::SetGain(AudioStreamId stream, int gain) {
+    streams_[stream].gain = std::clamp(gain, 0, AUDIO_MIXER_UNITY_GAIN);
+}
+
+size_t AudioMixer::GetReadySamples(int stream, uint32_t pending) const {
+    size_t samples = streams_[stream].samples;
+    if (samples < frame_samples_ && (pending & AUDIO_STREAM_BIT(stream))) {
+        return 0;
+    }
+    return std::min(samples, frame_samples_);
+}
+
+bool AudioMixer::HasFrame(uint32_t pending) const {
+    for (int i = 0; i < kAudioStreamCount; i++) {
+        if (GetReadySamples(i, pending) > 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+int AudioMixer::GetTargetGain(int stream, uint32_t pending) const {
+    int duck = AUDIO_MIXER_UNITY_GAIN;
+    for (int i = 0; i < kAudioStreamCount; i++) {
+        bool active = streams_[i].samples > 0 || (pending & AUDIO_STREAM_BIT(i));
+        if (active && kStreamConfigs[i].priority > kStreamConfigs[stream].priority) {
+            duck = std::min(duck, kStreamConfigs[i].duck_gain);
+        }
+    }
+    return streams_[stream].gain * duck / AUDIO_MIXER_UNITY_GAIN;
+}
+
+void AudioMixer::Read(Stream& stream, size_t count, int gain_from, int gain_to, size_t length, int16_t* copy_to) {
+    // Gain in Q15 * 256, stepped every sample over the whole frame. The step may be negative,
+    // so it is scaled with a multiplication rather than a shift.
+    int gain = gain_from * 256;
+    int step = (gain_to - gain_from) * 256 / static_cast<int>(length);
+    size_t position = 0;
+    while (position < count) {
+        auto& frame = stream.frames.front();
+        size_t n = std::min(count - position, frame.pcm.size() - stream.offset);
+        const int16_t* src = frame.pcm.data() + stream.offset;
+        if (copy_to != nullptr) {
+            std::copy(src, src + n, copy_to + position);
+        } else {
+            for (size_t i = 0; i < n; i++) {
+                accumulator_[position + i] += (src[i] * (gain >> 8)) >> 15;
+                gain += step;
+            }
+        }
+        position += n;
+        stream.offset += n;
+        stream.samples -= n;
+        if (stream.offset == frame.pcm.size()) {
+            stream.frames.pop_front();
+            stream.offset = 0;
+        }
+    }
+}
+
+uint32_t AudioMixer::Mix(uint32_t pending, std::vector<int16_t>& out, uint32_t& timestamp) {
+    size_t ready[kAudioStreamCount];
+    int targets[kAudioStreamCount];
+    size_t length = 0;
+    uint32_t mixed = 0;
+    timestamp = 0;
+    for (int i = 0; i < kAudioStreamCount; i++) {
+        ready[i] = GetReadySamples(i, pending);
+        targets[i] = GetTargetGain(i, pending);
+        if (ready[i] > 0) {
+            length = std::max(length, ready[i]);
+            mixed |= AUDIO_STREAM_BIT(i);
+            // Only the server audio has timestamps
+            auto& front = streams_[i].frames.front();
+            if (timestamp == 0 && front.timestamp != 0) {
+                timestamp = front.timestamp + streams_[i].offset * 1000 / sample_rate_;
+            }
+        }
+    }
+    if (mixed == 0) {
+        out.clear();
+        return 0;
+    }
+
+    out.resize(length);
+    int single = __builtin_ctz(mixed);
+    if (mixed == AUDIO_STREAM_BIT(single) && streams_[single].applied_gain == AUDIO_MIXER_UNITY_GAIN &&
+        targets[single] == AUDIO_MIXER_UNITY_GAIN) {
+        // A single stream at full gain is copied as is
+        Read(streams_[single], length, 0, 0, length, out.data());
+    } else {
+        accumulator_.assign(length, 0);
+        for (int i = 0; i < kAudioStreamCount; i++) {
+            if (ready[i] > 0) {
+                Read(streams_[i], ready[i], streams_[i].applied_gain, targets[i], length, nullptr);
+            }
+        }
+        for (size_t i = 0; i < length; i++) {
+            out[i] = static_cast<int16_t>(std::clamp(accumulator_[i], -32768, 32767));
+        }
+    }
+
+    // A stream that is not playing takes the new gain right away
+    for (int i = 0; i < kAudioStreamCount; i++) {
+        streams_[i].applied_gain = targets[i];
+    }
+    return mixed;
+}
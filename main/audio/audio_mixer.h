@@ -0,0 +1,71 @@
+#ifndef AUDIO_MIXER_H
+#define AUDIO_MIXER_H
+
+#include <cstdint>
+#include <cstddef>
+#include <deque>
+#include <vector>
+
+enum AudioStreamId {
+    kAudioStreamTts,        // Server speech
+    kAudioStreamUi,         // Short feedback sounds
+    kAudioStreamAlert,      // Alerts and activation codes
+    kAudioStreamCount,
+};
+
+#define AUDIO_STREAM_BIT(stream) (1u << (stream))
+
+// Gains are Q15, 32768 is 0 dB
+#define AUDIO_MIXER_UNITY_GAIN 32768
+
+/*
+ * Mixes the decoded PCM of the playback streams, all at the codec output rate.
+ * Each stream has its own gain, and while a stream has audio it ducks the
+ * streams with a lower priority. Gain changes are ramped over one frame.
+ *
+ * Not thread safe, AudioService calls it with its queue mutex held.
+ */
+class AudioMixer {
+public:
+    void Configure(int frame_samples, int sample_rate);
+    void Push(AudioStreamId stream, std::vector<int16_t>&& pcm, uint32_t timestamp);
+    // The queue is measured in mix frames, the pushed packets may be shorter than one
+    bool IsFull(AudioStreamId stream, int max_frames) const { return streams_[stream].samples >= frame_samples_ * max_frames; }
+    bool IsEmpty(AudioStreamId stream) const { return streams_[stream].frames.empty(); }
+    bool IsEmpty() const;
+    void Clear(AudioStreamId stream);
+    void SetGain(AudioStreamId stream, int gain);
+
+    // Streams in pending have more audio being decoded, they are only mixed once
+    // they have a full frame so that they are not cut into small pieces
+    bool HasFrame(uint32_t pending) const;
+    // Mixes the next frame into out and returns the bit mask of the streams in it.
+    // timestamp is the one of the server audio at the start of out, 0 if there is none.
+    uint32_t Mix(uint32_t pending, std::vector<int16_t>& out, uint32_t& timestamp);
+
+private:
+    struct Frame {
+        std::vector<int16_t> pcm;
+        uint32_t timestamp;
+    };
+
+    struct Stream {
+        std::deque<Frame> frames;
+        size_t offset = 0;      // Samples of the front frame already played
+        size_t samples = 0;     // Samples left in frames
+        int gain = AUDIO_MIXER_UNITY_GAIN;
+        int applied_gain = AUDIO_MIXER_UNITY_GAIN;  // Gain with ducking at the end of the last frame
+    };
+
+    Stream streams_[kAudioStreamCount];
+    size_t frame_samples_ = 0;
+    int sample_rate_ = 0;
+    std::vector<int32_t> accumulator_;
+
+    size_t GetReadySamples(int stream, uint32_t pending) const;
+    int GetTargetGain(int stream, uint32_t pending) const;
+    // Reads count samples of the stream, gain ramps from gain_from to gain_to
+    void Read(Stream& stream, size_t count, int gain_from, int gain_to, size_t length, int16_t* copy_to);
+};
+
+#endif // AUDIO_MIXER_H
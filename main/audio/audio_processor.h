@@ -20,6 +20,8 @@ public:
     virtual void OnVadStateChange(std::function<void(bool speaking)> callback) = 0;
     virtual size_t GetFeedSize() = 0;
     virtual void EnableDeviceAec(bool enable) = 0;
+    // The echo delay is measured and the AEC removes enough of the echo
+    virtual bool IsAecConverged() { return false; }
 };
 
 #endif
@@ -1,5 +1,9 @@
 #include "audio_service.h"
+#include "metrics.h"
+#include "tracer.h"
+#include "ogg_demuxer.h"
 #include <esp_log.h>
+#include <algorithm>
 #include <cstring>
 
 #if CONFIG_USE_AUDIO_PROCESSOR
@@ -34,8 +38,10 @@ void AudioService::Initialize(AudioCodec* codec) {
     codec_ = codec;
     codec_->Start();
 
-    /* Setup the audio codec */
-    opus_decoder_ = std::make_unique<OpusDecoderWrapper>(codec->output_sample_rate(), 1, OPUS_FRAME_DURATION_MS);
+    /* Setup the audio codec, the decoders of the sound streams are created on demand */
+    playback_streams_[kAudioStreamTts].decoder = std::make_unique<OpusDecoderWrapper>(codec->output_sample_rate(), 1, OPUS_FRAME_DURATION_MS);
+    mixer_.Configure(codec->output_sample_rate() * OPUS_FRAME_DURATION_MS / 1000, codec->output_sample_rate());
+    playback_clock_.Configure(codec->output_sample_rate(), 16000, AUDIO_CODEC_DMA_FRAME_NUM, AUDIO_CODEC_DMA_DESC_NUM);
     opus_encoder_ = std::make_unique<OpusEncoderWrapper>(16000, 1, OPUS_FRAME_DURATION_MS);
     opus_encoder_->SetComplexity(0);
 
@@ -66,6 +72,10 @@ void AudioService::Initialize(AudioCodec* codec) {
 
     audio_processor_->OnVadStateChange([this](bool speaking) {
         voice_detected_ = speaking;
+        if (!speaking) {
+            // The reply usually plays one server round trip after the user stopped speaking
+            ExpectOutput();
+        }
         if (callbacks_.on_vad_change) {
             callbacks_.on_vad_change(speaking);
         }
@@ -90,6 +100,20 @@ void AudioService::Initialize(AudioCodec* codec) {
         .skip_unhandled_events = true,
     };
     esp_timer_create(&audio_power_timer_args, &audio_power_timer_);
+
+    esp_timer_create_args_t output_prepower_timer_args = {
+        .callback = [](void* arg) {
+            AudioService* audio_service = (AudioService*)arg;
+            if (!audio_service->codec_->output_enabled()) {
+                audio_service->PowerUpOutput();
+            }
+        },
+        .arg = this,
+        .dispatch_method = ESP_TIMER_TASK,
+        .name = "output_prepower",
+        .skip_unhandled_events = true,
+    };
+    esp_timer_create(&output_prepower_timer_args, &output_prepower_timer_);
 }
 
 void AudioService::Start() {
@@ -138,6 +162,7 @@ void AudioService::Start() {
 
 void AudioService::Stop() {
     esp_timer_stop(audio_power_timer_);
+    esp_timer_stop(output_prepower_timer_);
     service_stopped_ = true;
     xEventGroupSetBits(event_group_, AS_EVENT_AUDIO_TESTING_RUNNING |
         AS_EVENT_WAKE_WORD_RUNNING |
@@ -145,8 +170,11 @@ void AudioService::Stop() {
 
     std::lock_guard<std::mutex> lock(audio_queue_mutex_);
     audio_encode_queue_.clear();
-    audio_decode_queue_.clear();
-    audio_playback_queue_.clear();
+    for (int i = 0; i < kAudioStreamCount; i++) {
+        playback_streams_[i].decode_queue.clear();
+        playback_streams_[i].generation++;
+        mixer_.Clear(static_cast<AudioStreamId>(i));
+    }
     audio_testing_queue_.clear();
     audio_queue_cv_.notify_all();
 }
@@ -192,8 +220,9 @@ bool AudioService::ReadAudioData(std::vector<int16_t>& data, int sample_rate, in
     }
 
     /* Update the last input time */
-    last_input_time_ = std::chrono::steady_clock::now();
+    power_manager_.OnInput(esp_timer_get_time() / 1000);
     debug_statistics_.input_count++;
+    UpdateInputLevel(data);
 
 #if CONFIG_USE_AUDIO_DEBUGGER
     // 音频调试：发送原始音频数据
@@ -206,6 +235,24 @@ bool AudioService::ReadAudioData(std::vector<int16_t>& data, int sample_rate, in
     return true;
 }
 
+void AudioService::UpdateInputLevel(const std::vector<int16_t>& data) {
+    // Mean absolute value of the mic channel, the reference channel is interleaved after it
+    int channels = codec_->input_channels();
+    int count = data.size() / channels;
+    if (count == 0) {
+        return;
+    }
+    uint32_t sum = 0;
+    for (size_t i = 0; i < data.size(); i += channels) {
+        sum += std::abs(data[i]);
+    }
+    uint32_t mean = sum / count;
+    // Integer log2 in 1/256 steps: bit length plus the next 8 bits as the fraction
+    int bits = 32 - __builtin_clz(mean | 1);
+    int log2_q8 = (bits - 1) * 256 + (((mean << (16 - bits)) >> 7) & 0xff);
+    input_level_ = std::clamp((log2_q8 - 5 * 256) / 6, 0, 255);
+}
+
 void AudioService::AudioInputTask() {
     while (true) {
         EventBits_t bits = xEventGroupWaitBits(event_group_, AS_EVENT_AUDIO_TESTING_RUNNING |
@@ -216,8 +263,15 @@ void AudioService::AudioInputTask() {
             break;
         }
         if (audio_input_need_warmup_) {
+            /* Drop the mic samples until the input has settled after being started */
+            int64_t warmup_start = esp_timer_get_time();
+            std::vector<int16_t> data;
+            power_manager_.StartInputSettling();
+            while (ReadAudioData(data, 16000, 16000 * AUDIO_INPUT_SETTLE_BLOCK_MS / 1000) &&
+                !power_manager_.OnInputSettlingBlock(data.data(), data.size() / codec_->input_channels(), codec_->input_channels())) {
+            }
             audio_input_need_warmup_ = false;
-            vTaskDelay(pdMS_TO_TICKS(120));
+            Metrics::GetInstance().Observe(kMetricInputSettleMs, (esp_timer_get_time() - warmup_start) / 1000);
             continue;
         }
 
@@ -262,6 +316,15 @@ void AudioService::AudioInputTask() {
             int samples = audio_processor_->GetFeedSize();
             if (samples > 0) {
                 if (ReadAudioData(data, 16000, samples)) {
+#if CONFIG_USE_SERVER_AEC
+                    /* Record what was playing when the frame was captured, the read returns at its end */
+                    {
+                        int64_t position = playback_clock_.GetPosition(codec_->output_buffers_sent(),
+                            codec_->output_buffer_sent_time(), static_cast<uint32_t>(esp_timer_get_time()));
+                        std::lock_guard<std::mutex> lock(audio_queue_mutex_);
+                        playback_clock_.OnCapture(position - samples * codec_->output_sample_rate() / 16000, samples);
+                    }
+#endif
                     audio_processor_->Feed(std::move(data));
                     continue;
                 }
@@ -276,82 +339,124 @@ void AudioService::AudioInputTask() {
 }
 
 void AudioService::AudioOutputTask() {
+    std::vector<int16_t> pcm;
+    uint32_t timestamp = 0;
+    // A frame is written one DMA buffer at a time, so that an abort cuts it in between
+    std::vector<int16_t> chunk;
+    const size_t chunk_samples = AUDIO_CODEC_DMA_FRAME_NUM * codec_->output_channels();
     while (true) {
         std::unique_lock<std::mutex> lock(audio_queue_mutex_);
-        audio_queue_cv_.wait(lock, [this]() { return !audio_playback_queue_.empty() || service_stopped_; });
+        audio_queue_cv_.wait(lock, [this]() {
+            return service_stopped_ || playback_abort_time_ != 0 || mixer_.HasFrame(GetPendingStreams());
+        });
         if (service_stopped_) {
             break;
         }
+        if (playback_abort_time_ != 0) {
+            lock.unlock();
+            pcm.clear();
+            StopOutput(pcm, 0);
+            continue;
+        }
 
-        auto task = std::move(audio_playback_queue_.front());
-        audio_playback_queue_.pop_front();
+        uint32_t streams = mixer_.Mix(GetPendingStreams(), pcm, timestamp);
         audio_queue_cv_.notify_all();
         lock.unlock();
 
         if (!codec_->output_enabled()) {
-            esp_timer_stop(audio_power_timer_);
-            esp_timer_start_periodic(audio_power_timer_, AUDIO_POWER_CHECK_INTERVAL_MS * 1000);
-            codec_->EnableOutput(true);
+            PowerUpOutput();
         }
-        codec_->OutputData(task->pcm);
-
-        /* Update the last output time */
-        last_output_time_ = std::chrono::steady_clock::now();
-        debug_statistics_.playback_count++;
-
+        for (size_t offset = 0; offset < pcm.size(); offset += chunk_samples) {
+            if (playback_abort_time_ != 0) {
+                StopOutput(pcm, offset);
+                break;
+            }
+            chunk.assign(pcm.begin() + offset, pcm.begin() + std::min(pcm.size(), offset + chunk_samples));
+            uint32_t buffers_sent = codec_->output_buffers_sent();
+            codec_->OutputData(chunk);
 #if CONFIG_USE_SERVER_AEC
-        /* Record the timestamp for server AEC */
-        if (task->timestamp > 0) {
+            /* Record where the chunk plays for server AEC */
+            uint32_t chunk_timestamp = timestamp == 0 ? 0 : timestamp + offset * 1000 / codec_->output_sample_rate();
             lock.lock();
-            timestamp_queue_.push_back(task->timestamp);
-        }
+            playback_clock_.OnWrite(chunk.size() / codec_->output_channels(), chunk_timestamp,
+                buffers_sent, codec_->output_restart_buffers());
+            lock.unlock();
 #endif
+        }
+        if (streams & AUDIO_STREAM_BIT(kAudioStreamTts)) {
+            Tracer::GetInstance().RecordFirst(kTraceFirstPcmPlayed);
+        }
+
+        /* Update the last output time */
+        power_manager_.OnOutput(esp_timer_get_time() / 1000);
+        debug_statistics_.playback_count++;
     }
 
     ESP_LOGW(TAG, "Audio output task stopped");
 }
 
+// Called by the output task for a pending abort, pcm[offset:] is the part of the frame not written yet
+void AudioService::StopOutput(const std::vector<int16_t>& pcm, size_t offset) {
+    int64_t abort_time = playback_abort_time_.exchange(0);
+    if (!codec_->output_enabled()) {
+        return;
+    }
+
+#if CONFIG_AUDIO_ABORT_FLUSH_DMA
+    bool flushed = codec_->DiscardOutput();
+#else
+    bool flushed = false;
+#endif
+    int silence_ms = 0;
+    if (!flushed) {
+        // Fade out the next few milliseconds so that the speech does not end on a step,
+        // the speaker is silent once the DMA buffers have played it
+        int channels = codec_->output_channels();
+        size_t fade_frames = std::min((pcm.size() - offset) / channels,
+            static_cast<size_t>(codec_->output_sample_rate() * AUDIO_ABORT_FADE_MS / 1000));
+        if (fade_frames > 0) {
+            std::vector<int16_t> fade(pcm.begin() + offset, pcm.begin() + offset + fade_frames * channels);
+            for (size_t i = 0; i < fade.size(); i++) {
+                fade[i] = fade[i] * static_cast<int>(fade_frames - i / channels) / static_cast<int>(fade_frames);
+            }
+            codec_->OutputData(fade);
+        }
+        silence_ms = (AUDIO_CODEC_DMA_DESC_NUM * AUDIO_CODEC_DMA_FRAME_NUM + fade_frames) * 1000 / codec_->output_sample_rate();
+    }
+    silence_ms += (esp_timer_get_time() - abort_time) / 1000;
+    Metrics::GetInstance().Observe(kMetricAbortToSilenceMs, silence_ms);
+    ESP_LOGI(TAG, "Playback aborted, silent after %d ms", silence_ms);
+}
+
 void AudioService::OpusCodecTask() {
     while (true) {
         std::unique_lock<std::mutex> lock(audio_queue_mutex_);
         audio_queue_cv_.wait(lock, [this]() {
             return service_stopped_ ||
                 (!audio_encode_queue_.empty() && audio_send_queue_.size() < MAX_SEND_PACKETS_IN_QUEUE) ||
-                (!audio_decode_queue_.empty() && audio_playback_queue_.size() < MAX_PLAYBACK_TASKS_IN_QUEUE);
+                GetStreamToDecode() >= 0 || HasIdleSoundDecoder();
         });
         if (service_stopped_) {
             break;
         }
 
-        /* Decode the audio from decode queue */
-        if (!audio_decode_queue_.empty() && audio_playback_queue_.size() < MAX_PLAYBACK_TASKS_IN_QUEUE) {
-            auto packet = std::move(audio_decode_queue_.front());
-            audio_decode_queue_.pop_front();
-            audio_queue_cv_.notify_all();
-            lock.unlock();
-
-            auto task = std::make_unique<AudioTask>();
-            task->type = kAudioTaskTypeDecodeToPlaybackQueue;
-            task->timestamp = packet->timestamp;
-
-            SetDecodeSampleRate(packet->sample_rate, packet->frame_duration);
-            if (opus_decoder_->Decode(std::move(packet->payload), task->pcm)) {
-                // Resample if the sample rate is different
-                if (opus_decoder_->sample_rate() != codec_->output_sample_rate()) {
-                    int target_size = output_resampler_.GetOutputSamples(task->pcm.size());
-                    std::vector<int16_t> resampled(target_size);
-                    output_resampler_.Process(task->pcm.data(), task->pcm.size(), resampled.data());
-                    task->pcm = std::move(resampled);
-                }
+        /* Release the decoders of the sound streams once they are played */
+        for (int i = kAudioStreamTts + 1; i < kAudioStreamCount; i++) {
+            auto& stream = playback_streams_[i];
+            if (stream.decoder && stream.decode_queue.empty() && !stream.decoding && mixer_.IsEmpty(static_cast<AudioStreamId>(i))) {
+                stream.decoder.reset();
+            }
+        }
 
-                lock.lock();
-                audio_playback_queue_.push_back(std::move(task));
-                audio_queue_cv_.notify_all();
-            } else {
-                ESP_LOGE(TAG, "Failed to decode audio");
-                lock.lock();
+        /* Decode the audio of the stream with the highest priority */
+        int stream = GetStreamToDecode();
+        if (stream >= 0) {
+            auto packet = std::move(playback_streams_[stream].decode_queue.front());
+            playback_streams_[stream].decode_queue.pop_front();
+            if (stream == kAudioStreamTts) {
+                Metrics::GetInstance().SetGauge(kMetricDecodeQueueDepth, playback_streams_[stream].decode_queue.size());
             }
-            debug_statistics_.decode_count++;
+            DecodePacket(static_cast<AudioStreamId>(stream), std::move(packet), lock);
         }
         
         /* Encode the audio to send queue */
@@ -365,15 +470,19 @@ void AudioService::OpusCodecTask() {
             packet->frame_duration = OPUS_FRAME_DURATION_MS;
             packet->sample_rate = 16000;
             packet->timestamp = task->timestamp;
+            auto encode_start = esp_timer_get_time();
             if (!opus_encoder_->Encode(std::move(task->pcm), packet->payload)) {
                 ESP_LOGE(TAG, "Failed to encode audio");
+                Metrics::GetInstance().Increment(kMetricEncodeFailed);
                 continue;
             }
+            Metrics::GetInstance().Observe(kMetricEncodeUs, esp_timer_get_time() - encode_start);
 
             if (task->type == kAudioTaskTypeEncodeToSendQueue) {
                 {
                     std::lock_guard<std::mutex> lock(audio_queue_mutex_);
                     audio_send_queue_.push_back(std::move(packet));
+                    Metrics::GetInstance().SetGauge(kMetricSendQueueDepth, audio_send_queue_.size());
                 }
                 if (callbacks_.on_send_queue_available) {
                     callbacks_.on_send_queue_available();
@@ -390,19 +499,93 @@ void AudioService::OpusCodecTask() {
     ESP_LOGW(TAG, "Opus codec task stopped");
 }
 
-void AudioService::SetDecodeSampleRate(int sample_rate, int frame_duration) {
-    if (opus_decoder_->sample_rate() == sample_rate && opus_decoder_->duration_ms() == frame_duration) {
+// Called with the lock held, returns with it held
+void AudioService::DecodePacket(AudioStreamId id, std::unique_ptr<AudioStreamPacket> packet, std::unique_lock<std::mutex>& lock) {
+    auto& stream = playback_streams_[id];
+    stream.decoding = true;
+    uint32_t generation = stream.generation;
+    audio_queue_cv_.notify_all();
+    lock.unlock();
+
+    std::vector<int16_t> pcm;
+    SetDecodeSampleRate(stream, packet->sample_rate, packet->frame_duration);
+    auto decode_start = esp_timer_get_time();
+    bool decoded = stream.decoder->Decode(std::move(packet->payload), pcm);
+    if (decoded) {
+        if (id == kAudioStreamTts) {
+            Metrics::GetInstance().Observe(kMetricDecodeUs, esp_timer_get_time() - decode_start);
+            Tracer::GetInstance().RecordFirst(kTraceFirstPcmDecoded);
+        }
+        // Resample if the sample rate is different
+        if (stream.decoder->sample_rate() != codec_->output_sample_rate()) {
+            int target_size = stream.resampler.GetOutputSamples(pcm.size());
+            std::vector<int16_t> resampled(target_size);
+            stream.resampler.Process(pcm.data(), pcm.size(), resampled.data());
+            pcm = std::move(resampled);
+        }
+    } else {
+        ESP_LOGE(TAG, "Failed to decode audio");
+        Metrics::GetInstance().Increment(kMetricDecodeFailed);
+    }
+
+    lock.lock();
+    stream.decoding = false;
+    if (generation != stream.generation) {
+        // The stream was reset while decoding, the reset could not touch the decoder
+        stream.decoder->ResetState();
+    } else if (decoded) {
+        mixer_.Push(id, std::move(pcm), packet->timestamp);
+    }
+    audio_queue_cv_.notify_all();
+    debug_statistics_.decode_count++;
+}
+
+void AudioService::SetDecodeSampleRate(PlaybackStream& stream, int sample_rate, int frame_duration) {
+    if (stream.decoder && stream.decoder->sample_rate() == sample_rate && stream.decoder->duration_ms() == frame_duration) {
         return;
     }
 
-    opus_decoder_.reset();
-    opus_decoder_ = std::make_unique<OpusDecoderWrapper>(sample_rate, 1, frame_duration);
+    stream.decoder.reset();
+    stream.decoder = std::make_unique<OpusDecoderWrapper>(sample_rate, 1, frame_duration);
+
+    if (stream.decoder->sample_rate() != codec_->output_sample_rate()) {
+        ESP_LOGI(TAG, "Resampling audio from %d to %d", stream.decoder->sample_rate(), codec_->output_sample_rate());
+        stream.resampler.Configure(stream.decoder->sample_rate(), codec_->output_sample_rate());
+    }
+}
+
+int AudioService::GetStreamToDecode() const {
+    for (int i = kAudioStreamCount - 1; i >= 0; i--) {
+        auto& stream = playback_streams_[i];
+        if (!stream.decode_queue.empty() && !mixer_.IsFull(static_cast<AudioStreamId>(i), MAX_PLAYBACK_TASKS_IN_QUEUE)) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+bool AudioService::HasIdleSoundDecoder() const {
+    for (int i = kAudioStreamTts + 1; i < kAudioStreamCount; i++) {
+        auto& stream = playback_streams_[i];
+        if (stream.decoder && stream.decode_queue.empty() && !stream.decoding && mixer_.IsEmpty(static_cast<AudioStreamId>(i))) {
+            return true;
+        }
+    }
+    return false;
+}
 
-    auto codec = Board::GetInstance().GetAudioCodec();
-    if (opus_decoder_->sample_rate() != codec->output_sample_rate()) {
-        ESP_LOGI(TAG, "Resampling audio from %d to %d", opus_decoder_->sample_rate(), codec->output_sample_rate());
-        output_resampler_.Configure(opus_decoder_->sample_rate(), codec->output_sample_rate());
+uint32_t AudioService::GetPendingStreams() const {
+    uint32_t pending = 0;
+    for (int i = 0; i < kAudioStreamCount; i++) {
+        if (!playback_streams_[i].decode_queue.empty() || playback_streams_[i].decoding) {
+            pending |= AUDIO_STREAM_BIT(i);
+        }
     }
+    return pending;
+}
+
+bool AudioService::IsPlaybackEmpty() const {
+    return GetPendingStreams() == 0 && mixer_.IsEmpty();
 }
 
 void AudioService::PushTaskToEncodeQueue(AudioTaskType type, std::vector<int16_t>&& pcm) {
@@ -413,15 +596,12 @@ void AudioService::PushTaskToEncodeQueue(AudioTaskType type, std::vector<int16_t
     /* Push the task to the encode queue */
     std::unique_lock<std::mutex> lock(audio_queue_mutex_);
 
-    /* If the task is to send queue, we need to set the timestamp */
-    if (type == kAudioTaskTypeEncodeToSendQueue && !timestamp_queue_.empty()) {
-        if (timestamp_queue_.size() <= MAX_TIMESTAMPS_IN_QUEUE) {
-            task->timestamp = timestamp_queue_.front();
-        } else {
-            ESP_LOGW(TAG, "Timestamp queue (%u) is full, dropping timestamp", timestamp_queue_.size());
-        }
-        timestamp_queue_.pop_front();
+#if CONFIG_USE_SERVER_AEC
+    /* Tag the uplink frame with the server audio that was playing when it was captured */
+    if (type == kAudioTaskTypeEncodeToSendQueue) {
+        task->timestamp = playback_clock_.PopCaptureTimestamp(task->pcm.size());
     }
+#endif
 
     audio_queue_cv_.wait(lock, [this]() { return audio_encode_queue_.size() < MAX_ENCODE_TASKS_IN_QUEUE; });
     audio_encode_queue_.push_back(std::move(task));
@@ -429,15 +609,24 @@ void AudioService::PushTaskToEncodeQueue(AudioTaskType type, std::vector<int16_t
 }
 
 bool AudioService::PushPacketToDecodeQueue(std::unique_ptr<AudioStreamPacket> packet, bool wait) {
+    return PushPacketToStream(kAudioStreamTts, std::move(packet), wait);
+}
+
+bool AudioService::PushPacketToStream(AudioStreamId id, std::unique_ptr<AudioStreamPacket> packet, bool wait) {
     std::unique_lock<std::mutex> lock(audio_queue_mutex_);
-    if (audio_decode_queue_.size() >= MAX_DECODE_PACKETS_IN_QUEUE) {
+    auto& queue = playback_streams_[id].decode_queue;
+    if (queue.size() >= MAX_DECODE_PACKETS_IN_QUEUE) {
         if (wait) {
-            audio_queue_cv_.wait(lock, [this]() { return audio_decode_queue_.size() < MAX_DECODE_PACKETS_IN_QUEUE; });
+            audio_queue_cv_.wait(lock, [&queue]() { return queue.size() < MAX_DECODE_PACKETS_IN_QUEUE; });
         } else {
+            Metrics::GetInstance().Increment(kMetricDecodeQueueDropped);
             return false;
         }
     }
-    audio_decode_queue_.push_back(std::move(packet));
+    queue.push_back(std::move(packet));
+    if (id == kAudioStreamTts) {
+        Metrics::GetInstance().SetGauge(kMetricDecodeQueueDepth, queue.size());
+    }
     audio_queue_cv_.notify_all();
     return true;
 }
@@ -449,6 +638,7 @@ std::unique_ptr<AudioStreamPacket> AudioService::PopPacketFromSendQueue() {
     }
     auto packet = std::move(audio_send_queue_.front());
     audio_send_queue_.pop_front();
+    Metrics::GetInstance().SetGauge(kMetricSendQueueDepth, audio_send_queue_.size());
     audio_queue_cv_.notify_all();
     return packet;
 }
@@ -503,7 +693,12 @@ void AudioService::EnableVoiceProcessing(bool enable) {
 
         /* We should make sure no audio is playing */
         ResetDecoder();
+        {
+            std::lock_guard<std::mutex> lock(audio_queue_mutex_);
+            playback_clock_.ResetCapture();
+        }
         audio_input_need_warmup_ = true;
+        ExpectOutput();
         audio_processor_->Start();
         xEventGroupSetBits(event_group_, AS_EVENT_AUDIO_PROCESSOR_RUNNING);
     } else {
@@ -518,9 +713,9 @@ void AudioService::EnableAudioTesting(bool enable) {
         xEventGroupSetBits(event_group_, AS_EVENT_AUDIO_TESTING_RUNNING);
     } else {
         xEventGroupClearBits(event_group_, AS_EVENT_AUDIO_TESTING_RUNNING);
-        /* Copy audio_testing_queue_ to audio_decode_queue_ */
+        /* Play the recorded audio back as speech */
         std::lock_guard<std::mutex> lock(audio_queue_mutex_);
-        audio_decode_queue_ = std::move(audio_testing_queue_);
+        playback_streams_[kAudioStreamTts].decode_queue = std::move(audio_testing_queue_);
         audio_queue_cv_.notify_all();
     }
 }
@@ -540,11 +735,11 @@ bool AudioService::WaitForPlayCompletion(int timeout_ms) {
     bool status = true; 
     if(timeout_ms == -1){
         audio_queue_cv_.wait(lock, [this]{
-            return audio_decode_queue_.empty() && audio_playback_queue_.empty();
+            return IsPlaybackEmpty();
         });
     }else{
         status = audio_queue_cv_.wait_for(lock, std::chrono::milliseconds(timeout_ms), [this]{
-            return audio_decode_queue_.empty() && audio_playback_queue_.empty();
+            return IsPlaybackEmpty();
         });
     }
     return status;
@@ -554,131 +749,84 @@ void AudioService::SetCallbacks(AudioServiceCallbacks& callbacks) {
     callbacks_ = callbacks;
 }
 
-void AudioService::PlaySound(const std::string_view& ogg) {
+void AudioService::PlaySound(const std::string_view& ogg, AudioStreamId stream) {
     if (!codec_->output_enabled()) {
-        esp_timer_stop(audio_power_timer_);
-        esp_timer_start_periodic(audio_power_timer_, AUDIO_POWER_CHECK_INTERVAL_MS * 1000);
-        codec_->EnableOutput(true);
+        PowerUpOutput();
     }
 
-    const uint8_t* buf = reinterpret_cast<const uint8_t*>(ogg.data());
-    size_t size = ogg.size();
-    size_t offset = 0;
-
-    auto find_page = [&](size_t start)->size_t {
-        for (size_t i = start; i + 4 <= size; ++i) {
-            if (buf[i] == 'O' && buf[i+1] == 'g' && buf[i+2] == 'g' && buf[i+3] == 'S') return i;
-        }
-        return static_cast<size_t>(-1);
-    };
-
-    bool seen_head = false;
-    bool seen_tags = false;
-    int sample_rate = 16000; // 默认值
-
-    while (true) {
-        size_t pos = find_page(offset);
-        if (pos == static_cast<size_t>(-1)) break;
-        offset = pos;
-        if (offset + 27 > size) break;
-
-        const uint8_t* page = buf + offset;
-        uint8_t page_segments = page[26];
-        size_t seg_table_off = offset + 27;
-        if (seg_table_off + page_segments > size) break;
-
-        size_t body_size = 0;
-        for (size_t i = 0; i < page_segments; ++i) body_size += page[27 + i];
-
-        size_t body_off = seg_table_off + page_segments;
-        if (body_off + body_size > size) break;
-
-        // Parse packets using lacing
-        size_t cur = body_off;
-        size_t seg_idx = 0;
-        while (seg_idx < page_segments) {
-            size_t pkt_len = 0;
-            size_t pkt_start = cur;
-            bool continued = false;
-            do {
-                uint8_t l = page[27 + seg_idx++];
-                pkt_len += l;
-                cur += l;
-                continued = (l == 255);
-            } while (continued && seg_idx < page_segments);
-
-            if (pkt_len == 0) continue;
-            const uint8_t* pkt_ptr = buf + pkt_start;
-
-            if (!seen_head) {
-                // 解析OpusHead包
-                if (pkt_len >= 19 && std::memcmp(pkt_ptr, "OpusHead", 8) == 0) {
-                    seen_head = true;
-                    
-                    // OpusHead结构：[0-7] "OpusHead", [8] version, [9] channel_count, [10-11] pre_skip
-                    // [12-15] input_sample_rate, [16-17] output_gain, [18] mapping_family
-                    if (pkt_len >= 12) {
-                        uint8_t version = pkt_ptr[8];
-                        uint8_t channel_count = pkt_ptr[9];
-                        
-                        if (pkt_len >= 16) {
-                            // 读取输入采样率 (little-endian)
-                            sample_rate = pkt_ptr[12] | (pkt_ptr[13] << 8) | 
-                                        (pkt_ptr[14] << 16) | (pkt_ptr[15] << 24);
-                            ESP_LOGI(TAG, "OpusHead: version=%d, channels=%d, sample_rate=%d", 
-                                   version, channel_count, sample_rate);
-                        }
-                    }
-                }
-                continue;
-            }
-            if (!seen_tags) {
-                // Expect OpusTags in second packet
-                if (pkt_len >= 8 && std::memcmp(pkt_ptr, "OpusTags", 8) == 0) {
-                    seen_tags = true;
-                }
-                continue;
-            }
-
-            // Audio packet (Opus)
-            auto packet = std::make_unique<AudioStreamPacket>();
-            packet->sample_rate = sample_rate;
-            packet->frame_duration = 60;
-            packet->payload.resize(pkt_len);
-            std::memcpy(packet->payload.data(), pkt_ptr, pkt_len);
-            PushPacketToDecodeQueue(std::move(packet), true);
-        }
+    OggDemuxer::Demux(ogg, [this, stream](int sample_rate, const uint8_t* data, size_t size) {
+        auto packet = std::make_unique<AudioStreamPacket>();
+        packet->sample_rate = sample_rate;
+        packet->frame_duration = 60;
+        packet->payload.assign(data, data + size);
+        PushPacketToStream(stream, std::move(packet), true);
+    });
+}
 
-        offset = body_off + body_size;
-    }
+void AudioService::SetStreamVolume(AudioStreamId stream, int volume) {
+    std::lock_guard<std::mutex> lock(audio_queue_mutex_);
+    mixer_.SetGain(stream, std::clamp(volume, 0, 100) * AUDIO_MIXER_UNITY_GAIN / 100);
 }
 
 bool AudioService::IsIdle() {
     std::lock_guard<std::mutex> lock(audio_queue_mutex_);
-    return audio_encode_queue_.empty() && audio_decode_queue_.empty() && audio_playback_queue_.empty() && audio_testing_queue_.empty();
+    return audio_encode_queue_.empty() && IsPlaybackEmpty() && audio_testing_queue_.empty();
 }
 
 void AudioService::ResetDecoder() {
     std::lock_guard<std::mutex> lock(audio_queue_mutex_);
-    opus_decoder_->ResetState();
-    timestamp_queue_.clear();
-    audio_decode_queue_.clear();
-    audio_playback_queue_.clear();
+    auto& tts = playback_streams_[kAudioStreamTts];
+    if (tts.decoding) {
+        // The codec task resets the decoder when it is done with it
+        tts.generation++;
+    } else {
+        tts.decoder->ResetState();
+    }
+    tts.decode_queue.clear();
+    Metrics::GetInstance().SetGauge(kMetricDecodeQueueDepth, 0);
+    mixer_.Clear(kAudioStreamTts);
     audio_testing_queue_.clear();
     audio_queue_cv_.notify_all();
 }
 
+void AudioService::AbortPlayback() {
+    // A second abort before the output task got to the first one keeps the first time
+    int64_t expected = 0;
+    playback_abort_time_.compare_exchange_strong(expected, esp_timer_get_time());
+    ResetDecoder();
+}
+
 void AudioService::CheckAndUpdateAudioPowerState() {
-    auto now = std::chrono::steady_clock::now();
-    auto input_elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(now - last_input_time_).count();
-    auto output_elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(now - last_output_time_).count();
-    if (input_elapsed > AUDIO_POWER_TIMEOUT_MS && codec_->input_enabled()) {
+    int64_t now_ms = esp_timer_get_time() / 1000;
+    if (codec_->input_enabled() && power_manager_.IsInputIdle(now_ms)) {
+        ESP_LOGI(TAG, "Codec input idle for %d ms, powering down", power_manager_.GetInputTimeout());
         codec_->EnableInput(false);
     }
-    if (output_elapsed > AUDIO_POWER_TIMEOUT_MS && codec_->output_enabled()) {
+    if (codec_->output_enabled() && power_manager_.IsOutputIdle(now_ms)) {
+        ESP_LOGI(TAG, "Codec output idle for %d ms, powering down", power_manager_.GetOutputTimeout());
         codec_->EnableOutput(false);
     }
     if (!codec_->input_enabled() && !codec_->output_enabled()) {
         esp_timer_stop(audio_power_timer_);
     }
-}
\ No newline at end of file
+}
+
+void AudioService::PowerUpOutput() {
+    esp_timer_stop(audio_power_timer_);
+    esp_timer_start_periodic(audio_power_timer_, AUDIO_POWER_CHECK_INTERVAL_MS * 1000);
+    codec_->EnableOutput(true);
+}
+
+// Playback may follow, power the output up when it is predicted to start
+void AudioService::ExpectOutput() {
+    int delay_ms = power_manager_.OnOutputExpected(esp_timer_get_time() / 1000);
+    esp_timer_stop(output_prepower_timer_);
+    if (delay_ms < 0 || codec_->output_enabled()) {
+        return;
+    }
+    if (delay_ms == 0) {
+        PowerUpOutput();
+    } else {
+        esp_timer_start_once(output_prepower_timer_, delay_ms * 1000);
+    }
+}
@@ -6,6 +6,7 @@
 #include <condition_variable>
 #include <chrono>
 #include <mutex>
+#include <atomic>
 
 #include <freertos/FreeRTOS.h>
 #include <freertos/task.h>
@@ -18,6 +19,9 @@
 
 #include "audio_codec.h"
 #include "audio_processor.h"
+#include "audio_mixer.h"
+#include "playback_clock.h"
+#include "codec_power_manager.h"
 #include "processors/audio_debugger.h"
 #include "wake_word.h"
 #include "protocol.h"
@@ -26,7 +30,8 @@
 /*
  * There are two types of audio data flow:
  * 1. (MIC) -> [Processors] -> {Encode Queue} -> [Opus Encoder] -> {Send Queue} -> (Server)
- * 2. (Server) -> {Decode Queue} -> [Opus Decoder] -> {Playback Queue} -> (Speaker)
+ * 2. (Server / Sounds) -> {Decode Queue} -> [Opus Decoder] -> [Mixer] -> (Speaker)
+ *    Each playback stream (TTS, UI sounds, alerts) has its own decode queue, decoder and resampler.
  *
  * We use one task for MIC / Speaker / Processors, and one task for Opus Encoder / Opus Decoder.
  * 
@@ -36,13 +41,16 @@
 
 #define OPUS_FRAME_DURATION_MS 60
 #define MAX_ENCODE_TASKS_IN_QUEUE 2
+// Per playback stream, in mixer frames of OPUS_FRAME_DURATION_MS. The mixer waits for a full
+// frame while a stream is decoding, so this must stay above one for shorter server frames.
 #define MAX_PLAYBACK_TASKS_IN_QUEUE 2
 #define MAX_DECODE_PACKETS_IN_QUEUE (2400 / OPUS_FRAME_DURATION_MS)
 #define MAX_SEND_PACKETS_IN_QUEUE (2400 / OPUS_FRAME_DURATION_MS)
 #define AUDIO_TESTING_MAX_DURATION_MS 10000
-#define MAX_TIMESTAMPS_IN_QUEUE 3
 
-#define AUDIO_POWER_TIMEOUT_MS 15000
+// Fade applied to the speech cut by an abort when the DMA buffers are not flushed
+#define AUDIO_ABORT_FADE_MS 10
+
 #define AUDIO_POWER_CHECK_INTERVAL_MS 1000
 
 
@@ -62,7 +70,6 @@ struct AudioServiceCallbacks {
 enum AudioTaskType {
     kAudioTaskTypeEncodeToSendQueue,
     kAudioTaskTypeEncodeToTestingQueue,
-    kAudioTaskTypeDecodeToPlaybackQueue,
 };
 
 struct AudioTask {
@@ -90,6 +97,8 @@ public:
     std::unique_ptr<AudioStreamPacket> PopWakeWordPacket();
     const std::string& GetLastWakeWord() const;
     bool IsVoiceDetected() const { return voice_detected_; }
+    // Mic level of the last input frame, 0-255 on a log scale (about -60 dBFS to -24 dBFS)
+    int GetInputLevel() const { return input_level_; }
     bool IsIdle();
     bool IsWakeWordRunning() const { return xEventGroupGetBits(event_group_) & AS_EVENT_WAKE_WORD_RUNNING; }
     bool IsAudioProcessorRunning() const { return xEventGroupGetBits(event_group_) & AS_EVENT_AUDIO_PROCESSOR_RUNNING; }
@@ -98,28 +107,45 @@ public:
     void EnableVoiceProcessing(bool enable);
     void EnableAudioTesting(bool enable);
     void EnableDeviceAec(bool enable);
+    bool IsAecConverged() const { return audio_processor_initialized_ && audio_processor_->IsAecConverged(); }
 
     bool WaitForPlayCompletion(int timeout_ms);
 
     void SetCallbacks(AudioServiceCallbacks& callbacks);
 
+    // Server speech, played on kAudioStreamTts
     bool PushPacketToDecodeQueue(std::unique_ptr<AudioStreamPacket> packet, bool wait = false);
     std::unique_ptr<AudioStreamPacket> PopPacketFromSendQueue();
-    void PlaySound(const std::string_view& sound);
+    // Sounds do not wait for the speech and are not cleared by ResetDecoder
+    void PlaySound(const std::string_view& sound, AudioStreamId stream = kAudioStreamUi);
+    // 0-100, applied by the mixer on top of the codec volume
+    void SetStreamVolume(AudioStreamId stream, int volume);
     bool ReadAudioData(std::vector<int16_t>& data, int sample_rate, int samples);
+    // Drops the queued speech and resets its decoder
     void ResetDecoder();
+    // Barge-in: ResetDecoder, and the output task also cuts the frame it is writing
+    // and the audio already in the codec DMA buffers
+    void AbortPlayback();
 
 private:
+    struct PlaybackStream {
+        std::deque<std::unique_ptr<AudioStreamPacket>> decode_queue;
+        std::unique_ptr<OpusDecoderWrapper> decoder;
+        OpusResampler resampler;
+        bool decoding = false;
+        // Bumped by a reset, a packet decoded meanwhile is dropped
+        uint32_t generation = 0;
+    };
+
+    void UpdateInputLevel(const std::vector<int16_t>& data);
     AudioCodec* codec_ = nullptr;
     AudioServiceCallbacks callbacks_;
     std::unique_ptr<AudioProcessor> audio_processor_;
     std::unique_ptr<WakeWord> wake_word_;
     std::unique_ptr<AudioDebugger> audio_debugger_;
     std::unique_ptr<OpusEncoderWrapper> opus_encoder_;
-    std::unique_ptr<OpusDecoderWrapper> opus_decoder_;
     OpusResampler input_resampler_;
     OpusResampler reference_resampler_;
-    OpusResampler output_resampler_;
     DebugStatistics debug_statistics_;
 
     EventGroupHandle_t event_group_;
@@ -130,30 +156,43 @@ private:
     TaskHandle_t opus_codec_task_handle_ = nullptr;
     std::mutex audio_queue_mutex_;
     std::condition_variable audio_queue_cv_;
-    std::deque<std::unique_ptr<AudioStreamPacket>> audio_decode_queue_;
     std::deque<std::unique_ptr<AudioStreamPacket>> audio_send_queue_;
     std::deque<std::unique_ptr<AudioStreamPacket>> audio_testing_queue_;
     std::deque<std::unique_ptr<AudioTask>> audio_encode_queue_;
-    std::deque<std::unique_ptr<AudioTask>> audio_playback_queue_;
+    PlaybackStream playback_streams_[kAudioStreamCount];
+    AudioMixer mixer_;
     // For server AEC
-    std::deque<uint32_t> timestamp_queue_;
+    PlaybackClock playback_clock_;
+    // Time of a pending AbortPlayback in microseconds, 0 if none
+    std::atomic<int64_t> playback_abort_time_{0};
 
     bool wake_word_initialized_ = false;
     bool audio_processor_initialized_ = false;
     bool voice_detected_ = false;
+    int input_level_ = 0;
     bool service_stopped_ = true;
     bool audio_input_need_warmup_ = false;
 
     esp_timer_handle_t audio_power_timer_ = nullptr;
-    std::chrono::steady_clock::time_point last_input_time_;
-    std::chrono::steady_clock::time_point last_output_time_;
+    // Powers the output up ahead of the playback predicted by power_manager_
+    esp_timer_handle_t output_prepower_timer_ = nullptr;
+    CodecPowerManager power_manager_;
 
     void AudioInputTask();
     void AudioOutputTask();
     void OpusCodecTask();
     void PushTaskToEncodeQueue(AudioTaskType type, std::vector<int16_t>&& pcm);
-    void SetDecodeSampleRate(int sample_rate, int frame_duration);
+    bool PushPacketToStream(AudioStreamId stream, std::unique_ptr<AudioStreamPacket> packet, bool wait);
+    int GetStreamToDecode() const;
+    bool HasIdleSoundDecoder() const;
+    uint32_t GetPendingStreams() const;
+    bool IsPlaybackEmpty() const;
+    void DecodePacket(AudioStreamId stream, std::unique_ptr<AudioStreamPacket> packet, std::unique_lock<std::mutex>& lock);
+    void SetDecodeSampleRate(PlaybackStream& stream, int sample_rate, int frame_duration);
+    void StopOutput(const std::vector<int16_t>& pcm, size_t offset);
     void CheckAndUpdateAudioPowerState();
+    void PowerUpOutput();
+    void ExpectOutput();
 };
 
 #endif
\ No newline at end of file
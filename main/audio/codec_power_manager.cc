@@ -0,0 +1,154 @@
+#include "codec_power_manager.h"
+
+#include <algorithm>
+#include <cstdlib>
+
+// Idle gaps seen before the timeout is learned
+#define GAPS_MIN_HISTORY 4
+// Playback is predicted when it followed at least this share of the recent expectations
+#define FOLLOW_MIN_HISTORY 4
+#define FOLLOW_HISTORY_BITS 8
+#define FOLLOW_MIN_PERCENT 75
+// The mic DC offset moves less than this between two settled blocks
+#define SETTLE_MAX_DC_STEP 64
+// A running mic has a noise floor, a block below this is the ADC or its path still muted
+#define SETTLE_MIN_LEVEL 2
+
+void CodecPowerManager::Gaps::Add(int value) {
+    values[index] = value;
+    index = (index + 1) % CODEC_POWER_HISTORY;
+    count = std::min(count + 1, static_cast<size_t>(CODEC_POWER_HISTORY));
+}
+
+int CodecPowerManager::Gaps::GetTimeout() const {
+    if (count < GAPS_MIN_HISTORY) {
+        return AUDIO_POWER_MAX_TIMEOUT_MS;
+    }
+    int sorted[CODEC_POWER_HISTORY];
+    std::copy(values, values + count, sorted);
+    std::sort(sorted, sorted + count);
+    // Stay on through 80% of the gaps, unless that is longer than the power is worth keeping
+    int timeout = sorted[(count * 4 - 1) / 5] + AUDIO_POWER_TIMEOUT_MARGIN_MS;
+    if (timeout > AUDIO_POWER_MAX_TIMEOUT_MS) {
+        return AUDIO_POWER_MIN_TIMEOUT_MS;
+    }
+    return std::max(timeout, AUDIO_POWER_MIN_TIMEOUT_MS);
+}
+
+void CodecPowerManager::OnInput(int64_t now_ms) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (input_gaps_.last_ms >= 0 && now_ms - input_gaps_.last_ms > AUDIO_POWER_BURST_GAP_MS) {
+        input_gaps_.Add(now_ms - input_gaps_.last_ms);
+    }
+    input_gaps_.last_ms = now_ms;
+}
+
+void CodecPowerManager::OnOutput(int64_t now_ms) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (output_gaps_.last_ms >= 0 && now_ms - output_gaps_.last_ms > AUDIO_POWER_BURST_GAP_MS) {
+        output_gaps_.Add(now_ms - output_gaps_.last_ms);
+    }
+    output_gaps_.last_ms = now_ms;
+
+    if (expected_ms_ >= 0) {
+        int delay = now_ms - expected_ms_;
+        if (delay <= AUDIO_OUTPUT_FOLLOW_WINDOW_MS) {
+            follow_delays_[follow_delay_index_] = delay;
+            follow_delay_index_ = (follow_delay_index_ + 1) % CODEC_POWER_HISTORY;
+            follow_delay_count_ = std::min(follow_delay_count_ + 1, static_cast<size_t>(CODEC_POWER_HISTORY));
+        }
+        RecordFollow(delay <= AUDIO_OUTPUT_FOLLOW_WINDOW_MS);
+        expected_ms_ = -1;
+    }
+}
+
+int CodecPowerManager::GetInputTimeout() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return input_gaps_.GetTimeout();
+}
+
+int CodecPowerManager::GetOutputTimeout() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return output_gaps_.GetTimeout();
+}
+
+bool CodecPowerManager::IsInputIdle(int64_t now_ms) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return now_ms - input_gaps_.last_ms > input_gaps_.GetTimeout();
+}
+
+bool CodecPowerManager::IsOutputIdle(int64_t now_ms) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    // An output powered up for the expected playback is kept on while it is expected
+    if (expected_ms_ >= 0 && now_ms - expected_ms_ <= AUDIO_OUTPUT_FOLLOW_WINDOW_MS) {
+        return false;
+    }
+    return now_ms - output_gaps_.last_ms > output_gaps_.GetTimeout();
+}
+
+int CodecPowerManager::OnOutputExpected(int64_t now_ms) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (expected_ms_ >= 0 && now_ms - expected_ms_ > AUDIO_OUTPUT_FOLLOW_WINDOW_MS) {
+        RecordFollow(false);
+    }
+    // Nothing to learn or predict while playing
+    if (output_gaps_.last_ms >= 0 && now_ms - output_gaps_.last_ms <= AUDIO_POWER_BURST_GAP_MS) {
+        expected_ms_ = -1;
+        return -1;
+    }
+    expected_ms_ = now_ms;
+
+    size_t history = std::min(follow_history_count_, static_cast<size_t>(FOLLOW_HISTORY_BITS));
+    if (history < FOLLOW_MIN_HISTORY || follow_delay_count_ == 0) {
+        return -1;
+    }
+    int followed = __builtin_popcount(follow_history_ & ((1u << history) - 1));
+    if (followed * 100 < static_cast<int>(history) * FOLLOW_MIN_PERCENT) {
+        return -1;
+    }
+    int earliest = *std::min_element(follow_delays_, follow_delays_ + follow_delay_count_);
+    return std::max(earliest - AUDIO_OUTPUT_PREPOWER_LEAD_MS, 0);
+}
+
+void CodecPowerManager::RecordFollow(bool followed) {
+    follow_history_ = (follow_history_ << 1) | (followed ? 1 : 0);
+    follow_history_count_++;
+}
+
+void CodecPowerManager::StartInputSettling() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    settle_blocks_ = 0;
+    settle_has_reference_ = false;
+}
+
+bool CodecPowerManager::OnInputSettlingBlock(const int16_t* data, size_t frames, int channels) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (frames == 0) {
+        return true;
+    }
+    // DC offset and mean absolute deviation of the first mic
+    int32_t sum = 0;
+    for (size_t i = 0; i < frames; i++) {
+        sum += data[i * channels];
+    }
+    int32_t dc = sum / static_cast<int32_t>(frames);
+    int32_t deviation = 0;
+    for (size_t i = 0; i < frames; i++) {
+        deviation += std::abs(data[i * channels] - dc);
+    }
+    int32_t level = deviation / static_cast<int32_t>(frames);
+
+    settle_blocks_++;
+    bool settled = false;
+    if (level < SETTLE_MIN_LEVEL) {
+        // Digital silence has a steady DC and level too, the block after it is compared from scratch
+        settle_has_reference_ = false;
+    } else {
+        // A power-up step moves the DC offset and leaves a decaying tail, speech does neither
+        settled = settle_has_reference_ && std::abs(dc - settle_dc_) < SETTLE_MAX_DC_STEP && level * 2 >= settle_level_;
+        settle_has_reference_ = true;
+        settle_dc_ = dc;
+        settle_level_ = level;
+    }
+    return settled || settle_blocks_ * AUDIO_INPUT_SETTLE_BLOCK_MS >= AUDIO_INPUT_SETTLE_MAX_MS;
+}
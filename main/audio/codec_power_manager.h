@@ -0,0 +1,88 @@
+#ifndef CODEC_POWER_MANAGER_H
+#define CODEC_POWER_MANAGER_H
+
+#include <cstdint>
+#include <cstddef>
+#include <mutex>
+
+// Idle timeouts are learned between these, the maximum is also the timeout until enough is learned
+#define AUDIO_POWER_MIN_TIMEOUT_MS 3000
+#define AUDIO_POWER_MAX_TIMEOUT_MS 15000
+// Kept on this long after the usual idle gap
+#define AUDIO_POWER_TIMEOUT_MARGIN_MS 1000
+// A longer pause between two frames ends a burst of use
+#define AUDIO_POWER_BURST_GAP_MS 300
+// Playback starting this long after listening or after the user stopped speaking follows it
+#define AUDIO_OUTPUT_FOLLOW_WINDOW_MS 10000
+// The output is powered up this long before the earliest playback seen after such an event
+#define AUDIO_OUTPUT_PREPOWER_LEAD_MS 150
+// The mic is read in blocks of this until it settles, never longer than the old fixed warm-up
+#define AUDIO_INPUT_SETTLE_BLOCK_MS 10
+#define AUDIO_INPUT_SETTLE_MAX_MS 120
+
+#define CODEC_POWER_HISTORY 16
+
+/*
+ * Decides when the codec input and output are powered down and when the output is
+ * powered up ahead of use, from the usage seen so far:
+ * - The idle timeout of each direction covers most of the recent gaps between two bursts
+ *   of use. When the gaps are mostly longer than AUDIO_POWER_MAX_TIMEOUT_MS the direction
+ *   is powered down after AUDIO_POWER_MIN_TIMEOUT_MS instead.
+ * - When playback usually follows listening or the end of the user speech, the output is
+ *   powered up during the server round trip, just before the earliest playback seen.
+ * - After the input is started, the mic is settled once its DC offset is steady and its
+ *   level no longer decays, instead of after a fixed delay. Digital silence before the
+ *   ADC runs does not count.
+ *
+ * Times are in milliseconds. Thread safe.
+ */
+class CodecPowerManager {
+public:
+    void OnInput(int64_t now_ms);
+    void OnOutput(int64_t now_ms);
+    int GetInputTimeout();
+    int GetOutputTimeout();
+    bool IsInputIdle(int64_t now_ms);
+    bool IsOutputIdle(int64_t now_ms);
+
+    // Playback may follow now, returns in how many ms to power up the output, -1 for not at all
+    int OnOutputExpected(int64_t now_ms);
+
+    void StartInputSettling();
+    // Takes the next block of interleaved mic samples, returns true once the mic has settled
+    bool OnInputSettlingBlock(const int16_t* data, size_t frames, int channels);
+
+private:
+    struct Gaps {
+        int values[CODEC_POWER_HISTORY] = {};
+        size_t count = 0;
+        size_t index = 0;
+        int64_t last_ms = -1;
+
+        void Add(int value);
+        int GetTimeout() const;
+    };
+
+    std::mutex mutex_;
+    Gaps input_gaps_;
+    Gaps output_gaps_;
+
+    // Time of the last event after which playback was expected, -1 if none is pending
+    int64_t expected_ms_ = -1;
+    int follow_delays_[CODEC_POWER_HISTORY] = {};
+    size_t follow_delay_count_ = 0;
+    size_t follow_delay_index_ = 0;
+    // Bit i is set when the i-th latest expectation was followed by playback
+    uint32_t follow_history_ = 0;
+    size_t follow_history_count_ = 0;
+
+    int settle_blocks_ = 0;
+    // The last block had a level to compare the next one with
+    bool settle_has_reference_ = false;
+    int32_t settle_dc_ = 0;
+    int32_t settle_level_ = 0;
+
+    void RecordFollow(bool followed);
+};
+
+#endif // CODEC_POWER_MANAGER_H
@@ -0,0 +1,20 @@
+#ifndef OGG_DEMUXER_H
+#define OGG_DEMUXER_H
+
+#include <cstdint>
+#include <cstddef>
+#include <functional>
+#include <string_view>
+
+// Splits an Ogg Opus stream into raw Opus packets.
+// Plain C++ without ESP-IDF dependencies, so it can also be built for the host.
+class OggDemuxer {
+public:
+    using PacketCallback = std::function<void(int sample_rate, const uint8_t* data, size_t size)>;
+
+    // Calls on_packet for every audio packet after the OpusHead / OpusTags headers,
+    // returns the number of audio packets found
+    static size_t Demux(const std::string_view& ogg, PacketCallback on_packet);
+};
+
+#endif // OGG_DEMUXER_H
@@ -0,0 +1,94 @@
+#include "playback_clock.h"
+
+#include <algorithm>
+
+// About two seconds of output and of capture, more than the audio processor delays the mic
+#define MAX_SEGMENTS 160
+#define MAX_CAPTURES 64
+
+void PlaybackClock::Configure(int output_sample_rate, int input_sample_rate, int buffer_frames, int buffer_count) {
+    output_sample_rate_ = output_sample_rate;
+    input_sample_rate_ = input_sample_rate;
+    buffer_frames_ = buffer_frames;
+    buffer_count_ = buffer_count;
+}
+
+void PlaybackClock::OnWrite(size_t frames, uint32_t timestamp, uint32_t buffers_sent, uint32_t restart_buffers) {
+    if (restart_buffers != restart_buffers_) {
+        // The restart dropped the buffer being filled, and what was written after the
+        // last buffer sent before it never played
+        restart_buffers_ = restart_buffers;
+        buffer_fill_ = buffer_frames_;
+        int64_t stop_position = static_cast<int64_t>(restart_buffers) * buffer_frames_;
+        while (!segments_.empty() && segments_.back().position >= stop_position) {
+            segments_.pop_back();
+        }
+    }
+
+    size_t written = 0;
+    while (written < frames) {
+        if (buffer_ == 0 || buffer_fill_ == static_cast<size_t>(buffer_frames_)) {
+            // The oldest free buffer the driver still keeps
+            buffer_ = std::max({buffer_ + 1, static_cast<int64_t>(restart_buffers_) + 1,
+                static_cast<int64_t>(buffers_sent) - (buffer_count_ - 2)});
+            buffer_fill_ = 0;
+        }
+        size_t n = std::min(frames - written, buffer_frames_ - buffer_fill_);
+        int64_t position = (buffer_ + buffer_count_ - 1) * buffer_frames_ + buffer_fill_;
+        uint32_t segment_timestamp = timestamp == 0 ? 0 : timestamp + written * 1000 / output_sample_rate_;
+        segments_.push_back(Segment{position, n, segment_timestamp});
+        buffer_fill_ += n;
+        written += n;
+    }
+
+    while (segments_.size() > MAX_SEGMENTS) {
+        segments_.pop_front();
+    }
+}
+
+int64_t PlaybackClock::GetPosition(uint32_t buffers_sent, uint32_t sent_time_us, uint32_t now_us) const {
+    int64_t elapsed = static_cast<uint32_t>(now_us - sent_time_us);
+    int64_t frames = std::min<int64_t>(elapsed * output_sample_rate_ / 1000000, buffer_frames_);
+    return static_cast<int64_t>(buffers_sent) * buffer_frames_ + frames;
+}
+
+uint32_t PlaybackClock::GetTimestamp(int64_t position) const {
+    // Audio written after a stall overlaps what was never played, the latest write wins
+    for (auto it = segments_.rbegin(); it != segments_.rend(); ++it) {
+        if (position >= it->position && position < it->position + static_cast<int64_t>(it->frames)) {
+            if (it->timestamp == 0) {
+                return 0;
+            }
+            return it->timestamp + (position - it->position) * 1000 / output_sample_rate_;
+        }
+    }
+    return 0;
+}
+
+void PlaybackClock::OnCapture(int64_t position, size_t samples) {
+    captures_.push_back(Capture{captured_samples_, position});
+    captured_samples_ += samples;
+    while (captures_.size() > MAX_CAPTURES) {
+        captures_.pop_front();
+    }
+}
+
+uint32_t PlaybackClock::PopCaptureTimestamp(size_t samples) {
+    uint64_t sample = popped_samples_;
+    popped_samples_ += samples;
+    while (captures_.size() > 1 && captures_[1].sample <= sample) {
+        captures_.pop_front();
+    }
+    if (captures_.empty() || captures_.front().sample > sample) {
+        return 0;
+    }
+    auto& capture = captures_.front();
+    int64_t offset = static_cast<int64_t>(sample - capture.sample) * output_sample_rate_ / input_sample_rate_;
+    return GetTimestamp(capture.position + offset);
+}
+
+void PlaybackClock::ResetCapture() {
+    captured_samples_ = 0;
+    popped_samples_ = 0;
+    captures_.clear();
+}
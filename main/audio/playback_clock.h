@@ -0,0 +1,67 @@
+#ifndef PLAYBACK_CLOCK_H
+#define PLAYBACK_CLOCK_H
+
+#include <cstdint>
+#include <cstddef>
+#include <deque>
+
+/*
+ * Tells which server audio was on the speaker when a mic frame was captured, for server AEC.
+ *
+ * Positions count frames at the output sample rate as emitted by the I2S DMA, one buffer of
+ * buffer_frames per "sent" event of the TX channel, silence included. The driver gives a
+ * buffer back to the writer when it is sent and the DMA plays it again after the rest of the
+ * ring, so the buffer freed by the n-th event plays from (n + buffer_count - 1) * buffer_frames.
+ * The writer fills the freed buffers in order, and the driver keeps at most buffer_count - 1 of
+ * them (dropping the oldest) and none after the channel is restarted.
+ *
+ * Not thread safe, AudioService calls it with its queue mutex held.
+ */
+class PlaybackClock {
+public:
+    void Configure(int output_sample_rate, int input_sample_rate, int buffer_frames, int buffer_count);
+
+    // After frames were written, timestamp is the one of the first frame (0 for no server audio).
+    // buffers_sent is read from the codec before the write, restart_buffers once it returned.
+    void OnWrite(size_t frames, uint32_t timestamp, uint32_t buffers_sent, uint32_t restart_buffers);
+    // Position now, interpolated from the time of the last sent buffer
+    int64_t GetPosition(uint32_t buffers_sent, uint32_t sent_time_us, uint32_t now_us) const;
+    // Timestamp of the server audio played at position plus the milliseconds into it, 0 if none
+    uint32_t GetTimestamp(int64_t position) const;
+
+    // The next samples mic samples (at the input sample rate) were captured from position on
+    void OnCapture(int64_t position, size_t samples);
+    // Takes the next samples mic samples and returns the timestamp played when the first was captured
+    uint32_t PopCaptureTimestamp(size_t samples);
+    // The capture and the frames taken by PopCaptureTimestamp start again from the same sample
+    void ResetCapture();
+
+private:
+    struct Segment {
+        int64_t position;
+        size_t frames;
+        uint32_t timestamp;
+    };
+
+    struct Capture {
+        uint64_t sample;
+        int64_t position;
+    };
+
+    int output_sample_rate_ = 0;
+    int input_sample_rate_ = 0;
+    int buffer_frames_ = 0;
+    int buffer_count_ = 0;
+
+    // Event number of the buffer being filled, 0 for none
+    int64_t buffer_ = 0;
+    size_t buffer_fill_ = 0;
+    uint32_t restart_buffers_ = 0;
+    std::deque<Segment> segments_;
+
+    uint64_t captured_samples_ = 0;
+    uint64_t popped_samples_ = 0;
+    std::deque<Capture> captures_;
+};
+
+#endif // PLAYBACK_CLOCK_H
@@ -1,7 +1,19 @@
 #include "afe_audio_processor.h"
+#include "speech_model_registry.h"
+#include "metrics.h"
+
 #include <esp_log.h>
+#include <cmath>
 
 #define PROCESSOR_RUNNING 0x01
+// ERLE 统计窗口（参考信号有效的输入采样数）与判定 AEC 收敛的门限
+#define ERLE_WINDOW_SAMPLES (16000 * 2)
+#define AEC_CONVERGED_ERLE_DB 15
+// AFE 只输出 NS 之后的数据，NS 会把残留回声当作噪声一起压掉，测得的 ERLE 偏高，
+// 开启 NS 时门限提高这么多，避免 NS 的抑制量被当成 AEC 已收敛
+#define ERLE_NS_MARGIN_DB 10
+// 参考信号静默超过这么久（输入采样数）后，上次测得的 ERLE 作废，等下次播放重新测量
+#define ERLE_EXPIRE_SAMPLES (16000 * 10)
 
 #define TAG "AfeAudioProcessor"
 
@@ -27,9 +39,9 @@ void AfeAudioProcessor::Initialize(AudioCodec* codec, int frame_duration_ms) {
         input_format.push_back('R');
     }
 
-    srmodel_list_t *models = esp_srmodel_init("model");
-    char* ns_model_name = esp_srmodel_filter(models, ESP_NSNET_PREFIX, NULL);
-    char* vad_model_name = esp_srmodel_filter(models, ESP_VADN_PREFIX, NULL);
+    auto& registry = SpeechModelRegistry::GetInstance();
+    char* ns_model_name = const_cast<char*>(registry.GetNsModel());
+    char* vad_model_name = const_cast<char*>(registry.GetVadModel());
     
     afe_config_t* afe_config = afe_config_init(input_format.c_str(), NULL, AFE_TYPE_VC, AFE_MODE_HIGH_PERF);
     afe_config->aec_mode = AEC_MODE_VOIP_HIGH_PERF;
@@ -39,7 +51,9 @@ void AfeAudioProcessor::Initialize(AudioCodec* codec, int frame_duration_ms) {
         afe_config->vad_model_name = vad_model_name;
     }
 
+    erle_threshold_db_ = AEC_CONVERGED_ERLE_DB;
     if (ns_model_name != nullptr) {
+        erle_threshold_db_ += ERLE_NS_MARGIN_DB;
         afe_config->ns_init = true;
         afe_config->ns_model_name = ns_model_name;
         afe_config->afe_ns_mode = AFE_NS_MODE_NET;
@@ -55,6 +69,12 @@ void AfeAudioProcessor::Initialize(AudioCodec* codec, int frame_duration_ms) {
 #ifdef CONFIG_USE_DEVICE_AEC
     afe_config->aec_init = true;
     afe_config->vad_init = false;
+    aec_enabled_ = true;
+    if (ref_num > 0) {
+        // 参考通道在最后，估计回声相对参考通道的延迟并在送入 AFE 前对齐
+        delay_estimator_.Configure(16000, codec_->input_channels(), codec_->input_channels() - 1);
+        estimate_delay_ = true;
+    }
 #else
     afe_config->aec_init = false;
     afe_config->vad_init = true;
@@ -88,6 +108,9 @@ void AfeAudioProcessor::Feed(std::vector<int16_t>&& data) {
     if (afe_data_ == nullptr) {
         return;
     }
+    if (estimate_delay_) {
+        MeasureInput(data);
+    }
     afe_iface_->feed(afe_data_, data.data());
 }
 
@@ -145,6 +168,10 @@ void AfeAudioProcessor::AudioProcessorTask() {
             }
         }
 
+        if (estimate_delay_) {
+            MeasureOutput(res->data, res->data_size / sizeof(int16_t));
+        }
+
         if (output_callback_) {
             size_t samples = res->data_size / sizeof(int16_t);
             
@@ -173,11 +200,80 @@ void AfeAudioProcessor::EnableDeviceAec(bool enable) {
 #if CONFIG_USE_DEVICE_AEC
         afe_iface_->disable_vad(afe_data_);
         afe_iface_->enable_aec(afe_data_);
+        aec_enabled_ = true;
 #else
         ESP_LOGE(TAG, "Device AEC is not supported");
 #endif
     } else {
         afe_iface_->disable_aec(afe_data_);
         afe_iface_->enable_vad(afe_data_);
+        aec_enabled_ = false;
+    }
+}
+
+bool AfeAudioProcessor::IsAecConverged() {
+    return aec_enabled_ && delay_estimator_.locked() && erle_db_ >= erle_threshold_db_;
+}
+
+void AfeAudioProcessor::MeasureInput(std::vector<int16_t>& data) {
+    int channels = codec_->input_channels();
+    size_t frames = data.size() / channels;
+    // 先按未补偿的数据测量延迟，再原地延迟参考或麦克风通道
+    if (delay_estimator_.Process(data.data(), frames)) {
+        ESP_LOGI(TAG, "AEC reference delay: %d ms", delay_estimator_.delay_ms());
+        Metrics::GetInstance().SetGauge(kMetricAecDelayMs, delay_estimator_.delay_ms());
+    }
+    if (!aec_enabled_) {
+        return;
+    }
+    if (!delay_estimator_.reference_active()) {
+        erle_quiet_samples_ += frames;
+        if (erle_quiet_samples_ >= ERLE_EXPIRE_SAMPLES && erle_db_ != 0) {
+            // 静默期间 AEC 滤波器不再更新，回声路径可能已变化（音量、摆放位置）
+            std::lock_guard<std::mutex> lock(erle_mutex_);
+            erle_db_ = 0;
+            Metrics::GetInstance().SetGauge(kMetricAecErleDb, 0);
+            erle_mic_energy_ = 0;
+            erle_mic_samples_ = 0;
+            erle_output_energy_ = 0;
+            erle_output_samples_ = 0;
+        }
+        return;
+    }
+    erle_quiet_samples_ = 0;
+
+    // ERLE 只统计有回声的时段：第一路麦克风的能量对比 AFE 输出的能量
+    int64_t energy = 0;
+    for (size_t i = 0; i < frames; i++) {
+        int32_t sample = data[i * channels];
+        energy += sample * sample;
+    }
+    std::lock_guard<std::mutex> lock(erle_mutex_);
+    erle_mic_energy_ += energy;
+    erle_mic_samples_ += frames;
+    if (erle_mic_samples_ < ERLE_WINDOW_SAMPLES || erle_output_samples_ == 0) {
+        return;
+    }
+    double mic_power = static_cast<double>(erle_mic_energy_) / erle_mic_samples_;
+    double output_power = static_cast<double>(erle_output_energy_) / erle_output_samples_;
+    erle_db_ = static_cast<int>(10 * log10((mic_power + 1) / (output_power + 1)));
+    Metrics::GetInstance().SetGauge(kMetricAecErleDb, erle_db_);
+    erle_mic_energy_ = 0;
+    erle_mic_samples_ = 0;
+    erle_output_energy_ = 0;
+    erle_output_samples_ = 0;
+}
+
+void AfeAudioProcessor::MeasureOutput(const int16_t* data, size_t samples) {
+    if (!aec_enabled_ || !delay_estimator_.reference_active()) {
+        return;
+    }
+    int64_t energy = 0;
+    for (size_t i = 0; i < samples; i++) {
+        int32_t sample = data[i];
+        energy += sample * sample;
     }
+    std::lock_guard<std::mutex> lock(erle_mutex_);
+    erle_output_energy_ += energy;
+    erle_output_samples_ += samples;
 }
@@ -9,9 +9,12 @@
 #include <string>
 #include <vector>
 #include <functional>
+#include <mutex>
+#include <atomic>
 
 #include "audio_processor.h"
 #include "audio_codec.h"
+#include "reference_delay_estimator.h"
 
 class AfeAudioProcessor : public AudioProcessor {
 public:
@@ -27,6 +30,7 @@ public:
     void OnVadStateChange(std::function<void(bool speaking)> callback) override;
     size_t GetFeedSize() override;
     void EnableDeviceAec(bool enable) override;
+    bool IsAecConverged() override;
 
 private:
     EventGroupHandle_t event_group_ = nullptr;
@@ -39,7 +43,22 @@ private:
     bool is_speaking_ = false;
     std::vector<int16_t> output_buffer_;
 
+    // 参考信号延迟估计与 ERLE 统计，仅在有参考通道且开启设备端 AEC 时使用
+    bool estimate_delay_ = false;
+    std::atomic<bool> aec_enabled_{false};
+    ReferenceDelayEstimator delay_estimator_;
+    std::mutex erle_mutex_;
+    int64_t erle_mic_energy_ = 0;
+    size_t erle_mic_samples_ = 0;
+    int64_t erle_output_energy_ = 0;
+    size_t erle_output_samples_ = 0;
+    std::atomic<int> erle_db_{0};
+    int erle_threshold_db_ = 0;
+    size_t erle_quiet_samples_ = 0;
+
     void AudioProcessorTask();
+    void MeasureInput(std::vector<int16_t>& data);
+    void MeasureOutput(const int16_t* data, size_t samples);
 };
 
 #endif 
\ No newline at end of file
@@ -29,6 +29,8 @@ AudioDebugger::AudioDebugger() {
             udp_server_addr_.sin_family = AF_INET;
             udp_server_addr_.sin_port = htons(port);
             inet_pton(AF_INET, ip.c_str(), &udp_server_addr_.sin_addr);
+            udp_metrics_addr_ = udp_server_addr_;
+            udp_metrics_addr_.sin_port = htons(port + 1);
             
             ESP_LOGI(TAG, "Initialized server address: %s", CONFIG_AUDIO_DEBUG_UDP_SERVER);
         } else {
@@ -65,4 +67,14 @@ void AudioDebugger::Feed(const std::vector<int16_t>& data) {
 #endif
 }
 
- 
\ No newline at end of file
+void AudioDebugger::SendMetrics(const std::string& snapshot) {
+#if CONFIG_USE_AUDIO_DEBUGGER
+    if (udp_sockfd_ >= 0) {
+        ssize_t sent = sendto(udp_sockfd_, snapshot.data(), snapshot.size(), 0,
+                             (struct sockaddr*)&udp_metrics_addr_, sizeof(udp_metrics_addr_));
+        if (sent < 0) {
+            ESP_LOGW(TAG, "Failed to send metrics to %s: %d", CONFIG_AUDIO_DEBUG_UDP_SERVER, errno);
+        }
+    }
+#endif
+}
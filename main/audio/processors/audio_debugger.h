@@ -2,6 +2,7 @@
 #define AUDIO_DEBUGGER_H
 
 #include <vector>
+#include <string>
 #include <cstdint>
 
 #include <sys/socket.h>
@@ -13,10 +14,13 @@ public:
     ~AudioDebugger();
 
     void Feed(const std::vector<int16_t>& data);
+    // 性能指标快照发送到 PORT + 1，避免混入音频数据流
+    void SendMetrics(const std::string& snapshot);
 
 private:
     int udp_sockfd_ = -1;
     struct sockaddr_in udp_server_addr_;
+    struct sockaddr_in udp_metrics_addr_;
 };
 
 #endif 
\ No newline at end of file
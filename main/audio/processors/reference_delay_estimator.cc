@@ -0,0 +1,147 @@
+#include "reference_delay_estimator.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+
+#define ESTIMATE_WINDOW_MS 1024
+#define ESTIMATE_INTERVAL_MS 500
+// Mean absolute value of a millisecond of reference that counts as playing (about -54 dBFS)
+#define REFERENCE_ACTIVE_LEVEL 64
+// The reference plays in this share of the window at least
+#define REFERENCE_ACTIVE_PERCENT 30
+#define MIN_CORRELATION 0.3f
+// Two estimates agree, and a new one replaces the current delay, within this
+#define DELAY_TOLERANCE_MS 2
+
+void ReferenceDelayEstimator::Configure(int sample_rate, int channels, int reference_channel) {
+    channels_ = channels;
+    reference_channel_ = reference_channel;
+    mic_channel_ = reference_channel == 0 ? 1 : 0;
+    samples_per_ms_ = sample_rate / 1000;
+
+    mic_envelope_.assign(ESTIMATE_WINDOW_MS, 0);
+    reference_envelope_.assign(ESTIMATE_WINDOW_MS, 0);
+    mic_window_.resize(ESTIMATE_WINDOW_MS);
+    reference_window_.resize(ESTIMATE_WINDOW_MS);
+    delay_lines_.assign(channels, {});
+    channel_delays_.assign(channels, 0);
+}
+
+bool ReferenceDelayEstimator::Process(int16_t* data, size_t frames) {
+    bool changed = false;
+    int32_t reference_level = 0;
+    size_t delay_line_size = std::max(REFERENCE_DELAY_MAX_MS, -REFERENCE_DELAY_MIN_MS + REFERENCE_DELAY_MARGIN_MS) * samples_per_ms_ + 1;
+    for (size_t i = 0; i < frames; i++) {
+        int16_t* frame = data + i * channels_;
+        int32_t reference = std::abs(frame[reference_channel_]);
+        mic_sum_ += std::abs(frame[mic_channel_]);
+        reference_sum_ += reference;
+        reference_level += reference;
+        if (++block_samples_ == samples_per_ms_) {
+            mic_envelope_[envelope_index_] = static_cast<float>(mic_sum_) / samples_per_ms_;
+            reference_envelope_[envelope_index_] = static_cast<float>(reference_sum_) / samples_per_ms_;
+            envelope_index_ = (envelope_index_ + 1) % mic_envelope_.size();
+            envelope_count_ = std::min(envelope_count_ + 1, mic_envelope_.size());
+            mic_sum_ = 0;
+            reference_sum_ = 0;
+            block_samples_ = 0;
+            if (++envelopes_since_estimate_ >= ESTIMATE_INTERVAL_MS && envelope_count_ == mic_envelope_.size()) {
+                envelopes_since_estimate_ = 0;
+                changed |= Estimate();
+            }
+        }
+
+        for (int c = 0; c < channels_; c++) {
+            if (channel_delays_[c] > 0) {
+                auto& line = delay_lines_[c];
+                if (line.empty()) {
+                    line.assign(delay_line_size, 0);
+                }
+                line[delay_index_] = frame[c];
+                frame[c] = line[(delay_index_ + line.size() - channel_delays_[c]) % line.size()];
+            }
+        }
+        delay_index_ = (delay_index_ + 1) % delay_line_size;
+    }
+    reference_active_ = frames > 0 && reference_level / static_cast<int32_t>(frames) > REFERENCE_ACTIVE_LEVEL;
+    return changed;
+}
+
+bool ReferenceDelayEstimator::Estimate() {
+    // Oldest first, and the reference has to play for a good part of the window
+    const size_t window = mic_envelope_.size();
+    size_t active = 0;
+    float mic_mean = 0;
+    float reference_mean = 0;
+    for (size_t i = 0; i < window; i++) {
+        size_t j = (envelope_index_ + i) % window;
+        mic_window_[i] = mic_envelope_[j];
+        reference_window_[i] = reference_envelope_[j];
+        mic_mean += mic_window_[i];
+        reference_mean += reference_window_[i];
+        if (reference_window_[i] > REFERENCE_ACTIVE_LEVEL) {
+            active++;
+        }
+    }
+    if (active * 100 < window * REFERENCE_ACTIVE_PERCENT) {
+        return false;
+    }
+
+    mic_mean /= window;
+    reference_mean /= window;
+    float mic_energy = 0;
+    float reference_energy = 0;
+    for (size_t i = 0; i < window; i++) {
+        mic_window_[i] -= mic_mean;
+        reference_window_[i] -= reference_mean;
+        mic_energy += mic_window_[i] * mic_window_[i];
+        reference_energy += reference_window_[i] * reference_window_[i];
+    }
+    if (mic_energy <= 0 || reference_energy <= 0) {
+        return false;
+    }
+
+    // mic[n] ~ reference[n - lag]
+    float best = 0;
+    int best_lag = 0;
+    for (int lag = REFERENCE_DELAY_MIN_MS; lag <= REFERENCE_DELAY_MAX_MS; lag++) {
+        size_t begin = std::max(lag, 0);
+        size_t end = window + std::min(lag, 0);
+        const float* mic = mic_window_.data();
+        const float* reference = reference_window_.data() - lag;
+        float sum = 0;
+        for (size_t n = begin; n < end; n++) {
+            sum += mic[n] * reference[n];
+        }
+        if (sum > best) {
+            best = sum;
+            best_lag = lag;
+        }
+    }
+    if (best < MIN_CORRELATION * sqrtf(mic_energy * reference_energy)) {
+        return false;
+    }
+
+    bool confirmed = has_candidate_ && std::abs(best_lag - last_candidate_ms_) <= DELAY_TOLERANCE_MS;
+    has_candidate_ = true;
+    last_candidate_ms_ = best_lag;
+    if (!confirmed || (locked_ && std::abs(best_lag - delay_ms_) <= DELAY_TOLERANCE_MS)) {
+        return false;
+    }
+    SetDelay(best_lag);
+    locked_ = true;
+    return true;
+}
+
+void ReferenceDelayEstimator::SetDelay(int delay_ms) {
+    delay_ms_ = delay_ms;
+    int compensation = delay_ms - REFERENCE_DELAY_MARGIN_MS;
+    for (int c = 0; c < channels_; c++) {
+        if (c == reference_channel_) {
+            channel_delays_[c] = std::max(compensation, 0) * samples_per_ms_;
+        } else {
+            channel_delays_[c] = std::max(-compensation, 0) * samples_per_ms_;
+        }
+    }
+}
@@ -0,0 +1,71 @@
+#ifndef REFERENCE_DELAY_ESTIMATOR_H
+#define REFERENCE_DELAY_ESTIMATOR_H
+
+#include <cstdint>
+#include <cstddef>
+#include <atomic>
+#include <vector>
+
+// Range of the echo lag behind the reference channel that is searched
+#define REFERENCE_DELAY_MIN_MS -20
+#define REFERENCE_DELAY_MAX_MS 200
+// The echo is aligned this long after its reference, the AEC filter needs it causal
+#define REFERENCE_DELAY_MARGIN_MS 4
+
+/*
+ * Measures how long the echo in the mic lags the reference channel and compensates it,
+ * so that the AEC gets its reference just ahead of the echo whatever the codec, the
+ * board and the speaker add. The lag is the peak of the cross-correlation of the mic
+ * and reference envelopes, decimated to 1 ms, over the last second. An estimate is taken
+ * when the reference is playing and two estimates in a row agree.
+ *
+ * Process() is called from the audio input task only, the getters from any task.
+ */
+class ReferenceDelayEstimator {
+public:
+    void Configure(int sample_rate, int channels, int reference_channel);
+    // Measures the interleaved frames, then delays the reference or the mics in place.
+    // Returns true when the compensated delay changed.
+    bool Process(int16_t* data, size_t frames);
+
+    bool locked() const { return locked_; }
+    // Lag of the echo behind the reference as captured, before compensation
+    int delay_ms() const { return delay_ms_; }
+    // The reference of the last frames was above the noise floor
+    bool reference_active() const { return reference_active_; }
+
+private:
+    int channels_ = 0;
+    int reference_channel_ = 0;
+    int mic_channel_ = 0;
+    int samples_per_ms_ = 0;
+
+    // Envelopes, one mean absolute value per millisecond
+    std::vector<float> mic_envelope_;
+    std::vector<float> reference_envelope_;
+    size_t envelope_index_ = 0;
+    size_t envelope_count_ = 0;
+    size_t envelopes_since_estimate_ = 0;
+    int32_t mic_sum_ = 0;
+    int32_t reference_sum_ = 0;
+    int block_samples_ = 0;
+    // The lag of the last estimate, a new one is only taken when the two agree
+    bool has_candidate_ = false;
+    int last_candidate_ms_ = 0;
+    std::vector<float> mic_window_;
+    std::vector<float> reference_window_;
+
+    // One delay line per channel, only the delayed channels use theirs
+    std::vector<std::vector<int16_t>> delay_lines_;
+    std::vector<int> channel_delays_;
+    size_t delay_index_ = 0;
+
+    std::atomic<bool> locked_{false};
+    std::atomic<int> delay_ms_{0};
+    std::atomic<bool> reference_active_{false};
+
+    bool Estimate();
+    void SetDelay(int delay_ms);
+};
+
+#endif // REFERENCE_DELAY_ESTIMATOR_H
@@ -0,0 +1,83 @@
+#include "speech_model_registry.h"
+
+#include <esp_log.h>
+#include <esp_timer.h>
+#include <esp_heap_caps.h>
+#include <esp_afe_sr_models.h>
+#include <esp_wn_models.h>
+#include <esp_mn_models.h>
+
+#include <cstring>
+
+#define TAG "SpeechModelRegistry"
+
+void SpeechModelRegistry::Load() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (loaded_) {
+        return;
+    }
+    loaded_ = true;
+
+    auto start_time = esp_timer_get_time();
+    size_t free_sram = heap_caps_get_free_size(MALLOC_CAP_INTERNAL);
+    size_t free_psram = heap_caps_get_free_size(MALLOC_CAP_SPIRAM);
+
+    auto models = esp_srmodel_init("model");
+    if (models == nullptr || models->num <= 0) {
+        ESP_LOGE(TAG, "No speech model found in the model partition");
+        if (models != nullptr) {
+            esp_srmodel_deinit(models);
+        }
+        return;
+    }
+    models_ = models;
+
+    for (int i = 0; i < models_->num; i++) {
+        char* name = models_->model_name[i];
+        ESP_LOGI(TAG, "Model %d: %s", i, name);
+        if (strstr(name, ESP_WN_PREFIX) != nullptr) {
+            wakenet_models_.push_back(name);
+        } else if (strstr(name, ESP_MN_PREFIX) != nullptr) {
+            multinet_models_.push_back(name);
+        } else if (ns_model_ == nullptr && strstr(name, ESP_NSNET_PREFIX) != nullptr) {
+            ns_model_ = name;
+        } else if (vad_model_ == nullptr && strstr(name, ESP_VADN_PREFIX) != nullptr) {
+            vad_model_ = name;
+        }
+    }
+
+    ESP_LOGI(TAG, "Loaded %d models in %lld ms, sram used: %d, psram used: %d", models_->num,
+        (esp_timer_get_time() - start_time) / 1000,
+        (int)(free_sram - heap_caps_get_free_size(MALLOC_CAP_INTERNAL)),
+        (int)(free_psram - heap_caps_get_free_size(MALLOC_CAP_SPIRAM)));
+}
+
+srmodel_list_t* SpeechModelRegistry::GetModels() {
+    Load();
+    return models_;
+}
+
+const char* SpeechModelRegistry::GetNsModel() {
+    Load();
+    return ns_model_;
+}
+
+const char* SpeechModelRegistry::GetVadModel() {
+    Load();
+    return vad_model_;
+}
+
+const std::vector<char*>& SpeechModelRegistry::GetWakeNetModels() {
+    Load();
+    return wakenet_models_;
+}
+
+const char* SpeechModelRegistry::GetMultiNetModel(const char* language) {
+    Load();
+    for (auto name : multinet_models_) {
+        if (language == nullptr || strstr(name, language) != nullptr) {
+            return name;
+        }
+    }
+    return nullptr;
+}
@@ -0,0 +1,46 @@
+#ifndef SPEECH_MODEL_REGISTRY_H
+#define SPEECH_MODEL_REGISTRY_H
+
+#include <model_path.h>
+
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Maps the "model" partition once and shares the model list between the
+// audio processor and the wake word implementations. The partition is
+// parsed lazily on first use and the list lives for the whole process.
+class SpeechModelRegistry {
+public:
+    static SpeechModelRegistry& GetInstance() {
+        static SpeechModelRegistry instance;
+        return instance;
+    }
+    // 删除拷贝构造函数和赋值运算符
+    SpeechModelRegistry(const SpeechModelRegistry&) = delete;
+    SpeechModelRegistry& operator=(const SpeechModelRegistry&) = delete;
+
+    // Returns nullptr if the model partition is missing or empty
+    srmodel_list_t* GetModels();
+
+    const char* GetNsModel();
+    const char* GetVadModel();
+    const std::vector<char*>& GetWakeNetModels();
+    const char* GetMultiNetModel(const char* language = nullptr);
+
+private:
+    SpeechModelRegistry() = default;
+    ~SpeechModelRegistry() = default;
+
+    void Load();
+
+    std::mutex mutex_;
+    bool loaded_ = false;
+    srmodel_list_t* models_ = nullptr;
+    char* ns_model_ = nullptr;
+    char* vad_model_ = nullptr;
+    std::vector<char*> wakenet_models_;
+    std::vector<char*> multinet_models_;
+};
+
+#endif
@@ -1,5 +1,6 @@
 #include "afe_wake_word.h"
 #include "audio_service.h"
+#include "speech_model_registry.h"
 
 #include <esp_log.h>
 #include <sstream>
@@ -29,10 +30,6 @@ AfeWakeWord::~AfeWakeWord() {
         heap_caps_free(wake_word_encode_task_buffer_);
     }
 
-    if (models_ != nullptr) {
-        esp_srmodel_deinit(models_);
-    }
-
     vEventGroupDelete(event_group_);
 }
 
@@ -40,22 +37,20 @@ bool AfeWakeWord::Initialize(AudioCodec* codec) {
     codec_ = codec;
     int ref_num = codec_->input_reference() ? 1 : 0;
 
-    models_ = esp_srmodel_init("model");
-    if (models_ == nullptr || models_->num == -1) {
+    auto& registry = SpeechModelRegistry::GetInstance();
+    models_ = registry.GetModels();
+    if (models_ == nullptr) {
         ESP_LOGE(TAG, "Failed to initialize wakenet model");
         return false;
     }
-    for (int i = 0; i < models_->num; i++) {
-        ESP_LOGI(TAG, "Model %d: %s", i, models_->model_name[i]);
-        if (strstr(models_->model_name[i], ESP_WN_PREFIX) != NULL) {
-            wakenet_model_ = models_->model_name[i];
-            auto words = esp_srmodel_get_wake_words(models_, wakenet_model_);
-            // split by ";" to get all wake words
-            std::stringstream ss(words);
-            std::string word;
-            while (std::getline(ss, word, ';')) {
-                wake_words_.push_back(word);
-            }
+    for (auto model : registry.GetWakeNetModels()) {
+        wakenet_model_ = model;
+        auto words = esp_srmodel_get_wake_words(models_, wakenet_model_);
+        // split by ";" to get all wake words
+        std::stringstream ss(words);
+        std::string word;
+        while (std::getline(ss, word, ';')) {
+            wake_words_.push_back(word);
         }
     }
 
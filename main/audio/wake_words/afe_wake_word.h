@@ -35,7 +35,7 @@ public:
     const std::string& GetLastDetectedWakeWord() const { return last_detected_wake_word_; }
 
 private:
-    srmodel_list_t *models_ = nullptr;
+    srmodel_list_t *models_ = nullptr;  // Owned by SpeechModelRegistry
     esp_afe_sr_iface_t* afe_iface_ = nullptr;
     esp_afe_sr_data_t* afe_data_ = nullptr;
     char* wakenet_model_ = NULL;
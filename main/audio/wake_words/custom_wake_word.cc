@@ -1,6 +1,7 @@
 #include "custom_wake_word.h"
 #include "audio_service.h"
 #include "system_info.h"
+#include "speech_model_registry.h"
 
 #include <esp_log.h>
 #include "esp_mn_iface.h"
@@ -28,23 +29,13 @@ CustomWakeWord::~CustomWakeWord() {
     if (wake_word_encode_task_buffer_ != nullptr) {
         heap_caps_free(wake_word_encode_task_buffer_);
     }
-
-    if (models_ != nullptr) {
-        esp_srmodel_deinit(models_);
-    }
 }
 
 bool CustomWakeWord::Initialize(AudioCodec* codec) {
     codec_ = codec;
 
-    models_ = esp_srmodel_init("model");
-    if (models_ == nullptr || models_->num == -1) {
-        ESP_LOGE(TAG, "Failed to initialize wakenet model");
-        return false;
-    }
-
     // 初始化 multinet (命令词识别)
-    mn_name_ = esp_srmodel_filter(models_, ESP_MN_PREFIX, ESP_MN_CHINESE);
+    mn_name_ = const_cast<char*>(SpeechModelRegistry::GetInstance().GetMultiNetModel(ESP_MN_CHINESE));
     if (mn_name_ == nullptr) {
         ESP_LOGE(TAG, "Failed to initialize multinet, mn_name is nullptr");
         ESP_LOGI(TAG, "Please refer to https://pcn7cs20v8cr.feishu.cn/wiki/CpQjwQsCJiQSWSkYEvrcxcbVnwh to add custom wake word");
@@ -36,7 +36,6 @@ private:
     // multinet 相关成员变量
     esp_mn_iface_t* multinet_ = nullptr;
     model_iface_data_t* multinet_model_data_ = nullptr;
-    srmodel_list_t *models_ = nullptr;
     char* mn_name_ = nullptr;
  
     std::function<void(const std::string& wake_word)> wake_word_detected_callback_;
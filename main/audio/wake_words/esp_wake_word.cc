@@ -1,4 +1,6 @@
 #include "esp_wake_word.h"
+#include "speech_model_registry.h"
+
 #include <esp_log.h>
 
 
@@ -10,25 +12,21 @@ EspWakeWord::EspWakeWord() {
 EspWakeWord::~EspWakeWord() {
     if (wakenet_data_ != nullptr) {
         wakenet_iface_->destroy(wakenet_data_);
-        esp_srmodel_deinit(wakenet_model_);
     }
 }
 
 bool EspWakeWord::Initialize(AudioCodec* codec) {
     codec_ = codec;
 
-    wakenet_model_ = esp_srmodel_init("model");
-    if (wakenet_model_ == nullptr || wakenet_model_->num == -1) {
-        ESP_LOGE(TAG, "Failed to initialize wakenet model");
+    auto& wakenet_models = SpeechModelRegistry::GetInstance().GetWakeNetModels();
+    if (wakenet_models.empty()) {
+        ESP_LOGE(TAG, "No wakenet model found");
         return false;
     }
-    if(wakenet_model_->num > 1) {
+    if (wakenet_models.size() > 1) {
         ESP_LOGW(TAG, "More than one model found, using the first one");
-    } else if (wakenet_model_->num == 0) {
-        ESP_LOGE(TAG, "No model found");
-        return false;
     }
-    char *model_name = wakenet_model_->model_name[0];
+    char *model_name = wakenet_models[0];
     wakenet_iface_ = (esp_wn_iface_t*)esp_wn_handle_from_name(model_name);
     wakenet_data_ = wakenet_iface_->create(model_name, DET_MODE_95);
 
@@ -31,7 +31,6 @@ public:
 private:
     esp_wn_iface_t *wakenet_iface_ = nullptr;
     model_iface_data_t *wakenet_data_ = nullptr;
-    srmodel_list_t *wakenet_model_ = nullptr;
     AudioCodec* codec_ = nullptr;
     std::atomic<bool> running_ = false;
 
@@ -0,0 +1,233 @@
+#include "benchmark.h"
+#include "benchmark_cases.h"
+#include "mcp_server.h"
+#include "protocol.h"
+#include "afsk_demod.h"
+#include "audio_codec.h"
+#include "assets/lang_config.h"
+
+#include <esp_log.h>
+#include <esp_timer.h>
+#include <esp_app_desc.h>
+#include <esp_pthread.h>
+#include <mbedtls/aes.h>
+#include <arpa/inet.h>
+#include <cJSON.h>
+
+#include <opus_encoder.h>
+#include <opus_decoder.h>
+#include <opus_resampler.h>
+
+#include <cmath>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+#define TAG "Benchmark"
+
+#define BENCHMARK_FRAME_DURATION_MS 60
+#define BENCHMARK_STACK_SIZE (2048 * 13)
+
+namespace {
+
+// A voiced-like test signal: two harmonics plus deterministic noise
+std::vector<int16_t> GenerateSignal(int sample_rate, int samples) {
+    std::vector<int16_t> pcm(samples);
+    uint32_t seed = 1;
+    for (int i = 0; i < samples; i++) {
+        seed = seed * 1103515245 + 12345;
+        float t = static_cast<float>(i) / sample_rate;
+        float value = 6000 * sinf(2 * M_PI * 220 * t) + 3000 * sinf(2 * M_PI * 660 * t) +
+            static_cast<int16_t>(seed >> 16) / 32;
+        pcm[i] = static_cast<int16_t>(value);
+    }
+    return pcm;
+}
+
+void RunOpus(BenchmarkReport& report) {
+    int frame_samples = BENCHMARK_SAMPLE_RATE * BENCHMARK_FRAME_DURATION_MS / 1000;
+    auto pcm = GenerateSignal(BENCHMARK_SAMPLE_RATE, frame_samples);
+
+    // Same settings as AudioService
+    OpusEncoderWrapper encoder(BENCHMARK_SAMPLE_RATE, 1, BENCHMARK_FRAME_DURATION_MS);
+    encoder.SetComplexity(0);
+    std::vector<uint8_t> opus;
+    report.Measure("opus_encode_16k_60ms", 50, [&]() {
+        auto frame = pcm;
+        encoder.Encode(std::move(frame), opus);
+    });
+
+    OpusDecoderWrapper decoder(BENCHMARK_SAMPLE_RATE, 1, BENCHMARK_FRAME_DURATION_MS);
+    std::vector<int16_t> decoded;
+    report.Measure("opus_decode_16k_60ms", 50, [&]() {
+        auto packet = opus;
+        decoder.Decode(std::move(packet), decoded);
+    });
+}
+
+void RunResamplers(BenchmarkReport& report) {
+    // Input codecs are resampled to 16 kHz, server audio to the output codec rate
+    static const int pairs[][2] = {
+        {24000, 16000},
+        {48000, 16000},
+        {16000, 24000},
+        {16000, 48000},
+        {24000, 48000},
+    };
+    for (auto& pair : pairs) {
+        OpusResampler resampler;
+        resampler.Configure(pair[0], pair[1]);
+        auto input = GenerateSignal(pair[0], pair[0] * BENCHMARK_FRAME_DURATION_MS / 1000);
+        std::vector<int16_t> output(resampler.GetOutputSamples(input.size()));
+        char name[32];
+        snprintf(name, sizeof(name), "resample_%d_%d_60ms", pair[0] / 1000, pair[1] / 1000);
+        report.Measure(name, 100, [&]() {
+            resampler.Process(input.data(), input.size(), output.data());
+        });
+    }
+}
+
+void RunFraming(BenchmarkReport& report) {
+    AudioStreamPacket packet;
+    packet.timestamp = 123456;
+    packet.payload.resize(120, 0x5a);
+
+    // Same layout as WebsocketProtocol::SendAudio
+    std::string serialized;
+    report.Measure("binary_protocol2_pack", 1000, [&]() {
+        serialized.resize(sizeof(BinaryProtocol2) + packet.payload.size());
+        auto bp2 = (BinaryProtocol2*)serialized.data();
+        bp2->version = htons(2);
+        bp2->type = 0;
+        bp2->reserved = 0;
+        bp2->timestamp = htonl(packet.timestamp);
+        bp2->payload_size = htonl(packet.payload.size());
+        memcpy(bp2->payload, packet.payload.data(), packet.payload.size());
+    });
+    report.Measure("binary_protocol2_unpack", 1000, [&]() {
+        auto bp2 = (const BinaryProtocol2*)serialized.data();
+        AudioStreamPacket incoming;
+        incoming.timestamp = ntohl(bp2->timestamp);
+        auto payload_size = ntohl(bp2->payload_size);
+        incoming.payload.assign(bp2->payload, bp2->payload + payload_size);
+    });
+
+    report.Measure("binary_protocol3_pack", 1000, [&]() {
+        serialized.resize(sizeof(BinaryProtocol3) + packet.payload.size());
+        auto bp3 = (BinaryProtocol3*)serialized.data();
+        bp3->type = 0;
+        bp3->reserved = 0;
+        bp3->payload_size = htons(packet.payload.size());
+        memcpy(bp3->payload, packet.payload.data(), packet.payload.size());
+    });
+    report.Measure("binary_protocol3_unpack", 1000, [&]() {
+        auto bp3 = (const BinaryProtocol3*)serialized.data();
+        AudioStreamPacket incoming;
+        auto payload_size = ntohs(bp3->payload_size);
+        incoming.payload.assign(bp3->payload, bp3->payload + payload_size);
+    });
+}
+
+void RunAesCtr(BenchmarkReport& report) {
+    // Same scheme as the MQTT + UDP audio channel: 16 byte nonce header + AES-128-CTR payload
+    uint8_t key[16];
+    for (int i = 0; i < 16; i++) {
+        key[i] = i * 17;
+    }
+    mbedtls_aes_context aes_ctx;
+    mbedtls_aes_init(&aes_ctx);
+    mbedtls_aes_setkey_enc(&aes_ctx, key, 128);
+
+    std::string aes_nonce(16, '\0');
+    std::vector<uint8_t> payload(120, 0x5a);
+    std::string encrypted;
+    uint32_t sequence = 0;
+    report.Measure("aes_ctr_encrypt_120b", 1000, [&]() {
+        std::string nonce(aes_nonce);
+        *(uint16_t*)&nonce[2] = htons(payload.size());
+        *(uint32_t*)&nonce[12] = htonl(++sequence);
+        encrypted.resize(nonce.size() + payload.size());
+        memcpy(encrypted.data(), nonce.data(), nonce.size());
+        size_t nc_off = 0;
+        uint8_t stream_block[16] = {0};
+        mbedtls_aes_crypt_ctr(&aes_ctx, payload.size(), &nc_off, (uint8_t*)nonce.c_str(), stream_block,
+            payload.data(), (uint8_t*)&encrypted[nonce.size()]);
+    });
+    mbedtls_aes_free(&aes_ctx);
+}
+
+void RunMcp(BenchmarkReport& report) {
+    // Replies are dropped because the protocol is not started yet
+    const std::string message = "{\"jsonrpc\":\"2.0\",\"id\":1,\"method\":\"tools/list\",\"params\":{\"cursor\":\"\"}}";
+    auto& mcp_server = McpServer::GetInstance();
+    report.Measure("mcp_parse_tools_list", 100, [&]() {
+        mcp_server.ParseMessage(message);
+    });
+
+    const std::string call = "{\"jsonrpc\":\"2.0\",\"id\":2,\"method\":\"tools/call\",\"params\":"
+        "{\"name\":\"self.audio_speaker.set_volume\",\"arguments\":{\"volume\":50}}}";
+    report.Measure("cjson_parse_tools_call", 200, [&]() {
+        cJSON* json = cJSON_Parse(call.c_str());
+        auto params = cJSON_GetObjectItem(json, "params");
+        auto arguments = cJSON_GetObjectItem(params, "arguments");
+        cJSON_GetObjectItem(arguments, "volume");
+        cJSON_Delete(json);
+    });
+}
+
+void RunAfsk(BenchmarkReport& report) {
+    // One second of alternating mark / space tones at the microphone rate,
+    // so the result is the CPU time per second of provisioning audio
+    std::vector<int16_t> samples(BENCHMARK_SAMPLE_RATE);
+    size_t samples_per_bit = BENCHMARK_SAMPLE_RATE / kBitRate;
+    for (size_t i = 0; i < samples.size(); i++) {
+        size_t frequency = (i / samples_per_bit) % 2 ? kMarkFrequency : kSpaceFrequency;
+        samples[i] = 8000 * sinf(2 * M_PI * frequency * i / BENCHMARK_SAMPLE_RATE);
+    }
+    audio_wifi_config::AudioSignalProcessor processor(kAudioSampleRate, kMarkFrequency, kSpaceFrequency,
+        kBitRate, kWindowSize, BENCHMARK_SAMPLE_RATE);
+    report.Measure("afsk_demod_1s", 10, [&]() {
+        processor.ProcessAudioSamples(samples);
+    });
+}
+
+} // namespace
+
+void Benchmark::Run() {
+    // The Opus encoder needs the same large stack as the opus_codec task
+    esp_pthread_cfg_t cfg = esp_pthread_get_default_config();
+    cfg.thread_name = "benchmark";
+    cfg.stack_size = BENCHMARK_STACK_SIZE;
+    cfg.prio = 5;
+    esp_pthread_set_cfg(&cfg);
+
+    std::thread([]() {
+        ESP_LOGI(TAG, "Running benchmarks...");
+        cJSON* root = cJSON_CreateObject();
+        cJSON_AddStringToObject(root, "board", BOARD_NAME);
+        cJSON_AddStringToObject(root, "version", esp_app_get_description()->version);
+        cJSON_AddNumberToObject(root, "cpu_mhz", CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ);
+        BenchmarkReport report;
+        RunOpus(report);
+        RunResamplers(report);
+        PortableBenchmarks::RunOggDemux(report, Lang::Sounds::OGG_SUCCESS);
+        RunFraming(report);
+        RunAesCtr(report);
+        RunMcp(report);
+        PortableBenchmarks::RunMcpDispatch(report);
+        PortableBenchmarks::RunControlMessages(report);
+        PortableBenchmarks::RunPlaybackClock(report, AUDIO_CODEC_DMA_FRAME_NUM, AUDIO_CODEC_DMA_DESC_NUM);
+        PortableBenchmarks::RunReferenceDelay(report);
+        PortableBenchmarks::RunInputSettling(report);
+        RunAfsk(report);
+        cJSON_AddItemToObject(root, "results", cJSON_Parse(report.ToJson().c_str()));
+
+        char* json_str = cJSON_PrintUnformatted(root);
+        ESP_LOGI(TAG, "BENCHMARK %s", json_str);
+        cJSON_free(json_str);
+        cJSON_Delete(root);
+    }).join();
+
+    cfg = esp_pthread_get_default_config();
+    esp_pthread_set_cfg(&cfg);
+}
@@ -0,0 +1,15 @@
+#ifndef _BENCHMARK_H_
+#define _BENCHMARK_H_
+
+// On-target micro benchmarks for the audio and protocol hot paths.
+// Enabled with CONFIG_USE_BENCHMARK, runs once at boot before the audio
+// service starts and logs a single "BENCHMARK {json}" line. Use
+// scripts/benchmark_report.py to save the report and compare it with
+// the stored baseline of the board. The platform-free cases are in
+// benchmark_cases.h and also run on the host (host/benchmark_main.cc).
+class Benchmark {
+public:
+    static void Run();
+};
+
+#endif // _BENCHMARK_H_
@@ -0,0 +1,399 @@
+#include "benchmark_cases.h"
+#include "ogg_demuxer.h"
+#include "control_message.h"
+#include "playback_clock.h"
+#include "reference_delay_estimator.h"
+#include "codec_power_manager.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+
+#if __has_include(<cJSON.h>)
+#include "mcp_server.h"
+#include <cJSON.h>
+#endif
+
+#define TAG "Benchmark"
+
+uint32_t (*BenchmarkReport::allocation_count)() = nullptr;
+
+void BenchmarkReport::AddValue(const char* name, const char* key, double value) {
+    auto it = std::find_if(results_.begin(), results_.end(), [name](const Result& result) {
+        return result.name == name;
+    });
+    if (it == results_.end()) {
+        results_.push_back({name, {}});
+        it = results_.end() - 1;
+    }
+    it->values.emplace_back(key, value);
+}
+
+std::string BenchmarkReport::ToJson() const {
+    std::string json = "{";
+    char number[32];
+    for (auto& result : results_) {
+        if (json.size() > 1) {
+            json += ",";
+        }
+        json += "\"" + result.name + "\":{";
+        for (size_t i = 0; i < result.values.size(); i++) {
+            snprintf(number, sizeof(number), "%.10g", result.values[i].second);
+            json += (i > 0 ? ",\"" : "\"") + result.values[i].first + "\":" + number;
+        }
+        json += "}";
+    }
+    return json + "}";
+}
+
+namespace PortableBenchmarks {
+
+const std::string_view kTtsSentenceFrame = "{\"type\":\"tts\",\"state\":\"sentence_start\","
+    "\"text\":\"\\u4eca\\u5929\\u5929\\u6c14\\u4e0d\\u9519\",\"session_id\":\"a1b2c3d4\"}";
+const std::string_view kTtsStateFrame = "{\"type\":\"tts\",\"state\":\"start\",\"session_id\":\"a1b2c3d4\"}";
+const std::string_view kMcpCallFrame = "{\"session_id\":\"a1b2c3d4\",\"type\":\"mcp\",\"payload\":{\"jsonrpc\":\"2.0\","
+    "\"id\":2,\"method\":\"tools/call\",\"params\":{\"name\":\"self.audio_speaker.set_volume\","
+    "\"arguments\":{\"volume\":50}}}}";
+
+void RunOggDemux(BenchmarkReport& report, const std::string_view& ogg) {
+    report.Measure("ogg_demux_success", 1000, [&]() {
+        size_t bytes = 0;
+        OggDemuxer::Demux(ogg, [&bytes](int sample_rate, const uint8_t* data, size_t size) {
+            bytes += size;
+        });
+    });
+}
+
+// Adds the message rate and, when they can be counted, the heap allocations of one message
+template<typename F>
+static void MeasureMessages(BenchmarkReport& report, const char* name, int iterations, F&& fn) {
+    double average = report.Measure(name, iterations, fn);
+    report.AddValue(name, "msgs_per_s", average > 0 ? std::round(1000000 / average) : 0);
+    if (BenchmarkReport::allocation_count != nullptr) {
+        uint32_t allocations = BenchmarkReport::allocation_count();
+        fn();
+        report.AddValue(name, "allocs", BenchmarkReport::allocation_count() - allocations);
+    }
+}
+
+void RunControlMessages(BenchmarkReport& report) {
+    // What Application does with each frame: dispatch on type and state, copy the text it shows
+    MeasureMessages(report, "control_tts_sentence", 1000, [&]() {
+        ControlMessage message;
+        message.Parse(kTtsSentenceFrame.data(), kTtsSentenceFrame.size());
+        std::string copy = message.GetString(message.text);
+    });
+    MeasureMessages(report, "control_tts_state", 1000, [&]() {
+        ControlMessage message;
+        message.Parse(kTtsStateFrame.data(), kTtsStateFrame.size());
+    });
+    MeasureMessages(report, "control_mcp_call", 500, [&]() {
+        ControlMessage message;
+        message.Parse(kMcpCallFrame.data(), kMcpCallFrame.size());
+    });
+
+#if __has_include(<cJSON.h>)
+    // What the protocols did before ControlMessage: a full cJSON tree, strcmp on type and state,
+    // and a copy of the text
+    int started = 0;
+    MeasureMessages(report, "cjson_tts_sentence", 1000, [&]() {
+        cJSON* root = cJSON_ParseWithLength(kTtsSentenceFrame.data(), kTtsSentenceFrame.size());
+        auto type = cJSON_GetObjectItem(root, "type");
+        auto state = cJSON_GetObjectItem(root, "state");
+        if (strcmp(type->valuestring, "tts") == 0 && strcmp(state->valuestring, "sentence_start") == 0) {
+            std::string copy(cJSON_GetObjectItem(root, "text")->valuestring);
+        }
+        cJSON_Delete(root);
+    });
+    MeasureMessages(report, "cjson_tts_state", 1000, [&]() {
+        cJSON* root = cJSON_ParseWithLength(kTtsStateFrame.data(), kTtsStateFrame.size());
+        auto type = cJSON_GetObjectItem(root, "type");
+        auto state = cJSON_GetObjectItem(root, "state");
+        if (strcmp(type->valuestring, "tts") == 0 && strcmp(state->valuestring, "start") == 0) {
+            started++;
+        }
+        cJSON_Delete(root);
+    });
+    MeasureMessages(report, "cjson_mcp_call", 500, [&]() {
+        cJSON* root = cJSON_ParseWithLength(kMcpCallFrame.data(), kMcpCallFrame.size());
+        cJSON_GetObjectItem(root, "payload");
+        cJSON_Delete(root);
+    });
+    // The payload handed to McpServer is still parsed with cJSON
+    MeasureMessages(report, "control_mcp_call_payload", 500, [&]() {
+        ControlMessage message;
+        message.Parse(kMcpCallFrame.data(), kMcpCallFrame.size());
+        cJSON* payload = cJSON_ParseWithLength(message.payload.data(), message.payload.size());
+        cJSON_Delete(payload);
+    });
+#endif
+}
+
+#if __has_include(<cJSON.h>)
+// A tool set of the size of the robot boards, several tools/list pages long, and the common
+// volume tool added last. Dispatch is what McpServer::ParseMessage does before replying.
+void RunMcpDispatch(BenchmarkReport& report) {
+    McpToolRegistry tools(MAX_TOOLS_LIST_PAYLOAD_SIZE);
+    for (int i = 0; i < 40; i++) {
+        tools.Add(new McpTool("self.robot.action_" + std::to_string(i),
+            "Makes the robot perform an action. steps: number of times to repeat it, "
+            "speed: duration of one step in milliseconds, smaller is faster, direction: forward or backward",
+            PropertyList({
+                Property("steps", kPropertyTypeInteger, 3, 1, 100),
+                Property("speed", kPropertyTypeInteger, 1000, 500, 1500),
+                Property("direction", kPropertyTypeString, std::string("forward")),
+            }), [](const PropertyList& properties) -> ReturnValue {
+                return properties["steps"].value<int>();
+            }));
+    }
+    tools.Add(new McpTool("self.audio_speaker.set_volume", "Set the volume of the audio speaker.",
+        PropertyList({Property("volume", kPropertyTypeInteger, 0, 100)}),
+        [](const PropertyList& properties) -> ReturnValue {
+            return true;
+        }));
+
+    // Session setup walks the pages through nextCursor
+    std::vector<std::string> requests;
+    std::string error;
+    std::string cursor;
+    do {
+        requests.push_back("{\"jsonrpc\":\"2.0\",\"id\":1,\"method\":\"tools/list\",\"params\":{\"cursor\":\""
+            + cursor + "\"}}");
+        auto page = tools.GetToolsListPage(cursor, error);
+        cJSON* json = page ? cJSON_Parse(page->c_str()) : nullptr;
+        auto next_cursor = cJSON_GetObjectItem(json, "nextCursor");
+        cursor = cJSON_IsString(next_cursor) ? next_cursor->valuestring : "";
+        cJSON_Delete(json);
+    } while (!cursor.empty());
+
+    report.Measure("mcp_tools_list", 200, [&]() {
+        for (auto& request : requests) {
+            cJSON* json = cJSON_Parse(request.c_str());
+            auto params = cJSON_GetObjectItem(json, "params");
+            auto page = tools.GetToolsListPage(cJSON_GetObjectItem(params, "cursor")->valuestring, error);
+            std::string payload = "{\"jsonrpc\":\"2.0\",\"id\":1,\"result\":" + *page + "}";
+            cJSON_Delete(json);
+        }
+    });
+    report.AddValue("mcp_tools_list", "pages", requests.size());
+
+    const char* call = "{\"jsonrpc\":\"2.0\",\"id\":2,\"method\":\"tools/call\",\"params\":"
+        "{\"name\":\"self.audio_speaker.set_volume\",\"arguments\":{\"volume\":50}}}";
+    report.Measure("mcp_tools_call", 1000, [&]() {
+        cJSON* json = cJSON_Parse(call);
+        auto params = cJSON_GetObjectItem(json, "params");
+        McpTool* tool = tools.Find(cJSON_GetObjectItem(params, "name")->valuestring);
+        PropertyList arguments = tool->properties();
+        if (McpToolRegistry::BindArguments(cJSON_GetObjectItem(params, "arguments"), arguments, error)) {
+            std::string payload = "{\"jsonrpc\":\"2.0\",\"id\":2,\"result\":" + tool->Call(arguments) + "}";
+        }
+        cJSON_Delete(json);
+    });
+}
+#endif
+
+// Loopback of PlaybackClock against a model of the I2S TX driver: a ring of DMA buffers
+// that are cleared once sent, and a queue of at most count - 1 free buffers for the writer.
+// Replies of random length are written with gaps, flushes and counters read just before a buffer
+// is sent, and the timestamp the clock gives for every played buffer is compared with what the ring played.
+void RunPlaybackClock(BenchmarkReport& report, int dma_frames, int dma_buffers) {
+    const int rate = 24000;
+    const int frames = dma_frames;
+    const int count = dma_buffers;
+    const int buffer_ms = frames * 1000 / rate;
+    const uint32_t buffer_us = frames * 1000000 / rate;
+    PlaybackClock clock;
+    clock.Configure(rate, BENCHMARK_SAMPLE_RATE, frames, count);
+
+    uint32_t seed = 1;
+    auto random = [&seed](uint32_t range) {
+        seed = seed * 1103515245 + 12345;
+        return (seed >> 16) % range;
+    };
+
+    std::vector<uint32_t> ring(count, 0);
+    std::deque<int> free_buffers;
+    std::vector<uint32_t> played;  // Timestamp played by each buffer sent
+    int playing = 0;
+    uint32_t restart = 0;
+    uint32_t timestamp = 1000;
+    int reply_left = 0;
+    int gap_left = 0;
+    double capture_error_us = 0;
+
+    for (int step = 0; step < 4000; step++) {
+        // The DMA sends a buffer, with some interrupt latency
+        uint32_t sent = played.size();
+        played.push_back(ring[playing]);
+        ring[playing] = 0;
+        if (free_buffers.size() == static_cast<size_t>(count - 1)) {
+            free_buffers.pop_front();
+        }
+        free_buffers.push_back(playing);
+        playing = (playing + 1) % count;
+        sent++;
+        uint32_t sent_time = sent * buffer_us + random(100);
+
+        // A mic frame captured somewhere in the buffer being played
+        uint32_t now = sent_time + random(buffer_us);
+        int64_t position = clock.GetPosition(sent, sent_time, now);
+        capture_error_us += std::abs(static_cast<double>(position) * 1000000 / rate - static_cast<double>(now));
+
+        if (gap_left > 0) {
+            gap_left--;
+            continue;
+        }
+        if (reply_left == 0) {
+            reply_left = 20 + random(200);
+            timestamp += 5000;
+        }
+        if (random(100) == 0) {
+            // Barge-in: AudioCodec::DiscardOutput restarts the ring from the first buffer
+            std::fill(ring.begin(), ring.end(), 0);
+            free_buffers.clear();
+            playing = 0;
+            restart = sent;
+            reply_left = 0;
+            gap_left = random(30);
+            continue;
+        }
+        // The writer is ahead, it fills every buffer the driver gives back
+        while (!free_buffers.empty() && reply_left > 0) {
+            ring[free_buffers.front()] = timestamp;
+            free_buffers.pop_front();
+            clock.OnWrite(frames, timestamp, random(32) == 0 ? sent - 1 : sent, restart);
+            timestamp += buffer_ms;
+            if (--reply_left == 0) {
+                gap_left = random(100);
+            }
+        }
+    }
+
+    // Only the last buffers are still in the clock history
+    int errors = 0;
+    int checked = 0;
+    double error_ms = 0;
+    int max_error_ms = 0;
+    for (size_t i = played.size() - 120; i < played.size(); i++) {
+        uint32_t expected = played[i];
+        uint32_t actual = clock.GetTimestamp(static_cast<int64_t>(i) * frames);
+        if (expected == 0 && actual == 0) {
+            continue;
+        }
+        checked++;
+        if (expected == 0 || actual == 0) {
+            errors++;
+            continue;
+        }
+        int error = std::abs(static_cast<int>(actual - expected));
+        error_ms += error;
+        max_error_ms = std::max(max_error_ms, error);
+    }
+
+    report.Measure("playback_clock_write", 1000, [&]() {
+        clock.OnWrite(frames, timestamp, played.size(), restart);
+        clock.GetTimestamp(static_cast<int64_t>(played.size()) * frames);
+    });
+    report.AddValue("playback_clock_write", "align_mean_ms", checked > errors ? std::round(error_ms / (checked - errors) * 10) / 10 : 0);
+    report.AddValue("playback_clock_write", "align_max_ms", max_error_ms);
+    report.AddValue("playback_clock_write", "align_misses", errors);
+    report.AddValue("playback_clock_write", "capture_mean_us", std::round(capture_error_us / 4000));
+    ESP_LOGI(TAG, "%-28s mean %.1f ms, max %d ms, %d/%d missed", "playback_clock_alignment",
+        checked > errors ? error_ms / (checked - errors) : 0, max_error_ms, errors, checked);
+}
+
+// A mic with the echo of the reference 48 ms late, as on a board with a slow codec path
+void RunReferenceDelay(BenchmarkReport& report) {
+    const int echo_delay_ms = 48;
+    const int chunk_frames = 256;
+    const int echo_delay = echo_delay_ms * BENCHMARK_SAMPLE_RATE / 1000;
+    ReferenceDelayEstimator estimator;
+    estimator.Configure(BENCHMARK_SAMPLE_RATE, 2, 1);
+
+    // Noise with a syllable-like envelope, so that the envelopes have something to correlate
+    std::vector<int16_t> reference(BENCHMARK_SAMPLE_RATE);
+    std::vector<int16_t> chunk(chunk_frames * 2);
+    uint32_t seed = 1;
+    size_t position = 0;
+    auto next_chunk = [&]() {
+        for (int i = 0; i < chunk_frames; i++, position++) {
+            seed = seed * 1103515245 + 12345;
+            float t = static_cast<float>(position) / BENCHMARK_SAMPLE_RATE;
+            float envelope = sinf(2 * M_PI * 3.7f * t) * sinf(2 * M_PI * 1.3f * t);
+            size_t index = position % reference.size();
+            reference[index] = static_cast<int16_t>(envelope * envelope * (static_cast<int16_t>(seed >> 16) / 4));
+            int16_t echo = position >= echo_delay ? reference[(position - echo_delay) % reference.size()] / 2 : 0;
+            chunk[i * 2] = echo + static_cast<int16_t>(seed & 0xff) - 128;
+            chunk[i * 2 + 1] = reference[index];
+        }
+    };
+
+    // Locks within a few seconds of playback
+    int lock_ms = -1;
+    for (int i = 0; i < 6 * BENCHMARK_SAMPLE_RATE / chunk_frames; i++) {
+        next_chunk();
+        estimator.Process(chunk.data(), chunk_frames);
+        if (lock_ms < 0 && estimator.locked()) {
+            lock_ms = (i + 1) * chunk_frames * 1000 / BENCHMARK_SAMPLE_RATE;
+        }
+    }
+
+    // Includes an estimate every 500 ms of audio
+    report.Measure("reference_delay_16ms", 1000, [&]() {
+        estimator.Process(chunk.data(), chunk_frames);
+    });
+    report.AddValue("reference_delay_16ms", "delay_ms", estimator.locked() ? estimator.delay_ms() : -1);
+    report.AddValue("reference_delay_16ms", "expected_ms", echo_delay_ms);
+    report.AddValue("reference_delay_16ms", "lock_ms", lock_ms);
+    ESP_LOGI(TAG, "%-28s %d ms (expected %d ms), locked after %d ms", "reference_delay_estimate",
+        estimator.locked() ? estimator.delay_ms() : -1, echo_delay_ms, lock_ms);
+}
+
+// A mic that starts with the DC step and the decaying ring of a codec power-up
+// Milliseconds until the mic counts as settled on pcm, read in settling blocks
+static int MeasureSettleMs(CodecPowerManager& manager, const std::vector<int16_t>& pcm) {
+    const int block_frames = BENCHMARK_SAMPLE_RATE * AUDIO_INPUT_SETTLE_BLOCK_MS / 1000;
+    manager.StartInputSettling();
+    for (size_t offset = 0; offset + block_frames <= pcm.size(); offset += block_frames) {
+        if (manager.OnInputSettlingBlock(pcm.data() + offset, block_frames, 1)) {
+            return (offset + block_frames) * 1000 / BENCHMARK_SAMPLE_RATE;
+        }
+    }
+    return AUDIO_INPUT_SETTLE_MAX_MS;
+}
+
+void RunInputSettling(BenchmarkReport& report) {
+    const int block_frames = BENCHMARK_SAMPLE_RATE * AUDIO_INPUT_SETTLE_BLOCK_MS / 1000;
+    // Some codecs output digital silence until the ADC path is running, the pop follows it
+    const int leading_zeros_ms = 30;
+    const size_t leading_zeros = BENCHMARK_SAMPLE_RATE * leading_zeros_ms / 1000;
+    std::vector<int16_t> pcm(BENCHMARK_SAMPLE_RATE * AUDIO_INPUT_SETTLE_MAX_MS / 1000);
+    std::vector<int16_t> delayed(pcm.size(), 0);
+    uint32_t seed = 1;
+    for (size_t i = 0; i < pcm.size(); i++) {
+        seed = seed * 1103515245 + 12345;
+        float t = static_cast<float>(i) / BENCHMARK_SAMPLE_RATE;
+        float pop = 2000 * expf(-t / 0.02f) + 4000 * expf(-t / 0.025f) * sinf(2 * M_PI * 760 * t);
+        pcm[i] = static_cast<int16_t>(pop + static_cast<int16_t>(seed >> 16) / 1024);
+        if (i + leading_zeros < delayed.size()) {
+            delayed[i + leading_zeros] = pcm[i];
+        }
+    }
+
+    CodecPowerManager manager;
+    int settle_ms = MeasureSettleMs(manager, pcm);
+    // The zeros must not count as settled, the pop after them still has to decay
+    int settle_after_zeros_ms = MeasureSettleMs(manager, delayed);
+
+    report.Measure("input_settle_block_10ms", 1000, [&]() {
+        manager.OnInputSettlingBlock(pcm.data(), block_frames, 1);
+    });
+    report.AddValue("input_settle_block_10ms", "settle_ms", settle_ms);
+    report.AddValue("input_settle_block_10ms", "settle_after_zeros_ms", settle_after_zeros_ms);
+    ESP_LOGI(TAG, "%-28s %d ms, %d ms after %d ms of zeros (fixed warm-up %d ms)", "input_settle",
+        settle_ms, settle_after_zeros_ms, leading_zeros_ms, AUDIO_INPUT_SETTLE_MAX_MS);
+}
+
+} // namespace PortableBenchmarks
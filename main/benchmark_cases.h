@@ -0,0 +1,74 @@
+#ifndef _BENCHMARK_CASES_H_
+#define _BENCHMARK_CASES_H_
+
+#include <esp_log.h>
+#include <esp_timer.h>
+
+#include <cmath>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+// The mic and Opus sample rate of AudioService
+#define BENCHMARK_SAMPLE_RATE 16000
+
+// Benchmark results as {"name": {"us": average, "n": iterations, ...}, ...}
+class BenchmarkReport {
+public:
+    // Number of heap allocations so far, set by builds that can count them (host_benchmark)
+    static uint32_t (*allocation_count)();
+
+    // Calls fn iterations times and records the average time of one call, which it returns
+    template<typename F>
+    double Measure(const char* name, int iterations, F&& fn) {
+        // Warm up caches and lazy allocations
+        fn();
+        auto start = esp_timer_get_time();
+        for (int i = 0; i < iterations; i++) {
+            fn();
+        }
+        double average = static_cast<double>(esp_timer_get_time() - start) / iterations;
+        AddValue(name, "us", std::round(average * 100) / 100);
+        AddValue(name, "n", iterations);
+        ESP_LOGI("Benchmark", "%-28s %10.1f us", name, average);
+        return average;
+    }
+
+    // Adds a number to the result of a benchmark, such as the accuracy it reached
+    void AddValue(const char* name, const char* key, double value);
+    std::string ToJson() const;
+
+private:
+    struct Result {
+        std::string name;
+        std::vector<std::pair<std::string, double>> values;
+    };
+    std::vector<Result> results_;
+};
+
+// Benchmarks of the platform-free code, run by the on-target benchmark and by the host build
+namespace PortableBenchmarks {
+
+// Typical server control frames, the sentence uses the \u escapes of Python's json.dumps
+extern const std::string_view kTtsSentenceFrame;
+extern const std::string_view kTtsStateFrame;
+extern const std::string_view kMcpCallFrame;
+
+void RunOggDemux(BenchmarkReport& report, const std::string_view& ogg);
+// ControlMessage, and the cJSON trees it replaced when cJSON is available
+void RunControlMessages(BenchmarkReport& report);
+// dma_frames and dma_buffers are the I2S TX ring of AudioCodec
+void RunPlaybackClock(BenchmarkReport& report, int dma_frames, int dma_buffers);
+void RunReferenceDelay(BenchmarkReport& report);
+void RunInputSettling(BenchmarkReport& report);
+
+#if __has_include(<cJSON.h>)
+// cJSON comes with ESP-IDF, the host build has these cases only when it finds a copy
+void RunMcpDispatch(BenchmarkReport& report);
+#endif
+
+} // namespace PortableBenchmarks
+
+#endif // _BENCHMARK_CASES_H_
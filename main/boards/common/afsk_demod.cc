@@ -2,7 +2,6 @@
 #include <cstring>
 #include <algorithm>
 #include "esp_log.h"
-#include "display.h"
 
 #ifndef M_PI
 #define M_PI 3.14159265358979323846
@@ -12,97 +11,6 @@ namespace audio_wifi_config
 {
     static const char *kLogTag = "AUDIO_WIFI_CONFIG";
 
-    void ReceiveWifiCredentialsFromAudio(Application *app,
-                                        WifiConfigurationAp *wifi_ap,
-                                        Display *display,
-                                        size_t input_channels
-                                    )
-    {
-        const int kInputSampleRate = 16000;                                    // Input sampling rate
-        const float kDownsampleStep = static_cast<float>(kInputSampleRate) / static_cast<float>(kAudioSampleRate); // Downsampling step
-        std::vector<int16_t> audio_data;
-        AudioSignalProcessor signal_processor(kAudioSampleRate, kMarkFrequency, kSpaceFrequency, kBitRate, kWindowSize);
-        AudioDataBuffer data_buffer;
-
-        while (true)
-        {
-            // 检查Application状态，只有在WiFi配置模式下才处理音频
-            if (app->GetDeviceState() != kDeviceStateWifiConfiguring) {
-                // 不在WiFi配置状态，休眠100ms后再检查
-                vTaskDelay(pdMS_TO_TICKS(100));
-                continue;
-            }
-            
-            if (!app->GetAudioService().ReadAudioData(audio_data, 16000, 480)) { // 16kHz, 480 samples corresponds to 30ms data
-                // 读取音频失败，短暂延迟后重试
-                ESP_LOGI(kLogTag, "Failed to read audio data, retrying.");
-                vTaskDelay(pdMS_TO_TICKS(10));
-                continue;
-            }
-
-            if (input_channels == 2) { // 如果是双声道输入，转换为单声道
-                auto mono_data = std::vector<int16_t>(audio_data.size() / 2);
-                for (size_t i = 0, j = 0; i < mono_data.size(); ++i, j += 2) {
-                    mono_data[i] = audio_data[j];
-                }
-                audio_data = std::move(mono_data);
-            }
-            
-            // Downsample the audio data
-            std::vector<float> downsampled_data;
-            size_t last_index = 0;
-
-            if (kDownsampleStep > 1.0f) {
-                downsampled_data.reserve(audio_data.size() / static_cast<size_t>(kDownsampleStep));
-                for (size_t i = 0; i < audio_data.size(); ++i) {
-                    size_t sample_index = static_cast<size_t>(i / kDownsampleStep);
-                    if ((sample_index + 1) > last_index) {
-                        downsampled_data.push_back(static_cast<float>(audio_data[i]));
-                        last_index = sample_index + 1;
-                    }
-                }
-            } else {
-                downsampled_data.reserve(audio_data.size());
-                for (int16_t sample : audio_data) {
-                    downsampled_data.push_back(static_cast<float>(sample));
-                }
-            }
-            
-            // Process audio samples to get probability data
-            auto probabilities = signal_processor.ProcessAudioSamples(downsampled_data);
-            
-            // Feed probability data to the data buffer
-            if (data_buffer.ProcessProbabilityData(probabilities, 0.5f)) {
-                // If complete data was received, extract WiFi credentials
-                if (data_buffer.decoded_text.has_value()) {
-                    ESP_LOGI(kLogTag, "Received text data: %s", data_buffer.decoded_text->c_str());
-                    display->SetChatMessage("system", data_buffer.decoded_text->c_str());
-                    
-                    // Split SSID and password by newline character
-                    std::string wifi_ssid, wifi_password;
-                    size_t newline_position = data_buffer.decoded_text->find('\n');
-                    if (newline_position != std::string::npos) {
-                        wifi_ssid = data_buffer.decoded_text->substr(0, newline_position);
-                        wifi_password = data_buffer.decoded_text->substr(newline_position + 1);
-                        ESP_LOGI(kLogTag, "WiFi SSID: %s, Password: %s", wifi_ssid.c_str(), wifi_password.c_str());
-                    } else {
-                        ESP_LOGE(kLogTag, "Invalid data format, no newline character found");
-                        continue;
-                    }
-                    
-                    if (wifi_ap->ConnectToWifi(wifi_ssid, wifi_password)) {
-                        wifi_ap->Save(wifi_ssid, wifi_password);  // Save WiFi credentials
-                        esp_restart();                            // Restart device to apply new WiFi configuration
-                    } else {
-                        ESP_LOGE(kLogTag, "Failed to connect to WiFi with received credentials");
-                    }
-                    data_buffer.decoded_text.reset();  // Clear processed data
-                }
-            }
-            vTaskDelay(pdMS_TO_TICKS(1));  // 1ms delay
-        }
-    }
-
     // Default start and end transmission identifiers
     // \x01\x02 = 00000001 00000010
     const std::vector<uint8_t> kDefaultStartTransmissionPattern = {
@@ -114,58 +22,43 @@ namespace audio_wifi_config
 
     // FrequencyDetector implementation
     FrequencyDetector::FrequencyDetector(float frequency, size_t window_size)
-        : frequency_(frequency), window_size_(window_size) {
-        frequency_bin_ = std::floor(frequency_ * static_cast<float>(window_size_));
-        angular_frequency_ = 2.0f * M_PI * frequency_;
-        cos_coefficient_ = std::cos(angular_frequency_);
-        sin_coefficient_ = std::sin(angular_frequency_);
-        filter_coefficient_ = 2.0f * cos_coefficient_;
-
-        // Initialize state buffer
-        state_buffer_.push_back(0.0f);
-        state_buffer_.push_back(0.0f);
-    }
-
-    void FrequencyDetector::Reset() {
-        state_buffer_.clear();
-        state_buffer_.push_back(0.0f);
-        state_buffer_.push_back(0.0f);
-    }
-
-    void FrequencyDetector::ProcessSample(float sample) {
-        if (state_buffer_.size() < 2) {
-            return;
+        : window_size_(window_size), real_part_(0), imaginary_part_(0) {
+        float frequency_bin = std::round(frequency * static_cast<float>(window_size_));
+        if (std::fabs(frequency_bin - frequency * static_cast<float>(window_size_)) > 0.01f) {
+            ESP_LOGW(kLogTag, "Frequency %.4f is not on a bin of window %zu", frequency, window_size_);
         }
 
-        float s_minus_2 = state_buffer_.front();  // S[-2]
-        state_buffer_.pop_front();
-        float s_minus_1 = state_buffer_.front();  // S[-1]
-        state_buffer_.pop_front();
-
-        float s_current = sample + filter_coefficient_ * s_minus_1 - s_minus_2;
+        cos_table_.resize(window_size_);
+        sin_table_.resize(window_size_);
+        for (size_t i = 0; i < window_size_; ++i) {
+            float angle = 2.0f * M_PI * frequency_bin * static_cast<float>(i) / static_cast<float>(window_size_);
+            cos_table_[i] = static_cast<int16_t>(std::lround(std::cos(angle) * 16384.0f));
+            sin_table_[i] = static_cast<int16_t>(std::lround(std::sin(angle) * 16384.0f));
+        }
+    }
 
-        state_buffer_.push_back(s_minus_1);  // Put S[-1] back
-        state_buffer_.push_back(s_current);  // Add new S[0]
+    void FrequencyDetector::Reset() {
+        real_part_ = 0;
+        imaginary_part_ = 0;
     }
 
-    float FrequencyDetector::GetAmplitude() const {
-        if (state_buffer_.size() < 2) {
-            return 0.0f;
+    int32_t FrequencyDetector::GetAmplitude() const {
+        int32_t a = std::abs(real_part_);
+        int32_t b = std::abs(imaginary_part_);
+        if (a < b) {
+            std::swap(a, b);
         }
-
-        float s_minus_1 = state_buffer_[1];                      // S[-1]
-        float s_minus_2 = state_buffer_[0];                      // S[-2]
-        float real_part = cos_coefficient_ * s_minus_1 - s_minus_2;  // Real part
-        float imaginary_part = sin_coefficient_ * s_minus_1;         // Imaginary part
-
-        return std::sqrt(real_part * real_part + imaginary_part * imaginary_part) / 
-               (static_cast<float>(window_size_) / 2.0f);
+        // |z| ~= max + 3/8 min, within 7%
+        return a + (b * 3 >> 3);
     }
 
     // AudioSignalProcessor implementation
     AudioSignalProcessor::AudioSignalProcessor(size_t sample_rate, size_t mark_frequency, size_t space_frequency,
-                                             size_t bit_rate, size_t window_size)
-        : input_buffer_size_(window_size), output_sample_count_(0) {
+                                             size_t bit_rate, size_t window_size, size_t input_sample_rate)
+        : ring_buffer_(window_size, 0), ring_index_(0), filled_samples_(0),
+          sample_rate_(sample_rate), input_sample_rate_(input_sample_rate ? input_sample_rate : sample_rate),
+          decimation_phase_(0), decimation_sum_(0), decimation_count_(0),
+          bit_phase_(0), last_level_(false) {
         if (sample_rate % bit_rate != 0) {
             // On ESP32 we can continue execution, but log the error
             ESP_LOGW(kLogTag, "Sample rate %zu is not divisible by bit rate %zu", sample_rate, bit_rate);
@@ -180,44 +73,66 @@ namespace audio_wifi_config
         samples_per_bit_ = sample_rate / bit_rate;  // Number of samples per bit
     }
 
-    std::vector<float> AudioSignalProcessor::ProcessAudioSamples(const std::vector<float> &samples) {
+    std::vector<float> AudioSignalProcessor::ProcessAudioSamples(const std::vector<int16_t> &samples) {
         std::vector<float> result;
 
-        for (float sample : samples) {
-            if (input_buffer_.size() < input_buffer_size_) {
-                input_buffer_.push_back(sample);  // Just add, don't process yet
-            } else {
-                // Input buffer is full, process the data
-                input_buffer_.pop_front();   // Remove oldest sample
-                input_buffer_.push_back(sample);  // Add new sample
-                output_sample_count_++;
-
-                if (output_sample_count_ >= samples_per_bit_) {
-                    // Process all samples in the window using Goertzel algorithm
-                    for (float window_sample : input_buffer_) {
-                        mark_detector_->ProcessSample(window_sample);
-                        space_detector_->ProcessSample(window_sample);
-                    }
-
-                    float mark_amplitude = mark_detector_->GetAmplitude();   // Mark amplitude
-                    float space_amplitude = space_detector_->GetAmplitude(); // Space amplitude
-
-                    // Avoid division by zero
-                    float mark_probability = mark_amplitude / 
-                                           (space_amplitude + mark_amplitude + std::numeric_limits<float>::epsilon());
-                    result.push_back(mark_probability);
+        for (int16_t sample : samples) {
+            if (input_sample_rate_ == sample_rate_) {
+                ProcessSample(sample, result);
+                continue;
+            }
 
-                    // Reset detector windows
-                    mark_detector_->Reset();
-                    space_detector_->Reset();
-                    output_sample_count_ = 0;  // Reset output counter
-                }
+            // Decimate by averaging the input samples between two outputs,
+            // a cheap low-pass against aliasing into the tone band
+            decimation_sum_ += sample;
+            decimation_count_++;
+            decimation_phase_ += sample_rate_;
+            if (decimation_phase_ >= input_sample_rate_) {
+                decimation_phase_ -= input_sample_rate_;
+                ProcessSample(static_cast<int16_t>(decimation_sum_ / decimation_count_), result);
+                decimation_sum_ = 0;
+                decimation_count_ = 0;
             }
         }
 
         return result;
     }
 
+    void AudioSignalProcessor::ProcessSample(int16_t sample, std::vector<float> &result) {
+        int16_t oldest_sample = ring_buffer_[ring_index_];
+        ring_buffer_[ring_index_] = sample;
+        mark_detector_->ProcessSample(sample, oldest_sample, ring_index_);
+        space_detector_->ProcessSample(sample, oldest_sample, ring_index_);
+        if (++ring_index_ == ring_buffer_.size()) {
+            ring_index_ = 0;
+        }
+        if (filled_samples_ < ring_buffer_.size()) {
+            filled_samples_++;
+            return;
+        }
+
+        int32_t mark_amplitude = mark_detector_->GetAmplitude();
+        int32_t space_amplitude = space_detector_->GetAmplitude();
+
+        // Clock recovery: the sliding window output crosses over half a window
+        // after a bit boundary, so a transition should be seen half a bit after
+        // the last decision. Pull the bit phase towards that point.
+        bool level = mark_amplitude > space_amplitude;
+        if (level != last_level_) {
+            last_level_ = level;
+            int error = bit_phase_ - samples_per_bit_ / 2;
+            bit_phase_ -= error / 2;
+        }
+
+        if (++bit_phase_ >= samples_per_bit_) {
+            bit_phase_ = 0;
+            // Avoid division by zero
+            float mark_probability = static_cast<float>(mark_amplitude) /
+                                     static_cast<float>(mark_amplitude + space_amplitude + 1);
+            result.push_back(mark_probability);
+        }
+    }
+
     // AudioDataBuffer implementation
     AudioDataBuffer::AudioDataBuffer()
         : current_state_(DataReceptionState::kInactive),
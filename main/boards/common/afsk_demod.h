@@ -6,8 +6,11 @@
 #include <memory>
 #include <optional>
 #include <cmath>
-#include "wifi_configuration_ap.h"
-#include "application.h"
+#include <cstdint>
+
+class Application;
+class WifiConfigurationAp;
+class Display;
 
 // Audio signal processing constants for WiFi configuration via audio
 const size_t kAudioSampleRate = 6400;
@@ -18,25 +21,25 @@ const size_t kWindowSize = 64;
 
 namespace audio_wifi_config
 {
-    // Main function to receive WiFi credentials through audio signal
+    // Main function to receive WiFi credentials through audio signal, in audio_wifi_config.cc.
+    // The demodulator below has no platform dependencies and is also built on the host.
     void ReceiveWifiCredentialsFromAudio(Application *app, WifiConfigurationAp *wifi_ap, Display *display, 
                                          size_t input_channels = 1);
 
     /**
-     * Goertzel algorithm implementation for single frequency detection
-     * Used to detect specific audio frequencies in the AFSK demodulation process
+     * Sliding Goertzel (sliding DFT) detector for a single frequency, fixed point
+     * The target frequency is rounded to the nearest DFT bin of the window, so
+     * the twiddle factors repeat every window and each sample is added and later
+     * removed with the same integer term: the running sum never drifts.
      */
     class FrequencyDetector
     {
     private:
-        float frequency_;              // Target frequency (normalized, i.e., f / fs)
-        size_t window_size_;           // Window size for analysis
-        float frequency_bin_;          // Frequency bin
-        float angular_frequency_;      // Angular frequency
-        float cos_coefficient_;        // cos(w)
-        float sin_coefficient_;        // sin(w)
-        float filter_coefficient_;     // 2 * cos(w)
-        std::deque<float> state_buffer_;  // Circular buffer for storing S[-1] and S[-2]
+        size_t window_size_;              // Window size for analysis
+        std::vector<int16_t> cos_table_;  // cos(2*pi*k*n/N) in Q14
+        std::vector<int16_t> sin_table_;  // sin(2*pi*k*n/N) in Q14
+        int32_t real_part_;               // Running real part of the DFT bin
+        int32_t imaginary_part_;          // Running imaginary part of the DFT bin
 
     public:
         /**
@@ -52,50 +55,72 @@ namespace audio_wifi_config
         void Reset();
 
         /**
-         * Process one audio sample
-         * @param sample Input audio sample
+         * Slide the window by one sample
+         * @param sample Newest audio sample
+         * @param oldest_sample Sample leaving the window (0 while the window is filling)
+         * @param index Position of the sample in the window (n mod window size)
          */
-        void ProcessSample(float sample);
+        void ProcessSample(int16_t sample, int16_t oldest_sample, size_t index) {
+            real_part_ += ((sample * cos_table_[index]) >> kTermShift) - ((oldest_sample * cos_table_[index]) >> kTermShift);
+            imaginary_part_ += ((sample * sin_table_[index]) >> kTermShift) - ((oldest_sample * sin_table_[index]) >> kTermShift);
+        }
 
         /**
-         * Calculate current amplitude
-         * @return Amplitude value
+         * Calculate current amplitude (alpha max plus beta min approximation)
+         * @return Amplitude value, relative to the other detectors with the same window
          */
-        float GetAmplitude() const;
+        int32_t GetAmplitude() const;
+
+    private:
+        // Keeps the sum of a full window of Q14 products inside int32
+        static constexpr int kTermShift = 6;
     };
 
     /**
      * Audio signal processor for Mark/Space frequency pair detection
-     * Processes audio signals to extract digital data using AFSK demodulation
+     * Processes audio signals to extract digital data using AFSK demodulation.
+     * Input samples are decimated to the processing sample rate, both detectors
+     * slide over a fixed ring buffer, and the bit clock is recovered from the
+     * mark/space transitions so bits are sampled when the window covers one bit.
      */
     class AudioSignalProcessor
     {
     private:
-        std::deque<float> input_buffer_;             // Input sample buffer
-        size_t input_buffer_size_;                   // Input buffer size = window size
-        size_t output_sample_count_;                 // Output sample counter
-        size_t samples_per_bit_;                     // Samples per bit threshold
+        std::vector<int16_t> ring_buffer_;           // Last window_size processed samples
+        size_t ring_index_;                          // Oldest sample position in ring buffer
+        size_t filled_samples_;                      // Samples in ring buffer, up to window size
+        size_t sample_rate_;                         // Processing sample rate
+        size_t input_sample_rate_;                   // Sample rate of ProcessAudioSamples input
+        size_t decimation_phase_;                    // Fractional decimation accumulator
+        int32_t decimation_sum_;                     // Sum of input samples since last output (boxcar filter)
+        int32_t decimation_count_;                   // Number of input samples in decimation_sum_
+        int bit_phase_;                              // Samples since last bit decision
+        int samples_per_bit_;                        // Samples per bit
+        bool last_level_;                            // Last mark/space decision, for clock recovery
         std::unique_ptr<FrequencyDetector> mark_detector_;   // Mark frequency detector
         std::unique_ptr<FrequencyDetector> space_detector_;  // Space frequency detector
 
+        void ProcessSample(int16_t sample, std::vector<float> &result);
+
     public:
         /**
          * Constructor
-         * @param sample_rate Audio sampling rate
+         * @param sample_rate Processing sampling rate
          * @param mark_frequency Mark frequency for digital '1'
          * @param space_frequency Space frequency for digital '0'
          * @param bit_rate Data transmission bit rate
          * @param window_size Analysis window size
+         * @param input_sample_rate Sampling rate of the input audio, 0 means sample_rate
          */
         AudioSignalProcessor(size_t sample_rate, size_t mark_frequency, size_t space_frequency,
-                           size_t bit_rate, size_t window_size);
+                           size_t bit_rate, size_t window_size, size_t input_sample_rate = 0);
 
         /**
          * Process input audio samples
-         * @param samples Input audio sample vector
-         * @return Vector of Mark probability values (0.0 to 1.0)
+         * @param samples Mono input audio samples at the input sampling rate
+         * @return Vector of Mark probability values (0.0 to 1.0), one per bit
          */
-        std::vector<float> ProcessAudioSamples(const std::vector<float> &samples);
+        std::vector<float> ProcessAudioSamples(const std::vector<int16_t> &samples);
     };
 
     /**
@@ -242,6 +242,10 @@ void Board::StartBlufiOtaMode(const std::string& upgrade_url, const std::string&
     vTaskDelay(pdMS_TO_TICKS(100));
 
     { //这个数据非常重要，check nvs 是否写成功
+        if (!Settings::Flush()) {
+            ESP_LOGE(TAG, "StartBlufiOtaMode commit blufi nvs failed");
+            esp_restart();
+        }
         Settings settings("board", false);
         
         std::string app = "app";
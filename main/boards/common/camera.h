@@ -10,6 +10,10 @@ public:
     virtual bool SetHMirror(bool enabled) = 0;
     virtual bool SetVFlip(bool enabled) = 0;
     virtual std::string Explain(const std::string& question) = 0;
+    // 连续视觉模式：后台保持低分辨率滚动帧，画面变化时才重新编码，
+    // Explain 上传最近的几张关键帧，画面没有变化时复用上一次的 JPEG
+    virtual bool SetContinuousVision(bool enabled) { return false; }
+    virtual bool IsContinuousVision() const { return false; }
 };
 
 #endif // CAMERA_H
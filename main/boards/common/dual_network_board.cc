@@ -4,22 +4,34 @@
 #include "assets/lang_config.h"
 #include "settings.h"
 #include <esp_log.h>
+#include <wifi_station.h>
+#include <ssid_manager.h>
 
 static const char *TAG = "DualNetworkBoard";
 
-DualNetworkBoard::DualNetworkBoard(gpio_num_t ml307_tx_pin, gpio_num_t ml307_rx_pin, gpio_num_t ml307_dtr_pin, int32_t default_net_type) 
-    : Board(), 
-      ml307_tx_pin_(ml307_tx_pin), 
-      ml307_rx_pin_(ml307_rx_pin), 
+DualNetworkBoard::DualNetworkBoard(gpio_num_t ml307_tx_pin, gpio_num_t ml307_rx_pin, gpio_num_t ml307_dtr_pin, int32_t default_net_type)
+    : Board(),
+      ml307_tx_pin_(ml307_tx_pin),
+      ml307_rx_pin_(ml307_rx_pin),
       ml307_dtr_pin_(ml307_dtr_pin) {
-    
+
     // 从Settings加载网络类型
-    network_type_ = LoadNetworkTypeFromSettings(default_net_type);
-    
-    // 只初始化当前网络类型对应的板卡
+    preferred_type_ = LoadNetworkTypeFromSettings(default_net_type);
+    network_type_ = preferred_type_.load();
+
     InitializeCurrentBoard();
 }
 
+DualNetworkBoard::~DualNetworkBoard() {
+    if (probe_timer_ != nullptr) {
+        esp_timer_stop(probe_timer_);
+        esp_timer_delete(probe_timer_);
+    }
+    if (switch_task_ != nullptr) {
+        vTaskDelete(switch_task_);
+    }
+}
+
 NetworkType DualNetworkBoard::LoadNetworkTypeFromSettings(int32_t default_net_type) {
     Settings settings("network", true);
     int network_type = settings.GetInt("type", default_net_type); // 默认使用ML307 (1)
@@ -33,61 +45,222 @@ void DualNetworkBoard::SaveNetworkTypeToSettings(NetworkType type) {
 }
 
 void DualNetworkBoard::InitializeCurrentBoard() {
+#if CONFIG_USE_NETWORK_FAILOVER
+    // 两种网络都创建，非当前的一种作为热备份
+    ESP_LOGI(TAG, "Initialize WiFi and ML307 boards, %s is active", network_type_ == NetworkType::ML307 ? "ML307" : "WiFi");
+    wifi_board_ = std::make_unique<WifiBoard>();
+    ml307_board_ = std::make_unique<Ml307Board>(ml307_tx_pin_, ml307_rx_pin_, ml307_dtr_pin_);
+#else
+    // 只初始化当前网络类型对应的板卡
     if (network_type_ == NetworkType::ML307) {
         ESP_LOGI(TAG, "Initialize ML307 board");
-        current_board_ = std::make_unique<Ml307Board>(ml307_tx_pin_, ml307_rx_pin_, ml307_dtr_pin_);
+        ml307_board_ = std::make_unique<Ml307Board>(ml307_tx_pin_, ml307_rx_pin_, ml307_dtr_pin_);
     } else {
         ESP_LOGI(TAG, "Initialize WiFi board");
-        current_board_ = std::make_unique<WifiBoard>();
+        wifi_board_ = std::make_unique<WifiBoard>();
+    }
+#endif
+    current_board_ = GetBoard(network_type_);
+}
+
+Board* DualNetworkBoard::GetBoard(NetworkType type) const {
+    if (type == NetworkType::ML307) {
+        return ml307_board_.get();
     }
+    return wifi_board_.get();
 }
 
 void DualNetworkBoard::SwitchNetworkType() {
     auto display = GetDisplay();
-    if (network_type_ == NetworkType::WIFI) {    
-        SaveNetworkTypeToSettings(NetworkType::ML307);
+    NetworkType type = network_type_ == NetworkType::WIFI ? NetworkType::ML307 : NetworkType::WIFI;
+    SaveNetworkTypeToSettings(type);
+    if (type == NetworkType::ML307) {
         display->ShowNotification(Lang::Strings::SWITCH_TO_4G_NETWORK);
     } else {
-        SaveNetworkTypeToSettings(NetworkType::WIFI);
         display->ShowNotification(Lang::Strings::SWITCH_TO_WIFI_NETWORK);
     }
+
+#if CONFIG_USE_NETWORK_FAILOVER
+    // 备用网络已连接时直接切换，无需重启，切换在网络切换任务中进行
+    if (standby_ready_ && switch_task_ != nullptr && IsLinkUp(type)) {
+        preferred_type_ = type;
+        xTaskNotify(switch_task_, NETWORK_SWITCH_REQUESTED, eSetBits);
+        return;
+    }
+#endif
     vTaskDelay(pdMS_TO_TICKS(1000));
     auto& app = Application::GetInstance();
     app.Reboot();
 }
 
- 
+
 std::string DualNetworkBoard::GetBoardType() {
-    return current_board_->GetBoardType();
+    return current_board_.load()->GetBoardType();
 }
 
 void DualNetworkBoard::StartNetwork() {
     auto display = Board::GetInstance().GetDisplay();
-    
+
     if (network_type_ == NetworkType::WIFI) {
         display->SetStatus(Lang::Strings::CONNECTING);
     } else {
         display->SetStatus(Lang::Strings::DETECTING_MODULE);
     }
-    current_board_->StartNetwork();
+    current_board_.load()->StartNetwork();
+
+#if CONFIG_USE_NETWORK_FAILOVER
+    // 当前网络就绪后在后台启动备用网络，并开始探测当前网络
+    xTaskCreate([](void* arg) {
+        auto board = (DualNetworkBoard*)arg;
+        board->StartStandbyNetwork();
+        vTaskDelete(NULL);
+    }, "standby_network", 4096, this, 2, nullptr);
+
+    xTaskCreate([](void* arg) {
+        auto board = (DualNetworkBoard*)arg;
+        board->NetworkSwitchTask();
+        vTaskDelete(NULL);
+    }, "network_switch", 4096, this, 2, &switch_task_);
+
+    esp_timer_create_args_t probe_timer_args = {
+        .callback = [](void* arg) {
+            auto board = (DualNetworkBoard*)arg;
+            xTaskNotify(board->switch_task_, NETWORK_SWITCH_PROBE_DUE, eSetBits);
+        },
+        .arg = this,
+        .dispatch_method = ESP_TIMER_TASK,
+        .name = "network_probe",
+        .skip_unhandled_events = true,
+    };
+    esp_timer_create(&probe_timer_args, &probe_timer_);
+    esp_timer_start_periodic(probe_timer_, NETWORK_PROBE_INTERVAL_MS * 1000);
+#endif
+}
+
+void DualNetworkBoard::StartStandbyNetwork() {
+    if (network_type_ == NetworkType::WIFI) {
+        // 4G 模块注册网络后休眠，切换过去时再唤醒
+        standby_ready_ = ml307_board_->StartStandbyNetwork();
+        return;
+    }
+
+    // Wi-Fi 备用时开启省电模式，断开后由 WifiStation 自行重连，不进入配网模式
+    auto& ssid_manager = SsidManager::GetInstance();
+    if (ssid_manager.GetSsidList().empty()) {
+        ESP_LOGW(TAG, "No WiFi configured, no WiFi standby");
+        return;
+    }
+    auto& wifi_station = WifiStation::GetInstance();
+    wifi_station.Start();
+    wifi_station.SetPowerSaveMode(true);
+    standby_ready_ = true;
+    ESP_LOGI(TAG, "WiFi standby started");
+}
+
+bool DualNetworkBoard::IsLinkUp(NetworkType type) {
+    // 只读取缓存的链路状态，不向休眠的模块发送 AT 命令
+    if (type == NetworkType::WIFI) {
+        return wifi_board_ != nullptr && WifiStation::GetInstance().IsConnected();
+    }
+    return ml307_board_ != nullptr && ml307_board_->IsNetworkReady();
+}
+
+void DualNetworkBoard::NetworkSwitchTask() {
+    while (true) {
+        uint32_t bits = 0;
+        xTaskNotifyWait(0, UINT32_MAX, &bits, portMAX_DELAY);
+        if (bits & NETWORK_SWITCH_REQUESTED) {
+            FailOver(preferred_type_, esp_timer_get_time());
+        }
+        if (bits & NETWORK_SWITCH_PROBE_DUE) {
+            ProbeNetwork();
+        }
+    }
+}
+
+void DualNetworkBoard::ProbeNetwork() {
+    NetworkType active = network_type_;
+    NetworkType standby = active == NetworkType::WIFI ? NetworkType::ML307 : NetworkType::WIFI;
+
+    if (IsLinkUp(active)) {
+        probe_failures_ = 0;
+        // 首选网络恢复一段时间后，在空闲时切回
+        if (active != preferred_type_ && standby_ready_ && IsLinkUp(preferred_type_)) {
+            if (++failback_probes_ >= NETWORK_FAILBACK_PROBES &&
+                Application::GetInstance().GetDeviceState() == kDeviceStateIdle) {
+                failback_probes_ = 0;
+                FailOver(preferred_type_, esp_timer_get_time());
+            }
+        } else {
+            failback_probes_ = 0;
+        }
+        return;
+    }
+
+    failback_probes_ = 0;
+    if (probe_failures_++ == 0) {
+        link_lost_time_us_ = esp_timer_get_time();
+        ESP_LOGW(TAG, "%s link is down", active == NetworkType::WIFI ? "WiFi" : "ML307");
+    }
+    if (probe_failures_ < NETWORK_PROBE_FAILURES || !standby_ready_ || !IsLinkUp(standby)) {
+        return;
+    }
+
+    auto display = GetDisplay();
+    if (standby == NetworkType::ML307) {
+        display->ShowNotification(Lang::Strings::SWITCH_TO_4G_NETWORK);
+    } else {
+        display->ShowNotification(Lang::Strings::SWITCH_TO_WIFI_NETWORK);
+    }
+    FailOver(standby, link_lost_time_us_);
+}
+
+void DualNetworkBoard::FailOver(NetworkType type, int64_t link_lost_time_us) {
+    {
+        std::lock_guard<std::mutex> lock(switch_mutex_);
+        if (network_type_ == type) {
+            return;
+        }
+        NetworkType previous = network_type_;
+        if (type == NetworkType::ML307) {
+            ml307_board_->SetStandby(false);
+        } else {
+            wifi_board_->SetPowerSaveMode(false);
+        }
+        current_board_ = GetBoard(type);
+        network_type_ = type;
+
+        // 原来的网络转为热备份，由其自身的重连机制恢复
+        if (previous == NetworkType::ML307) {
+            ml307_board_->SetStandby(true);
+        } else {
+            wifi_board_->SetPowerSaveMode(true);
+        }
+        probe_failures_ = 0;
+        failback_probes_ = 0;
+    }
+
+    ESP_LOGW(TAG, "Switched to %s, %d ms after the link was lost", type == NetworkType::WIFI ? "WiFi" : "ML307",
+        (int)((esp_timer_get_time() - link_lost_time_us) / 1000));
+    Application::GetInstance().OnNetworkSwitched(link_lost_time_us);
 }
 
 NetworkInterface* DualNetworkBoard::GetNetwork() {
-    return current_board_->GetNetwork();
+    return current_board_.load()->GetNetwork();
 }
 
 const char* DualNetworkBoard::GetNetworkStateIcon() {
-    return current_board_->GetNetworkStateIcon();
+    return current_board_.load()->GetNetworkStateIcon();
 }
 
 void DualNetworkBoard::SetPowerSaveMode(bool enabled) {
-    current_board_->SetPowerSaveMode(enabled);
+    current_board_.load()->SetPowerSaveMode(enabled);
 }
 
-std::string DualNetworkBoard::GetBoardJson() {   
-    return current_board_->GetBoardJson();
+std::string DualNetworkBoard::GetBoardJson() {
+    return current_board_.load()->GetBoardJson();
 }
 
 std::string DualNetworkBoard::GetDeviceStatusJson() {
-    return current_board_->GetDeviceStatusJson();
+    return current_board_.load()->GetDeviceStatusJson();
 }
@@ -4,7 +4,21 @@
 #include "board.h"
 #include "wifi_board.h"
 #include "ml307_board.h"
+#include <esp_timer.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
 #include <memory>
+#include <mutex>
+#include <atomic>
+
+// 当前网络的探测周期，连续失败 NETWORK_PROBE_FAILURES 次后切换到备用网络
+#define NETWORK_PROBE_INTERVAL_MS 1000
+#define NETWORK_PROBE_FAILURES 3
+// 首选网络恢复后连续正常这么多次，且设备空闲时切回
+#define NETWORK_FAILBACK_PROBES 10
+// 网络切换任务的通知位
+#define NETWORK_SWITCH_PROBE_DUE (1 << 0)
+#define NETWORK_SWITCH_REQUESTED (1 << 1)
 
 //enum NetworkType
 enum class NetworkType {
@@ -13,39 +27,64 @@ enum class NetworkType {
 };
 
 // 双网络板卡类，可以在WiFi和ML307之间切换
+// 开启 CONFIG_USE_NETWORK_FAILOVER 时两种网络同时初始化，另一种作为热备份，
+// 当前网络断开时不重启直接切换，并由 Application 在新网络上恢复对话
 class DualNetworkBoard : public Board {
 private:
-    // 使用基类指针存储当前活动的板卡
-    std::unique_ptr<Board> current_board_;
-    NetworkType network_type_ = NetworkType::ML307;  // Default to ML307
+    // 两种网络的板卡，未开启故障切换时只创建当前网络类型的板卡
+    std::unique_ptr<WifiBoard> wifi_board_;
+    std::unique_ptr<Ml307Board> ml307_board_;
+    // 当前活动的板卡，故障切换时在网络切换任务中更换
+    std::atomic<Board*> current_board_{nullptr};
+    std::atomic<NetworkType> network_type_{NetworkType::ML307};  // Default to ML307
+    // Settings 中保存的网络类型
+    std::atomic<NetworkType> preferred_type_{NetworkType::ML307};
 
     // ML307的引脚配置
     gpio_num_t ml307_tx_pin_;
     gpio_num_t ml307_rx_pin_;
     gpio_num_t ml307_dtr_pin_;
-    
+
+    // 故障切换
+    std::mutex switch_mutex_;
+    std::atomic<bool> standby_ready_{false};
+    esp_timer_handle_t probe_timer_ = nullptr;
+    // 探测和切换会发送阻塞的 AT 命令并更新界面，不能在 esp_timer 任务中执行
+    TaskHandle_t switch_task_ = nullptr;
+    int probe_failures_ = 0;
+    int failback_probes_ = 0;
+    int64_t link_lost_time_us_ = 0;
+
     // 从Settings加载网络类型
     NetworkType LoadNetworkTypeFromSettings(int32_t default_net_type);
-    
+
     // 保存网络类型到Settings
     void SaveNetworkTypeToSettings(NetworkType type);
 
     // 初始化当前网络类型对应的板卡
     void InitializeCurrentBoard();
- 
+
+    Board* GetBoard(NetworkType type) const;
+    bool IsLinkUp(NetworkType type);
+    void StartStandbyNetwork();
+    void NetworkSwitchTask();
+    void ProbeNetwork();
+    // 切换到 type 网络，link_lost_time_us 为发现原网络断开的时间
+    void FailOver(NetworkType type, int64_t link_lost_time_us);
+
 public:
     DualNetworkBoard(gpio_num_t ml307_tx_pin, gpio_num_t ml307_rx_pin, gpio_num_t ml307_dtr_pin = GPIO_NUM_NC, int32_t default_net_type = 1);
-    virtual ~DualNetworkBoard() = default;
- 
+    virtual ~DualNetworkBoard();
+
     // 切换网络类型
     void SwitchNetworkType();
-    
+
     // 获取当前网络类型
     NetworkType GetNetworkType() const { return network_type_; }
-    
+
     // 获取当前活动的板卡引用
-    Board& GetCurrentBoard() const { return *current_board_; }
-    
+    Board& GetCurrentBoard() const { return *current_board_.load(); }
+
     // 重写Board接口
     virtual std::string GetBoardType() override;
     virtual void StartNetwork() override;
@@ -56,4 +95,4 @@ public:
     virtual std::string GetDeviceStatusJson() override;
 };
 
-#endif // DUAL_NETWORK_BOARD_H 
\ No newline at end of file
+#endif // DUAL_NETWORK_BOARD_H
@@ -8,10 +8,21 @@
 #include <esp_heap_caps.h>
 #include <img_converters.h>
 #include <cstring>
+#include <cstdlib>
 
 #define TAG "Esp32Camera"
 
+// Continuous vision mode
+#define VISION_INTERVAL_MS 500
+#define VISION_CHANGE_THRESHOLD 12      // Mean absolute luma difference of the thumbnail (0-255)
+#define VISION_MAX_KEYFRAMES 3          // Frames uploaded together in one request
+#define VISION_KEYFRAME_MAX_AGE_MS 30000
+
+#define EXPLAIN_BOUNDARY "----ESP32_CAMERA_BOUNDARY"
+
 Esp32Camera::Esp32Camera(const camera_config_t& config) {
+    vision_stopped_ = xSemaphoreCreateBinary();
+
     // camera init
     esp_err_t err = esp_camera_init(&config); // 配置上面定义的参数
     if (err != ESP_OK) {
@@ -24,7 +35,7 @@ Esp32Camera::Esp32Camera(const camera_config_t& config) {
         s->set_hmirror(s, 0);  // 这里控制摄像头镜像 写1镜像 写0不镜像
     }
 
-    // 初始化预览图片的内存
+    // 初始化预览图片的描述，内存在第一次拍照时根据屏幕大小分配
     memset(&preview_image_, 0, sizeof(preview_image_));
     preview_image_.header.magic = LV_IMAGE_HEADER_MAGIC;
     preview_image_.header.cf = LV_COLOR_FORMAT_RGB565;
@@ -32,42 +43,39 @@ Esp32Camera::Esp32Camera(const camera_config_t& config) {
 
     switch (config.frame_size) {
         case FRAMESIZE_SVGA:
-            preview_image_.header.w = 800;
-            preview_image_.header.h = 600;
+            frame_width_ = 800;
+            frame_height_ = 600;
             break;
         case FRAMESIZE_VGA:
-            preview_image_.header.w = 640;
-            preview_image_.header.h = 480;
+            frame_width_ = 640;
+            frame_height_ = 480;
             break;
         case FRAMESIZE_QVGA:
-            preview_image_.header.w = 320;
-            preview_image_.header.h = 240;
+            frame_width_ = 320;
+            frame_height_ = 240;
             break;
         case FRAMESIZE_128X128:
-            preview_image_.header.w = 128;
-            preview_image_.header.h = 128;
+            frame_width_ = 128;
+            frame_height_ = 128;
             break;
         case FRAMESIZE_240X240:
-            preview_image_.header.w = 240;
-            preview_image_.header.h = 240;
+            frame_width_ = 240;
+            frame_height_ = 240;
             break;
         default:
             ESP_LOGE(TAG, "Unsupported frame size: %d, image preview will not be shown", config.frame_size);
-            preview_image_.data_size = 0;
-            preview_image_.data = nullptr;
-            return;
-    }
-
-    preview_image_.header.stride = preview_image_.header.w * 2;
-    preview_image_.data_size = preview_image_.header.w * preview_image_.header.h * 2;
-    preview_image_.data = (uint8_t*)heap_caps_malloc(preview_image_.data_size, MALLOC_CAP_SPIRAM);
-    if (preview_image_.data == nullptr) {
-        ESP_LOGE(TAG, "Failed to allocate memory for preview image");
-        return;
+            break;
     }
 }
 
 Esp32Camera::~Esp32Camera() {
+    SetContinuousVision(false);
+    keyframes_.clear();
+    vSemaphoreDelete(vision_stopped_);
+    if (decode_buffer_) {
+        heap_caps_free(decode_buffer_);
+        decode_buffer_ = nullptr;
+    }
     if (fb_) {
         esp_camera_fb_return(fb_);
         fb_ = nullptr;
@@ -84,11 +92,85 @@ void Esp32Camera::SetExplainUrl(const std::string& url, const std::string& token
     explain_token_ = token;
 }
 
-bool Esp32Camera::Capture() {
-    if (encoder_thread_.joinable()) {
-        encoder_thread_.join();
+bool Esp32Camera::InitializePreview() {
+    // The preview is never shown wider than the screen, downscale large frames by
+    // a power of two so the conversion and the LVGL scaling touch fewer pixels
+    preview_shift_ = 0;
+    auto display = Board::GetInstance().GetDisplay();
+    if (display != nullptr && display->width() > 0) {
+        while (preview_shift_ < 3 && (frame_width_ >> (preview_shift_ + 1)) >= display->width()) {
+            preview_shift_++;
+        }
+    }
+
+    preview_image_.header.w = frame_width_ >> preview_shift_;
+    preview_image_.header.h = frame_height_ >> preview_shift_;
+    preview_image_.header.stride = preview_image_.header.w * 2;
+    preview_image_.data_size = preview_image_.header.w * preview_image_.header.h * 2;
+    preview_image_.data = (uint8_t*)heap_caps_malloc(preview_image_.data_size, MALLOC_CAP_SPIRAM);
+    if (preview_image_.data == nullptr) {
+        ESP_LOGE(TAG, "Failed to allocate memory for preview image");
+        preview_image_.data_size = 0;
+        return false;
+    }
+    ESP_LOGI(TAG, "Preview image %dx%d", (int)preview_image_.header.w, (int)preview_image_.header.h);
+    return true;
+}
+
+// Swap the bytes of big endian RGB565 pixels, two pixels per 32-bit word
+static void SwapRgb565(const uint16_t* src, uint16_t* dst, size_t pixel_count) {
+    auto src32 = (const uint32_t*)src;
+    auto dst32 = (uint32_t*)dst;
+    size_t word_count = pixel_count / 2;
+    size_t i = 0;
+    for (; i + 4 <= word_count; i += 4) {
+        uint32_t a = src32[i], b = src32[i + 1], c = src32[i + 2], d = src32[i + 3];
+        dst32[i] = ((a & 0x00ff00ff) << 8) | ((a >> 8) & 0x00ff00ff);
+        dst32[i + 1] = ((b & 0x00ff00ff) << 8) | ((b >> 8) & 0x00ff00ff);
+        dst32[i + 2] = ((c & 0x00ff00ff) << 8) | ((c >> 8) & 0x00ff00ff);
+        dst32[i + 3] = ((d & 0x00ff00ff) << 8) | ((d >> 8) & 0x00ff00ff);
+    }
+    for (; i < word_count; i++) {
+        uint32_t a = src32[i];
+        dst32[i] = ((a & 0x00ff00ff) << 8) | ((a >> 8) & 0x00ff00ff);
+    }
+    if (pixel_count & 1) {
+        dst[pixel_count - 1] = __builtin_bswap16(src[pixel_count - 1]);
+    }
+}
+
+void Esp32Camera::UpdatePreview() {
+    int width = preview_image_.header.w;
+    int height = preview_image_.header.h;
+    auto dst = (uint16_t*)preview_image_.data;
+    if ((fb_->width >> preview_shift_) != width || (fb_->height >> preview_shift_) != height) {
+        ESP_LOGW(TAG, "Skip preview because frame size %dx%d changed", fb_->width, fb_->height);
+        return;
     }
 
+    if (fb_->format == PIXFORMAT_JPEG) {
+        // The decoder downscales by 1 / 2 / 4 / 8 for free
+        if (!jpg2rgb565(fb_->buf, fb_->len, preview_image_.data, (jpg_scale_t)preview_shift_)) {
+            ESP_LOGE(TAG, "Failed to decode JPEG frame for preview");
+            return;
+        }
+        SwapRgb565(dst, dst, width * height);
+    } else if (preview_shift_ == 0) {
+        SwapRgb565((const uint16_t*)fb_->buf, dst, width * height);
+    } else {
+        auto src = (const uint16_t*)fb_->buf;
+        for (int y = 0; y < height; y++) {
+            auto row = src + (y << preview_shift_) * fb_->width;
+            for (int x = 0; x < width; x++) {
+                *dst++ = __builtin_bswap16(row[x << preview_shift_]);
+            }
+        }
+    }
+    Board::GetInstance().GetDisplay()->SetPreviewImage(&preview_image_);
+}
+
+bool Esp32Camera::Capture() {
+    std::lock_guard<std::mutex> lock(mutex_);
     auto start_time = esp_timer_get_time();
     int frames_to_get = 2;
     // Try to get a stable frame
@@ -102,15 +184,20 @@ bool Esp32Camera::Capture() {
             return false;
         }
     }
-    auto end_time = esp_timer_get_time();
-    ESP_LOGI(TAG, "Camera captured %d frames in %d ms", frames_to_get, int((end_time - start_time) / 1000));
+    capture_time_ = esp_timer_get_time();
+    capture_ms_ = int((capture_time_ - start_time) / 1000);
+    preview_ms_ = 0;
+    ESP_LOGI(TAG, "Camera captured %d frames in %d ms", frames_to_get, capture_ms_);
 
     // 如果预览图片 buffer 为空，则跳过预览
     // 但仍返回 true，因为此时图像可以上传至服务器
-    if (preview_image_.data_size == 0) {
+    if (frame_width_ == 0) {
         ESP_LOGW(TAG, "Skip preview because of unsupported frame size");
         return true;
     }
+    if (preview_shift_ == -1 && !InitializePreview()) {
+        return true;
+    }
     if (preview_image_.data == nullptr) {
         ESP_LOGE(TAG, "Preview image data is not initialized");
         return true;
@@ -118,17 +205,12 @@ bool Esp32Camera::Capture() {
     // 显示预览图片
     auto display = Board::GetInstance().GetDisplay();
     if (display != nullptr) {
-        auto src = (uint16_t*)fb_->buf;
-        auto dst = (uint16_t*)preview_image_.data;
-        size_t pixel_count = fb_->len / 2;
-        for (size_t i = 0; i < pixel_count; i++) {
-            // 交换每个16位字内的字节
-            dst[i] = __builtin_bswap16(src[i]);
-        }
-        display->SetPreviewImage(&preview_image_);
+        UpdatePreview();
+        preview_ms_ = int((esp_timer_get_time() - capture_time_) / 1000);
     }
     return true;
 }
+
 bool Esp32Camera::SetHMirror(bool enabled) {
     sensor_t *s = esp_camera_sensor_get();
     if (s == nullptr) {
@@ -163,6 +245,68 @@ bool Esp32Camera::SetVFlip(bool enabled) {
     return true;
 }
 
+std::unique_ptr<Http> Esp32Camera::OpenExplainRequest(const std::string& question) {
+    auto network = Board::GetInstance().GetNetwork();
+    auto http = network->CreateHttp(3);
+
+    // 配置HTTP客户端，使用分块传输编码
+    http->SetHeader("Device-Id", SystemInfo::GetMacAddress().c_str());
+    http->SetHeader("Client-Id", Board::GetInstance().GetUuid().c_str());
+    if (!explain_token_.empty()) {
+        http->SetHeader("Authorization", "Bearer " + explain_token_);
+    }
+    http->SetHeader("Content-Type", "multipart/form-data; boundary=" EXPLAIN_BOUNDARY);
+    http->SetHeader("Transfer-Encoding", "chunked");
+    if (!http->Open("POST", explain_url_)) {
+        ESP_LOGE(TAG, "Failed to connect to explain URL");
+        return nullptr;
+    }
+
+    // 第一块：question字段
+    std::string question_field;
+    question_field += "--" EXPLAIN_BOUNDARY "\r\n";
+    question_field += "Content-Disposition: form-data; name=\"question\"\r\n";
+    question_field += "\r\n";
+    question_field += question + "\r\n";
+    http->Write(question_field.c_str(), question_field.size());
+    return http;
+}
+
+void Esp32Camera::WriteImagePart(Http* http, int index) {
+    // 文件字段头部，多张图片时第一张是最新的
+    std::string file_header;
+    if (index > 0) {
+        file_header += "\r\n";
+    }
+    file_header += "--" EXPLAIN_BOUNDARY "\r\n";
+    if (index == 0) {
+        file_header += "Content-Disposition: form-data; name=\"file\"; filename=\"camera.jpg\"\r\n";
+    } else {
+        file_header += "Content-Disposition: form-data; name=\"file\"; filename=\"camera_" + std::to_string(index) + ".jpg\"\r\n";
+    }
+    file_header += "Content-Type: image/jpeg\r\n";
+    file_header += "\r\n";
+    http->Write(file_header.c_str(), file_header.size());
+}
+
+std::string Esp32Camera::FinishExplainRequest(std::unique_ptr<Http> http) {
+    // multipart尾部
+    std::string multipart_footer;
+    multipart_footer += "\r\n--" EXPLAIN_BOUNDARY "--\r\n";
+    http->Write(multipart_footer.c_str(), multipart_footer.size());
+    // 结束块
+    http->Write("", 0);
+
+    if (http->GetStatusCode() != 200) {
+        ESP_LOGE(TAG, "Failed to upload photo, status code: %d", http->GetStatusCode());
+        return "{\"success\": false, \"message\": \"Failed to upload photo\"}";
+    }
+
+    std::string result = http->ReadAll();
+    http->Close();
+    return result;
+}
+
 /**
  * @brief 将摄像头捕获的图像发送到远程服务器进行AI分析和解释
  * 
@@ -171,10 +315,11 @@ bool Esp32Camera::SetVFlip(bool enabled) {
  * 问题对图像进行AI分析并返回结果。
  * 
  * 实现特点：
- * - 使用独立线程编码JPEG，与主线程分离
+ * - 摄像头输出 JPEG 时直接上传帧缓冲，不再重新编码
+ * - 其他格式边编码边写入 HTTP 请求体，不经过中间缓冲和拷贝
  * - 采用分块传输编码(chunked transfer encoding)优化内存使用
- * - 通过队列机制实现编码线程和发送线程的数据同步
  * - 支持设备ID、客户端ID和认证令牌的HTTP头部配置
+ * - 日志输出拍照、预览、连接、上传和等待响应各阶段的耗时
  * 
  * @param question 要向AI提出的关于图像的问题，将作为表单字段发送
  * @return std::string 服务器返回的JSON格式响应字符串
@@ -183,7 +328,7 @@ bool Esp32Camera::SetVFlip(bool enabled) {
  *                  {"success": false, "message": "错误信息"}
  * 
  * @note 调用此函数前必须先调用SetExplainUrl()设置服务器URL
- * @note 函数会等待之前的编码线程完成后再开始新的处理
+ * @note 连续视觉模式下上传最近的关键帧，不使用 Capture() 的结果
  * @warning 如果摄像头缓冲区为空或网络连接失败，将返回错误信息
  */
 std::string Esp32Camera::Explain(const std::string& question) {
@@ -191,115 +336,238 @@ std::string Esp32Camera::Explain(const std::string& question) {
         return "{\"success\": false, \"message\": \"Image explain URL or token is not set\"}";
     }
 
-    // 创建局部的 JPEG 队列, 40 entries is about to store 512 * 40 = 20480 bytes of JPEG data
-    QueueHandle_t jpeg_queue = xQueueCreate(40, sizeof(JpegChunk));
-    if (jpeg_queue == nullptr) {
-        ESP_LOGE(TAG, "Failed to create JPEG queue");
-        return "{\"success\": false, \"message\": \"Failed to create JPEG queue\"}";
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (continuous_vision_) {
+        return ExplainKeyframes(lock, question);
+    }
+    if (fb_ == nullptr) {
+        return "{\"success\": false, \"message\": \"No image captured\"}";
     }
 
-    // We spawn a thread to encode the image to JPEG
-    encoder_thread_ = std::thread([this, jpeg_queue]() {
-        frame2jpg_cb(fb_, 80, [](void* arg, size_t index, const void* data, size_t len) -> unsigned int {
-            auto jpeg_queue = (QueueHandle_t)arg;
-            JpegChunk chunk = {
-                .data = (uint8_t*)heap_caps_aligned_alloc(16, len, MALLOC_CAP_SPIRAM),
-                .len = len
-            };
-            memcpy(chunk.data, data, len);
-            xQueueSend(jpeg_queue, &chunk, portMAX_DELAY);
+    auto start_time = esp_timer_get_time();
+    auto http = OpenExplainRequest(question);
+    if (!http) {
+        return "{\"success\": false, \"message\": \"Failed to connect to explain URL\"}";
+    }
+    auto connected_time = esp_timer_get_time();
+    WriteImagePart(http.get(), 0);
+
+    // 第三块：JPEG数据
+    size_t total_sent = 0;
+    if (fb_->format == PIXFORMAT_JPEG) {
+        http->Write((const char*)fb_->buf, fb_->len);
+        total_sent = fb_->len;
+    } else {
+        struct EncodeContext {
+            Http* http;
+            size_t total_sent;
+        } context = { http.get(), 0 };
+        // The encoder output goes straight into the chunked request body
+        frame2jpg_cb(fb_, 80, [](void* arg, size_t index, const void* data, size_t len) -> size_t {
+            auto context = (EncodeContext*)arg;
+            if (data != nullptr && len > 0) {
+                context->http->Write((const char*)data, len);
+                context->total_sent += len;
+            }
             return len;
-        }, jpeg_queue);
-    });
+        }, &context);
+        total_sent = context.total_sent;
+    }
 
-    auto network = Board::GetInstance().GetNetwork();
-    auto http = network->CreateHttp(3);
-    // 构造multipart/form-data请求体
-    std::string boundary = "----ESP32_CAMERA_BOUNDARY";
+    auto uploaded_time = esp_timer_get_time();
+    std::string result = FinishExplainRequest(std::move(http));
+    auto end_time = esp_timer_get_time();
 
-    // 配置HTTP客户端，使用分块传输编码
-    http->SetHeader("Device-Id", SystemInfo::GetMacAddress().c_str());
-    http->SetHeader("Client-Id", Board::GetInstance().GetUuid().c_str());
-    if (!explain_token_.empty()) {
-        http->SetHeader("Authorization", "Bearer " + explain_token_);
+    // Get remain task stack size
+    size_t remain_stack_size = uxTaskGetStackHighWaterMark(nullptr);
+    ESP_LOGI(TAG, "Explain image size=%dx%d, compressed size=%d, remain stack size=%d, question=%s\n%s",
+        fb_->width, fb_->height, total_sent, remain_stack_size, question.c_str(), result.c_str());
+    ESP_LOGI(TAG, "Explain latency: capture %d ms, preview %d ms, connect %d ms, upload %d ms, response %d ms, "
+        "capture to response %d ms", capture_ms_, preview_ms_, int((connected_time - start_time) / 1000),
+        int((uploaded_time - connected_time) / 1000), int((end_time - uploaded_time) / 1000),
+        int((end_time - capture_time_) / 1000));
+    return result;
+}
+
+bool Esp32Camera::SetContinuousVision(bool enabled) {
+    std::lock_guard<std::mutex> control_lock(vision_control_mutex_);
+    if (enabled == continuous_vision_) {
+        return true;
     }
-    http->SetHeader("Content-Type", "multipart/form-data; boundary=" + boundary);
-    http->SetHeader("Transfer-Encoding", "chunked");
-    if (!http->Open("POST", explain_url_)) {
-        ESP_LOGE(TAG, "Failed to connect to explain URL");
-        // Clear the queue
-        encoder_thread_.join();
-        JpegChunk chunk;
-        while (xQueueReceive(jpeg_queue, &chunk, portMAX_DELAY) == pdPASS) {
-            if (chunk.data != nullptr) {
-                heap_caps_free(chunk.data);
-            } else {
-                break;
+    if (!enabled) {
+        // Wake the vision task from its wait and wait until it has finished its current step
+        continuous_vision_ = false;
+        xTaskNotifyGive(vision_task_);
+        xSemaphoreTake(vision_stopped_, portMAX_DELAY);
+        vision_task_ = nullptr;
+        std::lock_guard<std::mutex> lock(mutex_);
+        keyframes_.clear();
+        ESP_LOGI(TAG, "Continuous vision disabled");
+        return true;
+    }
+
+    continuous_vision_ = true;
+    if (xTaskCreate([](void* arg) {
+        auto self = static_cast<Esp32Camera*>(arg);
+        self->VisionLoop();
+        xSemaphoreGive(self->vision_stopped_);
+        vTaskDelete(NULL);
+    }, "vision", 6144, this, 2, &vision_task_) != pdPASS) {
+        ESP_LOGE(TAG, "Failed to create the vision task");
+        continuous_vision_ = false;
+        return false;
+    }
+    ESP_LOGI(TAG, "Continuous vision enabled");
+    return true;
+}
+
+void Esp32Camera::VisionLoop() {
+    while (continuous_vision_) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            VisionStep();
+        }
+        // Returns early when SetContinuousVision(false) notifies the task
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(VISION_INTERVAL_MS));
+    }
+}
+
+bool Esp32Camera::ComputeThumbnail(uint8_t* thumbnail) {
+    const uint16_t* pixels = (const uint16_t*)fb_->buf;
+    int width = fb_->width;
+    int height = fb_->height;
+    if (fb_->format == PIXFORMAT_JPEG) {
+        // Decode at 1/8 scale, plenty for a 32x24 thumbnail
+        width = fb_->width / 8;
+        height = fb_->height / 8;
+        // The frame size may change, e.g. after a sensor reconfiguration
+        size_t size = width * height * 2;
+        if (size > decode_buffer_size_) {
+            heap_caps_free(decode_buffer_);
+            decode_buffer_size_ = 0;
+            decode_buffer_ = (uint8_t*)heap_caps_malloc(size, MALLOC_CAP_SPIRAM);
+            if (decode_buffer_ == nullptr) {
+                ESP_LOGE(TAG, "Failed to allocate vision decode buffer");
+                return false;
             }
+            decode_buffer_size_ = size;
         }
-        vQueueDelete(jpeg_queue);
-        return "{\"success\": false, \"message\": \"Failed to connect to explain URL\"}";
+        if (!jpg2rgb565(fb_->buf, fb_->len, decode_buffer_, JPG_SCALE_8X)) {
+            ESP_LOGE(TAG, "Failed to decode JPEG frame for vision");
+            return false;
+        }
+        pixels = (const uint16_t*)decode_buffer_;
+    } else if (fb_->format != PIXFORMAT_RGB565) {
+        ESP_LOGE(TAG, "Unsupported pixel format for vision: %d", fb_->format);
+        return false;
     }
-    
-    {
-        // 第一块：question字段
-        std::string question_field;
-        question_field += "--" + boundary + "\r\n";
-        question_field += "Content-Disposition: form-data; name=\"question\"\r\n";
-        question_field += "\r\n";
-        question_field += question + "\r\n";
-        http->Write(question_field.c_str(), question_field.size());
-    }
-    {
-        // 第二块：文件字段头部
-        std::string file_header;
-        file_header += "--" + boundary + "\r\n";
-        file_header += "Content-Disposition: form-data; name=\"file\"; filename=\"camera.jpg\"\r\n";
-        file_header += "Content-Type: image/jpeg\r\n";
-        file_header += "\r\n";
-        http->Write(file_header.c_str(), file_header.size());
+
+    // Nearest sample per cell, big endian RGB565 to 8-bit luma
+    for (int y = 0; y < VISION_THUMBNAIL_HEIGHT; y++) {
+        auto row = pixels + (y * height / VISION_THUMBNAIL_HEIGHT) * width;
+        for (int x = 0; x < VISION_THUMBNAIL_WIDTH; x++) {
+            uint16_t pixel = __builtin_bswap16(row[x * width / VISION_THUMBNAIL_WIDTH]);
+            int r = (pixel >> 8) & 0xf8;
+            int g = (pixel >> 3) & 0xfc;
+            int b = (pixel << 3) & 0xf8;
+            *thumbnail++ = (r * 77 + g * 150 + b * 29) >> 8;
+        }
     }
+    return true;
+}
 
-    // 第三块：JPEG数据
-    size_t total_sent = 0;
-    while (true) {
-        JpegChunk chunk;
-        if (xQueueReceive(jpeg_queue, &chunk, portMAX_DELAY) != pdPASS) {
-            ESP_LOGE(TAG, "Failed to receive JPEG chunk");
-            break;
+// Grabs the latest frame and keeps it as a new JPEG keyframe if the scene changed.
+// Returns true if a keyframe was added.
+bool Esp32Camera::VisionStep() {
+    if (fb_ != nullptr) {
+        esp_camera_fb_return(fb_);
+    }
+    fb_ = esp_camera_fb_get();
+    if (fb_ == nullptr) {
+        ESP_LOGE(TAG, "Camera capture failed");
+        return false;
+    }
+
+    uint8_t thumbnail[VISION_THUMBNAIL_WIDTH * VISION_THUMBNAIL_HEIGHT];
+    if (!ComputeThumbnail(thumbnail)) {
+        return false;
+    }
+    int score = 255;
+    if (!keyframes_.empty()) {
+        int sum = 0;
+        for (size_t i = 0; i < sizeof(thumbnail); i++) {
+            sum += abs(thumbnail[i] - keyframe_thumbnail_[i]);
         }
-        if (chunk.data == nullptr) {
-            break; // The last chunk
+        score = sum / sizeof(thumbnail);
+    }
+    if (score < VISION_CHANGE_THRESHOLD) {
+        return false;
+    }
+
+    uint8_t* jpeg = nullptr;
+    size_t len = 0;
+    if (fb_->format == PIXFORMAT_JPEG) {
+        jpeg = (uint8_t*)heap_caps_malloc(fb_->len, MALLOC_CAP_SPIRAM);
+        if (jpeg == nullptr) {
+            ESP_LOGE(TAG, "Failed to allocate keyframe");
+            return false;
         }
-        http->Write((const char*)chunk.data, chunk.len);
-        total_sent += chunk.len;
-        heap_caps_free(chunk.data);
+        memcpy(jpeg, fb_->buf, fb_->len);
+        len = fb_->len;
+    } else if (!frame2jpg(fb_, 80, &jpeg, &len)) {
+        ESP_LOGE(TAG, "Failed to encode keyframe");
+        return false;
     }
-    // Wait for the encoder thread to finish
-    encoder_thread_.join();
-    // 清理队列
-    vQueueDelete(jpeg_queue);
+    VisionKeyframe keyframe = { std::shared_ptr<uint8_t>(jpeg, free), len, esp_timer_get_time() };
+    memcpy(keyframe_thumbnail_, thumbnail, sizeof(thumbnail));
+    keyframes_.push_back(keyframe);
+    if (keyframes_.size() > VISION_MAX_KEYFRAMES) {
+        keyframes_.pop_front();
+    }
+    ESP_LOGI(TAG, "Scene changed (score %d), keyframe %u bytes", score, keyframe.len);
+    return true;
+}
 
-    {
-        // 第四块：multipart尾部
-        std::string multipart_footer;
-        multipart_footer += "\r\n--" + boundary + "--\r\n";
-        http->Write(multipart_footer.c_str(), multipart_footer.size());
+std::string Esp32Camera::ExplainKeyframes(std::unique_lock<std::mutex>& lock, const std::string& question) {
+    auto start_time = esp_timer_get_time();
+    // Check the scene once more, the question may be about something that just appeared
+    bool changed = VisionStep();
+    if (keyframes_.empty()) {
+        return "{\"success\": false, \"message\": \"No image captured\"}";
     }
-    // 结束块
-    http->Write("", 0);
+    auto capture_time = esp_timer_get_time();
 
-    if (http->GetStatusCode() != 200) {
-        ESP_LOGE(TAG, "Failed to upload photo, status code: %d", http->GetStatusCode());
-        return "{\"success\": false, \"message\": \"Failed to upload photo\"}";
+    // Drop old scenes, but always keep the newest one
+    while (keyframes_.size() > 1 && capture_time - keyframes_.front().time > VISION_KEYFRAME_MAX_AGE_MS * 1000LL) {
+        keyframes_.pop_front();
     }
 
-    std::string result = http->ReadAll();
-    http->Close();
+    // Upload a copy, so that the vision task keeps capturing during the upload
+    auto keyframes = keyframes_;
+    lock.unlock();
 
-    // Get remain task stack size
-    size_t remain_stack_size = uxTaskGetStackHighWaterMark(nullptr);
-    ESP_LOGI(TAG, "Explain image size=%dx%d, compressed size=%d, remain stack size=%d, question=%s\n%s",
-        fb_->width, fb_->height, total_sent, remain_stack_size, question.c_str(), result.c_str());
+    auto http = OpenExplainRequest(question);
+    if (!http) {
+        return "{\"success\": false, \"message\": \"Failed to connect to explain URL\"}";
+    }
+    auto connected_time = esp_timer_get_time();
+
+    size_t total_sent = 0;
+    int index = 0;
+    for (auto it = keyframes.rbegin(); it != keyframes.rend(); ++it, ++index) {
+        WriteImagePart(http.get(), index);
+        http->Write((const char*)it->jpeg.get(), it->len);
+        total_sent += it->len;
+    }
+
+    auto uploaded_time = esp_timer_get_time();
+    std::string result = FinishExplainRequest(std::move(http));
+    auto end_time = esp_timer_get_time();
+
+    ESP_LOGI(TAG, "Explain %d keyframe(s)%s, size=%u, question=%s\n%s", index,
+        changed ? "" : " (reused last JPEG)", total_sent, question.c_str(), result.c_str());
+    ESP_LOGI(TAG, "Explain latency: capture %d ms, connect %d ms, upload %d ms, response %d ms",
+        int((capture_time - start_time) / 1000), int((connected_time - capture_time) / 1000),
+        int((uploaded_time - connected_time) / 1000), int((end_time - uploaded_time) / 1000));
     return result;
 }
@@ -3,26 +3,65 @@
 
 #include <esp_camera.h>
 #include <lvgl.h>
-#include <thread>
 #include <memory>
+#include <mutex>
+#include <deque>
+#include <atomic>
 
 #include <freertos/FreeRTOS.h>
-#include <freertos/queue.h>
+#include <freertos/task.h>
+#include <freertos/semphr.h>
+#include <http.h>
 
 #include "camera.h"
 
-struct JpegChunk {
-    uint8_t* data;
+// Continuous vision: luma thumbnail used for the change score
+#define VISION_THUMBNAIL_WIDTH 32
+#define VISION_THUMBNAIL_HEIGHT 24
+
+// The JPEG is shared so that an upload can keep it while the vision task drops it
+struct VisionKeyframe {
+    std::shared_ptr<uint8_t> jpeg;
     size_t len;
+    int64_t time;
 };
 
 class Esp32Camera : public Camera {
 private:
     camera_fb_t* fb_ = nullptr;
     lv_img_dsc_t preview_image_;
+    int frame_width_ = 0;
+    int frame_height_ = 0;
+    int preview_shift_ = -1;  // Preview is downscaled by 1 << preview_shift_, -1 before the first capture
     std::string explain_url_;
     std::string explain_token_;
-    std::thread encoder_thread_;
+    // Latency of the last capture, reported by Explain
+    int64_t capture_time_ = 0;
+    int capture_ms_ = 0;
+    int preview_ms_ = 0;
+
+    // Continuous vision mode, the frames are guarded by mutex_ together with fb_
+    std::mutex mutex_;
+    // Serializes SetContinuousVision, the vision task is started and stopped under it
+    std::mutex vision_control_mutex_;
+    TaskHandle_t vision_task_ = nullptr;
+    SemaphoreHandle_t vision_stopped_ = nullptr;  // Given by the vision task when it exits
+    std::atomic<bool> continuous_vision_{false};
+    std::deque<VisionKeyframe> keyframes_;
+    uint8_t keyframe_thumbnail_[VISION_THUMBNAIL_WIDTH * VISION_THUMBNAIL_HEIGHT];
+    uint8_t* decode_buffer_ = nullptr;  // 1/8 scale decode of JPEG frames for the thumbnail
+    size_t decode_buffer_size_ = 0;
+
+    bool InitializePreview();
+    void UpdatePreview();
+    void VisionLoop();
+    bool VisionStep();
+    // Called with mutex_ held by lock, which is released during the upload
+    std::string ExplainKeyframes(std::unique_lock<std::mutex>& lock, const std::string& question);
+    bool ComputeThumbnail(uint8_t* thumbnail);
+    std::unique_ptr<Http> OpenExplainRequest(const std::string& question);
+    void WriteImagePart(Http* http, int index);
+    std::string FinishExplainRequest(std::unique_ptr<Http> http);
 
 public:
     Esp32Camera(const camera_config_t& config);
@@ -34,6 +73,8 @@ public:
     virtual bool SetHMirror(bool enabled) override;
     virtual bool SetVFlip(bool enabled) override;
     virtual std::string Explain(const std::string& question);
+    virtual bool SetContinuousVision(bool enabled) override;
+    virtual bool IsContinuousVision() const override { return continuous_vision_; }
 };
 
 #endif // ESP32_CAMERA_H
\ No newline at end of file
@@ -11,6 +11,8 @@
 
 static const char *TAG = "Ml307Board";
 
+#define STANDBY_DETECT_RETRIES 10
+
 Ml307Board::Ml307Board(gpio_num_t tx_pin, gpio_num_t rx_pin, gpio_num_t dtr_pin) : tx_pin_(tx_pin), rx_pin_(rx_pin), dtr_pin_(dtr_pin) {
 }
 
@@ -23,28 +25,10 @@ void Ml307Board::StartNetwork() {
     auto display = Board::GetInstance().GetDisplay();
     display->SetStatus(Lang::Strings::DETECTING_MODULE);
 
-    while (true) {
-        modem_ = AtModem::Detect(tx_pin_, rx_pin_, dtr_pin_, 921600);
-        if (modem_ != nullptr) {
-            break;
-        }
+    while (!DetectModem()) {
         vTaskDelay(pdMS_TO_TICKS(1000));
     }
 
-    modem_->OnNetworkStateChanged([this, &application](bool network_ready) {
-        if (network_ready) {
-            ESP_LOGI(TAG, "Network is ready");
-        } else {
-            ESP_LOGE(TAG, "Network is down");
-            auto device_state = application.GetDeviceState();
-            if (device_state == kDeviceStateListening || device_state == kDeviceStateSpeaking) {
-                application.Schedule([this, &application]() {
-                    application.SetDeviceState(kDeviceStateIdle);
-                });
-            }
-        }
-    });
-
     // Wait for network ready
     display->SetStatus(Lang::Strings::REGISTERING_NETWORK);
     while (true) {
@@ -68,6 +52,64 @@ void Ml307Board::StartNetwork() {
     ESP_LOGI(TAG, "ML307 ICCID: %s", iccid.c_str());
 }
 
+bool Ml307Board::DetectModem() {
+    modem_ = AtModem::Detect(tx_pin_, rx_pin_, dtr_pin_, 921600);
+    if (modem_ == nullptr) {
+        return false;
+    }
+
+    modem_->OnNetworkStateChanged([this](bool network_ready) {
+        if (network_ready) {
+            ESP_LOGI(TAG, "Network is ready");
+        } else {
+            ESP_LOGE(TAG, "Network is down");
+            // A standby modem going down does not affect the conversation
+            auto& application = Application::GetInstance();
+            auto device_state = application.GetDeviceState();
+            if (Board::GetInstance().GetNetwork() == modem_.get() &&
+                (device_state == kDeviceStateListening || device_state == kDeviceStateSpeaking)) {
+                application.Schedule([&application]() {
+                    application.SetDeviceState(kDeviceStateIdle);
+                });
+            }
+        }
+    });
+    return true;
+}
+
+bool Ml307Board::StartStandbyNetwork() {
+    for (int i = 0; i < STANDBY_DETECT_RETRIES && !DetectModem(); i++) {
+        vTaskDelay(pdMS_TO_TICKS(1000));
+    }
+    if (modem_ == nullptr) {
+        ESP_LOGW(TAG, "ML307 not detected, no cellular standby");
+        return false;
+    }
+    auto result = modem_->WaitForNetworkReady();
+    if (result != NetworkStatus::Ready) {
+        ESP_LOGW(TAG, "ML307 standby failed to register: %d", (int)result);
+        return false;
+    }
+    SetStandby(true);
+    ESP_LOGI(TAG, "ML307 standby ready");
+    return true;
+}
+
+void Ml307Board::SetStandby(bool standby) {
+    // 没有接 DTR 的板子无法唤醒模块，备用时保持在线
+    if (modem_ == nullptr || dtr_pin_ == GPIO_NUM_NC) {
+        return;
+    }
+    if (standby) {
+        // Enable sleep mode, and sleep in 1 second after DTR is set to high
+        modem_->SetSleepMode(true, 1);
+        modem_->GetAtUart()->SetDtrPin(true);
+    } else {
+        // Set the DTR pin to low to wake the modem up before any AT command
+        modem_->GetAtUart()->SetDtrPin(false);
+    }
+}
+
 NetworkInterface* Ml307Board::GetNetwork() {
     return modem_.get();
 }
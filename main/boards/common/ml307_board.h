@@ -14,6 +14,7 @@ protected:
     gpio_num_t dtr_pin_;
 
     virtual std::string GetBoardJson() override;
+    bool DetectModem();
 
 public:
     Ml307Board(gpio_num_t tx_pin, gpio_num_t rx_pin, gpio_num_t dtr_pin = GPIO_NUM_NC);
@@ -24,6 +25,12 @@ public:
     virtual void SetPowerSaveMode(bool enabled) override;
     virtual AudioCodec* GetAudioCodec() override { return nullptr; }
     virtual std::string GetDeviceStatusJson() override;
+
+    // 作为备用网络启动：不更新界面，检测不到模块或注册失败时返回 false
+    bool StartStandbyNetwork();
+    // 备用时让模块休眠，需要 DTR 引脚唤醒，未接 DTR 时不做处理
+    void SetStandby(bool standby);
+    bool IsNetworkReady() const { return modem_ != nullptr && modem_->network_ready(); }
 };
 
 #endif // ML307_BOARD_H
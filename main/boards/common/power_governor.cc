@@ -0,0 +1,181 @@
+#include "power_governor.h"
+#include "application.h"
+#include "device_state_event.h"
+#include "metrics.h"
+
+#include <esp_log.h>
+
+#define TAG "PowerGovernor"
+
+// Log a power summary every 60 updates (1 minute)
+#define POWER_SUMMARY_INTERVAL 60
+
+PowerGovernor::PowerGovernor() {
+    // Rough estimates for an ESP32-S3 board with the speaker amplifier on,
+    // boards should override them with measured values
+    for (auto& current : state_current_ma_) {
+        current = 100;
+    }
+    state_current_ma_[kDeviceStateIdle] = 45;
+    state_current_ma_[kDeviceStateConnecting] = 120;
+    state_current_ma_[kDeviceStateListening] = 110;
+    state_current_ma_[kDeviceStateSpeaking] = 180;
+}
+
+PowerGovernor::~PowerGovernor() {
+    if (update_timer_ != nullptr) {
+        esp_timer_stop(update_timer_);
+        esp_timer_delete(update_timer_);
+    }
+    if (cpu_lock_ != nullptr) {
+        esp_pm_lock_delete(cpu_lock_);
+    }
+    if (apb_lock_ != nullptr) {
+        esp_pm_lock_delete(apb_lock_);
+    }
+}
+
+void PowerGovernor::Start(int max_freq_mhz) {
+    if (started_) {
+        return;
+    }
+    max_freq_mhz_ = max_freq_mhz;
+
+    // Create the locks first so the CPU does not slow down before the first update
+    auto ret = esp_pm_lock_create(ESP_PM_CPU_FREQ_MAX, 0, "governor_cpu", &cpu_lock_);
+    if (ret == ESP_ERR_NOT_SUPPORTED) {
+        ESP_LOGW(TAG, "Power management not supported");
+        return;
+    }
+    ESP_ERROR_CHECK(ret);
+    ESP_ERROR_CHECK(esp_pm_lock_create(ESP_PM_APB_FREQ_MAX, 0, "governor_apb", &apb_lock_));
+    esp_pm_lock_acquire(cpu_lock_);
+    cpu_lock_held_ = true;
+
+    esp_pm_config_t pm_config = {
+        .max_freq_mhz = max_freq_mhz_,
+        .min_freq_mhz = min_freq_mhz_,
+        .light_sleep_enable = false,
+    };
+    ret = esp_pm_configure(&pm_config);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to configure DFS: %s", esp_err_to_name(ret));
+        return;
+    }
+
+    last_account_time_ = esp_timer_get_time();
+    state_ = Application::GetInstance().GetDeviceState();
+    started_ = true;
+
+    DeviceStateEventManager::GetInstance().RegisterStateChangeCallback([this](DeviceState previous_state, DeviceState current_state) {
+        Update();
+    });
+
+    esp_timer_create_args_t timer_args = {
+        .callback = [](void* arg) {
+            auto self = static_cast<PowerGovernor*>(arg);
+            self->Update();
+        },
+        .arg = this,
+        .dispatch_method = ESP_TIMER_TASK,
+        .name = "power_governor",
+        .skip_unhandled_events = true,
+    };
+    ESP_ERROR_CHECK(esp_timer_create(&timer_args, &update_timer_));
+    ESP_ERROR_CHECK(esp_timer_start_periodic(update_timer_, 1000000));
+    ESP_LOGI(TAG, "Started, CPU %d-%d MHz", min_freq_mhz_, max_freq_mhz_);
+}
+
+void PowerGovernor::SetStateCurrent(DeviceState state, int milliamps) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    state_current_ma_[state] = milliamps;
+}
+
+void PowerGovernor::SetLightSleepCurrent(int milliamps) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    light_sleep_current_ma_ = milliamps;
+}
+
+void PowerGovernor::OnLightSleepChanged(bool light_sleep) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        Account(esp_timer_get_time());
+        light_sleep_ = light_sleep;
+    }
+    // Held locks would keep the chip out of light sleep, re-evaluate now
+    // instead of waiting for the next tick
+    if (started_) {
+        Update();
+    }
+}
+
+void PowerGovernor::Account(int64_t now) {
+    if (last_account_time_ == 0) {
+        last_account_time_ = now;
+        return;
+    }
+    int64_t elapsed = now - last_account_time_;
+    last_account_time_ = now;
+    if (light_sleep_) {
+        light_sleep_us_ += elapsed;
+        charge_mas_ += light_sleep_current_ma_ * elapsed / 1000000.0;
+    } else {
+        time_in_state_us_[state_] += elapsed;
+        charge_mas_ += state_current_ma_[state_] * elapsed / 1000000.0;
+    }
+}
+
+void PowerGovernor::Update() {
+    auto& app = Application::GetInstance();
+    auto& audio_service = app.GetAudioService();
+    auto state = app.GetDeviceState();
+    // Prompt sounds and late TTS frames can still be in the queues after going idle
+    bool busy = (state != kDeviceStateIdle && state != kDeviceStateFatalError) || !audio_service.IsIdle();
+    // The wake word engine needs a stable APB clock for I2S, but not the full CPU speed
+    bool listening = !busy && audio_service.IsWakeWordRunning();
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto now = esp_timer_get_time();
+    Account(now);
+    state_ = state;
+
+    if (busy != cpu_lock_held_) {
+        if (busy) {
+            esp_pm_lock_acquire(cpu_lock_);
+        } else {
+            esp_pm_lock_release(cpu_lock_);
+        }
+        cpu_lock_held_ = busy;
+    }
+    if (listening != apb_lock_held_) {
+        if (listening) {
+            esp_pm_lock_acquire(apb_lock_);
+        } else {
+            esp_pm_lock_release(apb_lock_);
+        }
+        apb_lock_held_ = listening;
+    }
+
+    int64_t idle_us = time_in_state_us_[kDeviceStateIdle];
+    int64_t active_us = 0;
+    int64_t total_us = light_sleep_us_;
+    for (int i = 0; i <= kDeviceStateFatalError; i++) {
+        total_us += time_in_state_us_[i];
+        if (i != kDeviceStateIdle) {
+            active_us += time_in_state_us_[i];
+        }
+    }
+    int average_ma = total_us > 0 ? charge_mas_ * 1000000.0 / total_us : 0;
+
+    auto& metrics = Metrics::GetInstance();
+    metrics.SetGauge(kMetricActiveSeconds, active_us / 1000000);
+    metrics.SetGauge(kMetricIdleSeconds, idle_us / 1000000);
+    metrics.SetGauge(kMetricLightSleepSeconds, light_sleep_us_ / 1000000);
+    metrics.SetGauge(kMetricAverageCurrentMa, average_ma);
+
+    if (++update_count_ % POWER_SUMMARY_INTERVAL == 0) {
+        ESP_LOGI(TAG, "active %llds, idle %llds, light sleep %llds, avg %d mA, lock %s",
+            active_us / 1000000, idle_us / 1000000, light_sleep_us_ / 1000000, average_ma,
+            cpu_lock_held_ ? "cpu" : (apb_lock_held_ ? "apb" : "none"));
+    }
+}
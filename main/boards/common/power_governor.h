@@ -0,0 +1,66 @@
+#pragma once
+
+#include <mutex>
+
+#include <esp_timer.h>
+#include <esp_pm.h>
+
+#include "device_state.h"
+
+// Activity-aware power governor (CONFIG_USE_POWER_GOVERNOR).
+// Dynamic frequency scaling stays on all the time, the governor only holds
+// PM locks while the device is busy:
+//   - conversation states (connecting / listening / speaking ...): CPU max
+//   - audio queues not empty (prompt playback while idle): CPU max
+//   - idle with wake word running: APB max, keeps >= 80 MHz for the wake word
+//   - idle without wake word: no lock, the CPU drops to the minimum frequency
+// Light sleep is still entered by PowerSaveTimer once the wake word is stopped.
+// It also accumulates time-in-state and an estimated charge from a per-state
+// current table, published through Metrics.
+class PowerGovernor {
+public:
+    static PowerGovernor& GetInstance() {
+        static PowerGovernor instance;
+        return instance;
+    }
+    // 删除拷贝构造函数和赋值运算符
+    PowerGovernor(const PowerGovernor&) = delete;
+    PowerGovernor& operator=(const PowerGovernor&) = delete;
+
+    void Start(int max_freq_mhz = CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ);
+    bool started() const { return started_; }
+    int min_freq_mhz() const { return min_freq_mhz_; }
+
+    // Boards can calibrate the estimate with measured currents
+    void SetStateCurrent(DeviceState state, int milliamps);
+    void SetLightSleepCurrent(int milliamps);
+    // Called by PowerSaveTimer when it enters / exits light sleep
+    void OnLightSleepChanged(bool light_sleep);
+
+private:
+    PowerGovernor();
+    ~PowerGovernor();
+
+    void Update();
+    void Account(int64_t now);
+
+    std::mutex mutex_;
+    bool started_ = false;
+    int max_freq_mhz_ = CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ;
+    int min_freq_mhz_ = 40;
+    esp_timer_handle_t update_timer_ = nullptr;
+    esp_pm_lock_handle_t cpu_lock_ = nullptr;
+    esp_pm_lock_handle_t apb_lock_ = nullptr;
+    bool cpu_lock_held_ = false;
+    bool apb_lock_held_ = false;
+    bool light_sleep_ = false;
+    int update_count_ = 0;
+
+    DeviceState state_ = kDeviceStateUnknown;
+    int64_t last_account_time_ = 0;
+    int64_t time_in_state_us_[kDeviceStateFatalError + 1] = {};
+    int64_t light_sleep_us_ = 0;
+    double charge_mas_ = 0;  // milliamp-seconds
+    int state_current_ma_[kDeviceStateFatalError + 1];
+    int light_sleep_current_ma_ = 5;
+};
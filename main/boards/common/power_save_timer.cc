@@ -1,6 +1,7 @@
 #include "power_save_timer.h"
 #include "application.h"
 #include "settings.h"
+#include "power_governor.h"
 
 #include <esp_log.h>
 
@@ -95,10 +96,12 @@ void PowerSaveTimer::PowerSaveCheck() {
                     .light_sleep_enable = true,
                 };
                 esp_pm_configure(&pm_config);
+                PowerGovernor::GetInstance().OnLightSleepChanged(true);
             }
         }
     }
     if (seconds_to_shutdown_ != -1 && ticks_ >= seconds_to_shutdown_ && on_shutdown_request_) {
+        Settings::Flush();
         on_shutdown_request_();
     }
 }
@@ -110,12 +113,15 @@ void PowerSaveTimer::WakeUp() {
         in_sleep_mode_ = false;
 
         if (cpu_max_freq_ != -1) {
+            // Keep DFS on if the governor is running, it raises the frequency with PM locks
+            auto& governor = PowerGovernor::GetInstance();
             esp_pm_config_t pm_config = {
                 .max_freq_mhz = cpu_max_freq_,
-                .min_freq_mhz = cpu_max_freq_,
+                .min_freq_mhz = governor.started() ? governor.min_freq_mhz() : cpu_max_freq_,
                 .light_sleep_enable = false,
             };
             esp_pm_configure(&pm_config);
+            governor.OnLightSleepChanged(false);
 
             // Enable wake word detection
             auto& app = Application::GetInstance();
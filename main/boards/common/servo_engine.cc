@@ -0,0 +1,144 @@
+#include "servo_engine.h"
+
+#include <esp_log.h>
+#include <algorithm>
+#include <cmath>
+
+#define TAG "ServoEngine"
+
+// Entries per turn, interpolated linearly between entries
+#define SINE_TABLE_SIZE 256
+
+static int16_t sine_table[SINE_TABLE_SIZE + 1];
+
+ServoEngine::ServoEngine(int servo_count, std::function<int(int servo)> read_position,
+                         std::function<void(const int* positions)> write_positions)
+    : servo_count_(servo_count), read_position_(read_position), write_positions_(write_positions) {
+    if (servo_count_ > SERVO_ENGINE_MAX_SERVOS) {
+        ESP_LOGE(TAG, "Too many servos: %d", servo_count_);
+        servo_count_ = SERVO_ENGINE_MAX_SERVOS;
+    }
+    if (sine_table[SINE_TABLE_SIZE / 4] == 0) {
+        for (int i = 0; i <= SINE_TABLE_SIZE; i++) {
+            sine_table[i] = (int16_t)std::lround(std::sin(2 * M_PI * i / SINE_TABLE_SIZE) * 32767);
+        }
+    }
+
+    segment_queue_ = xQueueCreate(2, sizeof(ServoSegment));
+    idle_semaphore_ = xSemaphoreCreateBinary();
+
+    esp_timer_create_args_t timer_args = {
+        .callback = [](void* arg) {
+            auto self = static_cast<ServoEngine*>(arg);
+            self->Tick();
+        },
+        .arg = this,
+        .dispatch_method = ESP_TIMER_TASK,
+        .name = "servo_engine",
+        .skip_unhandled_events = true,
+    };
+    ESP_ERROR_CHECK(esp_timer_create(&timer_args, &timer_));
+}
+
+ServoEngine::~ServoEngine() {
+    if (timer_ != nullptr) {
+        esp_timer_stop(timer_);
+        esp_timer_delete(timer_);
+    }
+    if (segment_queue_ != nullptr) {
+        vQueueDelete(segment_queue_);
+    }
+    if (idle_semaphore_ != nullptr) {
+        vSemaphoreDelete(idle_semaphore_);
+    }
+}
+
+uint16_t ServoEngine::PhaseFromRadians(double radians) {
+    double turns = radians / (2 * M_PI);
+    turns -= std::floor(turns);
+    return (uint16_t)(turns * 65536);
+}
+
+void ServoEngine::Run(const ServoSegment& segment) {
+    if (segment.duration_ms < SERVO_ENGINE_TICK_MS / 2) {
+        return;
+    }
+    xQueueSend(segment_queue_, &segment, portMAX_DELAY);
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!esp_timer_is_active(timer_)) {
+            xSemaphoreTake(idle_semaphore_, 0);
+            ESP_ERROR_CHECK(esp_timer_start_periodic(timer_, SERVO_ENGINE_TICK_MS * 1000));
+        }
+    }
+    xSemaphoreTake(idle_semaphore_, portMAX_DELAY);
+}
+
+int ServoEngine::Sin(uint32_t phase) {
+    // 8 bits table index, 16 bits for linear interpolation
+    uint32_t index = phase >> 24;
+    int32_t fraction = (phase >> 8) & 0xffff;
+    int32_t a = sine_table[index];
+    int32_t b = sine_table[index + 1];
+    return a + (((b - a) * fraction) >> 16);
+}
+
+int ServoEngine::Evaluate(int servo, uint32_t tick) const {
+    const ServoTrack& track = segment_.tracks[servo];
+    if (!track.oscillate) {
+        int diff = track.target - start_[servo];
+        return start_[servo] + (diff * (int)tick + (diff >= 0 ? 1 : -1) * (int)total_ticks_ / 2) / (int)total_ticks_;
+    }
+    uint32_t phase = ((uint32_t)track.phase << 16) + tick * phase_increment_;
+    return track.offset + ((track.amplitude * Sin(phase) + (1 << 14)) >> 15);
+}
+
+bool ServoEngine::StartNextSegment() {
+    if (xQueueReceive(segment_queue_, &segment_, 0) != pdTRUE) {
+        return false;
+    }
+    tick_ = 0;
+    total_ticks_ = std::max<uint32_t>(1, (segment_.duration_ms + SERVO_ENGINE_TICK_MS / 2) / SERVO_ENGINE_TICK_MS);
+    phase_increment_ = segment_.period_ms > 0 ?
+        (uint32_t)((1ULL << 32) * SERVO_ENGINE_TICK_MS / segment_.period_ms) : 0;
+    for (int i = 0; i < servo_count_; i++) {
+        start_[i] = read_position_(i);
+        positions_[i] = start_[i];
+        blend_[i] = 0;
+        if (segment_.tracks[i].active && segment_.tracks[i].oscillate) {
+            blend_[i] = start_[i] - Evaluate(i, 0);
+        }
+    }
+    return true;
+}
+
+void ServoEngine::Tick() {
+    if (!playing_) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!StartNextSegment()) {
+            // Nothing left to play, stop ticking until the next Run
+            esp_timer_stop(timer_);
+            xSemaphoreGive(idle_semaphore_);
+            return;
+        }
+        playing_ = true;
+    }
+
+    tick_++;
+    for (int i = 0; i < servo_count_; i++) {
+        if (!segment_.tracks[i].active) {
+            continue;
+        }
+        int position = Evaluate(i, tick_);
+        if (tick_ < SERVO_ENGINE_BLEND_TICKS) {
+            position += blend_[i] * (int)(SERVO_ENGINE_BLEND_TICKS - tick_) / SERVO_ENGINE_BLEND_TICKS;
+        }
+        positions_[i] = position;
+    }
+    write_positions_(positions_);
+
+    if (tick_ >= total_ticks_) {
+        // Chain the next segment on the next tick without a gap
+        playing_ = false;
+    }
+}
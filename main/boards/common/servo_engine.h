@@ -0,0 +1,75 @@
+#ifndef SERVO_ENGINE_H
+#define SERVO_ENGINE_H
+
+#include <functional>
+#include <mutex>
+
+#include <esp_timer.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/queue.h>
+#include <freertos/semphr.h>
+
+#define SERVO_ENGINE_TICK_MS 10
+#define SERVO_ENGINE_MAX_SERVOS 8
+// Oscillations start from the current pose and fade into the trajectory
+#define SERVO_ENGINE_BLEND_TICKS 10
+
+// One servo of a motion segment, positions in degrees (90 = center)
+struct ServoTrack {
+    bool active;        // false: the servo keeps its position
+    bool oscillate;     // true: offset + amplitude * sin(phase), false: linear move to target
+    int16_t target;
+    int16_t amplitude;
+    int16_t offset;
+    uint16_t phase;     // Start phase, 65536 = one turn
+};
+
+// A keyframe trajectory for all servos, built by the movement functions and
+// played by the engine without any work on the calling task
+struct ServoSegment {
+    uint32_t duration_ms;
+    uint32_t period_ms;  // Oscillation period
+    ServoTrack tracks[SERVO_ENGINE_MAX_SERVOS];
+};
+
+// Plays servo segments from a single periodic timer. Every tick evaluates all
+// tracks with a sine table and integer interpolation, then hands the positions
+// of all servos to the board in one call so the PWM duties are updated together.
+class ServoEngine {
+public:
+    // read_position returns the current position of a servo,
+    // write_positions receives servo_count positions every tick
+    ServoEngine(int servo_count, std::function<int(int servo)> read_position,
+                std::function<void(const int* positions)> write_positions);
+    ~ServoEngine();
+
+    // Queues a segment and blocks until all queued segments are played
+    void Run(const ServoSegment& segment);
+
+    static uint16_t PhaseFromRadians(double radians);
+
+private:
+    void Tick();
+    bool StartNextSegment();
+    int Evaluate(int servo, uint32_t tick) const;
+    static int Sin(uint32_t phase);
+
+    int servo_count_;
+    std::function<int(int)> read_position_;
+    std::function<void(const int*)> write_positions_;
+    esp_timer_handle_t timer_ = nullptr;
+    QueueHandle_t segment_queue_ = nullptr;
+    SemaphoreHandle_t idle_semaphore_ = nullptr;
+    std::mutex mutex_;
+
+    bool playing_ = false;
+    ServoSegment segment_;
+    uint32_t tick_ = 0;
+    uint32_t total_ticks_ = 0;
+    uint32_t phase_increment_ = 0;
+    int start_[SERVO_ENGINE_MAX_SERVOS] = {};
+    int blend_[SERVO_ENGINE_MAX_SERVOS] = {};
+    int positions_[SERVO_ENGINE_MAX_SERVOS] = {};
+};
+
+#endif // SERVO_ENGINE_H
@@ -7,6 +7,7 @@
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "oscillator.h"
+#include "servo_engine.h"
 
 //-- Constants
 #define FORWARD 1
@@ -76,14 +77,14 @@ private:
     int servo_trim_[SERVO_COUNT];
     int servo_initial_[SERVO_COUNT] = {180, 180, 0, 0, 90, 90};
 
-    unsigned long final_time_;
-    unsigned long partial_time_;
-    float increment_[SERVO_COUNT];
+    // Plays MoveServos / OscillateServos trajectories from one timer
+    ServoEngine engine_;
 
     bool is_otto_resting_;
 
     void Execute(int amplitude[SERVO_COUNT], int offset[SERVO_COUNT], int period,
                  double phase_diff[SERVO_COUNT], float steps);
+    void WriteServos(const int* positions);
 };
 
 #endif  // __MOVEMENTS_H__
\ No newline at end of file
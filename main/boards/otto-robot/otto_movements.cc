@@ -8,7 +8,10 @@ static const char* TAG = "OttoMovements";
 
 #define HAND_HOME_POSITION 45
 
-Otto::Otto() {
+Otto::Otto()
+    : engine_(SERVO_COUNT,
+              [this](int servo) { return servo_pins_[servo] != -1 ? servo_[servo].GetPosition() : 90; },
+              [this](const int* positions) { WriteServos(positions); }) {
     is_otto_resting_ = false;
     has_hands_ = false;
     // 初始化所有舵机管脚为-1（未连接）
@@ -91,31 +94,15 @@ void Otto::MoveServos(int time, int servo_target[]) {
         SetRestState(false);
     }
 
-    final_time_ = millis() + time;
-    if (time > 10) {
-        for (int i = 0; i < SERVO_COUNT; i++) {
-            if (servo_pins_[i] != -1) {
-                increment_[i] = (servo_target[i] - servo_[i].GetPosition()) / (time / 10.0);
-            }
-        }
-
-        for (int iteration = 1; millis() < final_time_; iteration++) {
-            partial_time_ = millis() + 10;
-            for (int i = 0; i < SERVO_COUNT; i++) {
-                if (servo_pins_[i] != -1) {
-                    servo_[i].SetPosition(servo_[i].GetPosition() + increment_[i]);
-                }
-            }
-            vTaskDelay(pdMS_TO_TICKS(10));
-        }
-    } else {
-        for (int i = 0; i < SERVO_COUNT; i++) {
-            if (servo_pins_[i] != -1) {
-                servo_[i].SetPosition(servo_target[i]);
-            }
+    ServoSegment segment = {};
+    segment.duration_ms = std::max(time, SERVO_ENGINE_TICK_MS);
+    for (int i = 0; i < SERVO_COUNT; i++) {
+        if (servo_pins_[i] != -1) {
+            segment.tracks[i].active = true;
+            segment.tracks[i].target = servo_target[i];
         }
-        vTaskDelay(pdMS_TO_TICKS(time));
     }
+    engine_.Run(segment);
 
     // final adjustment to the target.
     bool f = true;
@@ -155,29 +142,36 @@ void Otto::MoveSingle(int position, int servo_number) {
     }
 }
 
-void Otto::OscillateServos(int amplitude[SERVO_COUNT], int offset[SERVO_COUNT], int period,
-                           double phase_diff[SERVO_COUNT], float cycle = 1) {
+// Called by the servo engine every tick: set all duties first, then latch them together
+void Otto::WriteServos(const int* positions) {
     for (int i = 0; i < SERVO_COUNT; i++) {
         if (servo_pins_[i] != -1) {
-            servo_[i].SetO(offset[i]);
-            servo_[i].SetA(amplitude[i]);
-            servo_[i].SetT(period);
-            servo_[i].SetPh(phase_diff[i]);
+            servo_[i].Write(positions[i]);
         }
     }
+    for (int i = 0; i < SERVO_COUNT; i++) {
+        if (servo_pins_[i] != -1) {
+            servo_[i].Update();
+        }
+    }
+}
 
-    double ref = millis();
-    double end_time = period * cycle + ref;
-
-    while (millis() < end_time) {
-        for (int i = 0; i < SERVO_COUNT; i++) {
-            if (servo_pins_[i] != -1) {
-                servo_[i].Refresh();
-            }
+void Otto::OscillateServos(int amplitude[SERVO_COUNT], int offset[SERVO_COUNT], int period,
+                           double phase_diff[SERVO_COUNT], float cycle = 1) {
+    ServoSegment segment = {};
+    segment.duration_ms = period * cycle;
+    segment.period_ms = period;
+    for (int i = 0; i < SERVO_COUNT; i++) {
+        if (servo_pins_[i] != -1) {
+            int sign = servo_[i].IsReversed() ? -1 : 1;
+            segment.tracks[i].active = true;
+            segment.tracks[i].oscillate = true;
+            segment.tracks[i].amplitude = sign * amplitude[i];
+            segment.tracks[i].offset = 90 + sign * offset[i];
+            segment.tracks[i].phase = ServoEngine::PhaseFromRadians(phase_diff[i]);
         }
-        vTaskDelay(5);
     }
-    vTaskDelay(pdMS_TO_TICKS(10));
+    engine_.Run(segment);
 }
 
 void Otto::Execute(int amplitude[SERVO_COUNT], int offset[SERVO_COUNT], int period,
@@ -186,16 +180,8 @@ void Otto::Execute(int amplitude[SERVO_COUNT], int offset[SERVO_COUNT], int peri
         SetRestState(false);
     }
 
-    int cycles = (int)steps;
-
-    //-- Execute complete cycles
-    if (cycles >= 1)
-        for (int i = 0; i < cycles; i++)
-            OscillateServos(amplitude, offset, period, phase_diff);
-
-    //-- Execute the final not complete cycle
-    OscillateServos(amplitude, offset, period, phase_diff, (float)steps - cycles);
-    vTaskDelay(pdMS_TO_TICKS(10));
+    //-- All cycles, including the final not complete one, as a single trajectory
+    OscillateServos(amplitude, offset, period, phase_diff, steps);
 }
 
 ///////////////////////////////////////////////////////////////////
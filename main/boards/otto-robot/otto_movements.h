@@ -7,6 +7,7 @@
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "oscillator.h"
+#include "servo_engine.h"
 
 //-- Constants
 #define FORWARD 1
@@ -91,15 +92,15 @@ private:
     int servo_pins_[SERVO_COUNT];
     int servo_trim_[SERVO_COUNT];
 
-    unsigned long final_time_;
-    unsigned long partial_time_;
-    float increment_[SERVO_COUNT];
+    // Plays MoveServos / OscillateServos trajectories from one timer
+    ServoEngine engine_;
 
     bool is_otto_resting_;
     bool has_hands_;  // 是否有手部舵机
 
     void Execute(int amplitude[SERVO_COUNT], int offset[SERVO_COUNT], int period,
                  double phase_diff[SERVO_COUNT], float steps);
+    void WriteServos(const int* positions);
 };
 
 #endif  // __OTTO_MOVEMENTS_H__
\ No newline at end of file
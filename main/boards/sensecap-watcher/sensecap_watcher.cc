@@ -9,6 +9,7 @@
 #include "led/single_led.h"
 #include "power_save_timer.h"
 #include "sscma_camera.h"
+#include "settings.h"
 
 #include <esp_log.h>
 #include "esp_check.h"
@@ -277,6 +278,7 @@ private:
             if (self->long_press_cnt_ > 400) {
                 ESP_LOGI(TAG, "Factory reset");
                 nvs_flash_erase();
+                Settings::Invalidate();
                 esp_restart();
             }
         }, this);
@@ -469,6 +471,7 @@ private:
             .argtable = NULL,
             .func_w_context = [](void *context,int argc, char** argv) -> int {
                 nvs_flash_erase();
+                Settings::Invalidate();
                 esp_restart();
                 return 0;
             },
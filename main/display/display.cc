@@ -149,6 +149,14 @@ void Display::UpdateStatusBar(bool update_all) {
             };
             icon = levels[battery_level / 20];
         }
+
+        // 电量过低时立即提交缓存的设置，避免掉电丢失
+        static bool low_battery_flushed = false;
+        bool low_battery = discharging && battery_level < 20;
+        if (low_battery && !low_battery_flushed) {
+            Settings::Flush();
+        }
+        low_battery_flushed = low_battery;
         DisplayLockGuard lock(this);
         if (battery_label_ != nullptr && battery_icon_ != icon) {
             battery_icon_ = icon;
@@ -13,9 +13,40 @@
 #include <cstring>
 
 #include "board.h"
+#if CONFIG_USE_ASSET_BUNDLE
+#include "asset_bundle.h"
+#include <map>
+#endif
 
 #define TAG "LcdDisplay"
 
+LV_IMG_DECLARE(LOGO);
+
+#if CONFIG_USE_ASSET_BUNDLE
+// GIF 表情打包在 assets 分区中，通过 mmap 零拷贝读取，不再编译进固件
+static const lv_img_dsc_t* GetGifAsset(const char* name) {
+    static std::map<std::string, lv_img_dsc_t> gifs;
+    auto it = gifs.find(name);
+    if (it != gifs.end()) {
+        return &it->second;
+    }
+
+    auto& bundle = AssetBundle::GetInstance();
+    auto entry = bundle.Find(name);
+    if (entry == nullptr) {
+        ESP_LOGW(TAG, "GIF %s not found in asset bundle", name);
+        return nullptr;
+    }
+    lv_img_dsc_t dsc = {};
+    dsc.header.cf = LV_COLOR_FORMAT_RAW;
+    dsc.header.w = entry->width;
+    dsc.header.h = entry->height;
+    dsc.data_size = entry->size;
+    dsc.data = bundle.GetData(entry);
+    return &gifs.emplace(name, dsc).first->second;
+}
+#define GIF_ASSET(symbol, name) GetGifAsset(name)
+#else
 LV_IMG_DECLARE(idle1);
 LV_IMG_DECLARE(idle2);
 LV_IMG_DECLARE(happy);
@@ -23,9 +54,10 @@ LV_IMG_DECLARE(anger);
 LV_IMG_DECLARE(gif_listen);
 LV_IMG_DECLARE(sleep1);
 LV_IMG_DECLARE(sleep2);
-LV_IMG_DECLARE(LOGO);
 LV_IMG_DECLARE(buxie);
 LV_IMG_DECLARE(love);
+#define GIF_ASSET(symbol, name) (&symbol)
+#endif
 
 
 
@@ -908,8 +940,9 @@ void LcdDisplay::SetupUI() {
         if (overlay_container != nullptr) {
             lv_obj_clear_flag(overlay_container, LV_OBJ_FLAG_HIDDEN);
         }
-        if (gif_label_ != nullptr) {
-            lv_gif_set_src(gif_label_, &idle2);
+        auto idle_gif = GIF_ASSET(idle2, "idle2");
+        if (gif_label_ != nullptr && idle_gif != nullptr) {
+            lv_gif_set_src(gif_label_, idle_gif);
             lv_obj_clear_flag(gif_label_, LV_OBJ_FLAG_HIDDEN);
         }
         if (preview_image_ != nullptr) {
@@ -1005,24 +1038,24 @@ void LcdDisplay::SetEmotion(const char* emotion) {
         };
        
         static const std::vector<Emotion> emotions = {
-            {&idle2, "neutral"},
-            {&idle1, "idle1"},
-            {&idle2, "idle2"},
-            {&sleep1, "sleepy"},
-            {&sleep1, "sleep1"},
-            {&sleep2, "sleep2"},
-            {&gif_listen, "listen"},
-            {&happy, "happy"},
-            {&anger, "angry"},
-            {&happy, "laughing"},
-            {&happy, "funny"},
-            {&happy, "loving"},
-            {&happy, "delicious"},
-            {&love, "kissy"},
-            {&buxie, "thinking"},
-            {&buxie, "silly"},
-            {&buxie, "winking"},
-            {&love, "loving"}
+            {GIF_ASSET(idle2, "idle2"), "neutral"},
+            {GIF_ASSET(idle1, "idle1"), "idle1"},
+            {GIF_ASSET(idle2, "idle2"), "idle2"},
+            {GIF_ASSET(sleep1, "sleep1"), "sleepy"},
+            {GIF_ASSET(sleep1, "sleep1"), "sleep1"},
+            {GIF_ASSET(sleep2, "sleep2"), "sleep2"},
+            {GIF_ASSET(gif_listen, "listen"), "listen"},
+            {GIF_ASSET(happy, "happy"), "happy"},
+            {GIF_ASSET(anger, "anger"), "angry"},
+            {GIF_ASSET(happy, "happy"), "laughing"},
+            {GIF_ASSET(happy, "happy"), "funny"},
+            {GIF_ASSET(happy, "happy"), "loving"},
+            {GIF_ASSET(happy, "happy"), "delicious"},
+            {GIF_ASSET(love, "love"), "kissy"},
+            {GIF_ASSET(buxie, "buxie"), "thinking"},
+            {GIF_ASSET(buxie, "buxie"), "silly"},
+            {GIF_ASSET(buxie, "buxie"), "winking"},
+            {GIF_ASSET(love, "love"), "loving"}
         };
             
             
@@ -1034,11 +1067,11 @@ void LcdDisplay::SetEmotion(const char* emotion) {
             return;
         }
         
-        if (it != emotions.end()) {
-            lv_gif_set_src(gif_label_, it->gif);
-        } else {
-            lv_gif_set_src(gif_label_, &idle2);
-        } 
+        auto gif = it != emotions.end() ? it->gif : GIF_ASSET(idle2, "idle2");
+        if (gif == nullptr) {
+            return;
+        }
+        lv_gif_set_src(gif_label_, gif);
 
         lv_obj_clear_flag(gif_label_, LV_OBJ_FLAG_HIDDEN);
 
@@ -1,16 +1,84 @@
 #include "circular_strip.h"
 #include "application.h"
 #include <esp_log.h>
+#include <algorithm>
+#include <cmath>
 
 #define TAG "CircularStrip"
 
-#define BLINK_INFINITE -1
+#define STRIP_GAMMA 2.2
+
+// Color of a state script, each channel is a brightness level
+// resolved with SetBrightness: 0 = off, 1 = low, 2 = default
+struct StripLevelColor {
+    uint8_t red, green, blue;
+};
+
+struct StripScriptLayer {
+    StripEffectType type;
+    StripLevelColor low;
+    StripLevelColor high;
+    int period_ms;
+    int length;
+    StripBlendMode blend;
+};
+
+struct StripStateScript {
+    DeviceState state;
+    StripScriptLayer layers[STRIP_MAX_LAYERS];
+};
+
+// 每个设备状态的灯效，聆听时在底色上叠加随说话音量变化的光环
+static const StripStateScript kStateScripts[] = {
+    { kDeviceStateStarting,        { { kStripEffectScroll,  { 0, 0, 0 }, { 1, 1, 2 }, 100, 3, kStripBlendReplace } } },
+    { kDeviceStateWifiConfiguring, { { kStripEffectBlink,   { 0, 0, 0 }, { 1, 1, 2 }, 500, 0, kStripBlendReplace } } },
+    { kDeviceStateIdle,            { { kStripEffectFadeOut, { 0, 0, 0 }, { 0, 0, 0 }, 300, 0, kStripBlendReplace } } },
+    { kDeviceStateConnecting,      { { kStripEffectSolid,   { 0, 0, 0 }, { 1, 1, 2 }, 0,   0, kStripBlendReplace } } },
+    { kDeviceStateListening,       { { kStripEffectSolid,   { 0, 0, 0 }, { 2, 1, 1 }, 0,   0, kStripBlendReplace },
+                                     { kStripEffectLevel,   { 0, 0, 0 }, { 2, 2, 1 }, 0,   0, kStripBlendMax } } },
+    { kDeviceStateAudioTesting,    { { kStripEffectSolid,   { 0, 0, 0 }, { 2, 1, 1 }, 0,   0, kStripBlendReplace } } },
+    { kDeviceStateSpeaking,        { { kStripEffectSolid,   { 0, 0, 0 }, { 1, 2, 1 }, 0,   0, kStripBlendReplace } } },
+    { kDeviceStateUpgrading,       { { kStripEffectBlink,   { 0, 0, 0 }, { 1, 2, 1 }, 100, 0, kStripBlendReplace } } },
+    { kDeviceStateActivating,      { { kStripEffectBlink,   { 0, 0, 0 }, { 1, 2, 1 }, 500, 0, kStripBlendReplace } } },
+};
+
+// t is 0 - 256
+static inline StripColor MixColor(StripColor a, StripColor b, int t) {
+    return {
+        (uint8_t)(a.red + ((b.red - a.red) * t >> 8)),
+        (uint8_t)(a.green + ((b.green - a.green) * t >> 8)),
+        (uint8_t)(a.blue + ((b.blue - a.blue) * t >> 8)),
+    };
+}
+
+static StripColor HueToColor(int hue, uint8_t value) {
+    int sector = hue * 6 >> 8;
+    int rise = ((hue * 6) & 0xff) * value >> 8;
+    int fall = value - rise;
+    switch (sector) {
+        case 0: return { value, (uint8_t)rise, 0 };
+        case 1: return { (uint8_t)fall, value, 0 };
+        case 2: return { 0, value, (uint8_t)rise };
+        case 3: return { 0, (uint8_t)fall, value };
+        case 4: return { (uint8_t)rise, 0, value };
+        default: return { value, 0, (uint8_t)fall };
+    }
+}
 
 CircularStrip::CircularStrip(gpio_num_t gpio, uint8_t max_leds) : max_leds_(max_leds) {
     // If the gpio is not connected, you should use NoLed class
     assert(gpio != GPIO_NUM_NC);
 
-    colors_.resize(max_leds_);
+    pixels_.resize(max_leds_);
+    frame_.resize(max_leds_);
+    layer_buffer_.resize(max_leds_);
+    output_.resize(max_leds_);
+
+    // Effects are mixed in perceptual space and mapped to PWM values once per frame
+    for (int i = 0; i < 256; i++) {
+        gamma_table_[i] = (uint8_t)std::lround(std::pow(i / 255.0, STRIP_GAMMA) * 255);
+        inverse_gamma_table_[i] = (uint8_t)std::lround(std::pow(i / 255.0, 1 / STRIP_GAMMA) * 255);
+    }
 
     led_strip_config_t strip_config = {};
     strip_config.strip_gpio_num = gpio;
@@ -28,152 +96,239 @@ CircularStrip::CircularStrip(gpio_num_t gpio, uint8_t max_leds) : max_leds_(max_
         .callback = [](void *arg) {
             auto strip = static_cast<CircularStrip*>(arg);
             std::lock_guard<std::mutex> lock(strip->mutex_);
-            if (strip->strip_callback_ != nullptr) {
-                strip->strip_callback_();
+            if (!strip->RenderFrame()) {
+                esp_timer_stop(strip->strip_timer_);
             }
         },
         .arg = this,
         .dispatch_method = ESP_TIMER_TASK,
         .name = "strip_timer",
-        .skip_unhandled_events = false,
+        .skip_unhandled_events = true,
     };
     ESP_ERROR_CHECK(esp_timer_create(&strip_timer_args, &strip_timer_));
 }
 
 CircularStrip::~CircularStrip() {
     esp_timer_stop(strip_timer_);
+    esp_timer_delete(strip_timer_);
     if (led_strip_ != nullptr) {
         led_strip_del(led_strip_);
     }
 }
 
+StripColor CircularStrip::ToPerceptual(StripColor color) const {
+    return { inverse_gamma_table_[color.red], inverse_gamma_table_[color.green], inverse_gamma_table_[color.blue] };
+}
 
 void CircularStrip::SetAllColor(StripColor color) {
     std::lock_guard<std::mutex> lock(mutex_);
-    esp_timer_stop(strip_timer_);
-    for (int i = 0; i < max_leds_; i++) {
-        colors_[i] = color;
-        led_strip_set_pixel(led_strip_, i, color.red, color.green, color.blue);
-    }
-    led_strip_refresh(led_strip_);
+    std::fill(pixels_.begin(), pixels_.end(), ToPerceptual(color));
+    StripEffect effect;
+    effect.type = kStripEffectStatic;
+    SetEffectsLocked(&effect, 1);
 }
 
 void CircularStrip::SetSingleColor(uint8_t index, StripColor color) {
+    if (index >= max_leds_) {
+        return;
+    }
     std::lock_guard<std::mutex> lock(mutex_);
-    esp_timer_stop(strip_timer_);
-    colors_[index] = color;
-    led_strip_set_pixel(led_strip_, index, color.red, color.green, color.blue);
-    led_strip_refresh(led_strip_);
+    // Freeze whatever is shown now and change one pixel
+    pixels_ = frame_;
+    pixels_[index] = ToPerceptual(color);
+    StripEffect effect;
+    effect.type = kStripEffectStatic;
+    SetEffectsLocked(&effect, 1);
 }
 
 void CircularStrip::Blink(StripColor color, int interval_ms) {
-    for (int i = 0; i < max_leds_; i++) {
-        colors_[i] = color;
+    StripEffect effect;
+    effect.type = kStripEffectBlink;
+    effect.high = color;
+    effect.period_ms = interval_ms;
+    SetEffects(&effect, 1);
+}
+
+void CircularStrip::Breathe(StripColor low, StripColor high, int interval_ms) {
+    // interval_ms is the time of one color step, as in the first implementation
+    int steps = std::max({ std::abs(high.red - low.red), std::abs(high.green - low.green),
+        std::abs(high.blue - low.blue), 1 });
+    StripEffect effect;
+    effect.type = kStripEffectBreathe;
+    effect.low = low;
+    effect.high = high;
+    effect.period_ms = 2 * steps * interval_ms;
+    SetEffects(&effect, 1);
+}
+
+void CircularStrip::Scroll(StripColor low, StripColor high, int length, int interval_ms) {
+    StripEffect effect;
+    effect.type = kStripEffectScroll;
+    effect.low = low;
+    effect.high = high;
+    effect.length = length;
+    effect.period_ms = interval_ms;
+    SetEffects(&effect, 1);
+}
+
+void CircularStrip::Rainbow(uint8_t brightness, int period_ms) {
+    StripEffect effect;
+    effect.type = kStripEffectRainbow;
+    effect.high = { brightness, brightness, brightness };
+    effect.period_ms = period_ms;
+    SetEffects(&effect, 1);
+}
+
+void CircularStrip::SetEffects(const StripEffect* effects, int count) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    SetEffectsLocked(effects, count);
+}
+
+void CircularStrip::SetEffectsLocked(const StripEffect* effects, int count) {
+    if (led_strip_ == nullptr) {
+        return;
     }
-    StartStripTask(interval_ms, [this]() {
-        static bool on = true;
-        if (on) {
-            for (int i = 0; i < max_leds_; i++) {
-                led_strip_set_pixel(led_strip_, i, colors_[i].red, colors_[i].green, colors_[i].blue);
-            }
-            led_strip_refresh(led_strip_);
+
+    auto now = esp_timer_get_time();
+    for (int i = 0; i < STRIP_MAX_LAYERS; i++) {
+        auto& layer = layers_[i];
+        layer.effect = i < count ? effects[i] : StripEffect();
+        layer.effect.low = ToPerceptual(layer.effect.low);
+        layer.effect.high = ToPerceptual(layer.effect.high);
+        layer.effect.period_ms = std::max(layer.effect.period_ms, 1);
+        layer.start_time = now;
+        if (layer.effect.type == kStripEffectFadeOut) {
+            layer.fade_from = frame_;
         } else {
-            led_strip_clear(led_strip_);
+            layer.fade_from.clear();
         }
-        on = !on;
-    });
-}
+    }
 
-void CircularStrip::FadeOut(int interval_ms) {
-    StartStripTask(interval_ms, [this]() {
-        bool all_off = true;
-        for (int i = 0; i < max_leds_; i++) {
-            colors_[i].red /= 2;
-            colors_[i].green /= 2;
-            colors_[i].blue /= 2;
-            if (colors_[i].red != 0 || colors_[i].green != 0 || colors_[i].blue != 0) {
-                all_off = false;
-            }
-            led_strip_set_pixel(led_strip_, i, colors_[i].red, colors_[i].green, colors_[i].blue);
-        }
-        if (all_off) {
-            led_strip_clear(led_strip_);
-            esp_timer_stop(strip_timer_);
-        } else {
-            led_strip_refresh(led_strip_);
+    // Show the first frame right away, the timer only runs while something moves
+    if (RenderFrame()) {
+        if (!esp_timer_is_active(strip_timer_)) {
+            esp_timer_start_periodic(strip_timer_, STRIP_FRAME_INTERVAL_MS * 1000);
         }
-    });
+    } else {
+        esp_timer_stop(strip_timer_);
+    }
 }
 
-void CircularStrip::Breathe(StripColor low, StripColor high, int interval_ms) {
-    StartStripTask(interval_ms, [this, low, high]() {
-        static bool increase = true;
-        static StripColor color = low;
-        if (increase) {
-            if (color.red < high.red) {
-                color.red++;
-            }
-            if (color.green < high.green) {
-                color.green++;
-            }
-            if (color.blue < high.blue) {
-                color.blue++;
-            }
-            if (color.red == high.red && color.green == high.green && color.blue == high.blue) {
-                increase = false;
-            }
-        } else {
-            if (color.red > low.red) {
-                color.red--;
+bool CircularStrip::RenderLayer(StripLayer& layer, int64_t elapsed_ms, std::vector<StripColor>& out) {
+    auto& effect = layer.effect;
+    int period = effect.period_ms;
+    switch (effect.type) {
+        case kStripEffectStatic:
+            std::copy(pixels_.begin(), pixels_.end(), out.begin());
+            return false;
+        case kStripEffectSolid:
+            std::fill(out.begin(), out.end(), effect.high);
+            return false;
+        case kStripEffectBlink:
+            std::fill(out.begin(), out.end(), (elapsed_ms / period) % 2 == 0 ? effect.high : StripColor());
+            return true;
+        case kStripEffectBreathe: {
+            // Triangle wave 0 -> 256 -> 0
+            int phase = (elapsed_ms % period) * 512 / period;
+            std::fill(out.begin(), out.end(), MixColor(effect.low, effect.high, phase < 256 ? phase : 512 - phase));
+            return true;
+        }
+        case kStripEffectScroll: {
+            int offset = (elapsed_ms / period) % max_leds_;
+            std::fill(out.begin(), out.end(), effect.low);
+            for (int j = 0; j < effect.length; j++) {
+                out[(offset + j) % max_leds_] = effect.high;
             }
-            if (color.green > low.green) {
-                color.green--;
+            return true;
+        }
+        case kStripEffectRainbow: {
+            uint8_t value = std::max({ effect.high.red, effect.high.green, effect.high.blue });
+            int base = (elapsed_ms % period) * 256 / period;
+            for (int i = 0; i < max_leds_; i++) {
+                out[i] = HueToColor((base + i * 256 / max_leds_) & 0xff, value);
             }
-            if (color.blue > low.blue) {
-                color.blue--;
+            return true;
+        }
+        case kStripEffectFadeOut: {
+            // Linear in perceptual space, which looks even to the eye
+            if (elapsed_ms >= period) {
+                std::fill(out.begin(), out.end(), StripColor());
+                effect.type = kStripEffectNone;
+                return false;
             }
-            if (color.red == low.red && color.green == low.green && color.blue == low.blue) {
-                increase = true;
+            int t = elapsed_ms * 256 / period;
+            for (int i = 0; i < max_leds_; i++) {
+                out[i] = MixColor(layer.fade_from[i], StripColor(), t);
             }
+            return true;
         }
-        for (int i = 0; i < max_leds_; i++) {
-            led_strip_set_pixel(led_strip_, i, color.red, color.green, color.blue);
+        case kStripEffectLevel: {
+            // level_ lights pixels in 1/256 steps, the last one partially
+            int fill = level_ * max_leds_;
+            for (int i = 0; i < max_leds_; i++) {
+                out[i] = MixColor(effect.low, effect.high, std::clamp(fill - i * 256, 0, 256));
+            }
+            return true;
         }
-        led_strip_refresh(led_strip_);
-    });
+        default:
+            std::fill(out.begin(), out.end(), StripColor());
+            return false;
+    }
 }
 
-void CircularStrip::Scroll(StripColor low, StripColor high, int length, int interval_ms) {
-    for (int i = 0; i < max_leds_; i++) {
-        colors_[i] = low;
-    }
-    StartStripTask(interval_ms, [this, low, high, length]() {
-        static int offset = 0;
-        for (int i = 0; i < max_leds_; i++) {
-            colors_[i] = low;
+bool CircularStrip::RenderFrame() {
+    auto now = esp_timer_get_time();
+    bool animating = false;
+
+    for (auto& layer : layers_) {
+        if (layer.effect.type == kStripEffectLevel) {
+            // Fast attack, slow release so the ring does not flicker between audio frames
+            auto& app = Application::GetInstance();
+            int target = app.IsVoiceDetected() ? app.GetAudioService().GetInputLevel() : 0;
+            level_ = target > level_ ? target : level_ - (level_ - target + 3) / 4;
+            break;
         }
-        for (int j = 0; j < length; j++) {
-            int i = (offset + j) % max_leds_;
-            colors_[i] = high;
+    }
+
+    std::fill(frame_.begin(), frame_.end(), StripColor());
+    for (auto& layer : layers_) {
+        if (layer.effect.type == kStripEffectNone) {
+            continue;
         }
+        animating |= RenderLayer(layer, (now - layer.start_time) / 1000, layer_buffer_);
         for (int i = 0; i < max_leds_; i++) {
-            led_strip_set_pixel(led_strip_, i, colors_[i].red, colors_[i].green, colors_[i].blue);
+            auto& dst = frame_[i];
+            auto& src = layer_buffer_[i];
+            switch (layer.effect.blend) {
+                case kStripBlendMax:
+                    dst = { std::max(dst.red, src.red), std::max(dst.green, src.green), std::max(dst.blue, src.blue) };
+                    break;
+                case kStripBlendAdd:
+                    dst = { (uint8_t)std::min(dst.red + src.red, 255), (uint8_t)std::min(dst.green + src.green, 255),
+                        (uint8_t)std::min(dst.blue + src.blue, 255) };
+                    break;
+                default:
+                    dst = src;
+                    break;
+            }
         }
-        led_strip_refresh(led_strip_);
-        offset = (offset + 1) % max_leds_;
-    });
-}
-
-void CircularStrip::StartStripTask(int interval_ms, std::function<void()> cb) {
-    if (led_strip_ == nullptr) {
-        return;
     }
 
-    std::lock_guard<std::mutex> lock(mutex_);
-    esp_timer_stop(strip_timer_);
-    
-    strip_callback_ = cb;
-    esp_timer_start_periodic(strip_timer_, interval_ms * 1000);
+    // Map to PWM values and refresh the strip once, only if anything changed
+    bool changed = !output_valid_;
+    for (int i = 0; i < max_leds_; i++) {
+        StripColor color = { gamma_table_[frame_[i].red], gamma_table_[frame_[i].green], gamma_table_[frame_[i].blue] };
+        if (changed || color.red != output_[i].red || color.green != output_[i].green || color.blue != output_[i].blue) {
+            changed = true;
+        }
+        output_[i] = color;
+        led_strip_set_pixel(led_strip_, i, color.red, color.green, color.blue);
+    }
+    if (changed) {
+        led_strip_refresh(led_strip_);
+        output_valid_ = true;
+    }
+    return animating;
 }
 
 void CircularStrip::SetBrightness(uint8_t default_brightness, uint8_t low_brightness) {
@@ -185,49 +340,26 @@ void CircularStrip::SetBrightness(uint8_t default_brightness, uint8_t low_bright
 void CircularStrip::OnStateChanged() {
     auto& app = Application::GetInstance();
     auto device_state = app.GetDeviceState();
-    switch (device_state) {
-        case kDeviceStateStarting: {
-            StripColor low = { 0, 0, 0 };
-            StripColor high = { low_brightness_, low_brightness_, default_brightness_ };
-            Scroll(low, high, 3, 100);
-            break;
+    for (auto& script : kStateScripts) {
+        if (script.state != device_state) {
+            continue;
         }
-        case kDeviceStateWifiConfiguring: {
-            StripColor color = { low_brightness_, low_brightness_, default_brightness_ };
-            Blink(color, 500);
-            break;
+        const uint8_t levels[] = { 0, low_brightness_, default_brightness_ };
+        auto resolve = [&levels](const StripLevelColor& color) {
+            return StripColor{ levels[color.red], levels[color.green], levels[color.blue] };
+        };
+        StripEffect effects[STRIP_MAX_LAYERS];
+        for (int i = 0; i < STRIP_MAX_LAYERS; i++) {
+            auto& layer = script.layers[i];
+            effects[i].type = layer.type;
+            effects[i].low = resolve(layer.low);
+            effects[i].high = resolve(layer.high);
+            effects[i].period_ms = layer.period_ms;
+            effects[i].length = layer.length;
+            effects[i].blend = layer.blend;
         }
-        case kDeviceStateIdle:
-            FadeOut(50);
-            break;
-        case kDeviceStateConnecting: {
-            StripColor color = { low_brightness_, low_brightness_, default_brightness_ };
-            SetAllColor(color);
-            break;
-        }
-        case kDeviceStateListening:
-        case kDeviceStateAudioTesting: {
-            StripColor color = { default_brightness_, low_brightness_, low_brightness_ };
-            SetAllColor(color);
-            break;
-        }
-        case kDeviceStateSpeaking: {
-            StripColor color = { low_brightness_, default_brightness_, low_brightness_ };
-            SetAllColor(color);
-            break;
-        }
-        case kDeviceStateUpgrading: {
-            StripColor color = { low_brightness_, default_brightness_, low_brightness_ };
-            Blink(color, 100);
-            break;
-        }
-        case kDeviceStateActivating: {
-            StripColor color = { low_brightness_, default_brightness_, low_brightness_ };
-            Blink(color, 500);
-            break;
-        }
-        default:
-            ESP_LOGW(TAG, "Unknown led strip event: %d", device_state);
-            return;
+        SetEffects(effects, STRIP_MAX_LAYERS);
+        return;
     }
+    ESP_LOGW(TAG, "Unknown led strip event: %d", device_state);
 }
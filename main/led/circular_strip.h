@@ -12,10 +12,43 @@
 #define DEFAULT_BRIGHTNESS 32
 #define LOW_BRIGHTNESS 4
 
+// Compositor frame interval, effects are defined in milliseconds and do not depend on it
+#define STRIP_FRAME_INTERVAL_MS 20
+#define STRIP_MAX_LAYERS 2
+
 struct StripColor {
     uint8_t red = 0, green = 0, blue = 0;
 };
 
+enum StripEffectType {
+    kStripEffectNone,
+    kStripEffectStatic,     // Pixels set by SetAllColor / SetSingleColor
+    kStripEffectSolid,      // All pixels high
+    kStripEffectBlink,      // high on / off every period_ms
+    kStripEffectBreathe,    // low -> high -> low once every period_ms
+    kStripEffectScroll,     // length pixels of high over low, one step every period_ms
+    kStripEffectRainbow,    // Hue wheel at the brightness of high, one turn every period_ms
+    kStripEffectFadeOut,    // The current frame fades to off over period_ms
+    kStripEffectLevel,      // Pixels of high over low following the mic level while voice is detected
+};
+
+enum StripBlendMode {
+    kStripBlendReplace,
+    kStripBlendMax,
+    kStripBlendAdd,
+};
+
+// Colors are in output (PWM) values like the rest of the API,
+// the compositor interpolates them in perceptual space
+struct StripEffect {
+    StripEffectType type = kStripEffectNone;
+    StripColor low;
+    StripColor high;
+    int period_ms = 0;
+    int length = 0;
+    StripBlendMode blend = kStripBlendReplace;
+};
+
 class CircularStrip : public Led {
 public:
     CircularStrip(gpio_num_t gpio, uint8_t max_leds);
@@ -28,24 +61,39 @@ public:
     void Blink(StripColor color, int interval_ms);
     void Breathe(StripColor low, StripColor high, int interval_ms);
     void Scroll(StripColor low, StripColor high, int length, int interval_ms);
+    void Rainbow(uint8_t brightness, int period_ms);
+    // Replaces all layers, layer 0 is at the bottom
+    void SetEffects(const StripEffect* effects, int count);
 
 private:
+    struct StripLayer {
+        StripEffect effect;
+        int64_t start_time = 0;
+        std::vector<StripColor> fade_from;
+    };
+
     std::mutex mutex_;
-    TaskHandle_t blink_task_ = nullptr;
     led_strip_handle_t led_strip_ = nullptr;
     int max_leds_ = 0;
-    std::vector<StripColor> colors_;
-    int blink_counter_ = 0;
-    int blink_interval_ms_ = 0;
     esp_timer_handle_t strip_timer_ = nullptr;
-    std::function<void()> strip_callback_ = nullptr;
+    StripLayer layers_[STRIP_MAX_LAYERS];
+    std::vector<StripColor> pixels_;        // Static pixels, perceptual space
+    std::vector<StripColor> frame_;         // Composed frame, perceptual space
+    std::vector<StripColor> layer_buffer_;
+    std::vector<StripColor> output_;        // Last values sent to the strip
+    bool output_valid_ = false;
+    int level_ = 0;
+    uint8_t gamma_table_[256];
+    uint8_t inverse_gamma_table_[256];
 
     uint8_t default_brightness_ = DEFAULT_BRIGHTNESS;
     uint8_t low_brightness_ = LOW_BRIGHTNESS;
 
-    void StartStripTask(int interval_ms, std::function<void()> cb);
-    void Rainbow(StripColor low, StripColor high, int interval_ms);
-    void FadeOut(int interval_ms);
+    void SetEffectsLocked(const StripEffect* effects, int count);
+    bool RenderLayer(StripLayer& layer, int64_t elapsed_ms, std::vector<StripColor>& out);
+    // Returns true while any layer is animated
+    bool RenderFrame();
+    StripColor ToPerceptual(StripColor color) const;
 };
 
 #endif // _CIRCULAR_STRIP_H_
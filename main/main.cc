@@ -7,6 +7,7 @@
 
 #include "application.h"
 #include "system_info.h"
+#include "settings.h"
 
 #define TAG "main"
 
@@ -20,6 +21,7 @@ extern "C" void app_main(void)
     if (ret == ESP_ERR_NVS_NO_FREE_PAGES || ret == ESP_ERR_NVS_NEW_VERSION_FOUND) {
         ESP_LOGW(TAG, "Erasing NVS flash to fix corruption");
         ESP_ERROR_CHECK(nvs_flash_erase());
+        Settings::Invalidate();
         ret = nvs_flash_init();
     }
     ESP_ERROR_CHECK(ret);
@@ -6,6 +6,7 @@
  #include "mcp_server.h"
  #include <esp_log.h>
  #include <esp_app_desc.h>
+ #include <esp_timer.h>
  #include <algorithm>
  #include <cstring>
  #include <esp_pthread.h>
@@ -13,26 +14,23 @@
  #include "application.h"
  #include "display.h"
  #include "board.h"
+ #include "metrics.h"
  
  #define TAG "MCP"
  
  #define DEFAULT_TOOLCALL_STACK_SIZE 6144
  
- McpServer::McpServer() {
+ McpServer::McpServer() : tools_(MAX_TOOLS_LIST_PAYLOAD_SIZE) {
  }
  
  McpServer::~McpServer() {
-     for (auto tool : tools_) {
-         delete tool;
-     }
-     tools_.clear();
  }
  
  void McpServer::AddCommonTools() {
      // To speed up the response time, we add the common tools to the beginning of
      // the tools list to utilize the prompt cache.
-     // Backup the original tools list and restore it after adding the common tools.
-     auto original_tools = std::move(tools_);
+     // The common tools are added after the original ones and then moved to the front.
+     size_t original_count = tools_.size();
      auto& board = Board::GetInstance();
  
      AddTool("self.get_device_status",
@@ -54,9 +52,9 @@
              auto codec = board.GetAudioCodec();
              int volume = properties["volume"].value<int>();
 #if CONFIG_USE_DEVICE_AEC
-             // AEC 开启时，音量不允许超过 80
+             // AEC 开启且尚未收敛时，音量不允许超过 80
              auto& app = Application::GetInstance();
-             if (app.GetAecMode() != kAecOff && volume > 80) {
+             if (app.GetAecMode() != kAecOff && !app.GetAudioService().IsAecConverged() && volume > 80) {
                  volume = 80;
              }
 #endif
@@ -91,19 +89,45 @@
              });
     }
  
-     // Restore the original tools list to the end of the tools list
-     tools_.insert(tools_.end(), original_tools.begin(), original_tools.end());
+#if CONFIG_USE_CAMERA_CONTINUOUS_VISION
+     auto camera = board.GetCamera();
+     if (camera) {
+         AddTool("self.camera.take_photo",
+             "Take a photo and explain it. Use this tool after the user asks you to see something.\n"
+             "Args:\n"
+             "  `question`: The question that you want to ask about the photo.\n"
+             "Return:\n"
+             "  A JSON object that provides the photo information.",
+             PropertyList({
+                 Property("question", kPropertyTypeString)
+             }),
+             [camera](const PropertyList& properties) -> ReturnValue {
+                 // In continuous vision mode Explain takes a fresh keyframe itself, a capture would only add latency
+                 if (!camera->IsContinuousVision() && !camera->Capture()) {
+                     return std::string("{\"success\": false, \"message\": \"Failed to capture photo\"}");
+                 }
+                 auto question = properties["question"].value<std::string>();
+                 return camera->Explain(question);
+             });
+     }
+#endif
+ 
+#if CONFIG_USE_METRICS_MCP_TOOL
+     AddTool("self.get_performance_metrics",
+         "Diagnostics only. Returns the device performance counters, heap low-water marks and latency histograms as JSON.",
+         PropertyList(),
+         [](const PropertyList& properties) -> ReturnValue {
+             Metrics::GetInstance().UpdateHeapStats();
+             return Metrics::GetInstance().GetSnapshotJson();
+         });
+#endif
+ 
+     // Keep the original tools at the end of the tools list
+     tools_.MoveToFront(original_count);
  }
  
  void McpServer::AddTool(McpTool* tool) {
-     // Prevent adding duplicate tools
-     if (std::find_if(tools_.begin(), tools_.end(), [tool](const McpTool* t) { return t->name() == tool->name(); }) != tools_.end()) {
-         ESP_LOGW(TAG, "Tool %s already added", tool->name().c_str());
-         return;
-     }
- 
-     ESP_LOGI(TAG, "Add tool: %s", tool->name().c_str());
-     tools_.push_back(tool);
+     tools_.Add(tool);
  }
  
  void McpServer::AddTool(const std::string& name, const std::string& description, const PropertyList& properties, std::function<ReturnValue(const PropertyList&)> callback) {
@@ -134,6 +158,10 @@
                      token_str = std::string(token->valuestring);
                  }
                  camera->SetExplainUrl(url_str, token_str);
+#if CONFIG_USE_CAMERA_CONTINUOUS_VISION
+                 // Keep watching the scene from now on, questions upload the recent keyframes
+                 camera->SetContinuousVision(true);
+#endif
              }
          }
      }
@@ -243,95 +271,27 @@
  }
  
  void McpServer::GetToolsList(int id, const std::string& cursor) {
-     const int max_payload_size = 8000;
-     std::string json = "{\"tools\":[";
-     
-     bool found_cursor = cursor.empty();
-     auto it = tools_.begin();
-     std::string next_cursor = "";
-     
-     while (it != tools_.end()) {
-         // 如果我们还没有找到起始位置，继续搜索
-         if (!found_cursor) {
-             if ((*it)->name() == cursor) {
-                 found_cursor = true;
-             } else {
-                 ++it;
-                 continue;
-             }
-         }
-         
-         // 添加tool前检查大小
-         std::string tool_json = (*it)->to_json() + ",";
-         if (json.length() + tool_json.length() + 30 > max_payload_size) {
-             // 如果添加这个tool会超出大小限制，设置next_cursor并退出循环
-             next_cursor = (*it)->name();
-             break;
-         }
-         
-         json += tool_json;
-         ++it;
-     }
-     
-     if (json.back() == ',') {
-         json.pop_back();
-     }
-     
-     if (json.back() == '[' && !tools_.empty()) {
-         // 如果没有添加任何tool，返回错误
-         ESP_LOGE(TAG, "tools/list: Failed to add tool %s because of payload size limit", next_cursor.c_str());
-         ReplyError(id, "Failed to add tool " + next_cursor + " because of payload size limit");
+     std::string error;
+     auto page = tools_.GetToolsListPage(cursor, error);
+     if (page == nullptr) {
+         ReplyError(id, error);
          return;
      }
- 
-     if (next_cursor.empty()) {
-         json += "]}";
-     } else {
-         json += "],\"nextCursor\":\"" + next_cursor + "\"}";
-     }
-     
-     ReplyResult(id, json);
+     ReplyResult(id, *page);
  }
  
  void McpServer::DoToolCall(int id, const std::string& tool_name, const cJSON* tool_arguments, int stack_size) {
-     auto tool_iter = std::find_if(tools_.begin(), tools_.end(), 
-                                  [&tool_name](const McpTool* tool) { 
-                                      return tool->name() == tool_name; 
-                                  });
-     
-     if (tool_iter == tools_.end()) {
+     McpTool* tool = tools_.Find(tool_name);
+     if (tool == nullptr) {
          ESP_LOGE(TAG, "tools/call: Unknown tool: %s", tool_name.c_str());
          ReplyError(id, "Unknown tool: " + tool_name);
          return;
      }
  
-     PropertyList arguments = (*tool_iter)->properties();
-     try {
-         for (auto& argument : arguments) {
-             bool found = false;
-             if (cJSON_IsObject(tool_arguments)) {
-                 auto value = cJSON_GetObjectItem(tool_arguments, argument.name().c_str());
-                 if (argument.type() == kPropertyTypeBoolean && cJSON_IsBool(value)) {
-                     argument.set_value<bool>(value->valueint == 1);
-                     found = true;
-                 } else if (argument.type() == kPropertyTypeInteger && cJSON_IsNumber(value)) {
-                     argument.set_value<int>(value->valueint);
-                     found = true;
-                 } else if (argument.type() == kPropertyTypeString && cJSON_IsString(value)) {
-                     argument.set_value<std::string>(value->valuestring);
-                     found = true;
-                 }
-             }
- 
-             if (!argument.has_default_value() && !found) {
-                 ESP_LOGE(TAG, "tools/call: Missing valid argument: %s", argument.name().c_str());
-                 ReplyError(id, "Missing valid argument: " + argument.name());
-                 return;
-             }
-         }
-     } catch (const std::exception& e) {
-         ESP_LOGE(TAG, "tools/call: %s", e.what());
-         ReplyError(id, e.what());
+     PropertyList arguments = tool->properties();
+     std::string error;
+     if (!McpToolRegistry::BindArguments(tool_arguments, arguments, error)) {
+         ReplyError(id, error);
          return;
      }
  
@@ -343,9 +303,9 @@
      esp_pthread_set_cfg(&cfg);
  
      // Use a thread to call the tool to avoid blocking the main thread
-     tool_call_thread_ = std::thread([this, id, tool_iter, arguments = std::move(arguments)]() {
+     tool_call_thread_ = std::thread([this, id, tool, arguments = std::move(arguments)]() {
          try {
-             ReplyResult(id, (*tool_iter)->Call(arguments));
+             ReplyResult(id, tool->Call(arguments));
          } catch (const std::exception& e) {
              ESP_LOGE(TAG, "tools/call: %s", e.what());
              ReplyError(id, e.what());
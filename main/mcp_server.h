@@ -4,6 +4,7 @@
 #include <string>
 #include <vector>
 #include <map>
+#include <unordered_map>
 #include <functional>
 #include <variant>
 #include <optional>
@@ -12,6 +13,9 @@
 
 #include <cJSON.h>
 
+// Size limit of a tools/list reply, larger lists are split into pages
+#define MAX_TOOLS_LIST_PAYLOAD_SIZE 8000
+
 // 添加类型别名
 using ReturnValue = std::variant<bool, int, std::string>;
 
@@ -86,7 +90,8 @@ public:
         value_ = value;
     }
 
-    std::string to_json() const {
+    // 直接构建 cJSON 对象，便于嵌套到上层 JSON 中，避免序列化后再解析
+    cJSON* to_cjson() const {
         cJSON *json = cJSON_CreateObject();
         
         if (type_ == kPropertyTypeBoolean) {
@@ -111,7 +116,11 @@ public:
                 cJSON_AddStringToObject(json, "default", value<std::string>().c_str());
             }
         }
-        
+        return json;
+    }
+
+    std::string to_json() const {
+        cJSON *json = to_cjson();
         char *json_str = cJSON_PrintUnformatted(json);
         std::string result(json_str);
         cJSON_free(json_str);
@@ -154,14 +163,16 @@ public:
         return required;
     }
 
-    std::string to_json() const {
+    cJSON* to_cjson() const {
         cJSON *json = cJSON_CreateObject();
-        
         for (const auto& property : properties_) {
-            cJSON *prop_json = cJSON_Parse(property.to_json().c_str());
-            cJSON_AddItemToObject(json, property.name().c_str(), prop_json);
+            cJSON_AddItemToObject(json, property.name().c_str(), property.to_cjson());
         }
-        
+        return json;
+    }
+
+    std::string to_json() const {
+        cJSON *json = to_cjson();
         char *json_str = cJSON_PrintUnformatted(json);
         std::string result(json_str);
         cJSON_free(json_str);
@@ -202,8 +213,7 @@ public:
         cJSON *input_schema = cJSON_CreateObject();
         cJSON_AddStringToObject(input_schema, "type", "object");
         
-        cJSON *properties = cJSON_Parse(properties_.to_json().c_str());
-        cJSON_AddItemToObject(input_schema, "properties", properties);
+        cJSON_AddItemToObject(input_schema, "properties", properties_.to_cjson());
         
         if (!required.empty()) {
             cJSON *required_array = cJSON_CreateArray();
@@ -249,6 +259,40 @@ public:
     }
 };
 
+// The tools of McpServer, indexed by name, with the tools/list pages serialized once.
+// Implemented in mcp_tool_registry.cc without platform dependencies, for the host benchmark.
+class McpToolRegistry {
+public:
+    explicit McpToolRegistry(size_t max_payload_size) : max_payload_size_(max_payload_size) {}
+    ~McpToolRegistry();
+
+    // Owns the added tools, returns false without adding if a tool of the same name exists
+    bool Add(McpTool* tool);
+    // Moves the tools added after the first ones to the beginning of the list
+    void MoveToFront(size_t first);
+    McpTool* Find(const std::string& name) const;
+    inline size_t size() const { return tools_.size(); }
+
+    // The tools/list result of the cursor, or nullptr with error set
+    const std::string* GetToolsListPage(const std::string& cursor, std::string& error);
+
+    // Copies the arguments of tools/call into the properties of the tool, or sets error
+    static bool BindArguments(const cJSON* arguments, PropertyList& properties, std::string& error);
+
+private:
+    void BuildToolsListPages();
+
+    size_t max_payload_size_;
+    std::vector<McpTool*> tools_;
+    std::unordered_map<std::string, McpTool*> tool_index_;
+
+    // tools/list 的分页结果在首次请求时序列化并缓存，只在添加工具后重建
+    bool tools_list_dirty_ = true;
+    std::vector<std::string> tools_list_pages_;
+    std::unordered_map<std::string, size_t> tools_list_cursors_;
+    std::string tools_list_error_;
+};
+
 class McpServer {
 public:
     static McpServer& GetInstance() {
@@ -274,7 +318,7 @@ private:
     void GetToolsList(int id, const std::string& cursor);
     void DoToolCall(int id, const std::string& tool_name, const cJSON* tool_arguments, int stack_size);
 
-    std::vector<McpTool*> tools_;
+    McpToolRegistry tools_;
     std::thread tool_call_thread_;
 };
 
@@ -0,0 +1,128 @@
+#include "mcp_server.h"
+
+#include <esp_log.h>
+#include <esp_timer.h>
+#include <algorithm>
+
+#define TAG "MCP"
+
+McpToolRegistry::~McpToolRegistry() {
+    for (auto tool : tools_) {
+        delete tool;
+    }
+}
+
+bool McpToolRegistry::Add(McpTool* tool) {
+    // Prevent adding duplicate tools
+    if (tool_index_.find(tool->name()) != tool_index_.end()) {
+        ESP_LOGW(TAG, "Tool %s already added", tool->name().c_str());
+        return false;
+    }
+
+    ESP_LOGI(TAG, "Add tool: %s", tool->name().c_str());
+    tools_.push_back(tool);
+    tool_index_[tool->name()] = tool;
+    tools_list_dirty_ = true;
+    return true;
+}
+
+void McpToolRegistry::MoveToFront(size_t first) {
+    std::rotate(tools_.begin(), tools_.begin() + std::min(first, tools_.size()), tools_.end());
+    tools_list_dirty_ = true;
+}
+
+McpTool* McpToolRegistry::Find(const std::string& name) const {
+    auto it = tool_index_.find(name);
+    return it == tool_index_.end() ? nullptr : it->second;
+}
+
+void McpToolRegistry::BuildToolsListPages() {
+    auto start_time = esp_timer_get_time();
+    tools_list_pages_.clear();
+    tools_list_cursors_.clear();
+    tools_list_error_.clear();
+
+    // 每一页都是完整的 result JSON，nextCursor 为下一页第一个工具的名称
+    std::string json = "{\"tools\":[";
+    tools_list_cursors_[""] = 0;
+    for (auto tool : tools_) {
+        std::string tool_json = tool->to_json() + ",";
+        if (json.length() + tool_json.length() + 30 > max_payload_size_ && json.back() != '[') {
+            // 当前页已满，从这个工具开始新的一页
+            json.pop_back();
+            json += "],\"nextCursor\":\"" + tool->name() + "\"}";
+            tools_list_pages_.push_back(std::move(json));
+            tools_list_cursors_[tool->name()] = tools_list_pages_.size();
+            json = "{\"tools\":[";
+        }
+        if (json.length() + tool_json.length() + 30 > max_payload_size_) {
+            // 单个工具就超出了大小限制，请求这一页时返回错误
+            ESP_LOGE(TAG, "tools/list: Failed to add tool %s because of payload size limit", tool->name().c_str());
+            tools_list_error_ = "Failed to add tool " + tool->name() + " because of payload size limit";
+            json.clear();
+            break;
+        }
+        json += tool_json;
+    }
+
+    if (!json.empty()) {
+        if (json.back() == ',') {
+            json.pop_back();
+        }
+        json += "]}";
+        tools_list_pages_.push_back(std::move(json));
+    }
+    tools_list_dirty_ = false;
+    ESP_LOGI(TAG, "Serialized %u tools into %u pages in %lld ms", (unsigned)tools_.size(),
+        (unsigned)tools_list_pages_.size(), (long long)(esp_timer_get_time() - start_time) / 1000);
+}
+
+const std::string* McpToolRegistry::GetToolsListPage(const std::string& cursor, std::string& error) {
+    if (tools_list_dirty_) {
+        BuildToolsListPages();
+    }
+
+    auto it = tools_list_cursors_.find(cursor);
+    if (it == tools_list_cursors_.end()) {
+        ESP_LOGE(TAG, "tools/list: Invalid cursor: %s", cursor.c_str());
+        error = "Invalid cursor: " + cursor;
+        return nullptr;
+    }
+    if (it->second >= tools_list_pages_.size()) {
+        error = tools_list_error_;
+        return nullptr;
+    }
+    return &tools_list_pages_[it->second];
+}
+
+bool McpToolRegistry::BindArguments(const cJSON* arguments, PropertyList& properties, std::string& error) {
+    try {
+        for (auto& argument : properties) {
+            bool found = false;
+            if (cJSON_IsObject(arguments)) {
+                auto value = cJSON_GetObjectItem(arguments, argument.name().c_str());
+                if (argument.type() == kPropertyTypeBoolean && cJSON_IsBool(value)) {
+                    argument.set_value<bool>(value->valueint == 1);
+                    found = true;
+                } else if (argument.type() == kPropertyTypeInteger && cJSON_IsNumber(value)) {
+                    argument.set_value<int>(value->valueint);
+                    found = true;
+                } else if (argument.type() == kPropertyTypeString && cJSON_IsString(value)) {
+                    argument.set_value<std::string>(value->valuestring);
+                    found = true;
+                }
+            }
+
+            if (!argument.has_default_value() && !found) {
+                ESP_LOGE(TAG, "tools/call: Missing valid argument: %s", argument.name().c_str());
+                error = "Missing valid argument: " + argument.name();
+                return false;
+            }
+        }
+    } catch (const std::exception& e) {
+        ESP_LOGE(TAG, "tools/call: %s", e.what());
+        error = e.what();
+        return false;
+    }
+    return true;
+}
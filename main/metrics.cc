@@ -0,0 +1,146 @@
+#include "metrics.h"
+
+#include <esp_log.h>
+#include <esp_timer.h>
+#include <esp_heap_caps.h>
+#include <esp_app_desc.h>
+#include <cJSON.h>
+
+#include <algorithm>
+
+#if CONFIG_USE_AUDIO_DEBUGGER
+#include "processors/audio_debugger.h"
+#include <memory>
+#endif
+
+#define TAG "Metrics"
+
+static const char* const COUNTER_NAMES[kMetricCounterCount] = {
+    "wake_word_detected",
+    "audio_channel_open_failed",
+    "decode_queue_dropped",
+    "encode_failed",
+    "decode_failed",
+    "send_audio_failed",
+    "preconnect_dropped",
+    "connection_reused",
+    "network_failover",
+    "failover_packets_lost",
+};
+
+static const char* const GAUGE_NAMES[kMetricGaugeCount] = {
+    "decode_queue_depth",
+    "send_queue_depth",
+    "free_sram",
+    "min_free_sram",
+    "free_psram",
+    "min_free_psram",
+    "active_seconds",
+    "idle_seconds",
+    "light_sleep_seconds",
+    "average_current_ma",
+    "aec_delay_ms",
+    "aec_erle_db",
+};
+
+static const char* const HISTOGRAM_NAMES[kMetricHistogramCount] = {
+    "wake_word_to_channel_open_ms",
+    "wake_word_to_first_uplink_ms",
+    "vad_end_to_first_tts_ms",
+    "encode_us",
+    "decode_us",
+    "send_audio_us",
+    "channel_connect_ms",
+    "channel_hello_ms",
+    "abort_to_silence_ms",
+    "input_settle_ms",
+    "network_failover_ms",
+};
+
+void Metrics::UpdateHeapStats() {
+    SetGauge(kMetricFreeSram, heap_caps_get_free_size(MALLOC_CAP_INTERNAL));
+    SetGauge(kMetricMinFreeSram, heap_caps_get_minimum_free_size(MALLOC_CAP_INTERNAL));
+    SetGauge(kMetricFreePsram, heap_caps_get_free_size(MALLOC_CAP_SPIRAM));
+    SetGauge(kMetricMinFreePsram, heap_caps_get_minimum_free_size(MALLOC_CAP_SPIRAM));
+}
+
+std::string Metrics::GetSnapshotJson() {
+    cJSON* root = cJSON_CreateObject();
+    cJSON_AddStringToObject(root, "version", esp_app_get_description()->version);
+    cJSON_AddNumberToObject(root, "uptime_ms", esp_timer_get_time() / 1000);
+
+    cJSON* counters = cJSON_CreateObject();
+    for (int i = 0; i < kMetricCounterCount; i++) {
+        cJSON_AddNumberToObject(counters, COUNTER_NAMES[i], counters_[i].load(std::memory_order_relaxed));
+    }
+    cJSON_AddItemToObject(root, "counters", counters);
+
+    cJSON* gauges = cJSON_CreateObject();
+    for (int i = 0; i < kMetricGaugeCount; i++) {
+        cJSON_AddNumberToObject(gauges, GAUGE_NAMES[i], gauges_[i].load(std::memory_order_relaxed));
+    }
+    cJSON_AddItemToObject(root, "gauges", gauges);
+
+    cJSON* histograms = cJSON_CreateObject();
+    for (int i = 0; i < kMetricHistogramCount; i++) {
+        auto& h = histograms_[i];
+        uint32_t buckets[METRIC_HISTOGRAM_BUCKETS];
+        uint32_t count = 0;
+        for (int b = 0; b < METRIC_HISTOGRAM_BUCKETS; b++) {
+            buckets[b] = h.buckets[b].load(std::memory_order_relaxed);
+            count += buckets[b];
+        }
+        uint32_t max = h.max.load(std::memory_order_relaxed);
+
+        // Percentiles are reported as the upper bound of the bucket they fall into
+        auto percentile = [&](int p) -> uint32_t {
+            if (count == 0) {
+                return 0;
+            }
+            uint32_t rank = (static_cast<uint64_t>(count) * p + 99) / 100;
+            uint32_t seen = 0;
+            for (int b = 0; b < METRIC_HISTOGRAM_BUCKETS; b++) {
+                seen += buckets[b];
+                if (seen >= rank) {
+                    return b == METRIC_HISTOGRAM_BUCKETS - 1 ? max : std::min<uint32_t>(1u << b, max);
+                }
+            }
+            return max;
+        };
+
+        cJSON* item = cJSON_CreateObject();
+        cJSON_AddNumberToObject(item, "count", count);
+        cJSON_AddNumberToObject(item, "p50", percentile(50));
+        cJSON_AddNumberToObject(item, "p90", percentile(90));
+        cJSON_AddNumberToObject(item, "p99", percentile(99));
+        cJSON_AddNumberToObject(item, "max", max);
+        // Trailing empty buckets are omitted to keep the snapshot compact
+        int last = METRIC_HISTOGRAM_BUCKETS - 1;
+        while (last >= 0 && buckets[last] == 0) {
+            last--;
+        }
+        cJSON* bucket_array = cJSON_CreateArray();
+        for (int b = 0; b <= last; b++) {
+            cJSON_AddItemToArray(bucket_array, cJSON_CreateNumber(buckets[b]));
+        }
+        cJSON_AddItemToObject(item, "buckets", bucket_array);
+        cJSON_AddItemToObject(histograms, HISTOGRAM_NAMES[i], item);
+    }
+    cJSON_AddItemToObject(root, "histograms", histograms);
+
+    char* json_str = cJSON_PrintUnformatted(root);
+    std::string result(json_str);
+    cJSON_free(json_str);
+    cJSON_Delete(root);
+    return result;
+}
+
+void Metrics::ReportToAudioDebugger() {
+#if CONFIG_USE_AUDIO_DEBUGGER
+    static std::unique_ptr<AudioDebugger> debugger;
+    if (debugger == nullptr) {
+        debugger = std::make_unique<AudioDebugger>();
+    }
+    debugger->SendMetrics(GetSnapshotJson());
+#endif
+}
@@ -0,0 +1,108 @@
+#ifndef _METRICS_H_
+#define _METRICS_H_
+
+#include <atomic>
+#include <string>
+#include <cstdint>
+
+enum MetricCounter {
+    kMetricWakeWordDetected,
+    kMetricAudioChannelOpenFailed,
+    kMetricDecodeQueueDropped,
+    kMetricEncodeFailed,
+    kMetricDecodeFailed,
+    kMetricSendAudioFailed,
+    kMetricPreconnectDropped,
+    kMetricConnectionReused,
+    kMetricNetworkFailover,
+    kMetricFailoverPacketsLost,
+    kMetricCounterCount
+};
+
+enum MetricGauge {
+    kMetricDecodeQueueDepth,
+    kMetricSendQueueDepth,
+    kMetricFreeSram,
+    kMetricMinFreeSram,
+    kMetricFreePsram,
+    kMetricMinFreePsram,
+    kMetricActiveSeconds,
+    kMetricIdleSeconds,
+    kMetricLightSleepSeconds,
+    kMetricAverageCurrentMa,
+    kMetricAecDelayMs,
+    kMetricAecErleDb,
+    kMetricGaugeCount
+};
+
+enum MetricHistogram {
+    kMetricWakeWordToChannelOpenMs,
+    kMetricWakeWordToFirstUplinkMs,
+    kMetricVadEndToFirstTtsMs,
+    kMetricEncodeUs,
+    kMetricDecodeUs,
+    kMetricSendAudioUs,
+    kMetricChannelConnectMs,
+    kMetricChannelHelloMs,
+    kMetricAbortToSilenceMs,
+    kMetricInputSettleMs,
+    kMetricNetworkFailoverMs,
+    kMetricHistogramCount
+};
+
+// Bucket i counts values in [2^(i-1), 2^i), the last bucket is open-ended
+#define METRIC_HISTOGRAM_BUCKETS 20
+
+// Process-wide performance counters, gauges and latency histograms.
+// Updates are relaxed atomics so they can be called from any task or
+// timer callback; only GetSnapshotJson allocates.
+class Metrics {
+public:
+    static Metrics& GetInstance() {
+        static Metrics instance;
+        return instance;
+    }
+    // 删除拷贝构造函数和赋值运算符
+    Metrics(const Metrics&) = delete;
+    Metrics& operator=(const Metrics&) = delete;
+
+    void Increment(MetricCounter counter, uint32_t value = 1) {
+        counters_[counter].fetch_add(value, std::memory_order_relaxed);
+    }
+
+    void SetGauge(MetricGauge gauge, int32_t value) {
+        gauges_[gauge].store(value, std::memory_order_relaxed);
+    }
+
+    void Observe(MetricHistogram histogram, uint32_t value) {
+        auto& h = histograms_[histogram];
+        int bucket = value == 0 ? 0 : 32 - __builtin_clz(value);
+        if (bucket >= METRIC_HISTOGRAM_BUCKETS) {
+            bucket = METRIC_HISTOGRAM_BUCKETS - 1;
+        }
+        h.buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+        uint32_t max = h.max.load(std::memory_order_relaxed);
+        while (value > max && !h.max.compare_exchange_weak(max, value, std::memory_order_relaxed)) {
+        }
+    }
+
+    // Samples free / low-water heap of internal SRAM and PSRAM into the gauges
+    void UpdateHeapStats();
+    std::string GetSnapshotJson();
+    // Sends the snapshot to the audio debug UDP server (CONFIG_USE_AUDIO_DEBUGGER)
+    void ReportToAudioDebugger();
+
+private:
+    Metrics() = default;
+
+    struct Histogram {
+        std::atomic<uint32_t> max{0};
+        std::atomic<uint32_t> buckets[METRIC_HISTOGRAM_BUCKETS] = {};
+    };
+
+    std::atomic<uint32_t> counters_[kMetricCounterCount] = {};
+    std::atomic<int32_t> gauges_[kMetricGaugeCount] = {};
+    Histogram histograms_[kMetricHistogramCount];
+};
+
+#endif // _METRICS_H_
@@ -0,0 +1,358 @@
+#include "control_message.h"
+
+#include <esp_log.h>
+
+#define TAG "ControlMessage"
+
+namespace {
+
+enum JsonKind {
+    kJsonString,
+    kJsonObject,
+    kJsonArray,
+    kJsonScalar,
+};
+
+enum ControlField {
+    kFieldType,
+    kFieldState,
+    kFieldSessionId,
+    kFieldText,
+    kFieldEmotion,
+    kFieldCommand,
+    kFieldStatus,
+    kFieldMessage,
+    kFieldPayload,
+    kFieldCount
+};
+
+#define FIELD_BIT(field) (1u << (field))
+
+struct FieldSchema {
+    std::string_view name;
+    JsonKind kind;
+};
+
+// Indexed by ControlField, a field of another kind is ignored
+constexpr FieldSchema kFieldSchemas[kFieldCount] = {
+    {"type",       kJsonString},
+    {"state",      kJsonString},
+    {"session_id", kJsonString},
+    {"text",       kJsonString},
+    {"emotion",    kJsonString},
+    {"command",    kJsonString},
+    {"status",     kJsonString},
+    {"message",    kJsonString},
+    {"payload",    kJsonObject},
+};
+
+struct TypeSchema {
+    std::string_view name;
+    ControlMessageType type;
+    uint32_t required;
+};
+
+constexpr TypeSchema kTypeSchemas[] = {
+    {"hello",   kControlMessageHello,   0},
+    {"goodbye", kControlMessageGoodbye, 0},
+    {"tts",     kControlMessageTts,     FIELD_BIT(kFieldState)},
+    {"stt",     kControlMessageStt,     FIELD_BIT(kFieldText)},
+    {"llm",     kControlMessageLlm,     FIELD_BIT(kFieldEmotion)},
+    {"mcp",     kControlMessageMcp,     FIELD_BIT(kFieldPayload)},
+    {"system",  kControlMessageSystem,  FIELD_BIT(kFieldCommand)},
+    {"alert",   kControlMessageAlert,   FIELD_BIT(kFieldStatus) | FIELD_BIT(kFieldMessage) | FIELD_BIT(kFieldEmotion)},
+    {"custom",  kControlMessageCustom,  FIELD_BIT(kFieldPayload)},
+    {"iot",     kControlMessageIot,     0},
+};
+
+struct StateSchema {
+    std::string_view name;
+    ControlMessageState state;
+};
+
+constexpr StateSchema kStateSchemas[] = {
+    {"start",          kControlMessageStateStart},
+    {"stop",           kControlMessageStateStop},
+    {"sentence_start", kControlMessageStateSentenceStart},
+    {"sentence_end",   kControlMessageStateSentenceEnd},
+};
+
+constexpr uint32_t HashName(std::string_view name) {
+    // FNV-1a
+    uint32_t hash = 2166136261u;
+    for (char c : name) {
+        hash ^= static_cast<uint8_t>(c);
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+// Finds a name of a schema table with a single probe and one comparison.
+// The slots are computed at compile time, see the static_asserts below.
+template <size_t Size>
+struct PerfectHash {
+    int8_t slots[Size] = {};
+    bool perfect = true;
+
+    template <typename T, size_t N>
+    constexpr PerfectHash(const T (&table)[N]) {
+        for (auto& slot : slots) {
+            slot = -1;
+        }
+        for (size_t i = 0; i < N; i++) {
+            auto& slot = slots[HashName(table[i].name) % Size];
+            if (slot != -1) {
+                perfect = false;
+            }
+            slot = i;
+        }
+    }
+
+    template <typename T, size_t N>
+    int Find(const T (&table)[N], std::string_view name) const {
+        int index = slots[HashName(name) % Size];
+        if (index < 0 || table[index].name != name) {
+            return -1;
+        }
+        return index;
+    }
+};
+
+// Increase the size when adding a name makes two of them collide
+constexpr PerfectHash<17> kFieldIndex(kFieldSchemas);
+constexpr PerfectHash<24> kTypeIndex(kTypeSchemas);
+constexpr PerfectHash<8> kStateIndex(kStateSchemas);
+static_assert(kFieldIndex.perfect, "Field names collide, increase the hash table size");
+static_assert(kTypeIndex.perfect, "Message types collide, increase the hash table size");
+static_assert(kStateIndex.perfect, "Message states collide, increase the hash table size");
+
+inline bool IsSpace(char c) {
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+const char* SkipSpace(const char* p, const char* end) {
+    while (p < end && IsSpace(*p)) {
+        p++;
+    }
+    return p;
+}
+
+// p is at the opening quote, returns the closing quote
+const char* SkipString(const char* p, const char* end) {
+    for (p++; p < end; p++) {
+        if (*p == '\\') {
+            p++;
+        } else if (*p == '"') {
+            return p;
+        }
+    }
+    return nullptr;
+}
+
+// p is at '{' or '[', returns the matching bracket
+const char* SkipContainer(const char* p, const char* end) {
+    int depth = 0;
+    for (; p < end; p++) {
+        if (*p == '"') {
+            p = SkipString(p, end);
+            if (p == nullptr) {
+                return nullptr;
+            }
+        } else if (*p == '{' || *p == '[') {
+            depth++;
+        } else if (*p == '}' || *p == ']') {
+            if (--depth == 0) {
+                return p;
+            }
+        }
+    }
+    return nullptr;
+}
+
+bool ParseHex4(std::string_view text, size_t pos, uint32_t& value) {
+    if (pos + 4 > text.size()) {
+        return false;
+    }
+    value = 0;
+    for (size_t i = pos; i < pos + 4; i++) {
+        char c = text[i];
+        value <<= 4;
+        if (c >= '0' && c <= '9') {
+            value |= c - '0';
+        } else if (c >= 'a' && c <= 'f') {
+            value |= c - 'a' + 10;
+        } else if (c >= 'A' && c <= 'F') {
+            value |= c - 'A' + 10;
+        } else {
+            return false;
+        }
+    }
+    return true;
+}
+
+void AppendUtf8(std::string& out, uint32_t code) {
+    if (code < 0x80) {
+        out += static_cast<char>(code);
+    } else if (code < 0x800) {
+        out += static_cast<char>(0xC0 | (code >> 6));
+        out += static_cast<char>(0x80 | (code & 0x3F));
+    } else if (code < 0x10000) {
+        out += static_cast<char>(0xE0 | (code >> 12));
+        out += static_cast<char>(0x80 | ((code >> 6) & 0x3F));
+        out += static_cast<char>(0x80 | (code & 0x3F));
+    } else {
+        out += static_cast<char>(0xF0 | (code >> 18));
+        out += static_cast<char>(0x80 | ((code >> 12) & 0x3F));
+        out += static_cast<char>(0x80 | ((code >> 6) & 0x3F));
+        out += static_cast<char>(0x80 | (code & 0x3F));
+    }
+}
+
+} // namespace
+
+bool ControlMessage::Parse(const char* data, size_t size) {
+    *this = ControlMessage();
+
+    // Only the top level members are tokenized, nested values are kept as raw spans
+    std::string_view values[kFieldCount];
+    uint32_t present = 0;
+    const char* end = data + size;
+    const char* p = SkipSpace(data, end);
+    if (p == end || *p != '{') {
+        return false;
+    }
+    p = SkipSpace(p + 1, end);
+    while (p < end && *p != '}') {
+        if (*p != '"') {
+            return false;
+        }
+        auto key_end = SkipString(p, end);
+        if (key_end == nullptr) {
+            return false;
+        }
+        std::string_view key(p + 1, key_end - p - 1);
+        p = SkipSpace(key_end + 1, end);
+        if (p == end || *p != ':') {
+            return false;
+        }
+        p = SkipSpace(p + 1, end);
+        if (p == end) {
+            return false;
+        }
+
+        JsonKind kind;
+        const char* value_start = p;
+        const char* value_end;
+        if (*p == '"') {
+            kind = kJsonString;
+            value_end = SkipString(p, end);
+            if (value_end == nullptr) {
+                return false;
+            }
+            value_start = p + 1;
+            p = value_end + 1;
+        } else if (*p == '{' || *p == '[') {
+            kind = *p == '{' ? kJsonObject : kJsonArray;
+            value_end = SkipContainer(p, end);
+            if (value_end == nullptr) {
+                return false;
+            }
+            p = ++value_end;
+        } else {
+            kind = kJsonScalar;
+            while (p < end && *p != ',' && *p != '}' && !IsSpace(*p)) {
+                p++;
+            }
+            value_end = p;
+        }
+
+        int field = kFieldIndex.Find(kFieldSchemas, key);
+        if (field >= 0 && kFieldSchemas[field].kind == kind) {
+            values[field] = std::string_view(value_start, value_end - value_start);
+            present |= FIELD_BIT(field);
+        }
+
+        p = SkipSpace(p, end);
+        if (p < end && *p == ',') {
+            p = SkipSpace(p + 1, end);
+        }
+    }
+    if (p == end) {
+        return false;
+    }
+
+    if (!(present & FIELD_BIT(kFieldType))) {
+        ESP_LOGE(TAG, "Missing message type");
+        return false;
+    }
+    type_name = values[kFieldType];
+    session_id = values[kFieldSessionId];
+    text = values[kFieldText];
+    emotion = values[kFieldEmotion];
+    command = values[kFieldCommand];
+    status = values[kFieldStatus];
+    message = values[kFieldMessage];
+    payload = values[kFieldPayload];
+    escaped = true;
+
+    int index = kTypeIndex.Find(kTypeSchemas, type_name);
+    if (index >= 0) {
+        type = kTypeSchemas[index].type;
+        uint32_t missing = kTypeSchemas[index].required & ~present;
+        if (missing != 0) {
+            ESP_LOGW(TAG, "Message %s requires %s", kTypeSchemas[index].name.data(),
+                kFieldSchemas[__builtin_ctz(missing)].name.data());
+            return false;
+        }
+    }
+    if (present & FIELD_BIT(kFieldState)) {
+        index = kStateIndex.Find(kStateSchemas, values[kFieldState]);
+        state = index >= 0 ? kStateSchemas[index].state : kControlMessageStateUnknown;
+    }
+    return true;
+}
+
+std::string ControlMessage::GetString(std::string_view field) const {
+    if (!escaped || field.find('\\') == std::string_view::npos) {
+        return std::string(field);
+    }
+
+    std::string result;
+    result.reserve(field.size());
+    for (size_t i = 0; i < field.size(); i++) {
+        char c = field[i];
+        if (c != '\\' || i + 1 == field.size()) {
+            result += c;
+            continue;
+        }
+        c = field[++i];
+        switch (c) {
+        case 'b': result += '\b'; break;
+        case 'f': result += '\f'; break;
+        case 'n': result += '\n'; break;
+        case 'r': result += '\r'; break;
+        case 't': result += '\t'; break;
+        case 'u': {
+            uint32_t code;
+            if (!ParseHex4(field, i + 1, code)) {
+                break;
+            }
+            i += 4;
+            // Characters outside the BMP come as a surrogate pair
+            uint32_t low;
+            if (code >= 0xD800 && code < 0xDC00 && i + 2 < field.size() && field[i + 1] == '\\' &&
+                field[i + 2] == 'u' && ParseHex4(field, i + 3, low) && low >= 0xDC00 && low < 0xE000) {
+                code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+                i += 6;
+            }
+            AppendUtf8(result, code);
+            break;
+        }
+        default:
+            // \" \\ \/
+            result += c;
+            break;
+        }
+    }
+    return result;
+}
@@ -0,0 +1,56 @@
+#ifndef _CONTROL_MESSAGE_H_
+#define _CONTROL_MESSAGE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+enum ControlMessageType {
+    kControlMessageUnknown,
+    kControlMessageHello,
+    kControlMessageGoodbye,
+    kControlMessageTts,
+    kControlMessageStt,
+    kControlMessageLlm,
+    kControlMessageMcp,
+    kControlMessageSystem,
+    kControlMessageAlert,
+    kControlMessageCustom,
+    kControlMessageIot,
+};
+
+enum ControlMessageState {
+    kControlMessageStateNone,
+    kControlMessageStateUnknown,
+    kControlMessageStateStart,
+    kControlMessageStateStop,
+    kControlMessageStateSentenceStart,
+    kControlMessageStateSentenceEnd,
+};
+
+// A control message received from the server, or built directly by a protocol
+// that does not speak JSON (NeRtc). Parse() tokenizes the JSON text frame in
+// place: the string fields are views into the frame and stay valid only while
+// the frame does, use GetString() to keep a decoded copy.
+struct ControlMessage {
+    ControlMessageType type = kControlMessageUnknown;
+    ControlMessageState state = kControlMessageStateNone;
+    std::string_view type_name;
+    std::string_view session_id;
+    std::string_view text;
+    std::string_view emotion;
+    std::string_view command;
+    std::string_view status;
+    std::string_view message;
+    std::string_view payload;   // Raw JSON, an object (the commands array for iot)
+    // String fields still hold JSON escapes (set by Parse)
+    bool escaped = false;
+
+    // Returns false if the frame is not a JSON object or misses a field required by its type
+    bool Parse(const char* data, size_t size);
+    // Decodes a string field into UTF-8
+    std::string GetString(std::string_view field) const;
+};
+
+#endif // _CONTROL_MESSAGE_H_
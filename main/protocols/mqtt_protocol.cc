@@ -10,6 +10,9 @@
 
 #define TAG "MQTT"
 
+// The server answers a hello quickly, a migration waiting longer is better off with a new session
+#define RESUME_HELLO_TIMEOUT_MS 3000
+
 MqttProtocol::MqttProtocol() {
     event_group_handle_ = xEventGroupCreate();
 
@@ -87,32 +90,26 @@ bool MqttProtocol::StartMqttClient(bool report_error) {
     });
 
     mqtt_->OnMessage([this](const std::string& topic, const std::string& payload) {
-        cJSON* root = cJSON_Parse(payload.c_str());
-        if (root == nullptr) {
-            ESP_LOGE(TAG, "Failed to parse json message %s", payload.c_str());
-            return;
-        }
-        cJSON* type = cJSON_GetObjectItem(root, "type");
-        if (!cJSON_IsString(type)) {
-            ESP_LOGE(TAG, "Message type is invalid");
-            cJSON_Delete(root);
+        ControlMessage message;
+        if (!message.Parse(payload.data(), payload.size())) {
+            ESP_LOGE(TAG, "Invalid message %s", payload.c_str());
             return;
         }
 
-        if (strcmp(type->valuestring, "hello") == 0) {
+        if (message.type == kControlMessageHello) {
+            cJSON* root = cJSON_ParseWithLength(payload.data(), payload.size());
             ParseServerHello(root);
-        } else if (strcmp(type->valuestring, "goodbye") == 0) {
-            auto session_id = cJSON_GetObjectItem(root, "session_id");
-            ESP_LOGI(TAG, "Received goodbye message, session_id: %s", session_id ? session_id->valuestring : "null");
-            if (session_id == nullptr || session_id_ == session_id->valuestring) {
+            cJSON_Delete(root);
+        } else if (message.type == kControlMessageGoodbye) {
+            ESP_LOGI(TAG, "Received goodbye message, session_id: %.*s", (int)message.session_id.size(), message.session_id.data());
+            if (message.session_id.empty() || session_id_ == message.session_id) {
                 Application::GetInstance().Schedule([this]() {
                     CloseAudioChannel();
                 });
             }
-        } else if (on_incoming_json_ != nullptr) {
-            on_incoming_json_(root);
+        } else if (on_incoming_message_ != nullptr) {
+            on_incoming_message_(message);
         }
-        cJSON_Delete(root);
         last_incoming_time_ = std::chrono::steady_clock::now();
     });
 
@@ -216,7 +213,19 @@ bool MqttProtocol::OpenAudioChannel() {
         return false;
     }
 
-    std::lock_guard<std::mutex> lock(channel_mutex_);
+    {
+        std::lock_guard<std::mutex> lock(channel_mutex_);
+        ConnectUdp();
+    }
+
+    if (on_audio_channel_opened_ != nullptr) {
+        on_audio_channel_opened_();
+    }
+    return true;
+}
+
+// Creates the UDP channel of the session on the current network, channel_mutex_ is held
+void MqttProtocol::ConnectUdp() {
     auto network = Board::GetInstance().GetNetwork();
     udp_ = network->CreateUdp(2);
     udp_->OnMessage([this](const std::string& data) {
@@ -266,18 +275,63 @@ bool MqttProtocol::OpenAudioChannel() {
     });
 
     udp_->Connect(udp_server_, udp_port_);
+}
 
-    if (on_audio_channel_opened_ != nullptr) {
-        on_audio_channel_opened_();
+AudioChannelMigration MqttProtocol::MigrateAudioChannel() {
+    std::string session_id;
+    {
+        std::lock_guard<std::mutex> lock(channel_mutex_);
+        if (udp_ == nullptr || session_id_.empty()) {
+            return kAudioChannelLost;
+        }
+        udp_.reset();
+        session_id = session_id_;
     }
-    return true;
+    if (!StartMqttClient(false)) {
+        return kAudioChannelLost;
+    }
+
+    // Ask the server to resume the session on the new connection. A server that kept it answers
+    // with the same session ID, otherwise with a new session. Either way the hello carries the
+    // UDP parameters to use from now on.
+    xEventGroupClearBits(event_group_handle_, MQTT_PROTOCOL_SERVER_HELLO_EVENT);
+    if (!SendText(GetHelloMessage(session_id))) {
+        return kAudioChannelLost;
+    }
+    EventBits_t bits = xEventGroupWaitBits(event_group_handle_, MQTT_PROTOCOL_SERVER_HELLO_EVENT, pdTRUE, pdFALSE,
+        pdMS_TO_TICKS(RESUME_HELLO_TIMEOUT_MS));
+    if (!(bits & MQTT_PROTOCOL_SERVER_HELLO_EVENT)) {
+        ESP_LOGW(TAG, "No answer to resume session %s", session_id.c_str());
+        return kAudioChannelLost;
+    }
+
+    std::lock_guard<std::mutex> lock(channel_mutex_);
+    ConnectUdp();
+    last_incoming_time_ = std::chrono::steady_clock::now();
+    if (session_id_ != session_id) {
+        ESP_LOGW(TAG, "Server did not keep session %s, continuing in %s", session_id.c_str(), session_id_.c_str());
+        return kAudioChannelNewSession;
+    }
+    ESP_LOGI(TAG, "Audio channel migrated, session ID: %s", session_id_.c_str());
+    return kAudioChannelResumed;
+}
+
+void MqttProtocol::ResetConnection() {
+    {
+        std::lock_guard<std::mutex> lock(channel_mutex_);
+        udp_.reset();
+    }
+    StartMqttClient(false);
 }
 
-std::string MqttProtocol::GetHelloMessage() {
-    // 发送 hello 消息申请 UDP 通道
+std::string MqttProtocol::GetHelloMessage(const std::string& resume_session_id) {
+    // 发送 hello 消息申请 UDP 通道，带上 session_id 时请求恢复该会话
     cJSON* root = cJSON_CreateObject();
     cJSON_AddStringToObject(root, "type", "hello");
     cJSON_AddNumberToObject(root, "version", 3);
+    if (!resume_session_id.empty()) {
+        cJSON_AddStringToObject(root, "session_id", resume_session_id.c_str());
+    }
     cJSON_AddStringToObject(root, "transport", "udp");
     cJSON* features = cJSON_CreateObject();
 #if CONFIG_USE_SERVER_AEC
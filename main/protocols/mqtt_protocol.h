@@ -31,6 +31,8 @@ public:
     bool OpenAudioChannel() override;
     void CloseAudioChannel() override;
     bool IsAudioChannelOpened() const override;
+    AudioChannelMigration MigrateAudioChannel() override;
+    void ResetConnection() override;
 
 private:
     EventGroupHandle_t event_group_handle_;
@@ -49,11 +51,12 @@ private:
     esp_timer_handle_t reconnect_timer_;
 
     bool StartMqttClient(bool report_error=false);
+    void ConnectUdp();
     void ParseServerHello(const cJSON* root);
     std::string DecodeHexString(const std::string& hex_string);
 
     bool SendText(const std::string& text) override;
-    std::string GetHelloMessage();
+    std::string GetHelloMessage(const std::string& resume_session_id = "");
 };
 
 
@@ -197,11 +197,11 @@ NeRtcProtocol::NeRtcProtocol() {
     const esp_timer_create_args_t timer_args = {
         .callback = [](void* arg) {
             NeRtcProtocol* instance = static_cast<NeRtcProtocol*>(arg);
-            if (instance) {
-                cJSON* data = cJSON_CreateObject();
-                cJSON_AddStringToObject(data, "type", "system");
-                cJSON_AddStringToObject(data, "command", "sleep");
-                if (instance->on_incoming_json_) instance->on_incoming_json_(data);
+            if (instance && instance->on_incoming_message_) {
+                ControlMessage message;
+                message.type = kControlMessageSystem;
+                message.command = "sleep";
+                instance->on_incoming_message_(message);
             }
         },
         .arg = this,
@@ -415,12 +415,11 @@ void NeRtcProtocol::SendLlmImage(const char* img_url, const int32_t img_len, con
     nertc_ai_llm_image(engine_, request);
     delete request;
 
-    cJSON* data = cJSON_CreateObject();
-    cJSON_AddStringToObject(data, "type", "stt");
-    cJSON_AddStringToObject(data, "text", "llm image sent");
-    if (data) {
-        on_incoming_json_(data);
-        cJSON_Delete(data);
+    if (on_incoming_message_) {
+        ControlMessage message;
+        message.type = kControlMessageStt;
+        message.text = "llm image sent";
+        on_incoming_message_(message);
     }
 }
 
@@ -519,34 +518,29 @@ void NeRtcProtocol::ParseFunctionCall(cJSON* data, std::string& arguments, std::
     }
 }
 
-cJSON* NeRtcProtocol::BuildApplicationAsrProtocol(bool local_user ,const char* text) {
-    cJSON* data = cJSON_CreateObject();
+ControlMessage NeRtcProtocol::BuildApplicationAsrProtocol(bool local_user, const char* text) {
+    ControlMessage message;
     if (local_user) {
-        cJSON_AddStringToObject(data, "type", "stt");
-        cJSON_AddStringToObject(data, "text", text);
+        message.type = kControlMessageStt;
     } else {
-        std::string type    = "tts";
-        std::string state   = "sentence_start";
-        cJSON_AddStringToObject(data, "type", type.c_str());
-        cJSON_AddStringToObject(data, "state", state.c_str());
-        cJSON_AddStringToObject(data, "text", text);
+        message.type = kControlMessageTts;
+        message.state = kControlMessageStateSentenceStart;
     }
-
-    return data;
+    message.text = text;
+    return message;
 }
 
-cJSON* NeRtcProtocol::BuildApplicationTtsStateProtocol(const std::string& event) {
-    cJSON* data = cJSON_CreateObject();
-    cJSON_AddStringToObject(data, "type", "tts");
-    std::string state;
+ControlMessage NeRtcProtocol::BuildApplicationTtsStateProtocol(const std::string& event) {
+    ControlMessage message;
+    message.type = kControlMessageTts;
     if (event == "audio.agent.speech_started") {
-        state = "start";
+        message.state = kControlMessageStateStart;
     } else if (event == "audio.agent.speech_stopped") {
-        state = "stop";
+        message.state = kControlMessageStateStop;
+    } else {
+        message.state = kControlMessageStateUnknown;
     }
-    cJSON_AddStringToObject(data, "state", state.c_str());
-
-    return data;
+    return message;
 }
 
 cJSON* NeRtcProtocol::BuildApplicationIotVolumeProtocol(int volume) {
@@ -561,11 +555,19 @@ cJSON* NeRtcProtocol::BuildApplicationIotVolumeProtocol(int volume) {
     return commands;
 }
 
-cJSON* NeRtcProtocol::BuildApplicationIotStateProtocol(cJSON* commands) {
-    cJSON* data = cJSON_CreateObject();
-    cJSON_AddStringToObject(data, "type", "iot");
-    cJSON_AddItemToObject(data, "commands", commands);
-    return data;
+void NeRtcProtocol::DeliverIotCommands(cJSON* commands) {
+    char* commands_str = cJSON_PrintUnformatted(commands);
+    cJSON_Delete(commands);
+    if (commands_str == nullptr) {
+        return;
+    }
+    if (on_incoming_message_) {
+        ControlMessage message;
+        message.type = kControlMessageIot;
+        message.payload = commands_str;
+        on_incoming_message_(message);
+    }
+    cJSON_free(commands_str);
 }
 
 cJSON* NeRtcProtocol::BuildApplicationXiaoZhiIotProtocol(const std::string& name, cJSON* arguments) {
@@ -614,9 +616,7 @@ cJSON* NeRtcProtocol::BuildApplicationXiaoZhiIotProtocol(const std::string& name
 
     cJSON* commands = cJSON_CreateArray();
     cJSON_AddItemToArray(commands, command);
-
-    cJSON* state = BuildApplicationIotStateProtocol(commands);
-    return state;
+    return commands;
 }
 
 void NeRtcProtocol::OnError(const nertc_sdk_callback_context_t* ctx, nertc_sdk_error_code_e code, const char* msg) {
@@ -714,10 +714,8 @@ void NeRtcProtocol::OnAsrCaptionResult(const nertc_sdk_callback_context_t* ctx,
 
     for (int i = 0; i < result_count; i++) {
         auto result = results[i];
-        cJSON* caption_json = instance->BuildApplicationAsrProtocol(result.is_local_user, result.content);
-        if (caption_json) {
-            if (instance->on_incoming_json_) instance->on_incoming_json_(caption_json);
-            cJSON_Delete(caption_json);
+        if (instance->on_incoming_message_) {
+            instance->on_incoming_message_(instance->BuildApplicationAsrProtocol(result.is_local_user, result.content));
         }
     }
 }
@@ -760,9 +758,9 @@ void NeRtcProtocol::OnAiData(const nertc_sdk_callback_context_t* ctx, nertc_sdk_
                 ESP_LOGW(TAG, "RTC mode, ignore audio.agent.speech_ event");
                 return;
             }
-            cJSON* state_json = instance->BuildApplicationTtsStateProtocol(event_str);
-            if (instance->on_incoming_json_) instance->on_incoming_json_(state_json);
-            cJSON_Delete(state_json);
+            if (instance->on_incoming_message_) {
+                instance->on_incoming_message_(instance->BuildApplicationTtsStateProtocol(event_str));
+            }
             cJSON_Delete(data_json);
             return;
         }
@@ -787,10 +785,7 @@ void NeRtcProtocol::OnAiData(const nertc_sdk_callback_context_t* ctx, nertc_sdk_
             }
             int volume = volume_item->valueint;
             cJSON* commands = instance->BuildApplicationIotVolumeProtocol(volume);
-            cJSON* state_json = instance->BuildApplicationIotStateProtocol(commands);
-            if (instance->on_incoming_json_) instance->on_incoming_json_(state_json);
-
-            cJSON_Delete(state_json);
+            instance->DeliverIotCommands(commands);
             cJSON_Delete(arguments_json);
         } else if (name == "good_bye_call" || name == "Long_Silence") {
             esp_err_t err = esp_timer_start_once(instance->close_timer_, 3 * 1000 * 1000);
@@ -820,15 +815,13 @@ void NeRtcProtocol::OnAiData(const nertc_sdk_callback_context_t* ctx, nertc_sdk_
             ESP_LOGI(TAG, "phone call start name:%s -- number:%s . and stop ai", phone_name.c_str(), phone_number.c_str());
         } else { //尝试转换成到小智通用iot格式
             cJSON* arguments_json = cJSON_Parse(arguments.c_str());
-            cJSON* state_json = instance->BuildApplicationXiaoZhiIotProtocol(name, arguments_json);
-            if (!state_json) {
+            cJSON* commands = instance->BuildApplicationXiaoZhiIotProtocol(name, arguments_json);
+            if (!commands) {
                 ESP_LOGW(TAG, "build xiaozhi iot protocol failed, ignore it");
             } else {
-                if (instance->on_incoming_json_) instance->on_incoming_json_(state_json);
-
-                cJSON_Delete(state_json);
-                cJSON_Delete(arguments_json);
+                instance->DeliverIotCommands(commands);
             }
+            cJSON_Delete(arguments_json);
         }
 
         cJSON_Delete(data_json);
@@ -844,25 +837,21 @@ void NeRtcProtocol::OnAiData(const nertc_sdk_callback_context_t* ctx, nertc_sdk_
             cJSON_Delete(data_json);
             return;
         }
-        std::string emotion = message->valuestring;
-        cJSON* emot_json = cJSON_CreateObject();
-        cJSON_AddStringToObject(emot_json, "type",    "llm");
-        cJSON_AddStringToObject(emot_json, "emotion", emotion.c_str());
-        if (instance->on_incoming_json_) instance->on_incoming_json_(emot_json);
-        cJSON_Delete(emot_json);
+        if (instance->on_incoming_message_) {
+            ControlMessage emotion_message;
+            emotion_message.type = kControlMessageLlm;
+            emotion_message.emotion = message->valuestring;
+            instance->on_incoming_message_(emotion_message);
+        }
         cJSON_Delete(data_json);
     } else if (strncmp(type_str, "mcp", type_len) == 0) {
-        cJSON* payload_obj = cJSON_Parse(data_str);
-        if (!payload_obj) {
-            ESP_LOGE(TAG, "Failed to parse JSON data");
-            return;
+        // The data is the JSON-RPC payload itself, it is parsed once by the MCP server
+        if (instance->on_incoming_message_) {
+            ControlMessage message;
+            message.type = kControlMessageMcp;
+            message.payload = std::string_view(data_str, ai_data->data_len);
+            instance->on_incoming_message_(message);
         }
-
-        cJSON* mcp_json = cJSON_CreateObject();
-        cJSON_AddStringToObject(mcp_json, "type", "mcp");
-        cJSON_AddItemToObject(mcp_json, "payload", payload_obj);
-        if (instance->on_incoming_json_) instance->on_incoming_json_(mcp_json);
-        cJSON_Delete(mcp_json);
     }
 }
 
@@ -889,39 +878,33 @@ void NeRtcProtocol::OnAudioData(const nertc_sdk_callback_context_t* ctx, uint64_
 }
 
 bool NeRtcProtocol::SendText(const std::string& text) {
-    ESP_LOGI(TAG, "SendText: %s", text.c_str());
+    // The AI agent is driven through the SDK calls below, other messages have no equivalent
+    ESP_LOGD(TAG, "SendText ignored: %s", text.c_str());
+    return engine_ != nullptr;
+}
+
+void NeRtcProtocol::SendAbortSpeaking(AbortReason reason) {
+    ESP_LOGI(TAG, "SendAbortSpeaking");
     if (!engine_)
-        return false;
-    cJSON* data_json = cJSON_Parse(text.c_str());
-    cJSON* type_item = cJSON_GetObjectItem(data_json, "type");
-    if (type_item == nullptr || !cJSON_IsString(type_item)) {
-        ESP_LOGE(TAG, "type is null");
-        cJSON_Delete(data_json);
-        return false;
-    }
-    std::string type = type_item->valuestring;
-    if (type == "abort") {
-        nertc_ai_manual_interrupt(engine_);
-        cJSON* state_json = BuildApplicationTtsStateProtocol("audio.agent.speech_stopped");
-        if (on_incoming_json_) on_incoming_json_(state_json);
-        cJSON_Delete(state_json);
-    } else if (type == "listen") {
-        cJSON* state_item = cJSON_GetObjectItem(data_json, "state");
-        if (state_item == nullptr || !cJSON_IsString(state_item)) {
-            ESP_LOGE(TAG, "type is null");
-            cJSON_Delete(data_json);
-            return false;
-        }
-        std::string state = state_item->valuestring;
-        if (state == "start") {
-            nertc_ai_manual_start_listen(engine_);
-        } else if (state == "stop") {
-            nertc_ai_manual_stop_listen(engine_);
-        }
+        return;
+    nertc_ai_manual_interrupt(engine_);
+    if (on_incoming_message_) {
+        on_incoming_message_(BuildApplicationTtsStateProtocol("audio.agent.speech_stopped"));
     }
+}
 
-    cJSON_Delete(data_json);
-    return true;
+void NeRtcProtocol::SendStartListening(ListeningMode mode) {
+    ESP_LOGI(TAG, "SendStartListening");
+    if (!engine_)
+        return;
+    nertc_ai_manual_start_listen(engine_);
+}
+
+void NeRtcProtocol::SendStopListening() {
+    ESP_LOGI(TAG, "SendStopListening");
+    if (!engine_)
+        return;
+    nertc_ai_manual_stop_listen(engine_);
 }
 
 void NeRtcProtocol::SendMcpMessage(const std::string& payload) {
@@ -30,6 +30,9 @@ public:
     bool IsAudioChannelOpened() const override;
     bool SendAudio(std::unique_ptr<AudioStreamPacket> packet) override;
     void SendMcpMessage(const std::string& message) override;
+    void SendAbortSpeaking(AbortReason reason) override;
+    void SendStartListening(ListeningMode mode) override;
+    void SendStopListening() override;
     
     void SetAISleep();
     void SendAecReferenceAudio(std::unique_ptr<AudioStreamPacket> packet) ;
@@ -41,11 +44,12 @@ private:
     void RequestChecksum(std::string& checksum);
     void ParseFunctionCall(cJSON* data, std::string& arguments, std::string& name);
 
-    cJSON* BuildApplicationAsrProtocol(bool local_user ,const char* text);
-    cJSON* BuildApplicationTtsStateProtocol(const std::string& action);
+    ControlMessage BuildApplicationAsrProtocol(bool local_user, const char* text);
+    ControlMessage BuildApplicationTtsStateProtocol(const std::string& action);
+    // The IoT builders return a commands array, DeliverIotCommands takes its ownership
     cJSON* BuildApplicationIotVolumeProtocol(int volume);
-    cJSON* BuildApplicationIotStateProtocol(cJSON* commands);
     cJSON* BuildApplicationXiaoZhiIotProtocol(const std::string& name, cJSON* arguments);
+    void DeliverIotCommands(cJSON* commands);
 
 private:
     static void OnError(const nertc_sdk_callback_context_t* ctx, nertc_sdk_error_code_e code, const char* msg);
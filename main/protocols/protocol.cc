@@ -4,8 +4,8 @@
 
 #define TAG "Protocol"
 
-void Protocol::OnIncomingJson(std::function<void(const cJSON* root)> callback) {
-    on_incoming_json_ = callback;
+void Protocol::OnIncomingMessage(std::function<void(const ControlMessage& message)> callback) {
+    on_incoming_message_ = callback;
 }
 
 void Protocol::OnIncomingAudio(std::function<void(std::unique_ptr<AudioStreamPacket> packet)> callback) {
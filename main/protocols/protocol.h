@@ -7,6 +7,8 @@
 #include <chrono>
 #include <vector>
 
+#include "control_message.h"
+
 struct AudioStreamPacket {
     int sample_rate = 0;
     int frame_duration = 0;
@@ -35,6 +37,13 @@ enum AbortReason {
     kAbortReasonWakeWordDetected
 };
 
+// What became of the audio channel when the board moved to another network interface
+enum AudioChannelMigration {
+    kAudioChannelLost,          // Closed, a new channel has to be opened
+    kAudioChannelResumed,       // Open on the new interface, in the same session
+    kAudioChannelNewSession,    // Open on the new interface, the server started a new session
+};
+
 enum ListeningMode {
     kListeningModeAutoStop,
     kListeningModeManualStop,
@@ -56,7 +65,7 @@ public:
     }
 
     void OnIncomingAudio(std::function<void(std::unique_ptr<AudioStreamPacket> packet)> callback);
-    void OnIncomingJson(std::function<void(const cJSON* root)> callback);
+    void OnIncomingMessage(std::function<void(const ControlMessage& message)> callback);
     void OnAudioChannelOpened(std::function<void()> callback);
     void OnAudioChannelClosed(std::function<void()> callback);
     void OnNetworkError(std::function<void(const std::string& message)> callback);
@@ -67,6 +76,14 @@ public:
     virtual bool OpenAudioChannel() = 0;
     virtual void CloseAudioChannel() = 0;
     virtual bool IsAudioChannelOpened() const = 0;
+    // Hint that a conversation is likely to start soon. Protocols with a
+    // per-conversation transport may connect ahead of time, this can block.
+    virtual void PreConnect() {}
+    // The board moved to another network interface. Moves the open audio channel over, in its
+    // session when the server kept it.
+    virtual AudioChannelMigration MigrateAudioChannel() { return kAudioChannelLost; }
+    // Drops the connections made on the old network interface, without the closed callback
+    virtual void ResetConnection() {}
     virtual bool SendAudio(std::unique_ptr<AudioStreamPacket> packet) = 0;
     virtual void SendWakeWordDetected(const std::string& wake_word);
     virtual void SendStartListening(ListeningMode mode);
@@ -75,7 +92,7 @@ public:
     virtual void SendMcpMessage(const std::string& message);
 
 protected:
-    std::function<void(const cJSON* root)> on_incoming_json_;
+    std::function<void(const ControlMessage& message)> on_incoming_message_;
     std::function<void(std::unique_ptr<AudioStreamPacket> packet)> on_incoming_audio_;
     std::function<void()> on_audio_channel_opened_;
     std::function<void()> on_audio_channel_closed_;
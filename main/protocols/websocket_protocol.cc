@@ -3,6 +3,7 @@
 #include "system_info.h"
 #include "application.h"
 #include "settings.h"
+#include "metrics.h"
 
 #include <cstring>
 #include <cJSON.h>
@@ -12,11 +13,36 @@
 
 #define TAG "WS"
 
+// A kept-alive connection may have been dropped silently by a NAT, do not wait long for it
+#define REUSED_HELLO_TIMEOUT_MS 3000
+#define PRECONNECT_IDLE_SECONDS 10
+
 WebsocketProtocol::WebsocketProtocol() {
     event_group_handle_ = xEventGroupCreate();
+
+    esp_timer_create_args_t idle_timer_args = {
+        .callback = [](void* arg) {
+            auto protocol = static_cast<WebsocketProtocol*>(arg);
+            // Close on the main loop, it is the only task sending on the websocket
+            Application::GetInstance().Schedule([protocol]() {
+                std::unique_lock<std::mutex> lock(protocol->channel_mutex_, std::try_to_lock);
+                if (lock.owns_lock() && !protocol->channel_opened_ && protocol->websocket_ != nullptr) {
+                    ESP_LOGI(TAG, "Closing idle websocket");
+                    protocol->websocket_.reset();
+                }
+            });
+        },
+        .arg = this,
+        .dispatch_method = ESP_TIMER_TASK,
+        .name = "ws_idle",
+        .skip_unhandled_events = true,
+    };
+    ESP_ERROR_CHECK(esp_timer_create(&idle_timer_args, &idle_timer_));
 }
 
 WebsocketProtocol::~WebsocketProtocol() {
+    esp_timer_stop(idle_timer_);
+    esp_timer_delete(idle_timer_);
     vEventGroupDelete(event_group_handle_);
 }
 
@@ -26,6 +52,11 @@ bool WebsocketProtocol::Start() {
 }
 
 bool WebsocketProtocol::SendAudio(std::unique_ptr<AudioStreamPacket> packet) {
+    // Connecting, pre-connecting or resetting replaces websocket_, no audio goes out meanwhile
+    std::unique_lock<std::mutex> lock(channel_mutex_, std::try_to_lock);
+    if (!lock.owns_lock()) {
+        return false;
+    }
     if (websocket_ == nullptr || !websocket_->IsConnected()) {
         return false;
     }
@@ -71,15 +102,143 @@ bool WebsocketProtocol::SendText(const std::string& text) {
     return true;
 }
 
+bool WebsocketProtocol::IsConnected() const {
+    return websocket_ != nullptr && websocket_->IsConnected();
+}
+
 bool WebsocketProtocol::IsAudioChannelOpened() const {
-    return websocket_ != nullptr && websocket_->IsConnected() && !error_occurred_ && !IsTimeout();
+    return channel_opened_ && IsConnected() && !error_occurred_ && !IsTimeout();
 }
 
 void WebsocketProtocol::CloseAudioChannel() {
+    std::lock_guard<std::mutex> lock(channel_mutex_);
+#if CONFIG_WEBSOCKET_IDLE_KEEPALIVE_SECONDS > 0
+    if (channel_opened_ && IsConnected() && !error_occurred_) {
+        // End the session but keep the connection, the next conversation only needs the hello
+        std::string message = "{";
+        message += "\"session_id\":\"" + session_id_ + "\",";
+        message += "\"type\":\"goodbye\"";
+        message += "}";
+        SendText(message);
+        channel_opened_ = false;
+        StartIdleTimer();
+
+        if (on_audio_channel_closed_ != nullptr) {
+            on_audio_channel_closed_();
+        }
+        return;
+    }
+#endif
+    websocket_.reset();
+    channel_opened_ = false;
+}
+
+void WebsocketProtocol::StartIdleTimer() {
+#if CONFIG_WEBSOCKET_IDLE_KEEPALIVE_SECONDS > 0
+    esp_timer_stop(idle_timer_);
+    esp_timer_start_once(idle_timer_, CONFIG_WEBSOCKET_IDLE_KEEPALIVE_SECONDS * 1000000ULL);
+#else
+    // Keep-alive is disabled, only drop a pre-connected socket that was not used
+    esp_timer_stop(idle_timer_);
+    esp_timer_start_once(idle_timer_, PRECONNECT_IDLE_SECONDS * 1000000ULL);
+#endif
+}
+
+void WebsocketProtocol::ResetConnection() {
+    // The session belongs to the connection, it cannot move to another interface
+    std::lock_guard<std::mutex> lock(channel_mutex_);
+    esp_timer_stop(idle_timer_);
+    channel_opened_ = false;
     websocket_.reset();
 }
 
+void WebsocketProtocol::PreConnect() {
+    std::lock_guard<std::mutex> lock(channel_mutex_);
+    if (channel_opened_ || IsConnected()) {
+        return;
+    }
+    ESP_LOGI(TAG, "Pre-connecting websocket");
+    // The user has not asked for anything yet, a failure here must not raise an alert
+    if (Connect(false)) {
+        StartIdleTimer();
+    }
+}
+
 bool WebsocketProtocol::OpenAudioChannel() {
+    std::lock_guard<std::mutex> lock(channel_mutex_);
+    esp_timer_stop(idle_timer_);
+    auto& metrics = Metrics::GetInstance();
+    auto open_start = esp_timer_get_time();
+
+    bool reused = IsConnected() && !error_occurred_;
+    error_occurred_ = false;
+    if (!reused && !Connect()) {
+        return false;
+    }
+    auto connected_time = esp_timer_get_time();
+
+    // Send hello message to describe the client
+    xEventGroupClearBits(event_group_handle_, WEBSOCKET_PROTOCOL_SERVER_HELLO_EVENT);
+    auto message = GetHelloMessage();
+    bool sent = SendText(message);
+    EventBits_t bits = 0;
+    if (sent) {
+        bits = xEventGroupWaitBits(event_group_handle_, WEBSOCKET_PROTOCOL_SERVER_HELLO_EVENT, pdTRUE, pdFALSE,
+            pdMS_TO_TICKS(reused ? REUSED_HELLO_TIMEOUT_MS : 10000));
+    }
+    if (reused && !(bits & WEBSOCKET_PROTOCOL_SERVER_HELLO_EVENT)) {
+        // The kept connection is stale, start over with a new one
+        ESP_LOGW(TAG, "Kept websocket did not answer hello, reconnecting");
+        error_occurred_ = false;
+        websocket_.reset();
+        if (!Connect()) {
+            return false;
+        }
+        reused = false;
+        connected_time = esp_timer_get_time();
+        xEventGroupClearBits(event_group_handle_, WEBSOCKET_PROTOCOL_SERVER_HELLO_EVENT);
+        sent = SendText(message);
+        if (sent) {
+            bits = xEventGroupWaitBits(event_group_handle_, WEBSOCKET_PROTOCOL_SERVER_HELLO_EVENT, pdTRUE, pdFALSE, pdMS_TO_TICKS(10000));
+        }
+    }
+    if (!sent) {
+        return false;
+    }
+    if (!(bits & WEBSOCKET_PROTOCOL_SERVER_HELLO_EVENT)) {
+        ESP_LOGE(TAG, "Failed to receive server hello");
+        SetError(Lang::Strings::SERVER_TIMEOUT);
+        return false;
+    }
+
+    auto now = esp_timer_get_time();
+    int connect_ms = (connected_time - open_start) / 1000;
+    int hello_ms = (now - connected_time) / 1000;
+    // A pre-connected socket saved the connect time but was never a session, it is not a reuse
+    const char* connection = "new connection";
+    if (!reused) {
+        metrics.Observe(kMetricChannelConnectMs, connect_ms);
+    } else if (connection_had_session_) {
+        metrics.Increment(kMetricConnectionReused);
+        connection = "reused";
+    } else {
+        connection = "pre-connected";
+    }
+    metrics.Observe(kMetricChannelHelloMs, hello_ms);
+    ESP_LOGI(TAG, "Audio channel opened in %d ms (%s, connect %d ms, hello %d ms)",
+        (int)((now - open_start) / 1000), connection, connect_ms, hello_ms);
+
+    connection_had_session_ = true;
+
+    channel_opened_ = true;
+    if (on_audio_channel_opened_ != nullptr) {
+        on_audio_channel_opened_();
+    }
+
+    return true;
+}
+
+bool WebsocketProtocol::Connect(bool report_error) {
     Settings settings("websocket", false);
     std::string url = settings.GetString("url");
     std::string token = settings.GetString("token");
@@ -89,6 +248,7 @@ bool WebsocketProtocol::OpenAudioChannel() {
     }
 
     error_occurred_ = false;
+    connection_had_session_ = false;
 
     auto network = Board::GetInstance().GetNetwork();
     websocket_ = network->CreateWebSocket(1);
@@ -145,28 +305,25 @@ bool WebsocketProtocol::OpenAudioChannel() {
                 }
             }
         } else {
-            // Parse JSON data
-            auto root = cJSON_Parse(data);
-            auto type = cJSON_GetObjectItem(root, "type");
-            if (cJSON_IsString(type)) {
-                if (strcmp(type->valuestring, "hello") == 0) {
-                    ParseServerHello(root);
-                } else {
-                    if (on_incoming_json_ != nullptr) {
-                        on_incoming_json_(root);
-                    }
-                }
-            } else {
-                ESP_LOGE(TAG, "Missing message type, data: %s", data);
+            ControlMessage message;
+            if (!message.Parse(data, len)) {
+                ESP_LOGE(TAG, "Invalid message, data: %.*s", (int)len, data);
+            } else if (message.type == kControlMessageHello) {
+                // Only the hello carries nested fields, it is rare enough for a cJSON tree
+                auto root = cJSON_ParseWithLength(data, len);
+                ParseServerHello(root);
+                cJSON_Delete(root);
+            } else if (on_incoming_message_ != nullptr) {
+                on_incoming_message_(message);
             }
-            cJSON_Delete(root);
         }
         last_incoming_time_ = std::chrono::steady_clock::now();
     });
 
     websocket_->OnDisconnected([this]() {
         ESP_LOGI(TAG, "Websocket disconnected");
-        if (on_audio_channel_closed_ != nullptr) {
+        // A kept-alive connection closing between conversations is not a channel close
+        if (channel_opened_ && on_audio_channel_closed_ != nullptr) {
             on_audio_channel_closed_();
         }
     });
@@ -174,28 +331,13 @@ bool WebsocketProtocol::OpenAudioChannel() {
     ESP_LOGI(TAG, "Connecting to websocket server: %s with version: %d", url.c_str(), version_);
     if (!websocket_->Connect(url.c_str())) {
         ESP_LOGE(TAG, "Failed to connect to websocket server");
-        SetError(Lang::Strings::SERVER_NOT_CONNECTED);
-        return false;
-    }
-
-    // Send hello message to describe the client
-    auto message = GetHelloMessage();
-    if (!SendText(message)) {
-        return false;
-    }
-
-    // Wait for server hello
-    EventBits_t bits = xEventGroupWaitBits(event_group_handle_, WEBSOCKET_PROTOCOL_SERVER_HELLO_EVENT, pdTRUE, pdFALSE, pdMS_TO_TICKS(10000));
-    if (!(bits & WEBSOCKET_PROTOCOL_SERVER_HELLO_EVENT)) {
-        ESP_LOGE(TAG, "Failed to receive server hello");
-        SetError(Lang::Strings::SERVER_TIMEOUT);
+        if (report_error) {
+            SetError(Lang::Strings::SERVER_NOT_CONNECTED);
+        } else {
+            websocket_.reset();
+        }
         return false;
     }
-
-    if (on_audio_channel_opened_ != nullptr) {
-        on_audio_channel_opened_();
-    }
-
     return true;
 }
 
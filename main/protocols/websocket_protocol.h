@@ -7,6 +7,8 @@
 #include <web_socket.h>
 #include <freertos/FreeRTOS.h>
 #include <freertos/event_groups.h>
+#include <esp_timer.h>
+#include <mutex>
 
 #define WEBSOCKET_PROTOCOL_SERVER_HELLO_EVENT (1 << 0)
 
@@ -20,12 +22,23 @@ public:
     bool OpenAudioChannel() override;
     void CloseAudioChannel() override;
     bool IsAudioChannelOpened() const override;
+    void PreConnect() override;
+    void ResetConnection() override;
 
 private:
     EventGroupHandle_t event_group_handle_;
     std::unique_ptr<WebSocket> websocket_;
     int version_ = 1;
-
+    // The websocket may outlive the audio channel, see CONFIG_WEBSOCKET_IDLE_KEEPALIVE_SECONDS
+    bool channel_opened_ = false;
+    std::mutex channel_mutex_;
+    esp_timer_handle_t idle_timer_ = nullptr;
+    // Set once a hello succeeded on the current connection, a pre-connected socket has not had one yet
+    bool connection_had_session_ = false;
+
+    bool Connect(bool report_error = true);
+    bool IsConnected() const;
+    void StartIdleTimer();
     void ParseServerHello(const cJSON* root);
     bool SendText(const std::string& text) override;
     std::string GetHelloMessage();
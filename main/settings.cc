@@ -1,45 +1,292 @@
 #include "settings.h"
 
 #include <esp_log.h>
+#include <esp_timer.h>
+#include <esp_system.h>
 #include <nvs_flash.h>
 
+#include <map>
+#include <mutex>
+
 #define TAG "Settings"
 
+// Delay before pending writes are committed, restarted by every new write
+#define SETTINGS_COMMIT_DELAY_MS 3000
+
+namespace {
+
+struct SettingsEntry {
+    nvs_type_t type = NVS_TYPE_ANY;
+    std::string str_value;
+    int32_t int_value = 0;
+    bool dirty = false;
+    bool erased = false;
+};
+
+struct SettingsNamespace {
+    std::map<std::string, SettingsEntry> entries;
+    bool erase_all = false;
+    bool dirty = false;
+};
+
+class SettingsStore {
+public:
+    static SettingsStore& GetInstance() {
+        static SettingsStore instance;
+        return instance;
+    }
+    SettingsStore(const SettingsStore&) = delete;
+    SettingsStore& operator=(const SettingsStore&) = delete;
+
+    bool Get(const std::string& ns, const std::string& key, nvs_type_t type, SettingsEntry& out) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto& space = Load(ns);
+        auto it = space.entries.find(key);
+        if (it == space.entries.end() || it->second.erased || it->second.type != type) {
+            return false;
+        }
+        out = it->second;
+        return true;
+    }
+
+    void Set(const std::string& ns, const std::string& key, nvs_type_t type, const std::string& str_value, int32_t int_value) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto& space = Load(ns);
+        auto& entry = space.entries[key];
+        if (!entry.erased && entry.type == type && entry.str_value == str_value && entry.int_value == int_value) {
+            // Unchanged value, nothing to write
+            return;
+        }
+        entry.type = type;
+        entry.str_value = str_value;
+        entry.int_value = int_value;
+        entry.erased = false;
+        entry.dirty = true;
+        space.dirty = true;
+    }
+
+    void Erase(const std::string& ns, const std::string& key) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto& space = Load(ns);
+        auto it = space.entries.find(key);
+        if (it == space.entries.end() || it->second.erased) {
+            return;
+        }
+        it->second.erased = true;
+        it->second.dirty = true;
+        space.dirty = true;
+    }
+
+    void EraseAll(const std::string& ns) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto& space = Load(ns);
+        space.entries.clear();
+        space.erase_all = true;
+        space.dirty = true;
+    }
+
+    void ScheduleCommit() {
+        esp_timer_stop(commit_timer_);
+        esp_timer_start_once(commit_timer_, SETTINGS_COMMIT_DELAY_MS * 1000);
+    }
+
+    void Invalidate() {
+        esp_timer_stop(commit_timer_);
+        std::lock_guard<std::mutex> lock(mutex_);
+        namespaces_.clear();
+    }
+
+    bool Commit() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        bool success = true;
+        for (auto& [ns, space] : namespaces_) {
+            if (!space.dirty) {
+                continue;
+            }
+            if (!CommitNamespace(ns, space)) {
+                success = false;
+            }
+        }
+        return success;
+    }
+
+private:
+    std::mutex mutex_;
+    std::map<std::string, SettingsNamespace> namespaces_;
+    esp_timer_handle_t commit_timer_ = nullptr;
+
+    SettingsStore() {
+        esp_timer_create_args_t timer_args = {
+            .callback = [](void* arg) {
+                auto self = static_cast<SettingsStore*>(arg);
+                self->Commit();
+            },
+            .arg = this,
+            .dispatch_method = ESP_TIMER_TASK,
+            .name = "settings_commit",
+            .skip_unhandled_events = true,
+        };
+        ESP_ERROR_CHECK(esp_timer_create(&timer_args, &commit_timer_));
+
+        // Persist pending writes on every esp_restart()
+        esp_register_shutdown_handler([]() {
+            SettingsStore::GetInstance().Commit();
+        });
+    }
+
+    // Must be called with mutex_ held
+    SettingsNamespace& Load(const std::string& ns) {
+        auto it = namespaces_.find(ns);
+        if (it != namespaces_.end()) {
+            return it->second;
+        }
+
+        auto& space = namespaces_[ns];
+        nvs_handle_t handle = 0;
+        if (nvs_open(ns.c_str(), NVS_READONLY, &handle) != ESP_OK) {
+            // The namespace does not exist yet, it is created on the first commit
+            return space;
+        }
+
+        nvs_iterator_t iter = nullptr;
+        esp_err_t err = nvs_entry_find(NVS_DEFAULT_PART_NAME, ns.c_str(), NVS_TYPE_ANY, &iter);
+        while (err == ESP_OK) {
+            nvs_entry_info_t info;
+            nvs_entry_info(iter, &info);
+
+            SettingsEntry entry;
+            entry.type = info.type;
+            if (info.type == NVS_TYPE_STR) {
+                size_t length = 0;
+                if (nvs_get_str(handle, info.key, nullptr, &length) == ESP_OK) {
+                    entry.str_value.resize(length);
+                    nvs_get_str(handle, info.key, entry.str_value.data(), &length);
+                    while (!entry.str_value.empty() && entry.str_value.back() == '\0') {
+                        entry.str_value.pop_back();
+                    }
+                    space.entries[info.key] = std::move(entry);
+                }
+            } else if (info.type == NVS_TYPE_I32) {
+                if (nvs_get_i32(handle, info.key, &entry.int_value) == ESP_OK) {
+                    space.entries[info.key] = std::move(entry);
+                }
+            } else if (info.type == NVS_TYPE_U8) {
+                uint8_t value;
+                if (nvs_get_u8(handle, info.key, &value) == ESP_OK) {
+                    entry.int_value = value;
+                    space.entries[info.key] = std::move(entry);
+                }
+            }
+            err = nvs_entry_next(&iter);
+        }
+        nvs_release_iterator(iter);
+        nvs_close(handle);
+
+        ESP_LOGI(TAG, "Loaded namespace %s, %u keys", ns.c_str(), space.entries.size());
+        return space;
+    }
+
+    // Must be called with mutex_ held
+    bool CommitNamespace(const std::string& ns, SettingsNamespace& space) {
+        nvs_handle_t handle = 0;
+        esp_err_t err = nvs_open(ns.c_str(), NVS_READWRITE, &handle);
+        if (err != ESP_OK) {
+            ESP_LOGE(TAG, "Failed to open namespace %s: %s", ns.c_str(), esp_err_to_name(err));
+            return false;
+        }
+
+        if (space.erase_all) {
+            err = nvs_erase_all(handle);
+            if (err != ESP_OK) {
+                ESP_LOGE(TAG, "Failed to erase namespace %s: %s", ns.c_str(), esp_err_to_name(err));
+            }
+        }
+
+        int written = 0;
+        for (auto it = space.entries.begin(); it != space.entries.end();) {
+            auto& [key, entry] = *it;
+            if (!entry.dirty) {
+                ++it;
+                continue;
+            }
+
+            esp_err_t ret = ESP_OK;
+            if (entry.erased) {
+                ret = nvs_erase_key(handle, key.c_str());
+                if (ret == ESP_ERR_NVS_NOT_FOUND) {
+                    ret = ESP_OK;
+                }
+            } else if (entry.type == NVS_TYPE_STR) {
+                ret = nvs_set_str(handle, key.c_str(), entry.str_value.c_str());
+            } else if (entry.type == NVS_TYPE_I32) {
+                ret = nvs_set_i32(handle, key.c_str(), entry.int_value);
+            } else if (entry.type == NVS_TYPE_U8) {
+                ret = nvs_set_u8(handle, key.c_str(), entry.int_value ? 1 : 0);
+            }
+
+            if (ret != ESP_OK) {
+                ESP_LOGE(TAG, "Failed to write %s.%s: %s", ns.c_str(), key.c_str(), esp_err_to_name(ret));
+                err = ret;
+                ++it;
+                continue;
+            }
+            written++;
+            entry.dirty = false;
+            if (entry.erased) {
+                it = space.entries.erase(it);
+            } else {
+                ++it;
+            }
+        }
+
+        esp_err_t commit_err = nvs_commit(handle);
+        nvs_close(handle);
+        if (commit_err != ESP_OK) {
+            ESP_LOGE(TAG, "Failed to commit namespace %s: %s", ns.c_str(), esp_err_to_name(commit_err));
+            return false;
+        }
+        if (err != ESP_OK) {
+            // Keep the namespace dirty so the failed keys are retried on the next commit
+            return false;
+        }
+
+        space.erase_all = false;
+        space.dirty = false;
+        ESP_LOGI(TAG, "Committed namespace %s, %d changes", ns.c_str(), written);
+        return true;
+    }
+};
+
+} // namespace
+
 Settings::Settings(const std::string& ns, bool read_write) : ns_(ns), read_write_(read_write) {
-    nvs_open(ns.c_str(), read_write_ ? NVS_READWRITE : NVS_READONLY, &nvs_handle_);
 }
 
 Settings::~Settings() {
-    if (nvs_handle_ != 0) {
-        if (read_write_ && dirty_) {
-            ESP_ERROR_CHECK(nvs_commit(nvs_handle_));
-        }
-        nvs_close(nvs_handle_);
+    if (read_write_ && dirty_) {
+        SettingsStore::GetInstance().ScheduleCommit();
     }
 }
 
-std::string Settings::GetString(const std::string& key, const std::string& default_value) {
-    if (nvs_handle_ == 0) {
-        return default_value;
-    }
+bool Settings::Flush() {
+    return SettingsStore::GetInstance().Commit();
+}
 
-    size_t length = 0;
-    if (nvs_get_str(nvs_handle_, key.c_str(), nullptr, &length) != ESP_OK) {
-        return default_value;
-    }
+void Settings::Invalidate() {
+    SettingsStore::GetInstance().Invalidate();
+}
 
-    std::string value;
-    value.resize(length);
-    ESP_ERROR_CHECK(nvs_get_str(nvs_handle_, key.c_str(), value.data(), &length));
-    while (!value.empty() && value.back() == '\0') {
-        value.pop_back();
+std::string Settings::GetString(const std::string& key, const std::string& default_value) {
+    SettingsEntry entry;
+    if (!SettingsStore::GetInstance().Get(ns_, key, NVS_TYPE_STR, entry)) {
+        return default_value;
     }
-    return value;
+    return entry.str_value;
 }
 
 void Settings::SetString(const std::string& key, const std::string& value) {
     if (read_write_) {
-        ESP_ERROR_CHECK(nvs_set_str(nvs_handle_, key.c_str(), value.c_str()));
+        SettingsStore::GetInstance().Set(ns_, key, NVS_TYPE_STR, value, 0);
         dirty_ = true;
     } else {
         ESP_LOGW(TAG, "Namespace %s is not open for writing", ns_.c_str());
@@ -47,20 +294,16 @@ void Settings::SetString(const std::string& key, const std::string& value) {
 }
 
 int32_t Settings::GetInt(const std::string& key, int32_t default_value) {
-    if (nvs_handle_ == 0) {
+    SettingsEntry entry;
+    if (!SettingsStore::GetInstance().Get(ns_, key, NVS_TYPE_I32, entry)) {
         return default_value;
     }
-
-    int32_t value;
-    if (nvs_get_i32(nvs_handle_, key.c_str(), &value) != ESP_OK) {
-        return default_value;
-    }
-    return value;
+    return entry.int_value;
 }
 
 void Settings::SetInt(const std::string& key, int32_t value) {
     if (read_write_) {
-        ESP_ERROR_CHECK(nvs_set_i32(nvs_handle_, key.c_str(), value));
+        SettingsStore::GetInstance().Set(ns_, key, NVS_TYPE_I32, "", value);
         dirty_ = true;
     } else {
         ESP_LOGW(TAG, "Namespace %s is not open for writing", ns_.c_str());
@@ -68,20 +311,16 @@ void Settings::SetInt(const std::string& key, int32_t value) {
 }
 
 bool Settings::GetBool(const std::string& key, bool default_value) {
-    if (nvs_handle_ == 0) {
-        return default_value;
-    }
-
-    uint8_t value;
-    if (nvs_get_u8(nvs_handle_, key.c_str(), &value) != ESP_OK) {
+    SettingsEntry entry;
+    if (!SettingsStore::GetInstance().Get(ns_, key, NVS_TYPE_U8, entry)) {
         return default_value;
     }
-    return value != 0;
+    return entry.int_value != 0;
 }
 
 void Settings::SetBool(const std::string& key, bool value) {
     if (read_write_) {
-        ESP_ERROR_CHECK(nvs_set_u8(nvs_handle_, key.c_str(), value ? 1 : 0));
+        SettingsStore::GetInstance().Set(ns_, key, NVS_TYPE_U8, "", value ? 1 : 0);
         dirty_ = true;
     } else {
         ESP_LOGW(TAG, "Namespace %s is not open for writing", ns_.c_str());
@@ -90,10 +329,8 @@ void Settings::SetBool(const std::string& key, bool value) {
 
 void Settings::EraseKey(const std::string& key) {
     if (read_write_) {
-        auto ret = nvs_erase_key(nvs_handle_, key.c_str());
-        if (ret != ESP_ERR_NVS_NOT_FOUND) {
-            ESP_ERROR_CHECK(ret);
-        }
+        SettingsStore::GetInstance().Erase(ns_, key);
+        dirty_ = true;
     } else {
         ESP_LOGW(TAG, "Namespace %s is not open for writing", ns_.c_str());
     }
@@ -101,7 +338,8 @@ void Settings::EraseKey(const std::string& key) {
 
 void Settings::EraseAll() {
     if (read_write_) {
-        ESP_ERROR_CHECK(nvs_erase_all(nvs_handle_));
+        SettingsStore::GetInstance().EraseAll(ns_);
+        dirty_ = true;
     } else {
         ESP_LOGW(TAG, "Namespace %s is not open for writing", ns_.c_str());
     }
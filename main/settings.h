@@ -4,6 +4,11 @@
 #include <string>
 #include <nvs_flash.h>
 
+// Settings is a lightweight view on a process-wide write-back cache.
+// Each namespace is loaded from NVS once, reads are served from RAM and
+// writes are coalesced into a single debounced nvs_commit. Call Flush()
+// before a reboot, deep sleep or power-off to persist pending changes, and
+// Invalidate() after erasing the NVS partition.
 class Settings {
 public:
     Settings(const std::string& ns, bool read_write = false);
@@ -18,9 +23,13 @@ public:
     void EraseKey(const std::string& key);
     void EraseAll();
 
+    // Commit the pending writes of all namespaces to NVS immediately
+    static bool Flush();
+    // Drop the cached namespaces and the pending writes, after nvs_flash_erase()
+    static void Invalidate();
+
 private:
     std::string ns_;
-    nvs_handle_t nvs_handle_ = 0;
     bool read_write_ = false;
     bool dirty_ = false;
 };
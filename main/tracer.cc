@@ -0,0 +1,59 @@
+#include "tracer.h"
+
+#include <esp_log.h>
+
+#define TAG "Tracer"
+
+#if CONFIG_USE_LATENCY_TRACER
+static const char* const EVENT_NAMES[kTraceEventCount] = {
+    "wake_word_detected",
+    "open_audio_channel",
+    "first_uplink_sent",
+    "stt_received",
+    "tts_start_received",
+    "tts_sentence_received",
+    "tts_stop_received",
+    "first_downlink_queued",
+    "first_pcm_decoded",
+    "first_pcm_played",
+};
+
+static const char PHASE_CHARS[] = { 'i', 'B', 'E' };
+#endif
+
+void Tracer::NewTurn() {
+#if CONFIG_USE_LATENCY_TRACER
+    DumpTurn(turn_id_.load(std::memory_order_relaxed));
+    turn_id_.fetch_add(1, std::memory_order_relaxed);
+    first_events_.store(0, std::memory_order_relaxed);
+#endif
+}
+
+void Tracer::EndTurn() {
+#if CONFIG_USE_LATENCY_TRACER
+    DumpTurn(turn_id_.load(std::memory_order_relaxed));
+#endif
+}
+
+void Tracer::DumpTurn(uint32_t turn_id) {
+#if CONFIG_USE_LATENCY_TRACER
+    if (turn_id == 0 || turn_id == dumped_turn_id_) {
+        return;
+    }
+    dumped_turn_id_ = turn_id;
+    // Walk the ring from the oldest slot so the events are printed in order
+    uint32_t head = head_.load(std::memory_order_relaxed);
+    int64_t turn_start = 0;
+    for (uint32_t i = 0; i < TRACE_RING_SIZE; i++) {
+        auto& record = ring_[(head + i) % TRACE_RING_SIZE];
+        if (record.timestamp_us == 0 || record.turn_id != turn_id) {
+            continue;
+        }
+        if (turn_start == 0) {
+            turn_start = record.timestamp_us;
+        }
+        ESP_LOGI(TAG, "TRACE %lu %s %c %lld (+%lld ms)", turn_id, EVENT_NAMES[record.event],
+            PHASE_CHARS[record.phase], record.timestamp_us, (record.timestamp_us - turn_start) / 1000);
+    }
+#endif
+}
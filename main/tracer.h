@@ -0,0 +1,95 @@
+#ifndef _TRACER_H_
+#define _TRACER_H_
+
+#include <atomic>
+#include <cstdint>
+
+#include <esp_timer.h>
+#include "sdkconfig.h"
+
+enum TraceEvent {
+    kTraceWakeWordDetected,
+    kTraceOpenAudioChannel,
+    kTraceFirstUplinkSent,
+    kTraceSttReceived,
+    kTraceTtsStartReceived,
+    kTraceTtsSentenceReceived,
+    kTraceTtsStopReceived,
+    kTraceFirstDownlinkQueued,
+    kTraceFirstPcmDecoded,
+    kTraceFirstPcmPlayed,
+    kTraceEventCount
+};
+
+enum TracePhase : uint8_t {
+    kTracePhaseInstant,
+    kTracePhaseBegin,
+    kTracePhaseEnd,
+};
+
+#define TRACE_RING_SIZE 256
+
+// Conversation latency tracer.
+// Every turn (wake word / button press / continued dialog) gets a correlation
+// ID; events are stored with esp_timer timestamps in a fixed-size ring and
+// dumped as "TRACE <turn> <event> <phase> <us>" log lines when the turn ends.
+// Use scripts/trace_to_chrome.py to convert a monitor log to Chrome trace JSON.
+class Tracer {
+public:
+    static Tracer& GetInstance() {
+        static Tracer instance;
+        return instance;
+    }
+    // 删除拷贝构造函数和赋值运算符
+    Tracer(const Tracer&) = delete;
+    Tracer& operator=(const Tracer&) = delete;
+
+    // Dumps the previous turn and starts a new correlation ID
+    void NewTurn();
+    // Dumps the current turn, each turn is dumped only once
+    void EndTurn();
+    uint32_t turn_id() const { return turn_id_.load(std::memory_order_relaxed); }
+
+    void Record(TraceEvent event, TracePhase phase = kTracePhaseInstant) {
+#if CONFIG_USE_LATENCY_TRACER
+        uint32_t index = head_.fetch_add(1, std::memory_order_relaxed) % TRACE_RING_SIZE;
+        auto& record = ring_[index];
+        record.timestamp_us = esp_timer_get_time();
+        record.turn_id = turn_id_.load(std::memory_order_relaxed);
+        record.event = event;
+        record.phase = phase;
+#endif
+    }
+
+    // Records the event only for the first time in the current turn
+    void RecordFirst(TraceEvent event) {
+#if CONFIG_USE_LATENCY_TRACER
+        uint32_t bit = 1u << event;
+        if ((first_events_.fetch_or(bit, std::memory_order_relaxed) & bit) == 0) {
+            Record(event);
+        }
+#endif
+    }
+
+private:
+    Tracer() = default;
+
+    struct TraceRecord {
+        int64_t timestamp_us;
+        uint32_t turn_id;
+        uint8_t event;
+        uint8_t phase;
+    };
+
+    std::atomic<uint32_t> turn_id_{0};
+    std::atomic<uint32_t> first_events_{0};
+#if CONFIG_USE_LATENCY_TRACER
+    std::atomic<uint32_t> head_{0};
+    uint32_t dumped_turn_id_ = 0;
+    TraceRecord ring_[TRACE_RING_SIZE] = {};
+#endif
+
+    void DumpTurn(uint32_t turn_id);
+};
+
+#endif // _TRACER_H_
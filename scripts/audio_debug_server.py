@@ -1,6 +1,7 @@
 import socket
 import wave
 import argparse
+import threading
 
 
 '''
@@ -8,6 +9,20 @@ import argparse
   Listen for incoming messages and print them to the console.
   Save the audio to a WAV file.
 '''
+def receive_metrics(filename):
+    """
+    设备开启音频调试时，每 10 秒把性能指标快照 (JSON) 发送到 PORT + 1，逐行追加保存
+    """
+    metrics_socket = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+    metrics_socket.bind(('0.0.0.0', 8001))
+    with open(filename, "a") as f:
+        while True:
+            message, address = metrics_socket.recvfrom(8192)
+            f.write(message.decode('utf-8', errors='replace') + "\n")
+            f.flush()
+            print(f"Received metrics snapshot from {address}")
+
+
 def main(samplerate, channels):
     # Create a UDP socket
     server_socket = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
@@ -21,6 +36,7 @@ def main(samplerate, channels):
     wav_file.setframerate(samplerate)   # samplerate parameter
 
     print(f"Start saving audio from 0.0.0.0:8000 to {filename}...")
+    threading.Thread(target=receive_metrics, args=("metrics.jsonl",), daemon=True).start()
 
     try:
         while True:
@@ -0,0 +1,109 @@
+#!/usr/bin/env python3
+"""
+提取设备启动日志中的 BENCHMARK 报告，并与板子的基线对比
+
+需要在 menuconfig 中开启 CONFIG_USE_BENCHMARK，设备启动时输出:
+    I (1234) Benchmark: BENCHMARK {"board":"...","version":"...","cpu_mhz":240,"results":{...}}
+
+用法:
+    idf.py monitor | tee monitor.log
+    # 保存报告并与 scripts/benchmark_baselines/<board>.json 对比，有回归时返回 1
+    python scripts/benchmark_report.py monitor.log -o report.json
+    # 将本次结果保存为新的基线 (仅在确认结果正常后使用)
+    python scripts/benchmark_report.py monitor.log --update-baseline
+
+主机构建 (host/) 的 host_benchmark 输出同样格式的报告，只包含不依赖 ESP-IDF 的用例:
+    build-host/host_benchmark > host.log
+    python scripts/benchmark_report.py host.log
+
+基线文件中每一项可以设置自己的 "tolerance" (相对比例)，否则使用 --tolerance。
+host.json 是在一台开发机上取 5 次运行的中位数，主机上计时波动较大，每项容差为 0.5，
+换了机器请先用 --update-baseline 重新生成。
+"""
+import argparse
+import json
+import os
+import re
+import sys
+
+BASELINE_DIR = os.path.join(os.path.dirname(os.path.abspath(__file__)), "benchmark_baselines")
+REPORT_PATTERN = re.compile(r'BENCHMARK (\{.*\})')
+
+
+def load_report(path):
+    report = None
+    with open(path, 'r', encoding='utf-8', errors='replace') as f:
+        for line in f:
+            match = REPORT_PATTERN.search(line)
+            if match:
+                # Use the last report if the device rebooted several times
+                report = json.loads(match.group(1))
+    if report is None:
+        raise ValueError(f"No BENCHMARK line found in {path}")
+    return report
+
+
+def baseline_path(board):
+    name = re.sub(r'[^\w.-]', '_', board)
+    return os.path.join(BASELINE_DIR, f"{name}.json")
+
+
+def compare(report, baseline, tolerance):
+    regressions = []
+    print(f"{'benchmark':<30} {'baseline':>10} {'current':>10} {'change':>8}")
+    for name, result in report["results"].items():
+        base = baseline["results"].get(name)
+        if base is None:
+            print(f"{name:<30} {'-':>10} {result['us']:>10.1f} {'new':>8}")
+            continue
+        change = (result["us"] - base["us"]) / base["us"] if base["us"] > 0 else 0
+        limit = base.get("tolerance", tolerance)
+        flag = ""
+        if change > limit:
+            flag = "  REGRESSION"
+            regressions.append(name)
+        print(f"{name:<30} {base['us']:>10.1f} {result['us']:>10.1f} {change:>+8.1%}{flag}")
+    return regressions
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Extract and compare on-device benchmark reports")
+    parser.add_argument("log", help="Monitor log containing the BENCHMARK line")
+    parser.add_argument("-o", "--output", help="Save the extracted report as JSON")
+    parser.add_argument("--baseline", help="Baseline file (default: benchmark_baselines/<board>.json)")
+    parser.add_argument("--tolerance", type=float, default=0.10, help="Allowed slowdown ratio (default: 0.10)")
+    parser.add_argument("--update-baseline", action="store_true", help="Store this report as the new baseline")
+    args = parser.parse_args()
+
+    report = load_report(args.log)
+    print(f"Board: {report['board']}, version: {report['version']}, CPU: {report['cpu_mhz']} MHz")
+    if args.output:
+        with open(args.output, 'w') as f:
+            json.dump(report, f, indent=2)
+
+    path = args.baseline or baseline_path(report["board"])
+    if args.update_baseline:
+        os.makedirs(os.path.dirname(path), exist_ok=True)
+        with open(path, 'w') as f:
+            json.dump(report, f, indent=2)
+        print(f"Baseline saved to {path}")
+        return
+
+    if not os.path.exists(path):
+        print(f"No baseline at {path}, run with --update-baseline to create one")
+        return
+
+    with open(path, 'r') as f:
+        baseline = json.load(f)
+    if baseline.get("cpu_mhz") != report.get("cpu_mhz"):
+        print(f"Warning: baseline was recorded at {baseline.get('cpu_mhz')} MHz")
+
+    regressions = compare(report, baseline, args.tolerance)
+    if regressions:
+        print(f"{len(regressions)} benchmark(s) regressed: {', '.join(regressions)}")
+        sys.exit(1)
+    print("No regressions")
+
+
+if __name__ == "__main__":
+    main()
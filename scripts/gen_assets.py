@@ -0,0 +1,119 @@
+#!/usr/bin/env python3
+"""
+打包资源文件为 assets 分区镜像 (asset bundle)
+
+格式 (小端):
+    Header  16 字节: magic 'ASBL', version(u16), count(u16), total_size(u32), index_crc32(u32)
+    Entry   48 字节 * count, 按名称排序便于二分查找:
+            name[32], offset(u32), size(u32), width(u16), height(u16), reserved(u32)
+    Data    每个资源按 4 字节对齐
+
+index_crc32 为 Entry 表的 CRC32 (与 esp_rom_crc32_le(0, ...) 一致)。
+
+输入可以是普通文件，也可以是 LVGLImage 生成的 .c 数组 (例如 main/assets/gif/*.c)，
+后者会被还原为原始数据，资源名为文件名 (不含扩展名)。
+"""
+import argparse
+import os
+import re
+import struct
+import zlib
+
+MAGIC = b'ASBL'
+VERSION = 1
+HEADER_FORMAT = '<4sHHII'
+ENTRY_FORMAT = '<32sIIHHI'
+NAME_MAX = 31
+ALIGN = 4
+
+
+def parse_lvgl_c_array(path):
+    """从 LVGL 图片 .c 文件中提取原始数据与宽高"""
+    with open(path, 'r', encoding='utf-8') as f:
+        source = f.read()
+
+    array = re.search(r'uint8_t\s+\w+_map\[\]\s*=\s*\{(.*?)\};', source, re.S)
+    if array is None:
+        raise ValueError(f"No image map array found in {path}")
+    data = bytes(int(b, 16) for b in re.findall(r'0x([0-9a-fA-F]{2})', array.group(1)))
+
+    size = re.search(r'\.data_size\s*=\s*(\d+)', source)
+    if size is not None:
+        data = data[:int(size.group(1))]
+    width = re.search(r'\.header\.w\s*=\s*(\d+)', source)
+    height = re.search(r'\.header\.h\s*=\s*(\d+)', source)
+    return data, int(width.group(1)) if width else 0, int(height.group(1)) if height else 0
+
+
+def collect_assets(inputs):
+    assets = {}
+    for input_path in inputs:
+        paths = []
+        if os.path.isdir(input_path):
+            paths = [os.path.join(input_path, f) for f in sorted(os.listdir(input_path))]
+        else:
+            paths = [input_path]
+
+        for path in paths:
+            if not os.path.isfile(path):
+                continue
+            file_name = os.path.basename(path)
+            if file_name.endswith('.c'):
+                name = os.path.splitext(file_name)[0]
+                data, width, height = parse_lvgl_c_array(path)
+            else:
+                name = file_name
+                with open(path, 'rb') as f:
+                    data = f.read()
+                width, height = 0, 0
+
+            if len(name) > NAME_MAX:
+                raise ValueError(f"Asset name too long (max {NAME_MAX}): {name}")
+            if name in assets:
+                print(f"Warning: {name} is overridden by {path}")
+            assets[name] = (data, width, height)
+    return assets
+
+
+def pack(assets):
+    names = sorted(assets.keys())
+    header_size = struct.calcsize(HEADER_FORMAT)
+    entry_size = struct.calcsize(ENTRY_FORMAT)
+    offset = header_size + entry_size * len(names)
+
+    entries = b''
+    blobs = b''
+    for name in names:
+        data, width, height = assets[name]
+        padding = (-offset) % ALIGN
+        blobs += b'\0' * padding
+        offset += padding
+        entries += struct.pack(ENTRY_FORMAT, name.encode('utf-8'), offset, len(data), width, height, 0)
+        blobs += data
+        offset += len(data)
+
+    header = struct.pack(HEADER_FORMAT, MAGIC, VERSION, len(names), offset, zlib.crc32(entries) & 0xFFFFFFFF)
+    return header + entries + blobs
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Pack assets into an asset bundle for the assets partition")
+    parser.add_argument("--output", required=True, help="Output bundle file path")
+    parser.add_argument("--max-size", type=lambda x: int(x, 0), default=0, help="Assets partition size in bytes")
+    parser.add_argument("inputs", nargs='+', help="Asset files or directories")
+    args = parser.parse_args()
+
+    assets = collect_assets(args.inputs)
+    bundle = pack(assets)
+    if args.max_size and len(bundle) > args.max_size:
+        print(f"Error: bundle size {len(bundle)} exceeds partition size {args.max_size}")
+        exit(1)
+
+    os.makedirs(os.path.dirname(os.path.abspath(args.output)), exist_ok=True)
+    with open(args.output, 'wb') as f:
+        f.write(bundle)
+    print(f"Packed {len(assets)} assets into {args.output} ({len(bundle)} bytes)")
+
+
+if __name__ == "__main__":
+    main()
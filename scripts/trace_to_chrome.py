@@ -0,0 +1,73 @@
+#!/usr/bin/env python3
+"""
+将设备串口日志中的 TRACE 行转换为 Chrome Trace 格式 (chrome://tracing 或 https://ui.perfetto.dev)
+
+需要在 menuconfig 中开启 CONFIG_USE_LATENCY_TRACER，设备每轮对话结束时输出:
+    I (12345) Tracer: TRACE <turn> <event> <phase> <timestamp_us> (+<ms> ms)
+
+用法:
+    idf.py monitor | tee monitor.log
+    python scripts/trace_to_chrome.py monitor.log -o trace.json
+
+每轮对话显示为一个线程 (turn N)，B/E 事件显示为区间，其余为瞬时事件。
+"""
+import argparse
+import json
+import re
+import sys
+
+TRACE_PATTERN = re.compile(r'TRACE (\d+) (\w+) ([iBE]) (-?\d+)')
+
+
+def parse_log(lines):
+    events = []
+    seen = set()
+    for line in lines:
+        match = TRACE_PATTERN.search(line)
+        if match is None:
+            continue
+        turn, name, phase, timestamp = match.groups()
+        key = (turn, name, phase, timestamp)
+        if key in seen:
+            continue
+        seen.add(key)
+        events.append((int(turn), name, phase, int(timestamp)))
+    return events
+
+
+def to_chrome_trace(events):
+    trace_events = []
+    turns = sorted({turn for turn, _, _, _ in events})
+    for turn in turns:
+        trace_events.append({
+            "name": "thread_name", "ph": "M", "pid": 1, "tid": turn,
+            "args": {"name": f"turn {turn}"},
+        })
+
+    for turn, name, phase, timestamp in sorted(events, key=lambda e: e[3]):
+        event = {"name": name, "ph": phase, "ts": timestamp, "pid": 1, "tid": turn, "args": {"turn": turn}}
+        if phase == 'i':
+            event["s"] = "t"
+        trace_events.append(event)
+    return {"traceEvents": trace_events, "displayTimeUnit": "ms"}
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Convert device TRACE log lines to Chrome trace JSON")
+    parser.add_argument("log", nargs='?', help="Monitor log file (default: stdin)")
+    parser.add_argument("-o", "--output", default="trace.json", help="Output JSON file")
+    args = parser.parse_args()
+
+    if args.log:
+        with open(args.log, 'r', encoding='utf-8', errors='replace') as f:
+            events = parse_log(f)
+    else:
+        events = parse_log(sys.stdin)
+
+    with open(args.output, 'w') as f:
+        json.dump(to_chrome_trace(events), f, indent=1)
+    print(f"Wrote {len(events)} events to {args.output}")
+
+
+if __name__ == "__main__":
+    main()
@@ -431,7 +431,12 @@ void RestartApp() {
             ESP_PARTITION_TYPE_APP,
             ESP_PARTITION_SUBTYPE_APP_OTA_0,
             NULL);
-    ESP_ERROR_CHECK( esp_ota_set_boot_partition(ota0) ); 
+    esp_err_t err = esp_ota_set_boot_partition(ota0);
+    if (err != ESP_OK) {
+        // ota_0 镜像无效（流式升级失败已使其失效），没有旧固件可回退；
+        // nvs 中 app 仍为 ota，重启后 bootloader 回到 factory 重新下载升级
+        ESP_LOGE(TAG, "Failed to set boot partition ota_0: %s, retry OTA from factory after restart", esp_err_to_name(err));
+    }
 
     ESP_LOGI(TAG, "BLUFI configuration completed, restarting...");
     ESP_LOGI(TAG, "BLUFI configuration completed restarting ota_0 partition:%s at offset 0x%lx subtype:%d, restarting...\n",
@@ -14,8 +14,10 @@
 #include <esp_hmac.h>
 #endif
 #include "esp_timer.h"
+#include <spi_flash_mmap.h>
 
 #include <cstring>
+#include <new>
 #include <vector>
 #include <sstream>
 #include <algorithm>
@@ -276,14 +278,21 @@ bool GetNextSafePartition(const esp_partition_t **out)
     return true;
 }
 
-static void compute_md5(const uint8_t *buf, size_t len, uint8_t out[16])
+static void md5_to_hex(const uint8_t md5_sum[16], char out[33])
 {
-    mbedtls_md5_context ctx;
-    mbedtls_md5_init(&ctx);
-    mbedtls_md5_starts(&ctx);
-    mbedtls_md5_update(&ctx, buf, len);
-    mbedtls_md5_finish(&ctx, out);
-    mbedtls_md5_free(&ctx);
+    for (int i = 0; i < 16; ++i) {
+        sprintf(&out[i * 2], "%02x", md5_sum[i]);
+    }
+    out[32] = '\0';
+}
+
+/* 使 ota_0 中残缺的镜像失效，bootloader 校验失败后会回落到 factory(blufi) 重试 */
+static void invalidate_partition(const esp_partition_t *part)
+{
+    esp_err_t err = esp_partition_erase_range(part, 0, SPI_FLASH_SEC_SIZE);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to erase image header of %s: %s", part->label, esp_err_to_name(err));
+    }
 }
 
 bool Ota::Upgrade(const std::string& md5, const std::string& firmware_url) {
@@ -304,19 +313,75 @@ bool Ota::Upgrade(const std::string& md5, const std::string& firmware_url) {
         return false;
     }
     size_t bin_len = http->GetBodyLength();
-    if (bin_len == 0) {
-        ESP_LOGE(TAG, "Content-Length=0");
+    const size_t header_size = sizeof(esp_image_header_t) + sizeof(esp_image_segment_header_t) + sizeof(esp_app_desc_t);
+    if (bin_len < header_size) {
+        ESP_LOGE(TAG, "Content-Length=%u too small", bin_len);
+        return false;
+    }
+    if (bin_len > part->size) {
+        ESP_LOGE(TAG, "Image too large: %u > partition %s size %lu", bin_len, part->label, part->size);
         return false;
     }
 
-    /* 3. 一次性申请 PSRAM 缓存 */
-    uint8_t* bin_buf = (uint8_t*)heap_caps_malloc(bin_len + 100, MALLOC_CAP_SPIRAM);
+    /* 3. PSRAM 放得下整包时先缓存，md5 校验通过后才擦写 OTA_0，失败时 ota_0 中的旧固件保持完好；
+     *    否则边下载边写入 OTA_0，只需一个 4KB 的内部 RAM 缓冲，失败时使残缺镜像失效 */
+    std::unique_ptr<uint8_t, void (*)(void*)> bin_buf((uint8_t*)heap_caps_malloc(bin_len, MALLOC_CAP_SPIRAM), heap_caps_free);
     if (!bin_buf) {
-        ESP_LOGE(TAG, "No enough PSRAM for %u bytes", bin_len);
+        ESP_LOGW(TAG, "No enough PSRAM for %u bytes, stream to %s directly", bin_len, part->label);
+    }
+
+    const size_t buffer_size = 1024 * 4;
+    std::unique_ptr<uint8_t[]> buffer(new (std::nothrow) uint8_t[buffer_size]);
+    if (!buffer) {
+        ESP_LOGE(TAG, "No memory for %u bytes download buffer", buffer_size);
         return false;
     }
 
-    /* 4. 完整下载 */
+    mbedtls_md5_context md5_ctx;
+    mbedtls_md5_init(&md5_ctx);
+    mbedtls_md5_starts(&md5_ctx);
+
+    esp_ota_handle_t h = 0;
+    bool ota_begun = false;
+    std::string image_header;
+
+    // 解析 app 描述，版本相同则不擦写 flash；通过后才开始写 OTA_0
+    auto begin_ota = [&](const uint8_t* header) {
+        esp_app_desc_t new_desc;
+        memcpy(&new_desc, header + sizeof(esp_image_header_t) + sizeof(esp_image_segment_header_t), sizeof(new_desc));
+        if (new_desc.magic_word != ESP_APP_DESC_MAGIC_WORD) {
+            ESP_LOGE(TAG, "Invalid app descriptor magic 0x%lx", new_desc.magic_word);
+            return false;
+        }
+        ESP_LOGI(TAG, "New ver: %s", new_desc.version);
+        if (memcmp(new_desc.version, esp_app_get_description()->version, sizeof(new_desc.version)) == 0) {
+            ESP_LOGW(TAG, "Same version, skip");
+            return false;
+        }
+
+        installing_.store(true);
+        if (esp_ota_begin(part, OTA_WITH_SEQUENTIAL_WRITES, &h) != ESP_OK) {
+            ESP_LOGE(TAG, "ota_begin fail");
+            return false;
+        }
+        ota_begun = true;
+        return true;
+    };
+
+    // 放弃本次写入，使残缺镜像失效；HTTP 连接由 http 析构时关闭
+    auto abort_ota = [&]() {
+        if (ota_begun) {
+            esp_ota_abort(h);
+            invalidate_partition(part);
+        }
+        installing_.store(false);
+        return false;
+    };
+    auto fail = [&]() {
+        mbedtls_md5_free(&md5_ctx);
+        return abort_ota();
+    };
+
     size_t total = 0;
     int ret = 0;
     auto last_time = esp_timer_get_time();
@@ -324,13 +389,8 @@ bool Ota::Upgrade(const std::string& md5, const std::string& firmware_url) {
     int last_bytes = 0;
     int low_speed_count = 0;
 
-    int buffer_size = 1024 * 4;
-    uint8_t* buffer = new uint8_t[buffer_size];
-
     while (total < bin_len) {
-        // 尝试从 HTTP 流中读取数据
-        // ret = http->Read((char*)bin_buf + total, bin_len - total);
-        ret = http->Read((char*)buffer, buffer_size);
+        ret = http->Read((char*)buffer.get(), buffer_size);
 
         auto now = esp_timer_get_time();
         if (now - last_time > 1000000) {
@@ -339,7 +399,6 @@ bool Ota::Upgrade(const std::string& md5, const std::string& firmware_url) {
             if (interval <= 0) interval = 1;
             int speed = (total - last_bytes) / interval;
             last_bytes = total;
-            // 调用回调函数，第二个参数传递本次实际读取的字节数
             if (upgrade_callback_) upgrade_callback_("下载中:", total * 100 / bin_len, speed);
 
             if (speed < 100000 && (total * 100 / bin_len) < 60) { // 小于 100k,进度小于 60
@@ -347,118 +406,111 @@ bool Ota::Upgrade(const std::string& md5, const std::string& firmware_url) {
                 ESP_LOGW(TAG, "Low speed detected: %d bytes/s, count=%d", speed, low_speed_count);
                 if (low_speed_count >= 7) {
                     ESP_LOGE(TAG, "Download speed too low, aborting");
-                    http->Close();
-                    free(bin_buf);
-                    delete[] buffer;
-                    return false;
+                    return fail();
                 }
             } else {
                 low_speed_count = 0;
-            } 
+            }
         }
 
-        if (ret > 0) {
-            // 成功读取到数据
-            memcpy(bin_buf + total, buffer, ret);
-            total += ret;
-        } else if (ret < 0) {
-            // 发生错误
+        if (ret < 0) {
             if (ret == -ESP_ERR_HTTP_EAGAIN) {
-                // 这是“请重试”错误，不是致命的。
-                // 打印一个调试信息，然后继续循环等待数据。
+                // “请重试”错误，不是致命的，短暂延时后继续等待数据
                 ESP_LOGW(TAG, "ESP_ERR_HTTP_EAGAIN, no data available right now, retrying...");
-                // 可以加一个短暂的延时，避免CPU在无数据时空转
-                vTaskDelay(pdMS_TO_TICKS(100)); 
-                continue; // 继续下一次循环
-            } else {
-                // 这是一个真正的、无法恢复的错误
-                ESP_LOGE(TAG, "HTTP read error: %d (%s)", ret, esp_err_to_name(ret));
-                // 发生致命错误，必须终止
-                http->Close();
-                free(bin_buf);
-                return false;
+                vTaskDelay(pdMS_TO_TICKS(100));
+                continue;
             }
-        } else { // ret == 0
-            // 连接被对方正常关闭。如果此时数据还没下完，说明有问题。
+            ESP_LOGE(TAG, "HTTP read error: %d (%s)", ret, esp_err_to_name(ret));
+            return fail();
+        } else if (ret == 0) {
+            // 连接被对方关闭，交给后续的长度检查判断是否完整
             ESP_LOGW(TAG, "Connection closed by peer, but download may be incomplete.");
-            break; // 退出循环，让后续的长度检查来判断是否成功
+            break;
+        }
+        if (total + ret > bin_len) {
+            ESP_LOGE(TAG, "Received more than Content-Length %u", bin_len);
+            return fail();
+        }
+
+        mbedtls_md5_update(&md5_ctx, buffer.get(), ret);
+        if (bin_buf) {
+            memcpy(bin_buf.get() + total, buffer.get(), ret);
+            total += ret;
+            continue;
+        }
+
+        /* 4. 流式写入：凑齐镜像头后再开始写 OTA_0 */
+        if (!ota_begun) {
+            image_header.append((const char*)buffer.get(), ret);
+            if (image_header.size() >= header_size) {
+                if (!begin_ota((const uint8_t*)image_header.data())) {
+                    return fail();
+                }
+                // 把缓存的镜像头一次写入
+                if (esp_ota_write(h, image_header.data(), image_header.size()) != ESP_OK) {
+                    ESP_LOGE(TAG, "ota_write fail");
+                    return fail();
+                }
+                std::string().swap(image_header);
+            }
+            total += ret;
+            continue;
         }
 
-        vTaskDelay(pdMS_TO_TICKS(10)); 
+        if (esp_ota_write(h, buffer.get(), ret) != ESP_OK) {
+            ESP_LOGE(TAG, "ota_write fail");
+            return fail();
+        }
+        total += ret;
     }
 
     auto end_time = esp_timer_get_time();
-    ESP_LOGE(TAG, " Total download time: %.2f seconds\n", (end_time - start_time) / 1000000.0);
-
-    delete[] buffer;
-    buffer = nullptr;
+    ESP_LOGI(TAG, "Total download time: %.2f seconds", (end_time - start_time) / 1000000.0);
 
     http->Close();
     if (total != bin_len) {
         ESP_LOGE(TAG, "Download incomplete %u/%u ret:%d", total, bin_len, ret);
-        free(bin_buf);
-        return false;
+        return fail();
     }
 
-    /* 5. 简单版本校验（可选）*/
-    esp_app_desc_t *new_desc = (esp_app_desc_t *)(bin_buf + sizeof(esp_image_header_t) + sizeof(esp_image_segment_header_t));
-    ESP_LOGI(TAG, "New ver: %s", new_desc->version);
-    if (memcmp(new_desc->version, esp_app_get_description()->version, sizeof(new_desc->version)) == 0) {
-        ESP_LOGW(TAG, "Same version, skip");
-        free(bin_buf);
-        return false;
-    }
-    
-    // 计算 md5
+    /* 5. 校验 md5，不匹配则放弃本次升级 */
     uint8_t md5_sum[16];
-    compute_md5(bin_buf, bin_len, md5_sum);
+    mbedtls_md5_finish(&md5_ctx, md5_sum);
+    mbedtls_md5_free(&md5_ctx);
 
-    /* 如果你想打印成 32 位 HEX 字符串 */
     char md5_str[33];
-    for (int i = 0; i < 16; ++i) {
-        sprintf(&md5_str[i * 2], "%02x", md5_sum[i]);
-    }
-    md5_str[32] = '\0';
-
+    md5_to_hex(md5_sum, md5_str);
     ESP_LOGI(TAG, "Firmware MD5: %s md5_ota:%s", md5_str, md5.c_str());
     if (std::string(md5_str) != md5) {
-        ESP_LOGE(TAG, "MD5 mismatch, abort");
-        free(bin_buf);
-        return false;
+        ESP_LOGE(TAG, "MD5 mismatch, roll back");
+        return abort_ota();
     }
 
-    installing_.store(true);
-    if (upgrade_callback_) upgrade_callback_("准备安装:", 0, 0);
-
-    /* 6. 一次性烧写到 OTA_0 */
-    esp_ota_handle_t h = 0;
-    if (esp_ota_begin(part, bin_len, &h) != ESP_OK) {
-        ESP_LOGE(TAG, "ota_begin fail");
-        free(bin_buf);
-        return false;
-    }
-    int write_size = 4096 * 4;
-    for (size_t i = 0; i < bin_len; i += write_size) {
-        size_t chunk_size = (i + write_size > bin_len) ? (bin_len - i) : write_size;
-        if (esp_ota_write(h, bin_buf + i, chunk_size) != ESP_OK) {
-            ESP_LOGE(TAG, "ota_write fail");
-            esp_ota_abort(h);
-            free(bin_buf);
-            return false;
+    /* 6. 整包缓存的镜像校验通过后才擦写 OTA_0 */
+    if (bin_buf) {
+        if (!begin_ota(bin_buf.get())) {
+            return abort_ota();
+        }
+        const size_t write_size = 64 * 1024;
+        for (size_t offset = 0; offset < bin_len; offset += write_size) {
+            if (upgrade_callback_) upgrade_callback_("安装中:", offset * 100 / bin_len, 0);
+            if (esp_ota_write(h, bin_buf.get() + offset, std::min(write_size, bin_len - offset)) != ESP_OK) {
+                ESP_LOGE(TAG, "ota_write fail");
+                return abort_ota();
+            }
         }
-        // 调用回调函数，第三个参数传递本次实际写入的字节数
-        if (upgrade_callback_) upgrade_callback_("安装中:", (i + chunk_size) * 100 / bin_len, 0);
-        vTaskDelay(pdMS_TO_TICKS(10)); 
     }
-    if (esp_ota_end(h) != ESP_OK) {
-        ESP_LOGE(TAG, "ota_end fail");
-        free(bin_buf);
+
+    if (upgrade_callback_) upgrade_callback_("安装中:", 100, 0);
+    esp_err_t err = esp_ota_end(h);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "ota_end fail: %s", esp_err_to_name(err));
+        invalidate_partition(part);
+        installing_.store(false);
         return false;
     }
 
     installing_.store(false);
-
-    free(bin_buf);
     ESP_LOGI(TAG, "Download & burn OK, restart to take effect");
     return true;        // 由调用方决定何时 esp_restart()
 }